@@ -0,0 +1,368 @@
+#include "boundarymesh.h"
+#include "constants.h"
+
+#include <math.h>
+#include <cfloat>
+#include <algorithm> //for partition
+
+// returns the x, y, or z component of a vec3 for axis 0, 1, or 2
+double axisValue(vec3 &input, int axis){
+    if (axis == 0){
+        return input.x;
+    }
+    else if (axis == 1){
+        return input.y;
+    }
+    return input.z;
+}
+
+// returns which SAH bin a centroid coordinate falls into
+int sahBin(double value, double axismin, double axisextent){
+    int bin = (int)(((value - axismin) / axisextent) * MESH_SAH_BINS);
+    if (bin < 0){
+        bin = 0;
+    }
+    else if (bin >= MESH_SAH_BINS){
+        bin = MESH_SAH_BINS - 1;
+    }
+    return bin;
+}
+
+// expands an axis-aligned bounding box to contain point
+void growBox(vec3 &boxmin, vec3 &boxmax, vec3 &point){
+    boxmin.x = std::min(boxmin.x, point.x);
+    boxmin.y = std::min(boxmin.y, point.y);
+    boxmin.z = std::min(boxmin.z, point.z);
+    boxmax.x = std::max(boxmax.x, point.x);
+    boxmax.y = std::max(boxmax.y, point.y);
+    boxmax.z = std::max(boxmax.z, point.z);
+    return;
+}
+
+// surface area of an axis-aligned bounding box (well, half of it, but we only need to compare them)
+double boxArea(vec3 &boxmin, vec3 &boxmax){
+    double dx = boxmax.x - boxmin.x;
+    double dy = boxmax.y - boxmin.y;
+    double dz = boxmax.z - boxmin.z;
+    return (dx * dy) + (dy * dz) + (dz * dx);
+}
+
+void boundarymesh::Build(std::vector<vec3> &rings, int ringcount){
+    triangles.clear();
+    nodes.clear();
+    built = false;
+
+    // stitch each ring to the next one
+    // each pair of adjacent points on adjacent rings forms a quad, which we split into two triangles
+    triangles.reserve(ringcount * (MESH_RING_POINTS - 1) * 2);
+    for (int ring = 0; ring < ringcount; ring++){
+        int nextring = ring + 1;
+        if (nextring == ringcount){
+            nextring = 0;
+        }
+        for (int k = 0; k < MESH_RING_POINTS - 1; k++){
+            vec3 p00 = rings[(ring * MESH_RING_POINTS) + k];
+            vec3 p01 = rings[(ring * MESH_RING_POINTS) + k + 1];
+            vec3 p10 = rings[(nextring * MESH_RING_POINTS) + k];
+            vec3 p11 = rings[(nextring * MESH_RING_POINTS) + k + 1];
+            meshtriangle tri1;
+            tri1.a = p00;
+            tri1.b = p01;
+            tri1.c = p11;
+            meshtriangle tri2;
+            tri2.a = p00;
+            tri2.b = p11;
+            tri2.c = p10;
+            // skip degenerate triangles (these show up at the black and white poles where all the rings meet)
+            if (CrossProduct(tri1.b - tri1.a, tri1.c - tri1.a).magnitude() > EPSILONZERO){
+                triangles.push_back(tri1);
+            }
+            if (CrossProduct(tri2.b - tri2.a, tri2.c - tri2.a).magnitude() > EPSILONZERO){
+                triangles.push_back(tri2);
+            }
+        }
+    }
+
+    int tricount = triangles.size();
+    if (tricount == 0){
+        return;
+    }
+
+    std::vector<int> order(tricount);
+    std::vector<vec3> centroids(tricount);
+    for (int i = 0; i < tricount; i++){
+        order[i] = i;
+        centroids[i] = (triangles[i].a + triangles[i].b + triangles[i].c) / 3.0;
+    }
+
+    nodes.reserve(2 * ((tricount / MESH_LEAF_SIZE) + 1));
+    maxdepth = 0;
+    BuildNode(order, centroids, 0, tricount, 0);
+    // RayCast() pops one node and pushes two per level, so it needs a stack slot per level plus one
+    if (maxdepth + 1 > MESH_STACK_SIZE){
+        return;
+    }
+
+    // put the triangles in leaf order so each leaf's triangles are contiguous
+    std::vector<meshtriangle> sorted(tricount);
+    for (int i = 0; i < tricount; i++){
+        sorted[i] = triangles[order[i]];
+    }
+    triangles.swap(sorted);
+
+    built = true;
+    return;
+}
+
+void boundarymesh::BuildNode(std::vector<int> &order, std::vector<vec3> &centroids, int first, int count, int depth){
+    if (depth > maxdepth){
+        maxdepth = depth;
+    }
+    bvhnode node;
+    node.boxmin = vec3(DBL_MAX, DBL_MAX, DBL_MAX);
+    node.boxmax = vec3(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    vec3 centroidmin = node.boxmin;
+    vec3 centroidmax = node.boxmax;
+    for (int i = first; i < first + count; i++){
+        meshtriangle &tri = triangles[order[i]];
+        growBox(node.boxmin, node.boxmax, tri.a);
+        growBox(node.boxmin, node.boxmax, tri.b);
+        growBox(node.boxmin, node.boxmax, tri.c);
+        growBox(centroidmin, centroidmax, centroids[order[i]]);
+    }
+
+    int nodeindex = nodes.size();
+
+    // small enough to be a leaf
+    if (count <= MESH_LEAF_SIZE){
+        node.index = first;
+        node.count = count;
+        nodes.push_back(node);
+        return;
+    }
+
+    // otherwise find the best split using the surface area heuristic over a handful of bins per axis
+    // (the mesh is made of long skinny triangles fanning out from the achromatic axis, so a plain median split leaves a lot of overlap there)
+    double bestcost = DBL_MAX;
+    int bestaxis = -1;
+    int bestbin = 0;
+    for (int axis = 0; axis < 3; axis++){
+        double axismin = axisValue(centroidmin, axis);
+        double axisextent = axisValue(centroidmax, axis) - axismin;
+        if (axisextent < EPSILONZERO){
+            continue;
+        }
+        vec3 binmin[MESH_SAH_BINS];
+        vec3 binmax[MESH_SAH_BINS];
+        int bincount[MESH_SAH_BINS];
+        for (int bin = 0; bin < MESH_SAH_BINS; bin++){
+            binmin[bin] = vec3(DBL_MAX, DBL_MAX, DBL_MAX);
+            binmax[bin] = vec3(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+            bincount[bin] = 0;
+        }
+        for (int i = first; i < first + count; i++){
+            int bin = sahBin(axisValue(centroids[order[i]], axis), axismin, axisextent);
+            meshtriangle &tri = triangles[order[i]];
+            growBox(binmin[bin], binmax[bin], tri.a);
+            growBox(binmin[bin], binmax[bin], tri.b);
+            growBox(binmin[bin], binmax[bin], tri.c);
+            bincount[bin]++;
+        }
+        // sweep from the right to get the cost of everything right of each split
+        double rightarea[MESH_SAH_BINS];
+        int rightcount[MESH_SAH_BINS];
+        vec3 sweepmin = vec3(DBL_MAX, DBL_MAX, DBL_MAX);
+        vec3 sweepmax = vec3(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        int sweepcount = 0;
+        for (int bin = MESH_SAH_BINS - 1; bin > 0; bin--){
+            if (bincount[bin] > 0){
+                growBox(sweepmin, sweepmax, binmin[bin]);
+                growBox(sweepmin, sweepmax, binmax[bin]);
+            }
+            sweepcount += bincount[bin];
+            rightarea[bin] = boxArea(sweepmin, sweepmax);
+            rightcount[bin] = sweepcount;
+        }
+        // then sweep from the left and evaluate each split
+        sweepmin = vec3(DBL_MAX, DBL_MAX, DBL_MAX);
+        sweepmax = vec3(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        sweepcount = 0;
+        for (int bin = 0; bin < MESH_SAH_BINS - 1; bin++){
+            if (bincount[bin] > 0){
+                growBox(sweepmin, sweepmax, binmin[bin]);
+                growBox(sweepmin, sweepmax, binmax[bin]);
+            }
+            sweepcount += bincount[bin];
+            if ((sweepcount == 0) || (rightcount[bin + 1] == 0)){
+                continue;
+            }
+            double cost = (boxArea(sweepmin, sweepmax) * sweepcount) + (rightarea[bin + 1] * rightcount[bin + 1]);
+            if (cost < bestcost){
+                bestcost = cost;
+                bestaxis = axis;
+                bestbin = bin;
+            }
+        }
+    }
+
+    int half;
+    if (bestaxis >= 0){
+        // everything in bins up to and including bestbin goes left
+        double axismin = axisValue(centroidmin, bestaxis);
+        double axisextent = axisValue(centroidmax, bestaxis) - axismin;
+        auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&centroids, bestaxis, axismin, axisextent, bestbin](int A){
+            return sahBin(axisValue(centroids[A], bestaxis), axismin, axisextent) <= bestbin;
+        });
+        half = middle - (order.begin() + first);
+    }
+    else {
+        // all the centroids are in the same spot, so just split the list in half
+        half = count / 2;
+    }
+
+    node.index = 0;
+    node.count = 0;
+    nodes.push_back(node);
+    BuildNode(order, centroids, first, half, depth + 1);
+    nodes[nodeindex].index = nodes.size();
+    BuildNode(order, centroids, first + half, count - half, depth + 1);
+    return;
+}
+
+bool boundarymesh::RayCast(vec3 origin, vec3 dir, double mint, double &t){
+    if (!built){
+        return false;
+    }
+
+    // nudge zero direction components so the slab test doesn't wind up computing 0 * infinity
+    vec3 safedir = dir;
+    if (safedir.x == 0.0){
+        safedir.x = EPSILONZERO * EPSILONZERO;
+    }
+    if (safedir.y == 0.0){
+        safedir.y = EPSILONZERO * EPSILONZERO;
+    }
+    if (safedir.z == 0.0){
+        safedir.z = EPSILONZERO * EPSILONZERO;
+    }
+    vec3 invdir = vec3(1.0 / safedir.x, 1.0 / safedir.y, 1.0 / safedir.z);
+    double besthit = DBL_MAX;
+    bool found = false;
+
+    int stack[MESH_STACK_SIZE];
+    int stacksize = 0;
+    stack[stacksize++] = 0;
+    while (stacksize > 0){
+        int nodeindex = stack[--stacksize];
+        bvhnode &node = nodes[nodeindex];
+        if (!rayBoxIntersection(origin, invdir, node.boxmin, node.boxmax, mint, besthit)){
+            continue;
+        }
+        if (node.count > 0){
+            for (int i = node.index; i < node.index + node.count; i++){
+                double hit;
+                if (rayTriangleIntersection(origin, dir, triangles[i], hit) && (hit > mint) && (hit < besthit)){
+                    besthit = hit;
+                    found = true;
+                }
+            }
+        }
+        else {
+            // can't happen as long as Build() checked maxdepth, but don't silently skip part of the tree if it does
+            if (stacksize + 2 > MESH_STACK_SIZE){
+                return false;
+            }
+            // visit the nearer child first so we can cull more of the farther one
+            int leftchild = nodeindex + 1;
+            int rightchild = node.index;
+            double leftnear = rayBoxEntry(origin, invdir, nodes[leftchild].boxmin, nodes[leftchild].boxmax);
+            double rightnear = rayBoxEntry(origin, invdir, nodes[rightchild].boxmin, nodes[rightchild].boxmax);
+            if (leftnear <= rightnear){
+                stack[stacksize++] = rightchild;
+                stack[stacksize++] = leftchild;
+            }
+            else {
+                stack[stacksize++] = leftchild;
+                stack[stacksize++] = rightchild;
+            }
+        }
+    }
+
+    if (found){
+        t = besthit;
+    }
+    return found;
+}
+
+// Moller-Trumbore ray/triangle intersection
+// returns true if the ray intersects the triangle, and stores the ray parameter in t
+// (this is the hot loop, so the vector math is written out by hand rather than calling out to vec3.cpp)
+bool rayTriangleIntersection(vec3 &origin, vec3 &dir, meshtriangle &tri, double &t){
+    double e1x = tri.b.x - tri.a.x;
+    double e1y = tri.b.y - tri.a.y;
+    double e1z = tri.b.z - tri.a.z;
+    double e2x = tri.c.x - tri.a.x;
+    double e2y = tri.c.y - tri.a.y;
+    double e2z = tri.c.z - tri.a.z;
+    // pvec = dir x edge2
+    double px = (dir.y * e2z) - (dir.z * e2y);
+    double py = (dir.z * e2x) - (dir.x * e2z);
+    double pz = (dir.x * e2y) - (dir.y * e2x);
+    double det = (e1x * px) + (e1y * py) + (e1z * pz);
+    if (fabs(det) < EPSILONZERO * EPSILONZERO){
+        return false;
+    }
+    double invdet = 1.0 / det;
+    double tx = origin.x - tri.a.x;
+    double ty = origin.y - tri.a.y;
+    double tz = origin.z - tri.a.z;
+    double u = ((tx * px) + (ty * py) + (tz * pz)) * invdet;
+    // allow a little slop on the edges so rays don't slip through the cracks between triangles
+    if ((u < -EPSILON) || (u > 1.0 + EPSILON)){
+        return false;
+    }
+    // qvec = tvec x edge1
+    double qx = (ty * e1z) - (tz * e1y);
+    double qy = (tz * e1x) - (tx * e1z);
+    double qz = (tx * e1y) - (ty * e1x);
+    double v = ((dir.x * qx) + (dir.y * qy) + (dir.z * qz)) * invdet;
+    if ((v < -EPSILON) || (u + v > 1.0 + EPSILON)){
+        return false;
+    }
+    t = ((e2x * qx) + (e2y * qy) + (e2z * qz)) * invdet;
+    return true;
+}
+
+// returns the ray parameter where the ray enters the axis-aligned bounding box (negative if origin is inside the box)
+double rayBoxEntry(vec3 &origin, vec3 &invdir, vec3 &boxmin, vec3 &boxmax){
+    double t1 = (boxmin.x - origin.x) * invdir.x;
+    double t2 = (boxmax.x - origin.x) * invdir.x;
+    double tnear = std::min(t1, t2);
+    t1 = (boxmin.y - origin.y) * invdir.y;
+    t2 = (boxmax.y - origin.y) * invdir.y;
+    tnear = std::max(tnear, std::min(t1, t2));
+    t1 = (boxmin.z - origin.z) * invdir.z;
+    t2 = (boxmax.z - origin.z) * invdir.z;
+    tnear = std::max(tnear, std::min(t1, t2));
+    return tnear;
+}
+
+// Slab test for ray/axis-aligned-bounding-box intersection.
+// invdir is the componentwise reciprocal of the ray direction.
+// returns true if the ray hits the box somewhere in the range mint to maxt
+bool rayBoxIntersection(vec3 &origin, vec3 &invdir, vec3 &boxmin, vec3 &boxmax, double mint, double maxt){
+    double t1 = (boxmin.x - origin.x) * invdir.x;
+    double t2 = (boxmax.x - origin.x) * invdir.x;
+    double tnear = std::min(t1, t2);
+    double tfar = std::max(t1, t2);
+    t1 = (boxmin.y - origin.y) * invdir.y;
+    t2 = (boxmax.y - origin.y) * invdir.y;
+    tnear = std::max(tnear, std::min(t1, t2));
+    tfar = std::min(tfar, std::max(t1, t2));
+    t1 = (boxmin.z - origin.z) * invdir.z;
+    t2 = (boxmax.z - origin.z) * invdir.z;
+    tnear = std::max(tnear, std::min(t1, t2));
+    tfar = std::min(tfar, std::max(t1, t2));
+    // pad a little for flat boxes and floating point errors
+    return (tfar >= tnear - EPSILONZERO) && (tfar >= mint) && (tnear <= maxt);
+}
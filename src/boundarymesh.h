@@ -0,0 +1,71 @@
+#ifndef BOUNDARYMESH_H
+#define BOUNDARYMESH_H
+
+#include "vec3.h"
+
+#include <vector>
+
+#define MESH_HALF_RING_STEPS 32 // samples from white to cusp and from cusp to black
+#define MESH_RING_POINTS ((2 * MESH_HALF_RING_STEPS) + 1)
+#define MESH_LEAF_SIZE 4 // max triangles in a BVH leaf
+#define MESH_SAH_BINS 16 // candidate split positions per axis when building the BVH
+#define MESH_STACK_SIZE 64 // BVH traversal stack depth (tree depth is ~log2(triangles / leaf size), so this is plenty; Build() refuses a deeper tree)
+
+class meshtriangle{
+public:
+    vec3 a;
+    vec3 b;
+    vec3 c;
+};
+
+class bvhnode{
+public:
+    vec3 boxmin;
+    vec3 boxmax;
+    // for interior nodes, the index of the right child (the left child immediately follows this node)
+    // for leaf nodes, the index of the first triangle
+    int index;
+    // number of triangles for leaf nodes; 0 for interior nodes
+    int count;
+};
+
+// Triangle mesh of a gamut boundary in cartesian Jzazbz, built by stitching together adjacent sampled hue slices,
+// with a bounding volume hierarchy for fast ray casting.
+class boundarymesh{
+public:
+    std::vector<meshtriangle> triangles;
+    std::vector<bvhnode> nodes;
+    int maxdepth = 0; // depth of the deepest BVH node (the root is 0); traversal needs a stack of maxdepth + 1
+    bool built = false;
+
+    // Builds the mesh from rings of boundary points.
+    // rings holds ringcount rings of MESH_RING_POINTS each (in cartesian Jzazbz), ordered from white to black.
+    // The last ring is stitched back to the first ring to close the mesh.
+    // If the BVH comes out too deep for MESH_STACK_SIZE, built is left false, so RayCast() always misses.
+    void Build(std::vector<vec3> &rings, int ringcount);
+
+    // Casts a ray from origin in direction dir, and finds the nearest intersection with the mesh farther than mint.
+    // On a hit, stores the ray parameter (origin + dir * t) in t and returns true.
+    // Returns false (a miss) if the mesh isn't built or the traversal stack overflows.
+    bool RayCast(vec3 origin, vec3 dir, double mint, double &t);
+
+private:
+    // recursively builds the BVH over order[first] through order[first + count - 1]
+    // (order is a permutation of triangle indices that gets sorted into leaf order as we go)
+    // depth is the depth of the node being built, for maxdepth
+    void BuildNode(std::vector<int> &order, std::vector<vec3> &centroids, int first, int count, int depth);
+};
+
+// Moller-Trumbore ray/triangle intersection
+// returns true if the ray intersects the triangle, and stores the ray parameter in t
+bool rayTriangleIntersection(vec3 &origin, vec3 &dir, meshtriangle &tri, double &t);
+
+// returns the ray parameter where the ray enters the axis-aligned bounding box (negative if origin is inside the box)
+double rayBoxEntry(vec3 &origin, vec3 &invdir, vec3 &boxmin, vec3 &boxmax);
+
+// Slab test for ray/axis-aligned-bounding-box intersection.
+// invdir is the componentwise reciprocal of the ray direction.
+// returns true if the ray hits the box somewhere in the range mint to maxt
+bool rayBoxIntersection(vec3 &origin, vec3 &invdir, vec3 &boxmin, vec3 &boxmax, double mint, double maxt);
+
+#endif
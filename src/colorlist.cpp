@@ -0,0 +1,212 @@
+#include "colorlist.h"
+#include "colormisc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+    #define strcasecmp _stricmp
+#else
+    #include <strings.h>
+#endif
+
+int ColorListFormatFromFilename(const char* filename){
+    const char* dot = strrchr(filename, '.');
+    if (dot == NULL){
+        return COLOR_LIST_TEXT;
+    }
+    if (strcasecmp(dot, ".csv") == 0){
+        return COLOR_LIST_CSV;
+    }
+    if ((strcasecmp(dot, ".bin") == 0) || (strcasecmp(dot, ".rgb") == 0) || (strcasecmp(dot, ".raw") == 0)){
+        return COLOR_LIST_BINARY;
+    }
+    return COLOR_LIST_TEXT;
+}
+
+static std::string trim(const std::string &input){
+    size_t start = input.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos){
+        return "";
+    }
+    size_t end = input.find_last_not_of(" \t\r\n");
+    return input.substr(start, end - start + 1);
+}
+
+// parses "0xRRGGBB", "#RRGGBB", or "RRGGBB"; returns -1 if it's not one of those
+static int parsehexcolor(const std::string &input){
+    size_t start = 0;
+    if ((input.size() == 8) && (input[0] == '0') && ((input[1] == 'x') || (input[1] == 'X'))){
+        start = 2;
+    }
+    else if ((input.size() == 7) && (input[0] == '#')){
+        start = 1;
+    }
+    else if (input.size() != 6){
+        return -1;
+    }
+    int output = 0;
+    for (size_t i=start; i<input.size(); i++){
+        if (!isxdigit((unsigned char)input[i])){
+            return -1;
+        }
+        output = (output << 4) | (int)strtol(input.substr(i, 1).c_str(), NULL, 16);
+    }
+    return output;
+}
+
+// parses "red,green,blue" in decimal 0-255; returns -1 if it's not that
+static int parsecsvcolor(const std::string &input){
+    int channels[3];
+    size_t pos = 0;
+    for (int i=0; i<3; i++){
+        size_t comma = input.find(',', pos);
+        if ((i < 2) && (comma == std::string::npos)){
+            return -1;
+        }
+        std::string field = trim(input.substr(pos, (i < 2) ? comma - pos : std::string::npos));
+        if (field.empty() || (field.find_first_not_of("0123456789") != std::string::npos)){
+            return -1;
+        }
+        channels[i] = atoi(field.c_str());
+        if (channels[i] > 255){
+            return -1;
+        }
+        pos = comma + 1;
+    }
+    return (channels[0] << 16) | (channels[1] << 8) | channels[2];
+}
+
+bool colorlist::Read(const char* filename, int listformat){
+    format = listformat;
+    colors.clear();
+    lines.clear();
+    linecolors.clear();
+    FILE* file = fopen(filename, (format == COLOR_LIST_BINARY) ? "rb" : "r");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    if (format == COLOR_LIST_BINARY){
+        unsigned char record[3];
+        size_t got;
+        while ((got = fread(record, 1, 3, file)) == 3){
+            colors.push_back((record[0] << 16) | (record[1] << 8) | record[2]);
+        }
+        fclose(file);
+        if (got != 0){
+            fprintf(stderr, "gamutthingy: %s: file size is not a multiple of 3 bytes\n", filename);
+            return false;
+        }
+        return true;
+    }
+
+    std::string line;
+    int lineno = 0;
+    int c = 0;
+    while (c != EOF){
+        line.clear();
+        while (((c = fgetc(file)) != EOF) && (c != '\n')){
+            line.push_back((char)c);
+        }
+        if ((c == EOF) && line.empty()){
+            break;
+        }
+        lineno++;
+        if (!line.empty() && (line.back() == '\r')){
+            line.pop_back();
+        }
+        std::string trimmed = trim(line);
+        int color = -1;
+        if (format == COLOR_LIST_CSV){
+            color = parsecsvcolor(trimmed);
+            if ((color < 0) && !trimmed.empty() && !((lineno == 1) && !isdigit((unsigned char)trimmed[0]))){
+                fprintf(stderr, "gamutthingy: %s line %i: expected red,green,blue (0-255): %s\n", filename, lineno, line.c_str());
+                fclose(file);
+                return false;
+            }
+        }
+        else {
+            color = parsehexcolor(trimmed);
+            if ((color < 0) && !trimmed.empty() && (trimmed[0] != '#')){
+                fprintf(stderr, "gamutthingy: %s line %i: expected 0xRRGGBB: %s\n", filename, lineno, line.c_str());
+                fclose(file);
+                return false;
+            }
+        }
+        lines.push_back(line);
+        if (color >= 0){
+            linecolors.push_back(colors.size());
+            colors.push_back(color);
+        }
+        else {
+            linecolors.push_back(-1);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+bool colorlist::Write(const char* filename, const std::vector<vec3> &results, bool floats){
+    FILE* file = fopen(filename, (format == COLOR_LIST_BINARY) ? "wb" : "w");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    bool ok = true;
+    if (format == COLOR_LIST_BINARY){
+        for (size_t i=0; (i<results.size()) && ok; i++){
+            unsigned char record[3] = {toRGB8nodither(results[i].x), toRGB8nodither(results[i].y), toRGB8nodither(results[i].z)};
+            ok = (fwrite(record, 1, 3, file) == 3);
+            if (ok && floats){
+                float channels[3] = {(float)results[i].x, (float)results[i].y, (float)results[i].z};
+                ok = (fwrite(channels, sizeof(float), 3, file) == 3);
+            }
+        }
+    }
+    else {
+        for (size_t i=0; (i<lines.size()) && ok; i++){
+            int index = linecolors[i];
+            if (index < 0){
+                // csv header gets columns for the floats
+                if (floats && (format == COLOR_LIST_CSV) && (i == 0) && !lines[i].empty()){
+                    ok = (fprintf(file, "%s,red float,green float,blue float\n", lines[i].c_str()) >= 0);
+                }
+                else {
+                    ok = (fprintf(file, "%s\n", lines[i].c_str()) >= 0);
+                }
+                continue;
+            }
+            const vec3 &result = results[index];
+            int red = toRGB8nodither(result.x);
+            int green = toRGB8nodither(result.y);
+            int blue = toRGB8nodither(result.z);
+            if (format == COLOR_LIST_CSV){
+                ok = (fprintf(file, "%i,%i,%i", red, green, blue) >= 0);
+                if (ok && floats){
+                    ok = (fprintf(file, ",%.9f,%.9f,%.9f", result.x, result.y, result.z) >= 0);
+                }
+            }
+            else {
+                ok = (fprintf(file, "0x%02X%02X%02X", red, green, blue) >= 0);
+                if (ok && floats){
+                    ok = (fprintf(file, " %.9f %.9f %.9f", result.x, result.y, result.z) >= 0);
+                }
+            }
+            if (ok){
+                ok = (fputc('\n', file) != EOF);
+            }
+        }
+    }
+    if (fclose(file) != 0){
+        ok = false;
+    }
+    if (!ok){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+    }
+    return ok;
+}
@@ -0,0 +1,38 @@
+#ifndef COLORLIST_H
+#define COLORLIST_H
+
+#include "constants.h"
+#include "vec3.h"
+
+#include <string>
+#include <vector>
+
+// Lists of RGB8 colors for color list mode, in one of three formats:
+// COLOR_LIST_TEXT: one "0xRRGGBB" (or "#RRGGBB" or "RRGGBB") color per line.
+//     Blank lines and lines starting with # followed by a non-hex character are kept as-is in the output.
+//     Output lines are "0xRRGGBB", or "0xRRGGBB red green blue" with the unclamped floating point results.
+// COLOR_LIST_CSV: one "red,green,blue" color per row, in decimal 0-255. A first row that isn't numbers is taken as a header.
+//     Output rows are "red,green,blue", or "red,green,blue,redfloat,greenfloat,bluefloat" with the unclamped floating point results.
+// COLOR_LIST_BINARY: packed 3-byte RGB records.
+//     Output records are the same, or 3 bytes of RGB followed by 3 native-endian 32-bit floats with the unclamped floating point results.
+// All functions print an error and return false on failure.
+
+// picks a COLOR_LIST_* format from the file extension (.csv, .bin/.rgb/.raw, anything else is text)
+int ColorListFormatFromFilename(const char* filename);
+
+class colorlist{
+public:
+    int format = COLOR_LIST_TEXT;
+    std::vector<int> colors; // 0xRRGGBB
+
+    bool Read(const char* filename, int listformat);
+    // writes results (one per color) in the same format (and for text and csv, with the same non-color lines) as was read
+    bool Write(const char* filename, const std::vector<vec3> &results, bool floats);
+
+private:
+    // for text and csv, every line of the input, and which color (or -1 for none) each line was
+    std::vector<std::string> lines;
+    std::vector<int> linecolors;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "colormisc.h"
+#include "cpudispatch.h"
 #include "constants.h"
 #include "matrix.h"
 
@@ -28,7 +29,7 @@ double clampdouble(double input){
 // often don't line up with the Bayer matrix boundaries.
 // But quasirandom doesn't care where you cut and splice it; it's still balanced.
 // (Blue noise would work too, but that's a huge amount of overhead, while this is a very short function.)
-png_byte quasirandomdither(double input, int x, int y){
+static inline double quasirandomnoise(int x, int y){
     x++; // avoid x=0
     y++; // avoid y=0
     double dummy;
@@ -40,6 +41,11 @@ png_byte quasirandomdither(double input, int x, int y){
         dither = 2.0 - (2.0 * dither);
     }
     // if we ever get exactly 0.5, don't touch it; otherwise we might end up adding 1.0 to a black that means transparency.
+    return dither;
+}
+
+png_byte quasirandomdither(double input, int x, int y){
+    double dither = quasirandomnoise(x, y);
     //int output = (int)((input * 255.0) + dither);
     int output = (int)((input * 256.0) + dither);
     if (output > 255) output = 255;
@@ -47,6 +53,22 @@ png_byte quasirandomdither(double input, int x, int y){
     return (png_byte)output;
 }
 
+png_uint_16 quasirandomdither16(double input, int x, int y){
+    double dither = quasirandomnoise(x, y);
+    int output = (int)((input * 65536.0) + dither);
+    if (output > 65535) output = 65535;
+    if (output < 0) output = 0;
+    return (png_uint_16)output;
+}
+
+png_byte quasirandomditherresidual(png_byte base, float residual, int x, int y){
+    double dither = quasirandomnoise(x, y);
+    int output = (int)(((double)base + (double)residual) + dither);
+    if (output > 255) output = 255;
+    if (output < 0) output = 0;
+    return (png_byte)output;
+}
+
 // return to RGB8 with just rounding
 png_byte toRGB8nodither(double input){
     //int output = (int)((input * 255.0) + 0.5);
@@ -57,6 +79,29 @@ png_byte toRGB8nodither(double input){
     return (png_byte)output;
 }
 
+png_uint_16 toRGB16nodither(double input){
+    int output = BetterADC(input, 65536);
+    return (png_uint_16)output;
+}
+
+// span versions of the above for count values of one channel
+// pixel i is at x coordinate xstart + (i * xstep) for dithering
+static CPU_ALWAYS_INLINE void quasirandomditherspanBody(const double* input, png_byte* output, int count, int xstart, int xstep, int y){
+    for (int i=0; i<count; i++){
+        output[i] = quasirandomdither(input[i], xstart + (i * xstep), y);
+    }
+    return;
+}
+CPUDISPATCH(void, quasirandomditherspan, (const double* input, png_byte* output, int count, int xstart, int xstep, int y), (input, output, count, xstart, xstep, y))
+
+static CPU_ALWAYS_INLINE void toRGB8noditherspanBody(const double* input, png_byte* output, int count){
+    for (int i=0; i<count; i++){
+        output[i] = toRGB8nodither(input[i]);
+    }
+    return;
+}
+CPUDISPATCH(void, toRGB8noditherspan, (const double* input, png_byte* output, int count), (input, output, count))
+
 // sRGB gamma functions
 double togamma(double input){
     if (input <= 0.0031308){
@@ -115,6 +160,223 @@ double rec2084tolinear(double input, double maxnits){
 }
 
 
+// Precomputed transfer function tables
+// settings captured by initializeTransferTables()
+int TransferModeIn = GAMMA_LINEAR;
+int TransferModeOut = GAMMA_LINEAR;
+double TransferPowIn = 1.0;
+double TransferPowOut = 1.0;
+double TransferMaxNits = 200.0;
+bool TransferQuantized8 = false; // togammatable() may use the table
+
+double DAC8Table[256];
+double ToLinear8Table[256];
+int ToGammaTableMinExponent = TRANSFER_TABLE_MIN_EXPONENT;
+double ToGammaTableValue[TRANSFER_TABLE_SIZE];
+double ToGammaTableSlope[TRANSFER_TABLE_SIZE];
+double ToGammaTableMaxError = 0.0;
+
+// The pow() parts of the gamma functions (without the linear segments and clamping), and their derivatives for building the tables
+double srgbtogammacurve(double input){
+    return (1.055 * pow(input, (1.0/2.4))) - 0.055;
+}
+double srgbtogammaslope(double input){
+    return (1.055 / 2.4) * pow(input, (1.0/2.4) - 1.0);
+}
+double powertogammacurve(double input){
+    return pow(input, 1.0 / TransferPowOut);
+}
+double powertogammaslope(double input){
+    return (1.0 / TransferPowOut) * pow(input, (1.0 / TransferPowOut) - 1.0);
+}
+double rec2084togammacurve(double input){
+    const double m1 = 1305.0/8192.0;
+    const double m2 = 2523.0/32.0;
+    const double c1 = 107.0/128.0;
+    const double c2 = 2413.0/128.0;
+    const double c3 = 2392.0/128.0;
+    const double Ym1 = pow(input * (TransferMaxNits / 10000.0), m1);
+    return pow((c1 + (c2 * Ym1)) / (1.0 + (c3 * Ym1)), m2);
+}
+double rec2084togammaslope(double input){
+    const double m1 = 1305.0/8192.0;
+    const double m2 = 2523.0/32.0;
+    const double c1 = 107.0/128.0;
+    const double c2 = 2413.0/128.0;
+    const double c3 = 2392.0/128.0;
+    const double Ym1 = pow(input * (TransferMaxNits / 10000.0), m1);
+    double denominator = 1.0 + (c3 * Ym1);
+    double base = (c1 + (c2 * Ym1)) / denominator;
+    double dbasedY = (c2 - (c1 * c3)) / (denominator * denominator);
+    double dYdinput = (m1 * Ym1) / input;
+    return m2 * pow(base, m2 - 1.0) * dbasedY * dYdinput;
+}
+
+// the exact functions for the chosen modes
+double tolinearexact(double input){
+    if (TransferModeIn == GAMMA_SRGB){
+        return tolinear(input);
+    }
+    else if (TransferModeIn == GAMMA_REC2084){
+        return rec2084tolinear(input, TransferMaxNits);
+    }
+    else if (TransferModeIn == GAMMA_POWER){
+        return pow(input, TransferPowIn);
+    }
+    return input;
+}
+double togammaexact(double input){
+    if (TransferModeOut == GAMMA_SRGB){
+        return togamma(input);
+    }
+    else if (TransferModeOut == GAMMA_REC2084){
+        return rec2084togamma(input, TransferMaxNits);
+    }
+    else if (TransferModeOut == GAMMA_POWER){
+        return pow(input, 1.0 / TransferPowOut);
+    }
+    return input;
+}
+
+bool initializeTransferTables(int gammamodein, double gammapowin, int gammamodeout, double gammapowout, double hdrsdrmaxnits, bool quantized8){
+    TransferModeIn = gammamodein;
+    TransferModeOut = gammamodeout;
+    TransferPowIn = gammapowin;
+    TransferPowOut = gammapowout;
+    TransferMaxNits = hdrsdrmaxnits;
+    TransferQuantized8 = quantized8;
+
+    for (int i=0; i<256; i++){
+        DAC8Table[i] = BetterDAC(i, 256);
+        ToLinear8Table[i] = tolinearexact(DAC8Table[i]);
+    }
+
+    double (*curve)(double) = NULL;
+    double (*slope)(double) = NULL;
+    ToGammaTableMaxError = 0.0;
+    if (gammamodeout == GAMMA_SRGB){
+        ToGammaTableMinExponent = SRGB_TOGAMMA_TABLE_MIN_EXPONENT;
+        curve = srgbtogammacurve;
+        slope = srgbtogammaslope;
+    }
+    else if (gammamodeout == GAMMA_REC2084){
+        ToGammaTableMinExponent = TRANSFER_TABLE_MIN_EXPONENT;
+        curve = rec2084togammacurve;
+        slope = rec2084togammaslope;
+    }
+    else if (gammamodeout == GAMMA_POWER){
+        ToGammaTableMinExponent = TRANSFER_TABLE_MIN_EXPONENT;
+        curve = powertogammacurve;
+        slope = powertogammaslope;
+    }
+    if (quantized8 && (curve != NULL)){
+        OctaveTableBuild(ToGammaTableMinExponent, TRANSFER_TABLE_MAX_EXPONENT, ToGammaTableValue, ToGammaTableSlope, curve, slope);
+        ToGammaTableMaxError = OctaveTableMaxError(ToGammaTableMinExponent, TRANSFER_TABLE_MAX_EXPONENT, ToGammaTableValue, ToGammaTableSlope, curve, 1.0);
+    }
+
+    // the quantization guard only works if the output table is more accurate than the guard
+    // (this also catches NaN)
+    return (ToGammaTableMaxError < TRANSFER_TABLE_GUARD);
+}
+
+// The lookups are always inlined so the span functions below get a copy compiled for each instruction set level;
+// the exact-function fallbacks stay out of line.
+// initializeTransferTables() must be run once before this can be used.
+static CPU_ALWAYS_INLINE double tolineartableBody(double input){
+    // 8-bit input is a straight lookup
+    if ((input >= 0.0) && (input <= 1.0)){
+        unsigned int code = BetterADC(input, 256);
+        if (DAC8Table[code] == input){
+            return ToLinear8Table[code];
+        }
+    }
+    return tolinearexact(input);
+}
+
+static CPU_ALWAYS_INLINE double togammatableBody(double input){
+    // the table is only good enough when the output is quantized to 8 bits without dithering
+    if (!TransferQuantized8){
+        return togammaexact(input);
+    }
+    double output;
+    if (TransferModeOut == GAMMA_SRGB){
+        if (input <= 0.0031308){
+            return clampdouble(input * 12.92);
+        }
+        if (!OctaveTableInRange(input, ToGammaTableMinExponent, TRANSFER_TABLE_MAX_EXPONENT)){
+            return togamma(input);
+        }
+        output = clampdouble(OctaveTableLookup(input, ToGammaTableMinExponent, ToGammaTableValue, ToGammaTableSlope));
+    }
+    else if (TransferModeOut == GAMMA_REC2084){
+        input = clampdouble(input);
+        if (!OctaveTableInRange(input, ToGammaTableMinExponent, TRANSFER_TABLE_MAX_EXPONENT)){
+            return rec2084togamma(input, TransferMaxNits);
+        }
+        output = clampdouble(OctaveTableLookup(input, ToGammaTableMinExponent, ToGammaTableValue, ToGammaTableSlope));
+    }
+    else if (TransferModeOut == GAMMA_POWER){
+        if (!OctaveTableInRange(input, ToGammaTableMinExponent, TRANSFER_TABLE_MAX_EXPONENT)){
+            return pow(input, 1.0 / TransferPowOut);
+        }
+        output = OctaveTableLookup(input, ToGammaTableMinExponent, ToGammaTableValue, ToGammaTableSlope);
+    }
+    else {
+        return input;
+    }
+    // if we're close enough to an 8-bit quantization boundary that the table error might put us in the wrong bin, do it the slow way
+    double scaled = output * 256.0;
+    if (fabs(scaled - nearbyint(scaled)) < (TRANSFER_TABLE_GUARD * 256.0)){
+        return togammaexact(input);
+    }
+    return output;
+}
+
+double tolineartable(double input){
+    return tolineartableBody(input);
+}
+
+double togammatable(double input){
+    return togammatableBody(input);
+}
+
+vec3 tolineartablevec3(vec3 input){
+    return vec3(tolineartable(input.x), tolineartable(input.y), tolineartable(input.z));
+}
+
+vec3 togammatablevec3(vec3 input){
+    return vec3(togammatable(input.x), togammatable(input.y), togammatable(input.z));
+}
+
+// (the span functions are compiled for each instruction set level; see cpudispatch.h)
+static CPU_ALWAYS_INLINE void tolineartablespanBody(double* values, int count){
+    for (int i=0; i<count; i++){
+        values[i] = tolineartableBody(values[i]);
+    }
+    return;
+}
+CPUDISPATCH(void, tolineartablespan, (double* values, int count), (values, count))
+
+static CPU_ALWAYS_INLINE void togammatablespanBody(double* values, int count){
+    for (int i=0; i<count; i++){
+        values[i] = togammatableBody(values[i]);
+    }
+    return;
+}
+CPUDISPATCH(void, togammatablespan, (double* values, int count), (values, count))
+
+// prints the measured max absolute error of the tables vs. the exact functions
+void TransferTableErrorReport(){
+    if (TransferQuantized8){
+        printf("Output gamma table max error: %e (undithered 8-bit output is exact)\n", ToGammaTableMaxError);
+    }
+    else {
+        printf("Output gamma table not used (output isn't undithered 8-bit)\n");
+    }
+    return;
+}
+
+
 // Calculate angleA minus angleB assuming both are in range 0 to 2pi radians
 // Answer will be in range -pi to +pi radians.
 double AngleDiff(double angleA, double angleB){
@@ -3,6 +3,7 @@
 
 #include "vec3.h"
 #include "vec2.h"
+#include "octavetable.h"
 
 #include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
 
@@ -12,10 +13,22 @@ double clampdouble(double input);
 
 // convert a 0-1 double value to 0-255 png_byte value with Martin Roberts' quasirandom dithering
 png_byte quasirandomdither(double input, int x, int y);
+// same, for an input stored as base = toRGB8nodither(input) and residual = (input * 256) - base, rounded to float
+// (matches quasirandomdither() except where the rounding of the residual crosses a dither threshold)
+png_byte quasirandomditherresidual(png_byte base, float residual, int x, int y);
 
 // return to RGB8 with just rounding
 png_byte toRGB8nodither(double input);
 
+// 16-bit versions of the above (0-65535, for --png16)
+png_uint_16 quasirandomdither16(double input, int x, int y);
+png_uint_16 toRGB16nodither(double input);
+
+// span versions of the above for count values of one channel
+// for dithering, value i is at x coordinate xstart + (i * xstep)
+void quasirandomditherspan(const double* input, png_byte* output, int count, int xstart, int xstep, int y);
+void toRGB8noditherspan(const double* input, png_byte* output, int count);
+
 // sRGB gamma functions
 double togamma(double input);
 double tolinear(double input);
@@ -24,6 +37,34 @@ double tolinear(double input);
 double rec2084togamma(double input, double maxnits);
 double rec2084tolinear(double input, double maxnits);
 
+// Precomputed transfer function tables
+// Built once per run by initializeTransferTables() for the chosen input and output gamma modes.
+// tolineartable() is a straight table lookup of the exact function's output for the 256 BetterDAC() values of 8-bit input,
+// and uses the exact function for anything else (LUT grid points, 16-bit input, etc.), so it always matches the exact function.
+// togammatable() uses octave tables (see octavetable.h) of the pow() part of the output gamma function, but only if quantized8 was set,
+// meaning the run's only output is undithered RGB8. Otherwise it uses the exact function.
+// The table error (measured by initializeTransferTables(); about 1e-10) is far below the 8-bit quantization step,
+// and any output within TRANSFER_TABLE_GUARD of a quantization boundary is redone with the exact function,
+// so the undithered RGB8 output is identical to using the exact function.
+// Linear input/output needs no table. Until initializeTransferTables() is run, both modes are linear and both functions return their input unchanged.
+#define TRANSFER_TABLE_MIN_EXPONENT -30 // pow() inputs below 2^-30 use the exact function
+#define TRANSFER_TABLE_MAX_EXPONENT 1 // pow() inputs at or above 2 use the exact function
+#define SRGB_TOGAMMA_TABLE_MIN_EXPONENT -9 // the sRGB pow() segment starts at 0.0031308 (> 2^-9)
+#define TRANSFER_TABLE_SIZE OCTAVE_TABLE_SIZE(TRANSFER_TABLE_MIN_EXPONENT, TRANSFER_TABLE_MAX_EXPONENT)
+#define TRANSFER_TABLE_GUARD 1e-8
+bool initializeTransferTables(int gammamodein, double gammapowin, int gammamodeout, double gammapowout, double hdrsdrmaxnits, bool quantized8);
+double tolineartable(double input);
+double togammatable(double input);
+vec3 tolineartablevec3(vec3 input);
+vec3 togammatablevec3(vec3 input);
+// span versions for count values, in place
+void tolineartablespan(double* values, int count);
+void togammatablespan(double* values, int count);
+// BetterDAC(i, 256) for 8-bit input
+extern double DAC8Table[256];
+// prints the measured max absolute error of the output table vs. the exact function
+void TransferTableErrorReport();
+
 // Calculate angleA minus angleB assuming both are in range 0 to 2pi radians
 // Answer will be in range -pi to +pi radians.
 double AngleDiff(double angleA, double angleB);
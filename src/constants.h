@@ -33,6 +33,49 @@
 #define RMZONE_DELTA_BASED 0
 #define RMZONE_DEST_BASED 1
 
+#define BOUNDARY_SLICE 0 // intersect two adjacent sampled 2D hue slices and interpolate
+#define BOUNDARY_EXACT 1 // root-find where the focal ray leaves the linear RGB cube (gamuts without CRT emulation only)
+#define EXACT_BOUNDARY_MAX_ITERATIONS 100
+#define EXACT_BOUNDARY_TOLERANCE 1e-12 // in ray parameter units (i.e., fraction of the distance from focal point to color)
+#define BOUNDARY_BENCHMARK_SAMPLES 200000
+
+#define PQ_EXACT 0 // pow()
+#define PQ_FAST 1 // cubic interpolation in precomputed tables
+
+#define PRECISION_DOUBLE 0
+#define PRECISION_FLOAT 1 // single precision batch Jzazbz conversions
+
+// image file formats
+#define IMAGE_FORMAT_AUTO -1 // pick from the file extension
+#define IMAGE_FORMAT_PNG 0
+#define IMAGE_FORMAT_PPM 1 // binary netpbm RGB (P6)
+#define IMAGE_FORMAT_PAM 2 // netpbm PAM (P7) RGB or RGB_ALPHA
+#define IMAGE_FORMAT_RAW_RGB 3 // headerless 3 bytes per pixel
+#define IMAGE_FORMAT_RAW_RGBA 4 // headerless 4 bytes per pixel
+
+// frame stream mode
+#define FRAME_STREAM_NONE 0
+#define FRAME_STREAM_RGB24 1 // headerless raw RGB24 frames
+#define FRAME_STREAM_Y4M 2 // yuv4mpeg2
+#define Y4M_MATRIX_BT601 0
+#define Y4M_MATRIX_BT709 1
+
+// color list formats
+#define COLOR_LIST_AUTO -1 // pick from the file extension
+#define COLOR_LIST_TEXT 0 // 0xRRGGBB per line
+#define COLOR_LIST_CSV 1 // red,green,blue per row
+#define COLOR_LIST_BINARY 2 // packed 3-byte RGB
+
+// interpolation for applying a LUT
+#define LUT_INTERPOLATE_TRILINEAR 0
+#define LUT_INTERPOLATE_TETRAHEDRAL 1
+
+// zlib strategies for PNG output (same values as zlib's)
+#define PNG_STRATEGY_DEFAULT 0 // Z_DEFAULT_STRATEGY
+#define PNG_STRATEGY_FILTERED 1 // Z_FILTERED (libpng's default for filtered rows)
+#define PNG_STRATEGY_HUFFMAN 2 // Z_HUFFMAN_ONLY
+#define PNG_STRATEGY_RLE 3 // Z_RLE
+
 #define RETURN_SUCCESS 0
 #define ERROR_BAD_PARAM_BOOL 1
 #define ERROR_BAD_PARAM_STRING 2
@@ -54,6 +97,17 @@
 #define ERROR_PNG_OPEN_FAIL 18
 #define GAMUT_INITIALIZE_FAIL 19
 #define GAMUT_INITIALIZE_FAIL_SPIRAL 20
+#define ERROR_PQ_TABLE_FAIL 21
+#define ERROR_TRANSFER_TABLE_FAIL 22
+#define ERROR_CPU_LEVEL_UNSUPPORTED 23
+#define ERROR_IMAGE_READ_FAIL 24
+#define ERROR_IMAGE_WRITE_FAIL 25
+#define ERROR_FRAME_STREAM_FAIL 26
+#define ERROR_BATCH_LIST_FAIL 27
+#define ERROR_JOB_FILE_FAIL 28
+#define ERROR_SERVER_FAIL 29
+#define ERROR_COLOR_LIST_FAIL 30
+#define ERROR_LUT_APPLY_FAIL 31
 
 #define GAMMA_LINEAR 0
 #define GAMMA_SRGB 1
@@ -0,0 +1,213 @@
+#include "conversionplan.h"
+#include "constants.h"
+#include "colormisc.h"
+#include "crtemulation.h"
+#include "matrix.h"
+#include "lutapply.h"
+
+void conversionplan::Initialize(int gammamodein_in, double gammapowin_in, int gammamodeout_in, double gammapowout_in, int mapmode_in, gamutdescriptor &sourcegamut_in, gamutdescriptor &destgamut_in, int cccfunctiontype_in, double cccfloor_in, double cccceiling_in, double cccexp_in, double remapfactor_in, double remaplimit_in, bool softkneemode_in, double kneefactor_in, int mapdirection_in, int safezonetype_in, bool spiralcarisma_in, int lutmode_in, bool nesmode_in, double hdrsdrmaxnits_in){
+    gammamodein = gammamodein_in;
+    gammapowin = gammapowin_in;
+    gammamodeout = gammamodeout_in;
+    gammapowout = gammapowout_in;
+    mapmode = mapmode_in;
+    sourcegamut = &sourcegamut_in;
+    destgamut = &destgamut_in;
+    cccfunctiontype = cccfunctiontype_in;
+    cccfloor = cccfloor_in;
+    cccceiling = cccceiling_in;
+    cccexp = cccexp_in;
+    remapfactor = remapfactor_in;
+    remaplimit = remaplimit_in;
+    softkneemode = softkneemode_in;
+    kneefactor = kneefactor_in;
+    mapdirection = mapdirection_in;
+    safezonetype = safezonetype_in;
+    spiralcarisma = spiralcarisma_in;
+    lutmode = lutmode_in;
+    nesmode = nesmode_in;
+    hdrsdrmaxnits = hdrsdrmaxnits_in;
+
+    stages.clear();
+
+    // input side
+    if (sourcegamut->crtemumode == CRT_EMU_FRONT){
+        if (lutmode == LUTMODE_POSTCC){
+            stages.push_back(PLAN_STAGE_CRT_EOTF);
+        }
+        else if ((lutmode == LUTMODE_NONE)||(lutmode == LUTMODE_NORMAL)) {
+            stages.push_back(PLAN_STAGE_CRT_FRONT);
+        }
+        // nothing to do for LUTMODE_POSTGAMMA, since input color is already linear RGB
+    }
+    else if ((gammamodein == GAMMA_SRGB) || (gammamodein == GAMMA_REC2084) || (gammamodein == GAMMA_POWER)){
+        stages.push_back(PLAN_STAGE_TOLINEAR);
+    }
+
+    // Expanded intermediate LUTs expressly contain a ton of out-of-bounds colors
+    // XYZtoJzazbz() will force colors to black if luminosity is negative at that point.
+    // CUSP and VPR-alike GMA algorithms will pull down stuff that's above 1.0 luminosity.
+    // But desaturation-only algorithms (HLPCM) must have luminosity clamped.
+    // NES may also have out-of-bounds luminosity
+    if (((lutmode == LUTMODE_POSTCC) || nesmode) && (mapdirection == MAP_HLPCM)){
+        stages.push_back(PLAN_STAGE_CLAMP_LUMINOSITY);
+    }
+
+    // gamut mapping
+    if (mapmode == MAP_CLIP){
+        stages.push_back(PLAN_STAGE_CLIP);
+    }
+    else if (mapmode == MAP_CCC_A){
+        stages.push_back(PLAN_STAGE_CCC_A);
+    }
+    else if (mapmode == MAP_CCC_B){
+        stages.push_back(PLAN_STAGE_CCC_B);
+    }
+    else if (mapmode == MAP_CCC_C){
+        stages.push_back(PLAN_STAGE_CCC_C);
+    }
+    else if ((mapmode == MAP_CCC_D) || (mapmode == MAP_CCC_E)){
+        stages.push_back(PLAN_STAGE_KINOSHITA);
+    }
+    else {
+        stages.push_back(PLAN_STAGE_GAMUT_MAP);
+    }
+
+    // output side
+    if (destgamut->crtemumode == CRT_EMU_BACK){
+        stages.push_back(PLAN_STAGE_CRT_BACK);
+    }
+    else if ((gammamodeout == GAMMA_SRGB) || (gammamodeout == GAMMA_REC2084) || (gammamodeout == GAMMA_POWER)){
+        stages.push_back(PLAN_STAGE_TOGAMMA);
+    }
+
+    return;
+}
+
+void conversionplan::InitializeLUT(appliedlut &lut_in){
+    lut = &lut_in;
+    lutmode = lut->lutmode;
+    nesmode = false;
+    sourcegamut = NULL;
+    destgamut = NULL;
+    stages.clear();
+    stages.push_back(PLAN_STAGE_APPLY_LUT);
+    return;
+}
+
+conversionplan conversionplan::Variant(int lutmode_in, bool nesmode_in){
+    conversionplan output;
+    output.Initialize(gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, *sourcegamut, *destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode_in, nesmode_in, hdrsdrmaxnits);
+    return output;
+}
+
+vec3 conversionplan::Process(vec3 inputcolor){
+    ProcessSpan(&inputcolor.x, &inputcolor.y, &inputcolor.z, 1);
+    return inputcolor;
+}
+
+void conversionplan::ProcessSpan(double* red, double* green, double* blue, int count){
+    for (size_t i=0; i<stages.size(); i++){
+        RunStage(stages[i], red, green, blue, count);
+    }
+    return;
+}
+
+void conversionplan::RunStage(int stage, double* red, double* green, double* blue, int count){
+    switch (stage){
+        case PLAN_STAGE_CRT_EOTF:
+            sourcegamut->attachedCRT->tolinear1886appx1span(red, green, blue, count);
+            break;
+        case PLAN_STAGE_CRT_FRONT:
+            sourcegamut->attachedCRT->CRTEmulateGammaSpaceRGBtoLinearRGBSpan(red, green, blue, count);
+            break;
+        case PLAN_STAGE_TOLINEAR:
+            // the transfer tables were built for gammamodein, gammapowin, and hdrsdrmaxnits
+            tolineartablespan(red, count);
+            tolineartablespan(green, count);
+            tolineartablespan(blue, count);
+            break;
+        case PLAN_STAGE_CLAMP_LUMINOSITY:
+            for (int i=0; i<count; i++){
+                vec3 output = sourcegamut->ClampLuminosity(vec3(red[i], green[i], blue[i]));
+                red[i] = output.x;
+                green[i] = output.y;
+                blue[i] = output.z;
+            }
+            break;
+        case PLAN_STAGE_CLIP:
+            sourcegamut->linearRGBtoXYZSpan(red, green, blue, count);
+            destgamut->XYZtoLinearRGBSpan(red, green, blue, count);
+            break;
+        case PLAN_STAGE_CCC_A:
+            // take weighted average of corrected and uncorrected color
+            // based on YPrPgPb-space proximity to primary/secondary colors
+            for (int i=0; i<count; i++){
+                vec3 linearinputcolor = vec3(red[i], green[i], blue[i]);
+                vec3 tempcolor = sourcegamut->linearRGBtoXYZ(linearinputcolor);
+                vec3 outcolor = destgamut->XYZtoLinearRGB(tempcolor);
+                double maxP = sourcegamut->linearRGBfindmaxP(linearinputcolor);
+                double oldweight = 0.0;
+                if (cccfunctiontype == CCC_EXPONENTIAL){
+                    oldweight = powermap(cccfloor, cccceiling, maxP, cccexp);
+                }
+                else if (cccfunctiontype == CCC_CUBIC_HERMITE){
+                    oldweight = cubichermitemap(cccfloor, cccceiling, maxP);
+                }
+                double newweight = 1.0 - oldweight;
+                outcolor = (linearinputcolor * oldweight) + (outcolor * newweight);
+                red[i] = outcolor.x;
+                green[i] = outcolor.y;
+                blue[i] = outcolor.z;
+            }
+            break;
+        case PLAN_STAGE_CCC_B:
+            // apply the "Chunghwa" matrix
+            // we don't need to clamp here b/c the RGB8 quantizer will clamp for us later
+            multMatrixBySpan(destgamut->matrixChunghwa, red, green, blue, count);
+            break;
+        case PLAN_STAGE_CCC_C:
+            // apply the "Chunghwa" matrix, and take weighted average with the accurate color
+            for (int i=0; i<count; i++){
+                vec3 linearinputcolor = vec3(red[i], green[i], blue[i]);
+                vec3 corrected = multMatrixByColor(destgamut->matrixChunghwa, linearinputcolor);
+                vec3 tempcolor = sourcegamut->linearRGBtoXYZ(linearinputcolor);
+                vec3 accurate = destgamut->XYZtoLinearRGB(tempcolor);
+                double maxP = sourcegamut->linearRGBfindmaxP(linearinputcolor);
+                double cccweight = cubichermitemap(0.0, 1.0, maxP);
+                double accurateweight = 1.0 - cccweight;
+                corrected = (corrected * cccweight) + (accurate * accurateweight);
+                red[i] = corrected.x;
+                green[i] = corrected.y;
+                blue[i] = corrected.z;
+            }
+            break;
+        case PLAN_STAGE_KINOSHITA:
+            // apply the appropriate Kinoshita matrix
+            for (int i=0; i<count; i++){
+                vec3 output = sourcegamut->KinoshitaMultiply(vec3(red[i], green[i], blue[i]));
+                red[i] = output.x;
+                green[i] = output.y;
+                blue[i] = output.z;
+            }
+            break;
+        case PLAN_STAGE_GAMUT_MAP:
+            mapColorSpan(red, green, blue, count, *sourcegamut, *destgamut, (mapmode == MAP_EXPAND), remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, nesmode);
+            break;
+        case PLAN_STAGE_CRT_BACK:
+            destgamut->attachedCRT->CRTEmulateLinearRGBtoGammaSpaceRGBSpan(red, green, blue, count, true);
+            break;
+        case PLAN_STAGE_TOGAMMA:
+            // the transfer tables were built for gammamodeout, gammapowout, and hdrsdrmaxnits
+            togammatablespan(red, count);
+            togammatablespan(green, count);
+            togammatablespan(blue, count);
+            break;
+        case PLAN_STAGE_APPLY_LUT:
+            lut->ProcessSpan(red, green, blue, count);
+            break;
+        default:
+            break;
+    }
+    return;
+}
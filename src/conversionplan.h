@@ -0,0 +1,87 @@
+#ifndef CONVERSIONPLAN_H
+#define CONVERSIONPLAN_H
+
+#include "vec3.h"
+#include "gamutbounds.h"
+
+#include <vector>
+
+class appliedlut;
+
+// Stages of the conversion pipeline
+// input side
+#define PLAN_STAGE_CRT_EOTF 0 // BT.1886 Appendix 1 EOTF only (post-color-correction LUT input)
+#define PLAN_STAGE_CRT_FRONT 1 // full CRT emulation from gamma-space RGB to linear RGB
+#define PLAN_STAGE_TOLINEAR 2 // input gamma function
+#define PLAN_STAGE_CLAMP_LUMINOSITY 3 // clamp out-of-bounds luminosity for desaturation-only gamut mapping
+// gamut mapping
+#define PLAN_STAGE_CLIP 4
+#define PLAN_STAGE_CCC_A 5
+#define PLAN_STAGE_CCC_B 6
+#define PLAN_STAGE_CCC_C 7
+#define PLAN_STAGE_KINOSHITA 8 // CCC D and E
+#define PLAN_STAGE_GAMUT_MAP 9 // compression or expansion using mapColor()
+// output side
+#define PLAN_STAGE_CRT_BACK 10 // full CRT emulation from linear RGB to gamma-space RGB
+#define PLAN_STAGE_TOGAMMA 11 // output gamma function
+// the whole conversion, from an existing LUT
+#define PLAN_STAGE_APPLY_LUT 12
+
+// A conversion plan holds every setting needed to convert a color from the source gamut to the destination gamut,
+// and resolves the gamma, CRT emulation, LUT mode, and gamut mapping choices into a fixed list of stages once, up front.
+// So converting a color is just running it through the stages, with no re-branching on all the settings for every pixel.
+// Process() converts one color. ProcessSpan() runs a whole span of colors (a row, a list of unique colors, etc.),
+// held in structure-of-arrays layout (one array per channel), through each stage in turn.
+// The gamut descriptors (and any attached CRTs) must outlive the plan,
+// and initializeTransferTables() must have been run with the same gamma settings.
+class conversionplan{
+public:
+    // settings
+    int gammamodein;
+    double gammapowin;
+    int gammamodeout;
+    double gammapowout;
+    int mapmode;
+    gamutdescriptor* sourcegamut;
+    gamutdescriptor* destgamut;
+    int cccfunctiontype;
+    double cccfloor;
+    double cccceiling;
+    double cccexp;
+    double remapfactor;
+    double remaplimit;
+    bool softkneemode;
+    double kneefactor;
+    int mapdirection;
+    int safezonetype;
+    bool spiralcarisma;
+    int lutmode;
+    bool nesmode;
+    double hdrsdrmaxnits;
+
+    // LUT applied instead of converting (see lutapply.h), or NULL
+    appliedlut* lut = NULL;
+
+    // resolved stages, in order
+    std::vector<int> stages;
+
+    void Initialize(int gammamodein_in, double gammapowin_in, int gammamodeout_in, double gammapowout_in, int mapmode_in, gamutdescriptor &sourcegamut_in, gamutdescriptor &destgamut_in, int cccfunctiontype_in, double cccfloor_in, double cccceiling_in, double cccexp_in, double remapfactor_in, double remaplimit_in, bool softkneemode_in, double kneefactor_in, int mapdirection_in, int safezonetype_in, bool spiralcarisma_in, int lutmode_in, bool nesmode_in, double hdrsdrmaxnits_in);
+
+    // Sets up a plan that applies a LUT instead of converting, so the gamut descriptors aren't needed (and the other settings are unused)
+    void InitializeLUT(appliedlut &lut_in);
+
+    // Returns a copy of this plan with different LUT mode and NES settings
+    // (the single color and NES palette modes don't use the LUT mode chosen on the command line)
+    conversionplan Variant(int lutmode_in, bool nesmode_in);
+
+    // Do the full conversion process on a given color
+    vec3 Process(vec3 inputcolor);
+    // Do the full conversion process on count colors in place
+    void ProcessSpan(double* red, double* green, double* blue, int count);
+
+private:
+    // Run one stage on count colors in place
+    void RunStage(int stage, double* red, double* green, double* blue, int count);
+};
+
+#endif
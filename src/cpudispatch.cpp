@@ -0,0 +1,51 @@
+#include "cpudispatch.h"
+
+int CPUlevel = CPU_LEVEL_BASELINE;
+
+// returns the best level this CPU supports
+int DetectCPULevel(){
+#if CPU_DISPATCH_ENABLED
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("x86-64-v4")){
+        return CPU_LEVEL_AVX512;
+    }
+    if (__builtin_cpu_supports("x86-64-v3")){
+        return CPU_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("x86-64-v2")){
+        return CPU_LEVEL_SSE42;
+    }
+#endif
+    return CPU_LEVEL_BASELINE;
+}
+
+// sets CPUlevel to level (or the detected level for CPU_LEVEL_AUTO)
+// returns false if the CPU doesn't support level
+bool SetCPULevel(int level){
+    int detected = DetectCPULevel();
+    if (level == CPU_LEVEL_AUTO){
+        CPUlevel = detected;
+        return true;
+    }
+    if (level > detected){
+        return false;
+    }
+    CPUlevel = level;
+    return true;
+}
+
+const char* CPULevelName(int level){
+    switch (level){
+        case CPU_LEVEL_BASELINE:
+            return "baseline (SSE2)";
+        case CPU_LEVEL_SSE42:
+            return "SSE4.2 (x86-64-v2)";
+        case CPU_LEVEL_AVX2:
+            return "AVX2 (x86-64-v3)";
+        case CPU_LEVEL_AVX512:
+            return "AVX-512 (x86-64-v4)";
+        default:
+            break;
+    }
+    return "auto";
+}
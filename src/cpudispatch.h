@@ -0,0 +1,67 @@
+#ifndef CPUDISPATCH_H
+#define CPUDISPATCH_H
+
+// Runtime CPU feature dispatch ---------------------------------------------------------------------------------------------------------------
+// The makefile targets baseline x86-64 (SSE2) so the binary runs anywhere.
+// The hot span kernels are compiled once for each x86-64 microarchitecture level below, and CPUDISPATCH() picks the copy for CPUlevel at each call.
+// CPUlevel defaults to the best level the CPU supports (detected at startup), and can be forced lower with --cpu for benchmarking.
+// Only GCC and clang on x86-64 get the extra copies; everything else just uses the baseline copy.
+
+#define CPU_LEVEL_BASELINE 0 // x86-64 (SSE2)
+#define CPU_LEVEL_SSE42 1 // x86-64-v2 (SSE4.2, POPCNT)
+#define CPU_LEVEL_AVX2 2 // x86-64-v3 (AVX2, FMA, BMI2)
+#define CPU_LEVEL_AVX512 3 // x86-64-v4 (AVX-512F/BW/CD/DQ/VL)
+#define CPU_LEVEL_AUTO -1 // for --cpu: use the best detected level
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define CPU_DISPATCH_ENABLED 1
+#define CPU_TARGET_SSE42 __attribute__((target("arch=x86-64-v2")))
+#define CPU_TARGET_AVX2 __attribute__((target("arch=x86-64-v3")))
+#define CPU_TARGET_AVX512 __attribute__((target("arch=x86-64-v4")))
+#define CPU_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define CPU_DISPATCH_ENABLED 0
+#define CPU_TARGET_SSE42
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX512
+#define CPU_ALWAYS_INLINE inline
+#endif
+
+extern int CPUlevel;
+
+// returns the best level this CPU supports
+int DetectCPULevel();
+
+// sets CPUlevel to level (or the detected level for CPU_LEVEL_AUTO)
+// returns false if the CPU doesn't support level
+bool SetCPULevel(int level);
+
+const char* CPULevelName(int level);
+
+// Defines function name(params) that dispatches to a copy of name##Body(args) compiled for CPUlevel.
+// name##Body must be a CPU_ALWAYS_INLINE function so that each copy gets its own code generation.
+// Example:
+//     CPU_ALWAYS_INLINE void fooBody(double* x, int count){ ... }
+//     CPUDISPATCH(void, foo, (double* x, int count), (x, count))
+// (Floating point results are identical at every level: the makefile turns off FMA contraction with -ffp-contract=off,
+// and vectorizing a loop doesn't change the arithmetic done for each element.)
+#if CPU_DISPATCH_ENABLED
+#define CPUDISPATCH(rettype, name, params, args) \
+    CPU_TARGET_AVX512 static rettype name##AVX512 params { return name##Body args; } \
+    CPU_TARGET_AVX2 static rettype name##AVX2 params { return name##Body args; } \
+    CPU_TARGET_SSE42 static rettype name##SSE42 params { return name##Body args; } \
+    static rettype name##Baseline params { return name##Body args; } \
+    rettype name params { \
+        switch (CPUlevel){ \
+            case CPU_LEVEL_AVX512: return name##AVX512 args; \
+            case CPU_LEVEL_AVX2: return name##AVX2 args; \
+            case CPU_LEVEL_SSE42: return name##SSE42 args; \
+            default: return name##Baseline args; \
+        } \
+    }
+#else
+#define CPUDISPATCH(rettype, name, params, args) \
+    rettype name params { return name##Body args; }
+#endif
+
+#endif
@@ -2,6 +2,7 @@
 #include "constants.h"
 #include "matrix.h"
 #include "vec3.h"
+#include "cpudispatch.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -280,14 +281,15 @@ void crtdescriptor::BruteForce1886B(){
 // (BT.1361 does something similar.)
 // Dynamic range is restored in a post-processing step that chops off the black lift and then normalizes to 0-1.
 // Initialize1886EOTF() must be run once before this can be used.
-double crtdescriptor::tolinear1886appx1(double input){
+// (The work is done by the static helper so the span kernels below can inline it.)
+static CPU_ALWAYS_INLINE double tolinear1886appx1core(const crtdescriptor* crt, double input){
     
     // Shift input by b
-    input += CRT_EOTF_b;
+    input += crt->CRT_EOTF_b;
 
     // fix floating point errors
     // and clamp superblacks
-    if (zerolightclampenable && (input < 0.0)){
+    if (crt->zerolightclampenable && (input < 0.0)){
         input = 0.0;
     }
 
@@ -300,11 +302,11 @@ double crtdescriptor::tolinear1886appx1(double input){
     
     // The main EOTF function
     double output;
-    if (input < (0.35 + CRT_EOTF_b)){
-        output = CRT_EOTF_k * CRT_EOTF_s * pow(input, 3.0);
+    if (input < (0.35 + crt->CRT_EOTF_b)){
+        output = crt->CRT_EOTF_k * crt->CRT_EOTF_s * pow(input, 3.0);
     }
     else {
-        output = CRT_EOTF_k * pow(input, 2.6);
+        output = crt->CRT_EOTF_k * pow(input, 2.6);
     }
     
     // Flip sign again if input was negative
@@ -313,9 +315,9 @@ double crtdescriptor::tolinear1886appx1(double input){
     }
     
     // Chop off the black lift and normalize to 0-1
-    double bottom = superblacks ? 0.0 : CRT_EOTF_blacklevel;
+    double bottom = crt->superblacks ? 0.0 : crt->CRT_EOTF_blacklevel;
     output -= bottom;
-    output /= (CRT_EOTF_whitelevel - bottom);
+    output /= (crt->CRT_EOTF_whitelevel - bottom);
     
     // fix floating point errors very near 0 or 1
     if ((output != 0.0) && (fabs(output - 0.0) < 1e-10)){
@@ -328,13 +330,17 @@ double crtdescriptor::tolinear1886appx1(double input){
     return output;
 }
 
+double crtdescriptor::tolinear1886appx1(double input){
+    return tolinear1886appx1core(this, input);
+}
+
 // inverse of tolinear1886appx1()
 // Initialize1886EOTF() must be run once before this can be used.
-double crtdescriptor::togamma1886appx1(double input){
+static CPU_ALWAYS_INLINE double togamma1886appx1core(const crtdescriptor* crt, double input){
     
     // undo the chop and normalization post-processing
-    double bottom = superblacks ? 0.0 : CRT_EOTF_blacklevel;
-    input *= (CRT_EOTF_whitelevel - bottom);
+    double bottom = crt->superblacks ? 0.0 : crt->CRT_EOTF_blacklevel;
+    input *= (crt->CRT_EOTF_whitelevel - bottom);
     input += bottom;
     
     // Handle negative input by flipping sign 
@@ -346,11 +352,11 @@ double crtdescriptor::togamma1886appx1(double input){
     
     // The main EOTF function
     double output;
-    if (input < CRT_EOTF_i){
-        output = pow((1.0/CRT_EOTF_k) * (1.0/CRT_EOTF_s) * input, 1.0/3.0);
+    if (input < crt->CRT_EOTF_i){
+        output = pow((1.0/crt->CRT_EOTF_k) * (1.0/crt->CRT_EOTF_s) * input, 1.0/3.0);
     }
     else {
-        output = pow((1.0/CRT_EOTF_k) * input, 1.0/2.6);
+        output = pow((1.0/crt->CRT_EOTF_k) * input, 1.0/2.6);
     }
     
     // Flip sign again if input was negative
@@ -359,7 +365,7 @@ double crtdescriptor::togamma1886appx1(double input){
     }
     
     //unshift
-    output -= CRT_EOTF_b;
+    output -= crt->CRT_EOTF_b;
     
     // fix floating point errors very near 0 or 1
     if ((output != 0.0) && (fabs(output - 0.0) < 1e-10)){
@@ -373,6 +379,10 @@ double crtdescriptor::togamma1886appx1(double input){
     
 }
 
+double crtdescriptor::togamma1886appx1(double input){
+    return togamma1886appx1core(this, input);
+}
+
 // set the global variables for NTSC 1953 white balance
 // This is basically copy/paste from the first few steps of gamut boundary initialization.
 bool crtdescriptor::InitializeNTSC1953WhiteBalanceFactors(){
@@ -804,6 +814,179 @@ vec3 crtdescriptor::tolinear1886appx1vec3(vec3 input){
     return output;
 }
 
+// Span kernels ------------------------------------------------------------------------------------------------------------------------
+// These do the same work as CRTEmulateGammaSpaceRGBtoLinearRGB(), CRTEmulateLinearRGBtoGammaSpaceRGB(), and tolinear1886appx1vec3()
+// (with identical results), but a whole span at a time:
+// each step is a loop over the span with the settings hoisted out of it, so there's no per-color function call overhead,
+// the crush, matrix, clamp, and scale steps vectorize, and the EOTF is inlined with its table.
+// (compiled for each instruction set level; see cpudispatch.h)
+
+static CPU_ALWAYS_INLINE void crteotfspanBody(const crtdescriptor* crt, double* red, double* green, double* blue, int count){
+    for (int i=0; i<count; i++){
+        red[i] = tolinear1886appx1core(crt, red[i]);
+        green[i] = tolinear1886appx1core(crt, green[i]);
+        blue[i] = tolinear1886appx1core(crt, blue[i]);
+    }
+    return;
+}
+CPUDISPATCH(void, crteotfspan, (const crtdescriptor* crt, double* red, double* green, double* blue, int count), (crt, red, green, blue, count))
+
+// sign-preserving pow() on one channel
+static CPU_ALWAYS_INLINE void signedpowspan(double* values, int count, double exponent){
+    for (int i=0; i<count; i++){
+        bool flip = (values[i] < 0.0);
+        double output = pow(flip ? -values[i] : values[i], exponent);
+        values[i] = flip ? -output : output;
+    }
+    return;
+}
+
+static CPU_ALWAYS_INLINE void crtfrontendspanBody(const crtdescriptor* crt, double* red, double* green, double* blue, int count){
+    double* channels[3] = {red, green, blue};
+
+    if (crt->blackpedestalcrush){
+        // same as CrushBlack()
+        double amount = crt->blackpedestalcrushamount;
+        double scale = 1.0 - amount;
+        bool clamp = !crt->superblacks;
+        for (int c=0; c<3; c++){
+            double* values = channels[c];
+            for (int i=0; i<count; i++){
+                double output = (values[i] - amount) / scale;
+                values[i] = (clamp && (output < 0.0)) ? 0.0 : output;
+            }
+        }
+    }
+
+    // same as multMatrixBySpan(), inlined here
+    const double m00 = crt->overallMatrix[0][0];
+    const double m01 = crt->overallMatrix[0][1];
+    const double m02 = crt->overallMatrix[0][2];
+    const double m10 = crt->overallMatrix[1][0];
+    const double m11 = crt->overallMatrix[1][1];
+    const double m12 = crt->overallMatrix[1][2];
+    const double m20 = crt->overallMatrix[2][0];
+    const double m21 = crt->overallMatrix[2][1];
+    const double m22 = crt->overallMatrix[2][2];
+    for (int i=0; i<count; i++){
+        double inx = red[i];
+        double iny = green[i];
+        double inz = blue[i];
+        red[i] = m00 * inx + m01 * iny + m02 * inz;
+        green[i] = m10 * inx + m11 * iny + m12 * inz;
+        blue[i] = m20 * inx + m21 * iny + m22 * inz;
+    }
+
+    // clamp rgb (see CRTEmulateGammaSpaceRGBtoLinearRGB() for why)
+    double low = crt->rgbclamplowlevel;
+    double high = crt->rgbclamphighlevel;
+    for (int c=0; c<3; c++){
+        double* values = channels[c];
+        if (crt->clamphighrgb){
+            for (int i=0; i<count; i++){
+                values[i] = (values[i] > high) ? high : values[i];
+            }
+        }
+        for (int i=0; i<count; i++){
+            values[i] = (values[i] < low) ? low : values[i];
+        }
+    }
+
+    if (crt->globalgammaadjust != 1.0){
+        for (int c=0; c<3; c++){
+            signedpowspan(channels[c], count, crt->globalgammaadjust);
+        }
+    }
+
+    crteotfspanBody(crt, red, green, blue, count);
+
+    if (crt->NESrenormaliztionfactor != 1.0){
+        double factor = crt->NESrenormaliztionfactor;
+        for (int c=0; c<3; c++){
+            double* values = channels[c];
+            for (int i=0; i<count; i++){
+                values[i] *= factor;
+            }
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, crtfrontendspan, (const crtdescriptor* crt, double* red, double* green, double* blue, int count), (crt, red, green, blue, count))
+
+static CPU_ALWAYS_INLINE void crtbackendspanBody(const crtdescriptor* crt, double* red, double* green, double* blue, int count, bool uncrushblacks){
+    double* channels[3] = {red, green, blue};
+
+    if (crt->NESrenormaliztionfactor != 1.0){
+        double factor = crt->NESrenormaliztionfactor;
+        for (int c=0; c<3; c++){
+            double* values = channels[c];
+            for (int i=0; i<count; i++){
+                values[i] /= factor;
+            }
+        }
+    }
+
+    for (int i=0; i<count; i++){
+        red[i] = togamma1886appx1core(crt, red[i]);
+        green[i] = togamma1886appx1core(crt, green[i]);
+        blue[i] = togamma1886appx1core(crt, blue[i]);
+    }
+
+    if (crt->globalgammaadjust != 1.0){
+        for (int c=0; c<3; c++){
+            signedpowspan(channels[c], count, 1.0/crt->globalgammaadjust);
+        }
+    }
+
+    // same as multMatrixBySpan(), inlined here
+    const double m00 = crt->inverseOverallMatrix[0][0];
+    const double m01 = crt->inverseOverallMatrix[0][1];
+    const double m02 = crt->inverseOverallMatrix[0][2];
+    const double m10 = crt->inverseOverallMatrix[1][0];
+    const double m11 = crt->inverseOverallMatrix[1][1];
+    const double m12 = crt->inverseOverallMatrix[1][2];
+    const double m20 = crt->inverseOverallMatrix[2][0];
+    const double m21 = crt->inverseOverallMatrix[2][1];
+    const double m22 = crt->inverseOverallMatrix[2][2];
+    for (int i=0; i<count; i++){
+        double inx = red[i];
+        double iny = green[i];
+        double inz = blue[i];
+        red[i] = m00 * inx + m01 * iny + m02 * inz;
+        green[i] = m10 * inx + m11 * iny + m12 * inz;
+        blue[i] = m20 * inx + m21 * iny + m22 * inz;
+    }
+
+    if (crt->blackpedestalcrush && uncrushblacks){
+        // same as UncrushBlack()
+        double amount = crt->blackpedestalcrushamount;
+        double scale = 1.0 - amount;
+        for (int c=0; c<3; c++){
+            double* values = channels[c];
+            for (int i=0; i<count; i++){
+                values[i] = (values[i] * scale) + amount;
+            }
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, crtbackendspan, (const crtdescriptor* crt, double* red, double* green, double* blue, int count, bool uncrushblacks), (crt, red, green, blue, count, uncrushblacks))
+
+void crtdescriptor::tolinear1886appx1span(double* red, double* green, double* blue, int count){
+    crteotfspan(this, red, green, blue, count);
+    return;
+}
+
+void crtdescriptor::CRTEmulateGammaSpaceRGBtoLinearRGBSpan(double* red, double* green, double* blue, int count){
+    crtfrontendspan(this, red, green, blue, count);
+    return;
+}
+
+void crtdescriptor::CRTEmulateLinearRGBtoGammaSpaceRGBSpan(double* red, double* green, double* blue, int count, bool uncrushblacks){
+    crtbackendspan(this, red, green, blue, count, uncrushblacks);
+    return;
+}
+
 vec3 crtdescriptor::togamma1886appx1vec3(vec3 input){
     vec3 output;
     output.x = togamma1886appx1(input.x);
@@ -857,6 +1040,23 @@ double crtdescriptor::UnSuperBlack(double input){
 
 vec3 crtdescriptor::CRTEmulateGammaSpaceRGBtoLinearRGB(vec3 input){
 
+    vec3 output = CRTEmulateGammaSpaceRGBtoPreEOTF(input);
+
+    output.x = tolinear1886appx1(output.x);
+    output.y = tolinear1886appx1(output.y);
+    output.z = tolinear1886appx1(output.z);
+
+    if (NESrenormaliztionfactor != 1.0){
+        output.x *= NESrenormaliztionfactor;
+        output.y *= NESrenormaliztionfactor;
+        output.z *= NESrenormaliztionfactor;
+    }
+
+    return output;
+}
+
+vec3 crtdescriptor::CRTEmulateGammaSpaceRGBtoPreEOTF(vec3 input){
+
     if (blackpedestalcrush){
         input = CrushBlack(input);
     }
@@ -915,16 +1115,6 @@ vec3 crtdescriptor::CRTEmulateGammaSpaceRGBtoLinearRGB(vec3 input){
         }
     }
 
-    output.x = tolinear1886appx1(output.x);
-    output.y = tolinear1886appx1(output.y);
-    output.z = tolinear1886appx1(output.z);
-
-    if (NESrenormaliztionfactor != 1.0){
-        output.x *= NESrenormaliztionfactor;
-        output.y *= NESrenormaliztionfactor;
-        output.z *= NESrenormaliztionfactor;
-    }
-
     return output;
 }
 
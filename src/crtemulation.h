@@ -103,6 +103,12 @@ public:
 
     vec3 CRTEmulateGammaSpaceRGBtoLinearRGB(vec3 input);
     vec3 CRTEmulateLinearRGBtoGammaSpaceRGB(vec3 input, bool uncrushblacks);
+    // everything CRTEmulateGammaSpaceRGBtoLinearRGB() does before the EOTF (black crush, demodulation, clamping, and the gamma knob)
+    vec3 CRTEmulateGammaSpaceRGBtoPreEOTF(vec3 input);
+    // span versions of the above and of tolinear1886appx1vec3(), for count colors in structure-of-arrays layout (one array per channel), in place
+    void CRTEmulateGammaSpaceRGBtoLinearRGBSpan(double* red, double* green, double* blue, int count);
+    void CRTEmulateLinearRGBtoGammaSpaceRGBSpan(double* red, double* green, double* blue, int count, bool uncrushblacks);
+    void tolinear1886appx1span(double* red, double* green, double* blue, int count);
 
     void SetNESScaleFactor(double input);
     void NESScaleBlackPedestal(double input);
@@ -0,0 +1,284 @@
+#include "framestream.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #define dup _dup
+    #define dup2 _dup2
+    #define fileno _fileno
+#else
+    #include <unistd.h>
+#endif
+
+FILE* RedirectConsoleToStderr(){
+    fflush(stdout);
+    int framefd = dup(fileno(stdout));
+    if (framefd < 0){
+        fprintf(stderr, "gamutthingy: could not duplicate stdout: %s\n", strerror(errno));
+        return NULL;
+    }
+    if (dup2(fileno(stderr), fileno(stdout)) < 0){
+        fprintf(stderr, "gamutthingy: could not redirect stdout: %s\n", strerror(errno));
+        return NULL;
+    }
+#ifdef _WIN32
+    _setmode(framefd, _O_BINARY);
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    return fdopen(framefd, "wb");
+}
+
+// Kr and Kb for the Y'CbCr matrix
+static void y4mcoefficients(int matrix, double &kr, double &kb){
+    if (matrix == Y4M_MATRIX_BT709){
+        kr = 0.2126;
+        kb = 0.0722;
+    }
+    else {
+        kr = 0.299;
+        kb = 0.114;
+    }
+    return;
+}
+
+static png_byte clampbyte(double input){
+    long rounded = lround(input);
+    if (rounded < 0){
+        return 0;
+    }
+    if (rounded > 255){
+        return 255;
+    }
+    return (png_byte)rounded;
+}
+
+bool framereader::Open(FILE* input, int streamformat, int framewidth, int frameheight, int y4mmatrix){
+    file = input;
+    format = streamformat;
+    matrix = y4mmatrix;
+    if (format == FRAME_STREAM_RGB24){
+        width = framewidth;
+        height = frameheight;
+        if ((width < 1) || (height < 1)){
+            fprintf(stderr, "gamutthingy: raw RGB24 frame stream needs --raw-width and --raw-height\n");
+            return false;
+        }
+        return true;
+    }
+
+    // y4m stream header is one line of space-separated tokens
+    header.clear();
+    int c;
+    while (((c = fgetc(file)) != EOF) && (c != '\n')){
+        header.push_back((char)c);
+    }
+    if ((c == EOF) || (header.compare(0, 10, "YUV4MPEG2 ") != 0)){
+        fprintf(stderr, "gamutthingy: frame stream: Not a yuv4mpeg2 stream\n");
+        return false;
+    }
+    std::string chroma = "420jpeg"; // y4m default
+    size_t pos = 10;
+    while (pos < header.size()){
+        size_t end = header.find(' ', pos);
+        if (end == std::string::npos){
+            end = header.size();
+        }
+        std::string token = header.substr(pos, end - pos);
+        if (!token.empty()){
+            switch (token[0]){
+                case 'W':
+                    width = atoi(token.c_str() + 1);
+                    break;
+                case 'H':
+                    height = atoi(token.c_str() + 1);
+                    break;
+                case 'C':
+                    chroma = token.substr(1);
+                    break;
+                case 'I':
+                    if ((token != "Ip") && (token != "I?")){
+                        fprintf(stderr, "gamutthingy: frame stream: Interlaced y4m is not supported\n");
+                        return false;
+                    }
+                    break;
+                case 'X':
+                    if (token == "XCOLORRANGE=FULL"){
+                        fullrange = true;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        pos = end + 1;
+    }
+    if (chroma == "444"){
+        chroma420 = false;
+    }
+    else if ((chroma == "420jpeg") || (chroma == "420paldv") || (chroma == "420mpeg2") || (chroma == "420")){
+        chroma420 = true;
+    }
+    else {
+        fprintf(stderr, "gamutthingy: frame stream: Unsupported y4m chroma format C%s (use 444 or 420)\n", chroma.c_str());
+        return false;
+    }
+    if ((width < 1) || (height < 1)){
+        fprintf(stderr, "gamutthingy: frame stream: Bad frame size in y4m header\n");
+        return false;
+    }
+    return true;
+}
+
+bool framereader::ReadFrame(png_bytep rgb, bool &eof){
+    eof = false;
+    size_t pixels = (size_t)width * height;
+    if (format == FRAME_STREAM_RGB24){
+        size_t got = fread(rgb, 1, pixels * 3, file);
+        if (got == pixels * 3){
+            return true;
+        }
+        if (got == 0 && feof(file)){
+            eof = true;
+        }
+        else {
+            fprintf(stderr, "gamutthingy: frame stream: Truncated frame\n");
+        }
+        return false;
+    }
+
+    // frame header line
+    std::string frameheader;
+    int c;
+    while (((c = fgetc(file)) != EOF) && (c != '\n')){
+        frameheader.push_back((char)c);
+    }
+    if ((c == EOF) && frameheader.empty()){
+        eof = true;
+        return false;
+    }
+    if (frameheader.compare(0, 5, "FRAME") != 0){
+        fprintf(stderr, "gamutthingy: frame stream: Bad y4m frame header\n");
+        return false;
+    }
+    int chromawidth = chroma420 ? (width + 1) / 2 : width;
+    int chromaheight = chroma420 ? (height + 1) / 2 : height;
+    size_t chromasize = (size_t)chromawidth * chromaheight;
+    planes.resize(pixels + (chromasize * 2));
+    if (fread(planes.data(), 1, planes.size(), file) != planes.size()){
+        fprintf(stderr, "gamutthingy: frame stream: Truncated frame\n");
+        return false;
+    }
+    png_bytep yplane = planes.data();
+    png_bytep cbplane = yplane + pixels;
+    png_bytep crplane = cbplane + chromasize;
+
+    double kr, kb;
+    y4mcoefficients(matrix, kr, kb);
+    double kg = 1.0 - kr - kb;
+    double yoffset = fullrange ? 0.0 : 16.0;
+    double yscale = fullrange ? (1.0 / 255.0) : (1.0 / 219.0);
+    double cscale = fullrange ? (1.0 / 255.0) : (1.0 / 224.0);
+    for (int y=0; y<height; y++){
+        int cy = chroma420 ? y / 2 : y;
+        for (int x=0; x<width; x++){
+            int cx = chroma420 ? x / 2 : x;
+            size_t cindex = ((size_t)cy * chromawidth) + cx;
+            double luma = (yplane[((size_t)y * width) + x] - yoffset) * yscale;
+            double cb = (cbplane[cindex] - 128.0) * cscale;
+            double cr = (crplane[cindex] - 128.0) * cscale;
+            double red = luma + ((2.0 - (2.0 * kr)) * cr);
+            double blue = luma + ((2.0 - (2.0 * kb)) * cb);
+            double green = (luma - (kr * red) - (kb * blue)) / kg;
+            png_bytep pixel = &rgb[(((size_t)y * width) + x) * 3];
+            pixel[0] = clampbyte(red * 255.0);
+            pixel[1] = clampbyte(green * 255.0);
+            pixel[2] = clampbyte(blue * 255.0);
+        }
+    }
+    return true;
+}
+
+bool framewriter::Open(FILE* output, framereader &reader){
+    file = output;
+    format = reader.format;
+    width = reader.width;
+    height = reader.height;
+    chroma420 = reader.chroma420;
+    fullrange = reader.fullrange;
+    matrix = reader.matrix;
+    if (format == FRAME_STREAM_Y4M){
+        if (fprintf(file, "%s\n", reader.header.c_str()) < 0){
+            fprintf(stderr, "gamutthingy: frame stream: write failed: %s\n", strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool framewriter::WriteFrame(png_bytep rgb){
+    size_t pixels = (size_t)width * height;
+    if (format == FRAME_STREAM_RGB24){
+        if (fwrite(rgb, 1, pixels * 3, file) != pixels * 3){
+            fprintf(stderr, "gamutthingy: frame stream: write failed: %s\n", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    int chromawidth = chroma420 ? (width + 1) / 2 : width;
+    int chromaheight = chroma420 ? (height + 1) / 2 : height;
+    size_t chromasize = (size_t)chromawidth * chromaheight;
+    planes.resize(pixels + (chromasize * 2));
+    png_bytep yplane = planes.data();
+    png_bytep cbplane = yplane + pixels;
+    png_bytep crplane = cbplane + chromasize;
+
+    double kr, kb;
+    y4mcoefficients(matrix, kr, kb);
+    double kg = 1.0 - kr - kb;
+    double yoffset = fullrange ? 0.0 : 16.0;
+    double yscale = fullrange ? 255.0 : 219.0;
+    double cscale = fullrange ? 255.0 : 224.0;
+    // luma, and chroma accumulated over each chroma sample's pixels
+    std::vector<double> cbsum(chromasize, 0.0);
+    std::vector<double> crsum(chromasize, 0.0);
+    std::vector<int> chromacount(chromasize, 0);
+    for (int y=0; y<height; y++){
+        int cy = chroma420 ? y / 2 : y;
+        for (int x=0; x<width; x++){
+            int cx = chroma420 ? x / 2 : x;
+            size_t cindex = ((size_t)cy * chromawidth) + cx;
+            png_bytep pixel = &rgb[(((size_t)y * width) + x) * 3];
+            double red = pixel[0] / 255.0;
+            double green = pixel[1] / 255.0;
+            double blue = pixel[2] / 255.0;
+            double luma = (kr * red) + (kg * green) + (kb * blue);
+            yplane[((size_t)y * width) + x] = clampbyte(yoffset + (luma * yscale));
+            cbsum[cindex] += (blue - luma) / (2.0 - (2.0 * kb));
+            crsum[cindex] += (red - luma) / (2.0 - (2.0 * kr));
+            chromacount[cindex]++;
+        }
+    }
+    for (size_t i=0; i<chromasize; i++){
+        cbplane[i] = clampbyte(128.0 + ((cbsum[i] / chromacount[i]) * cscale));
+        crplane[i] = clampbyte(128.0 + ((crsum[i] / chromacount[i]) * cscale));
+    }
+    if ((fputs("FRAME\n", file) < 0) || (fwrite(planes.data(), 1, planes.size(), file) != planes.size())){
+        fprintf(stderr, "gamutthingy: frame stream: write failed: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool framewriter::Flush(){
+    if (fflush(file) != 0){
+        fprintf(stderr, "gamutthingy: frame stream: write failed: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include "constants.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
+
+// Continuous streams of video frames (e.g., piped from/to ffmpeg) for frame stream mode.
+// Frames are handed to and from the conversion code as RGB24 (3 bytes per pixel, no row padding).
+// FRAME_STREAM_RGB24 is headerless raw RGB24 frames of a size given on the command line
+// (ffmpeg: -f rawvideo -pix_fmt rgb24).
+// FRAME_STREAM_Y4M is yuv4mpeg2 with 8-bit 4:4:4 or 4:2:0 chroma (ffmpeg: -f yuv4mpegpipe -pix_fmt yuv444p or yuv420p).
+// The frame size comes from the stream header, and the output stream uses the same header (and chroma subsampling) as the input stream.
+// Y'CbCr is decoded to R'G'B' with the BT.601 or BT.709 matrix (y4m doesn't say which), in limited range unless the header says XCOLORRANGE=FULL.
+// 4:2:0 chroma is upsampled by repeating each sample, and downsampled by averaging each 2x2 block.
+// All functions print an error and return false on failure.
+
+// Moves console output (stdout) to stderr, so that stdout can carry frames (or server mode replies).
+// Returns a binary FILE* for the original stdout, or NULL on failure.
+FILE* RedirectConsoleToStderr();
+
+class framereader{
+public:
+    FILE* file = NULL;
+    int format = FRAME_STREAM_RGB24;
+    int width = 0;
+    int height = 0;
+    // y4m stuff
+    std::string header; // the stream header line, without the newline
+    bool chroma420 = false;
+    bool fullrange = false;
+    int matrix = Y4M_MATRIX_BT601;
+
+    // for raw RGB24, width and height give the frame size; for y4m, the stream header is read
+    bool Open(FILE* input, int streamformat, int framewidth, int frameheight, int y4mmatrix);
+    // reads the next frame into rgb (width * height * 3 bytes)
+    // returns false at the end of the stream (with eof set) or on error (with eof clear)
+    bool ReadFrame(png_bytep rgb, bool &eof);
+
+private:
+    std::vector<png_byte> planes;
+};
+
+class framewriter{
+public:
+    FILE* file = NULL;
+    int format = FRAME_STREAM_RGB24;
+    int width = 0;
+    int height = 0;
+    bool chroma420 = false;
+    bool fullrange = false;
+    int matrix = Y4M_MATRIX_BT601;
+
+    // takes the frame format from reader, and writes the y4m stream header if needed
+    bool Open(FILE* output, framereader &reader);
+    // writes a frame from rgb (width * height * 3 bytes)
+    bool WriteFrame(png_bytep rgb);
+    bool Flush();
+
+private:
+    std::vector<png_byte> planes;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#include "fulltable.h"
+#include "memocache.h"
+#include "colormisc.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+#ifdef _WIN32
+    #define FULLTABLE_MMAP 0
+#else
+    #define FULLTABLE_MMAP 1
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+// bump this if the file layout or the meaning of a stored result changes
+#define FULLTABLE_MAGIC "GAMUTTHINGYTAB01"
+
+#define FULLTABLE_COLORS (256 * 256 * 256)
+#define FULLTABLE_BYTES_SIZE ((size_t)FULLTABLE_COLORS * 3)
+#define FULLTABLE_RESIDUALS_SIZE ((size_t)FULLTABLE_COLORS * 3 * sizeof(float))
+// the header is padded to a whole page so the tables are aligned
+#define FULLTABLE_HEADER_ALIGN 4096
+
+typedef struct fulltableheader{
+    char magic[16];
+    uint64_t headersize; // including the key and padding
+    uint64_t keylength;
+} fulltableheader;
+
+bool fulltable::IsOpen(){
+    return (base != NULL);
+}
+
+#if FULLTABLE_MMAP
+
+// converts every 8-bit color with red value threadno, threadno + maxthreads, ... (one span per red and green value)
+static void fulltableworker(int threadno, int maxthreads, conversionplan* planptr, png_byte* bytes, float* residuals){
+    std::vector<double> red(256);
+    std::vector<double> green(256);
+    std::vector<double> blue(256);
+    for (int r=threadno; r<256; r+=maxthreads){
+        for (int g=0; g<256; g++){
+            for (int b=0; b<256; b++){
+                red[b] = DAC8Table[r];
+                green[b] = DAC8Table[g];
+                blue[b] = DAC8Table[b];
+            }
+            planptr->ProcessSpan(red.data(), green.data(), blue.data(), 256);
+            size_t index = ((size_t)r << 16) | (g << 8);
+            for (int b=0; b<256; b++){
+                double output[3] = {red[b], green[b], blue[b]};
+                for (int c=0; c<3; c++){
+                    png_byte rgb8 = toRGB8nodither(output[c]);
+                    bytes[((index + b) * 3) + c] = rgb8;
+                    residuals[((index + b) * 3) + c] = (float)((output[c] * 256.0) - rgb8);
+                }
+            }
+        }
+    }
+    return;
+}
+
+// Builds the table under a temporary name and links it into place.
+// If another process finishes first, theirs is kept.
+static bool buildtablefile(const std::string &name, const std::string &key, size_t headersize, size_t filelength, conversionplan &plan, int maxthreads, int verbosity){
+    std::string tempname = name + ".tmp." + std::to_string((long)getpid());
+    int tempfd = open(tempname.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (tempfd < 0){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", tempname.c_str(), strerror(errno));
+        return false;
+    }
+    void* mapping = MAP_FAILED;
+    if (ftruncate(tempfd, filelength) == 0){
+        mapping = mmap(NULL, filelength, PROT_READ | PROT_WRITE, MAP_SHARED, tempfd, 0);
+    }
+    if (mapping == MAP_FAILED){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", tempname.c_str(), strerror(errno));
+        close(tempfd);
+        unlink(tempname.c_str());
+        return false;
+    }
+    unsigned char* start = (unsigned char*)mapping;
+
+    if (verbosity >= VERBOSITY_SLIGHT){
+        printf("Building full table of all %i colors...\n", FULLTABLE_COLORS);
+        fflush(stdout);
+    }
+    auto buildstart = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i=0; i<maxthreads; i++){
+        workers.push_back(std::thread(fulltableworker, i, maxthreads, &plan, (png_byte*)(start + headersize), (float*)(start + headersize + FULLTABLE_BYTES_SIZE)));
+    }
+    for (int i=0; i<maxthreads; i++){
+        workers[i].join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildstart).count();
+    if (verbosity >= VERBOSITY_SLIGHT){
+        printf("Built full table in %.1f seconds (%f Mcolors/s).\n", elapsed, FULLTABLE_COLORS / elapsed / 1000000.0);
+    }
+
+    fulltableheader fixed;
+    memset(&fixed, 0, sizeof(fixed));
+    memcpy(fixed.magic, FULLTABLE_MAGIC, sizeof(fixed.magic));
+    fixed.headersize = headersize;
+    fixed.keylength = key.size();
+    memcpy(start, &fixed, sizeof(fixed));
+    memcpy(start + sizeof(fixed), key.data(), key.size());
+    bool ok = (munmap(mapping, filelength) == 0);
+    if (close(tempfd) != 0){
+        ok = false;
+    }
+    if (ok && (link(tempname.c_str(), name.c_str()) != 0) && (errno != EEXIST)){
+        ok = false;
+    }
+    if (!ok){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", name.c_str(), strerror(errno));
+    }
+    unlink(tempname.c_str());
+    return ok;
+}
+
+bool fulltable::Open(const char* directory, const std::string &key, conversionplan &plan, int maxthreads, int verbosity){
+    char hashname[64];
+    snprintf(hashname, sizeof(hashname), "gamutthingy-table-%016llx.bin", (unsigned long long)cachekeyhash(key));
+    std::string name = (std::filesystem::path(directory) / hashname).string();
+    if ((base != NULL) && (name == filename) && (key == openkey)){
+        return true;
+    }
+    Close();
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", directory, ec.message().c_str());
+        return false;
+    }
+    size_t headersize = ((sizeof(fulltableheader) + key.size() + FULLTABLE_HEADER_ALIGN - 1) / FULLTABLE_HEADER_ALIGN) * FULLTABLE_HEADER_ALIGN;
+    size_t filelength = headersize + FULLTABLE_BYTES_SIZE + FULLTABLE_RESIDUALS_SIZE;
+
+    fd = open(name.c_str(), O_RDONLY);
+    if ((fd < 0) && (errno == ENOENT)){
+        if (!buildtablefile(name, key, headersize, filelength, plan, maxthreads, verbosity)){
+            return false;
+        }
+        fd = open(name.c_str(), O_RDONLY);
+    }
+    if (fd < 0){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", name.c_str(), strerror(errno));
+        Close();
+        return false;
+    }
+    if ((size_t)info.st_size != filelength){
+        fprintf(stderr, "gamutthingy: full table %s: Wrong file size (not a full table for these settings?)\n", name.c_str());
+        Close();
+        return false;
+    }
+    void* mapping = mmap(NULL, filelength, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED){
+        fprintf(stderr, "gamutthingy: full table %s: %s\n", name.c_str(), strerror(errno));
+        Close();
+        return false;
+    }
+    base = (unsigned char*)mapping;
+    length = filelength;
+    // lookups are scattered all over the table
+    madvise(base, length, MADV_RANDOM);
+
+    fulltableheader fixed;
+    memcpy(&fixed, base, sizeof(fixed));
+    if ((memcmp(fixed.magic, FULLTABLE_MAGIC, sizeof(fixed.magic)) != 0) || (fixed.headersize != headersize) || (fixed.keylength != key.size()) || (memcmp(base + sizeof(fixed), key.data(), key.size()) != 0)){
+        fprintf(stderr, "gamutthingy: full table %s: Header doesn't match these settings\n", name.c_str());
+        Close();
+        return false;
+    }
+    bytes = (png_byte*)(base + headersize);
+    residuals = (float*)(base + headersize + FULLTABLE_BYTES_SIZE);
+    filename = name;
+    openkey = key;
+    return true;
+}
+
+void fulltable::Close(){
+    if (base != NULL){
+        munmap(base, length);
+    }
+    if (fd >= 0){
+        close(fd);
+    }
+    base = NULL;
+    length = 0;
+    fd = -1;
+    bytes = NULL;
+    residuals = NULL;
+    filename.clear();
+    openkey.clear();
+    return;
+}
+
+#else
+
+bool fulltable::Open(const char* directory, const std::string &key, conversionplan &plan, int maxthreads, int verbosity){
+    fprintf(stderr, "gamutthingy: --full-table is not available on this platform\n");
+    return false;
+}
+
+void fulltable::Close(){
+    return;
+}
+
+#endif
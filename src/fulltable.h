@@ -0,0 +1,49 @@
+#ifndef FULLTABLE_H
+#define FULLTABLE_H
+
+#include "conversionplan.h"
+
+#include <stdint.h>
+#include <string>
+#include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
+
+// Full 24-bit conversion table on disk (--full-table), so that converting an 8-bit image is one lookup per pixel.
+// For 8-bit input, the forward conversion is a function from 2^24 input colors to 2^24 output colors,
+// so the first run with a configuration converts every input color (BetterDAC() inputs, as for images, not the LUT grid) on all threads
+// and saves the results; later runs with the same configuration just map the file.
+// There is one file per configuration, named and checked the same way as the memo cache (see memocache.h).
+// After the header comes the undithered RGB8 output for every input color (48 MB), which is bit-exact with converting the image directly,
+// then a float residual for every channel (192 MB, (output * 256) - RGB8 output), which is only touched when dithering.
+// Dithering from the residuals matches dithering the full conversion except where the float rounding crosses a dither threshold.
+// The file is written under a temporary name and linked into place when complete, so a half-built table is never used.
+// The file is memory-mapped, so it's not available on Windows.
+// Open() prints an error and returns false on failure.
+
+class fulltable{
+public:
+    // opens the table for key in directory, first building it by converting every color with plan if it doesn't exist yet
+    // does nothing if that table is already open
+    bool Open(const char* directory, const std::string &key, conversionplan &plan, int maxthreads, int verbosity);
+    bool IsOpen();
+    void Close();
+
+    // undithered RGB8 output for an input color (3 bytes)
+    const png_byte* Output(png_byte red, png_byte green, png_byte blue){
+        return &bytes[(((size_t)red << 16) | (green << 8) | blue) * 3];
+    }
+    // residuals for an input color (3 floats), for quasirandomditherresidual()
+    const float* Residuals(png_byte red, png_byte green, png_byte blue){
+        return &residuals[(((size_t)red << 16) | (green << 8) | blue) * 3];
+    }
+
+private:
+    std::string filename;
+    std::string openkey;
+    unsigned char* base = NULL; // start of the mapping
+    size_t length = 0;
+    int fd = -1;
+    png_byte* bytes = NULL;
+    float* residuals = NULL;
+};
+
+#endif
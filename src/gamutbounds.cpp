@@ -16,12 +16,14 @@
 #include <numbers>
 #include <cstring> //for memcpy
 #include <algorithm> //for reverse
+#include <chrono>
+#include <random>
 
 // make this global so we only need to compute it once
 const double HuePerStep = ((2.0 *  std::numbers::pi_v<long double>) / HUE_STEPS);
 const double HalfHuePerStep = HuePerStep / 2.0;
 
-bool gamutdescriptor::initialize(std::string name, vec3 wp, vec3 rp, vec3 gp, vec3 bp, vec3 other_wp, bool issource, int verbose, int cattype, bool noadapt, bool compressenabled, int crtmode, crtdescriptor* crttoattach){
+bool gamutdescriptor::initialize(std::string name, vec3 wp, vec3 rp, vec3 gp, vec3 bp, vec3 other_wp, bool issource, int verbose, int cattype, bool noadapt, bool compressenabled, int crtmode, crtdescriptor* crttoattach, int boundmethod){
     verbosemode = verbose;
     gamutname = name;
     whitepoint = wp;
@@ -40,6 +42,14 @@ bool gamutdescriptor::initialize(std::string name, vec3 wp, vec3 rp, vec3 gp, ve
     forcenoadapt = (noadapt && issource);
     crtemumode = crtmode;
     attachedCRT = crttoattach;
+    boundarymethod = boundmethod;
+    if ((boundarymethod == BOUNDARY_EXACT) && (crtemumode != CRT_EMU_NONE)){
+        // CRT clipping rules operate on gamma-space RGB after black crush, etc., so there's no simple function to solve
+        if (verbose >= VERBOSITY_MINIMAL){
+            printf("Warning: Exact gamut boundary method does not support CRT emulation. Using slice method for %s.\n", gamutname.c_str());
+        }
+        boundarymethod = BOUNDARY_SLICE;
+    }
     if (verbose >= VERBOSITY_SLIGHT){
         printf("\n----------\nInitializing %s as ", gamutname.c_str());
         if (issourcegamut){
@@ -737,6 +747,86 @@ vec3 gamutdescriptor::JzCzhzToLinearRGB(vec3 input){
     return output;
 }
 
+void gamutdescriptor::linearRGBtoXYZSpan(double* x, double* y, double* z, int count){
+    if (needschromaticadapt && !forcenoadapt){
+        multMatrixBySpan(matrixNPMadaptToD65, x, y, z, count);
+    }
+    else {
+        multMatrixBySpan(matrixNPM, x, y, z, count);
+    }
+    return;
+}
+
+void gamutdescriptor::XYZtoLinearRGBSpan(double* x, double* y, double* z, int count){
+    if (needschromaticadapt && !forcenoadapt){
+        multMatrixBySpan(inverseMatrixNPMadaptToD65, x, y, z, count);
+    }
+    else {
+        multMatrixBySpan(inverseMatrixNPM, x, y, z, count);
+    }
+    return;
+}
+
+void gamutdescriptor::linearRGBtoJzCzhzSpan(double* x, double* y, double* z, int count){
+    // keep the screen barf
+    if (verbosemode >= VERBOSITY_EXTREME){
+        for (int i=0; i<count; i++){
+            vec3 output = linearRGBtoJzCzhz(vec3(x[i], y[i], z[i]));
+            x[i] = output.x;
+            y[i] = output.y;
+            z[i] = output.z;
+        }
+        return;
+    }
+    linearRGBtoXYZSpan(x, y, z, count);
+    if (Jzazbzprecision == PRECISION_FLOAT){
+        XYZtoJzazbzBatchFloat(x, y, z, x, y, z, count);
+    }
+    else if (PQmode == PQ_FAST){
+        XYZtoJzazbzBatch(x, y, z, x, y, z, count);
+    }
+    else {
+        for (int i=0; i<count; i++){
+            vec3 output = XYZtoJzazbz(vec3(x[i], y[i], z[i]));
+            x[i] = output.x;
+            y[i] = output.y;
+            z[i] = output.z;
+        }
+    }
+    for (int i=0; i<count; i++){
+        vec3 output = Polarize(vec3(x[i], y[i], z[i]));
+        x[i] = output.x;
+        y[i] = output.y;
+        z[i] = output.z;
+    }
+    return;
+}
+
+void gamutdescriptor::JzCzhzToLinearRGBSpan(double* x, double* y, double* z, int count){
+    for (int i=0; i<count; i++){
+        vec3 output = Depolarize(vec3(x[i], y[i], z[i]));
+        x[i] = output.x;
+        y[i] = output.y;
+        z[i] = output.z;
+    }
+    if (Jzazbzprecision == PRECISION_FLOAT){
+        JzazbzToXYZBatchFloat(x, y, z, x, y, z, count);
+    }
+    else if (PQmode == PQ_FAST){
+        JzazbzToXYZBatch(x, y, z, x, y, z, count);
+    }
+    else {
+        for (int i=0; i<count; i++){
+            vec3 output = JzazbzToXYZ(vec3(x[i], y[i], z[i]));
+            x[i] = output.x;
+            y[i] = output.y;
+            z[i] = output.z;
+        }
+    }
+    XYZtoLinearRGBSpan(x, y, z, count);
+    return;
+}
+
 vec3 gamutdescriptor::linearRGBtoJzazbz(vec3 input){
     if (verbosemode >= VERBOSITY_EXTREME){
         printf("Linear RGB input is: ");
@@ -2056,6 +2146,15 @@ vec2 gamutdescriptor::getBoundary2D(vec2 color, double focalpointluma, int huein
 // boundtype is used for the VP gamut mapping algorithm
 vec3 gamutdescriptor::getBoundary3D(vec3 color, double focalpointluma, int hueindex, int boundtype, bool dospiralcarisma){
     
+    // The exact solver only describes the real boundary, so VP's extrapolated bounds and spiral carisma's warped bounds still need the slices.
+    if ((boundarymethod == BOUNDARY_EXACT) && (boundtype == BOUND_NORMAL) && !dospiralcarisma){
+        vec3 exactbound;
+        if (getBoundary3DExact(color, focalpointluma, exactbound)){
+            return exactbound;
+        }
+        // if the solver couldn't bracket the boundary, fall through to the slice method
+    }
+    
     // Bascially we're going to call getBoundary2D() for the two adjacent sampled hue slices,
     // then do a line/plane intersection to get the final answer.
     
@@ -2171,6 +2270,374 @@ vec3 gamutdescriptor::getBoundary3D(vec3 color, double focalpointluma, int huein
     return output;
 }
 
+// Stitches the sampled hue slices into a triangle mesh (with BVH) for getBoundary3DMesh().
+// Each slice is resampled to a fixed number of points by arc length, half above the cusp and half below, so the cusps line up.
+void gamutdescriptor::BuildBoundaryMesh(){
+    std::vector<vec3> rings(HUE_STEPS * MESH_RING_POINTS);
+    std::vector<double> arclength;
+    for (int huestep = 0; huestep < HUE_STEPS; huestep++){
+        double hue = huestep * HuePerStep;
+        int pointcount = data[huestep].size();
+        
+        // find the cusp
+        int cuspindex = -1;
+        for (int i=0; i<pointcount; i++){
+            if (data[huestep][i].iscusp){
+                cuspindex = i;
+                break;
+            }
+        }
+        // this shouldn't happen, but if we somehow have no cusp, just split the slice in the middle
+        if ((cuspindex <= 0) || (cuspindex >= pointcount - 1)){
+            cuspindex = pointcount / 2;
+        }
+        
+        // points are ordered from white to black, so accumulate arc length in that order
+        arclength.resize(pointcount);
+        arclength[0] = 0.0;
+        for (int i=1; i<pointcount; i++){
+            arclength[i] = arclength[i-1] + distance2D(vec2(data[huestep][i-1].x, data[huestep][i-1].y), vec2(data[huestep][i].x, data[huestep][i].y));
+        }
+        
+        int segment = 0;
+        for (int k=0; k<MESH_RING_POINTS; k++){
+            // first half goes from white to the cusp, second half from the cusp to black
+            double target;
+            if (k <= MESH_HALF_RING_STEPS){
+                target = arclength[cuspindex] * ((double)k / (double)MESH_HALF_RING_STEPS);
+            }
+            else {
+                target = arclength[cuspindex] + ((arclength[pointcount - 1] - arclength[cuspindex]) * ((double)(k - MESH_HALF_RING_STEPS) / (double)MESH_HALF_RING_STEPS));
+            }
+            while ((segment < pointcount - 2) && (arclength[segment + 1] < target)){
+                segment++;
+            }
+            double seglength = arclength[segment + 1] - arclength[segment];
+            double fraction = 0.0;
+            if (seglength > EPSILONZERO){
+                fraction = (target - arclength[segment]) / seglength;
+            }
+            fraction = clampdouble(fraction);
+            double chroma = data[huestep][segment].x + ((data[huestep][segment + 1].x - data[huestep][segment].x) * fraction);
+            double luma = data[huestep][segment].y + ((data[huestep][segment + 1].y - data[huestep][segment].y) * fraction);
+            rings[(huestep * MESH_RING_POINTS) + k] = Depolarize(vec3(luma, chroma, hue));
+        }
+    }
+    mesh.Build(rings, HUE_STEPS);
+    return;
+}
+
+// Same as getBoundary3D() for BOUND_NORMAL without spiral carisma, but does one 3D ray cast against the boundary mesh
+// instead of two 2D slice intersections plus interpolation.
+// Returns false if the ray missed the mesh (the caller should fall back to getBoundary3D())
+bool gamutdescriptor::getBoundary3DMesh(vec3 color, double focalpointluma, vec3 &output){
+    
+    if ((color.x == 0.0) && (color.y == 0.0)){
+        output = color;
+        return true;
+    }
+    
+    // the focal point is on the achromatic axis, so the ray stays in color's hue plane
+    vec3 focalpoint = vec3(focalpointluma, 0.0, 0.0);
+    vec3 direction = Depolarize(color) - focalpoint;
+    if (direction.magnitude() < EPSILONZERO){
+        return false;
+    }
+    direction.normalize();
+    
+    double distance;
+    if (!mesh.RayCast(focalpoint, direction, EPSILONZERO, distance)){
+        return false;
+    }
+    
+    output = Polarize(focalpoint + (direction * distance));
+    output.z = color.z; // don't let atan2() noise move the hue
+    return true;
+}
+
+// Returns how far the supplied JzCzhz color is outside the linear RGB cube (the largest of R-1, G-1, B-1, -R, -G, -B)
+// Negative inside, zero on the boundary, and positive outside.
+double gamutdescriptor::RGBCubeExcess(vec3 color){
+    vec3 rgbcolor = JzCzhzToLinearRGB(color);
+    // inverse PQ function can generate NaN :( Let's assume all NaNs are waaay out of bounds
+    if (isnan(rgbcolor.x) ||  isnan(rgbcolor.y) || isnan(rgbcolor.z)){
+        return 1.0;
+    }
+    double excess = std::max(rgbcolor.x, std::max(rgbcolor.y, rgbcolor.z)) - 1.0;
+    excess = std::max(excess, -std::min(rgbcolor.x, std::min(rgbcolor.y, rgbcolor.z)));
+    return excess;
+}
+
+// Same as getBoundary3D() for BOUND_NORMAL without spiral carisma, but solves for the exact point where the ray
+// from the focal point through color leaves the linear RGB cube using Brent's method.
+// Returns false if the focal point is not inside the gamut (the caller should fall back to getBoundary3D())
+bool gamutdescriptor::getBoundary3DExact(vec3 color, double focalpointluma, vec3 &output){
+    
+    if ((color.x == 0.0) && (color.y == 0.0)){
+        output = color;
+        return true;
+    }
+    
+    // the focal point is on the achromatic axis, so the ray stays in color's hue plane
+    // and we can just walk luma and chroma linearly with t (t = 0 is the focal point; t = 1 is color)
+    double lumadelta = color.x - focalpointluma;
+    double chromadelta = color.y;
+    if ((fabs(lumadelta) < EPSILONZERO) && (chromadelta < EPSILONZERO)){
+        return false;
+    }
+    
+    // bracket the crossing
+    double a = 0.0;
+    double fa = RGBCubeExcess(vec3(focalpointluma, 0.0, color.z));
+    if (fa >= 0.0){
+        return false;
+    }
+    double b = 1.0;
+    double fb = RGBCubeExcess(vec3(focalpointluma + lumadelta, chromadelta, color.z));
+    int expansions = 0;
+    while (fb < 0.0){
+        // color is inside the gamut, so look farther out
+        a = b;
+        fa = fb;
+        b *= 2.0;
+        fb = RGBCubeExcess(vec3(focalpointluma + (b * lumadelta), b * chromadelta, color.z));
+        expansions++;
+        if (expansions > 64){
+            return false;
+        }
+    }
+    
+    // Brent's method
+    // (the excess function has a kink wherever the out-of-bounds channel changes, so interpolation won't always help,
+    // but Brent falls back to bisection when it doesn't.)
+    double c = a;
+    double fc = fa;
+    double d = b - a;
+    double e = d;
+    for (int i=0; i<EXACT_BOUNDARY_MAX_ITERATIONS; i++){
+        if ((fb > 0.0) == (fc > 0.0)){
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+        if (fabs(fc) < fabs(fb)){
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+        double tolerance = (2.0 * DBL_EPSILON * fabs(b)) + (0.5 * EXACT_BOUNDARY_TOLERANCE);
+        double middle = 0.5 * (c - b);
+        if ((fabs(middle) <= tolerance) || (fb == 0.0)){
+            break;
+        }
+        if ((fabs(e) >= tolerance) && (fabs(fa) > fabs(fb))){
+            // try interpolation
+            double p, q, r;
+            double s = fb / fa;
+            if (a == c){
+                // secant
+                p = 2.0 * middle * s;
+                q = 1.0 - s;
+            }
+            else {
+                // inverse quadratic
+                q = fa / fc;
+                r = fb / fc;
+                p = s * ((2.0 * middle * q * (q - r)) - ((b - a) * (r - 1.0)));
+                q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+            }
+            if (p > 0.0){
+                q = -q;
+            }
+            p = fabs(p);
+            if ((2.0 * p) < std::min((3.0 * middle * q) - fabs(tolerance * q), fabs(e * q))){
+                // accept interpolation
+                e = d;
+                d = p / q;
+            }
+            else {
+                // interpolation failed, bisect
+                d = middle;
+                e = d;
+            }
+        }
+        else {
+            // bounds decreasing too slowly, bisect
+            d = middle;
+            e = d;
+        }
+        a = b;
+        fa = fb;
+        if (fabs(d) > tolerance){
+            b += d;
+        }
+        else {
+            b += (middle > 0.0) ? tolerance : -tolerance;
+        }
+        fb = RGBCubeExcess(vec3(focalpointluma + (b * lumadelta), b * chromadelta, color.z));
+    }
+    
+    output = vec3(focalpointluma + (b * lumadelta), b * chromadelta, color.z);
+    return true;
+}
+
+// Measures the error of the table-driven PQ functions (PQ_FAST) vs. the exact ones (PQ_EXACT) in Jzazbz units
+// over a grid of linear RGB colors in this gamut, both for the forward conversion and for a round trip through the inverse.
+void gamutdescriptor::PQErrorReport(){
+    int oldmode = PQmode;
+    double maxforward = 0.0;
+    double totalforward = 0.0;
+    double maxroundtrip = 0.0;
+    double totalroundtrip = 0.0;
+    int count = 0;
+    const int steps = 33;
+    for (int r=0; r<steps; r++){
+        for (int g=0; g<steps; g++){
+            for (int b=0; b<steps; b++){
+                vec3 color = vec3((double)r / (steps - 1), (double)g / (steps - 1), (double)b / (steps - 1));
+                PQmode = PQ_EXACT;
+                vec3 exact = linearRGBtoJzazbz(color);
+                vec3 exactXYZ = JzazbzToXYZ(exact);
+                PQmode = PQ_FAST;
+                vec3 fast = linearRGBtoJzazbz(color);
+                vec3 fastXYZ = JzazbzToXYZ(exact);
+                // measure the inverse's error by taking its output back to Jzazbz exactly
+                PQmode = PQ_EXACT;
+                vec3 roundtrip = XYZtoJzazbz(fastXYZ);
+                vec3 exactroundtrip = XYZtoJzazbz(exactXYZ);
+                double forwarderror = Distance3D(exact, fast);
+                double roundtriperror = Distance3D(exactroundtrip, roundtrip);
+                totalforward += forwarderror;
+                totalroundtrip += roundtriperror;
+                if (forwarderror > maxforward){
+                    maxforward = forwarderror;
+                }
+                if (roundtriperror > maxroundtrip){
+                    maxroundtrip = roundtriperror;
+                }
+                count++;
+            }
+        }
+    }
+    PQmode = oldmode;
+    printf("Fast PQ error for %s over %i colors, in Jzazbz units:\n", gamutname.c_str(), count);
+    printf("\tForward (linear RGB to Jzazbz): mean %e, max %e\n", totalforward / count, maxforward);
+    printf("\tInverse (Jzazbz to XYZ, measured back in Jzazbz): mean %e, max %e\n", totalroundtrip / count, maxroundtrip);
+    return;
+}
+
+// Times the slice and mesh (and exact, if possible) boundary methods against each other on the same random queries and reports how much they disagree.
+void gamutdescriptor::BenchmarkBoundaryMethods(int samples){
+    
+    printf("\nBenchmarking boundary methods for %s with %i queries...\n", gamutname.c_str(), samples);
+    
+    if (!mesh.built){
+        auto buildstart = std::chrono::steady_clock::now();
+        BuildBoundaryMesh();
+        auto buildend = std::chrono::steady_clock::now();
+        printf("\tMesh build: %f ms (%i triangles, %i BVH nodes)\n", std::chrono::duration<double, std::milli>(buildend - buildstart).count(), (int)mesh.triangles.size(), (int)mesh.nodes.size());
+    }
+    
+    // random in-gamut colors, each with a CUSP-style focal point
+    std::mt19937 rng(8675309);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<vec3> colors;
+    std::vector<double> focallumas;
+    std::vector<int> hueindices;
+    colors.reserve(samples);
+    focallumas.reserve(samples);
+    hueindices.reserve(samples);
+    while ((int)colors.size() < samples){
+        vec3 color = linearRGBtoJzCzhz(vec3(uniform(rng), uniform(rng), uniform(rng)));
+        if (color.y < EPSILON){
+            continue;
+        }
+        double ceilweight;
+        int floorhueindex = hueToFloorIndex(color.z, ceilweight);
+        int ceilhueindex = floorhueindex + 1;
+        if (ceilhueindex == HUE_STEPS){
+            ceilhueindex = 0;
+        }
+        colors.push_back(color);
+        focallumas.push_back(((1.0 - ceilweight) * cusplumalist[floorhueindex]) + (ceilweight * cusplumalist[ceilhueindex]));
+        hueindices.push_back(floorhueindex);
+    }
+    
+    std::vector<vec3> slicebounds(samples);
+    std::vector<vec3> meshbounds(samples);
+    
+    int oldmethod = boundarymethod;
+    boundarymethod = BOUNDARY_SLICE;
+    auto slicestart = std::chrono::steady_clock::now();
+    for (int i=0; i<samples; i++){
+        slicebounds[i] = getBoundary3D(colors[i], focallumas[i], hueindices[i], BOUND_NORMAL, false);
+    }
+    auto sliceend = std::chrono::steady_clock::now();
+    boundarymethod = oldmethod;
+    
+    int misses = 0;
+    auto meshstart = std::chrono::steady_clock::now();
+    for (int i=0; i<samples; i++){
+        if (!getBoundary3DMesh(colors[i], focallumas[i], meshbounds[i])){
+            meshbounds[i] = slicebounds[i];
+            misses++;
+        }
+    }
+    auto meshend = std::chrono::steady_clock::now();
+    
+    double totaldiff = 0.0;
+    double maxdiff = 0.0;
+    for (int i=0; i<samples; i++){
+        double diff = Distance3D(Depolarize(slicebounds[i]), Depolarize(meshbounds[i]));
+        totaldiff += diff;
+        if (diff > maxdiff){
+            maxdiff = diff;
+        }
+    }
+    
+    double slicetime = std::chrono::duration<double, std::nano>(sliceend - slicestart).count() / samples;
+    double meshtime = std::chrono::duration<double, std::nano>(meshend - meshstart).count() / samples;
+    printf("\tSlice method: %f ns per query\n", slicetime);
+    printf("\tMesh method: %f ns per query (%f times the speed of slice method)\n", meshtime, slicetime / meshtime);
+    printf("\tMesh vs. slice boundary distance in Jzazbz: mean %f, max %f; %i mesh misses\n", totaldiff / samples, maxdiff, misses);
+    
+    // the exact solver only works without CRT emulation
+    if (crtemumode == CRT_EMU_NONE){
+        std::vector<vec3> exactbounds(samples);
+        misses = 0;
+        auto exactstart = std::chrono::steady_clock::now();
+        for (int i=0; i<samples; i++){
+            if (!getBoundary3DExact(colors[i], focallumas[i], exactbounds[i])){
+                exactbounds[i] = slicebounds[i];
+                misses++;
+            }
+        }
+        auto exactend = std::chrono::steady_clock::now();
+        
+        totaldiff = 0.0;
+        maxdiff = 0.0;
+        double totalexcess = 0.0;
+        for (int i=0; i<samples; i++){
+            double diff = Distance3D(Depolarize(slicebounds[i]), Depolarize(exactbounds[i]));
+            totaldiff += diff;
+            if (diff > maxdiff){
+                maxdiff = diff;
+            }
+            totalexcess += fabs(RGBCubeExcess(slicebounds[i]));
+        }
+        
+        double exacttime = std::chrono::duration<double, std::nano>(exactend - exactstart).count() / samples;
+        printf("\tExact method: %f ns per query (%f times the speed of slice method)\n", exacttime, slicetime / exacttime);
+        printf("\tExact vs. slice boundary distance in Jzazbz: mean %f, max %f; %i exact solver failures\n", totaldiff / samples, maxdiff, misses);
+        printf("\tSlice method mean distance from the RGB cube surface (in linear RGB): %f\n", totalexcess / samples);
+    }
+    return;
+}
+
 // given the x and y coordinates of a point in xyY space,
 // find a Y such that the corresponding linear RGB is 1.0 for lockcolor (LOCKRED, LOCKGREEN, or LOCKBLUE).
 // output the linear RGB triplet and set Y to the Y value
@@ -2688,6 +3155,14 @@ vec3 mapColor(vec3 color, gamutdescriptor &sourcegamut, gamutdescriptor &destgam
     
     // convert to JzCzhz
     vec3 Jcolor = sourcegamut.linearRGBtoJzCzhz(color);
+
+    vec3 Joutput = mapColorJzCzhz(Jcolor, sourcegamut, destgamut, expand, remapfactor, remaplimit, softknee, kneefactor, mapdirection, safezonetype, dospiralcarisma, nesmode);
+
+    return destgamut.JzCzhzToLinearRGB(Joutput);
+}
+
+vec3 mapColorJzCzhz(vec3 Jcolor, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, bool expand, double remapfactor, double remaplimit, bool softknee, double kneefactor, int mapdirection, int safezonetype, bool dospiralcarisma, bool nesmode){
+
     vec2 colorCJ = vec2(Jcolor.y, Jcolor.x); // chroma is x; luma is y
     vec3 Joutput = Jcolor;
     
@@ -2932,8 +3407,44 @@ vec3 mapColor(vec3 color, gamutdescriptor &sourcegamut, gamutdescriptor &destgam
     }
     */
     
-    return destgamut.JzCzhzToLinearRGB(Joutput);
+    return Joutput;
+
+}
+
+void mapColorSpan(double* red, double* green, double* blue, int count, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, bool expand, double remapfactor, double remaplimit, bool softknee, double kneefactor, int mapdirection, int safezonetype, bool dospiralcarisma, bool nesmode){
 
+    // note the easy black and white cases so we can put them back untouched afterwards
+    std::vector<bool> easy(count, false);
+    if (!(sourcegamut.needschromaticadapt && sourcegamut.forcenoadapt)){
+        for (int i=0; i<count; i++){
+            vec3 color = vec3(red[i], green[i], blue[i]);
+            easy[i] = color.isequal(vec3(0.0, 0.0, 0.0)) || color.isequal(vec3(1.0, 1.0, 1.0));
+        }
+    }
+    std::vector<double> savedred(red, red + count);
+    std::vector<double> savedgreen(green, green + count);
+    std::vector<double> savedblue(blue, blue + count);
+
+    sourcegamut.linearRGBtoJzCzhzSpan(red, green, blue, count);
+    for (int i=0; i<count; i++){
+        if (easy[i]){
+            continue;
+        }
+        vec3 Joutput = mapColorJzCzhz(vec3(red[i], green[i], blue[i]), sourcegamut, destgamut, expand, remapfactor, remaplimit, softknee, kneefactor, mapdirection, safezonetype, dospiralcarisma, nesmode);
+        red[i] = Joutput.x;
+        green[i] = Joutput.y;
+        blue[i] = Joutput.z;
+    }
+    destgamut.JzCzhzToLinearRGBSpan(red, green, blue, count);
+
+    for (int i=0; i<count; i++){
+        if (easy[i]){
+            red[i] = savedred[i];
+            green[i] = savedgreen[i];
+            blue[i] = savedblue[i];
+        }
+    }
+    return;
 }
 
 // Scales the distance to a color according to parameters
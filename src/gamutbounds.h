@@ -4,6 +4,7 @@
 #include "vec2.h"
 #include "vec3.h"
 #include "crtemulation.h"
+#include "boundarymesh.h"
 
 #include <vector>
 #include <string>
@@ -77,6 +78,8 @@ public:
     warprange selfwarp[HUE_STEPS];
     int crtemumode;
     crtdescriptor* attachedCRT;
+    int boundarymethod;
+    boundarymesh mesh;
     double matrixChunghwa[3][3];
     double KinoshitaS1Matrix[3][3];
     double KinoshitaS2Matrix[3][3];
@@ -136,7 +139,7 @@ public:
     double spiralcharismaexponent;
     int spiralcarismascalemode;
     
-    bool initialize(std::string name, vec3 wp, vec3 rp, vec3 gp, vec3 bp, vec3 other_wp, bool issource, int verbose, int cattype, bool noadapt, bool compressenabled, int crtmode, crtdescriptor* crttoattach);
+    bool initialize(std::string name, vec3 wp, vec3 rp, vec3 gp, vec3 bp, vec3 other_wp, bool issource, int verbose, int cattype, bool noadapt, bool compressenabled, int crtmode, crtdescriptor* crttoattach, int boundmethod);
     // resizes vectors ahead of time
     void reservespace();
     void initializeMatrixP();
@@ -176,6 +179,13 @@ public:
     vec3 linearRGBtoJzazbz(vec3 input);
     vec3 linearRGBtoJzCzhz(vec3 input);
     vec3 JzCzhzToLinearRGB(vec3 input);
+    // Span versions of the conversions above, for count colors in structure-of-arrays layout (one array per channel), in place
+    // The JzCzhz ones use the single precision batch Jzazbz kernels when Jzazbzprecision is PRECISION_FLOAT, the double precision batch kernels when PQmode is PQ_FAST,
+    // and the scalar functions otherwise (so results are identical to the single-color versions).
+    void linearRGBtoXYZSpan(double* x, double* y, double* z, int count);
+    void XYZtoLinearRGBSpan(double* x, double* y, double* z, int count);
+    void linearRGBtoJzCzhzSpan(double* x, double* y, double* z, int count);
+    void JzCzhzToLinearRGBSpan(double* x, double* y, double* z, int count);
     
     //vec3 linearRGBtoLCh(vec3 input);
     // TODO: LChtoLinearRGB
@@ -188,6 +198,28 @@ public:
     // boundtype is used for the VP gamut mapping algorithm
     vec3 getBoundary3D(vec3 color, double focalpointluma, int hueindex, int boundtype, bool dospiralcarisma);
     
+    // Stitches the sampled hue slices into a triangle mesh (with BVH) for getBoundary3DMesh().
+    // (Only used by BenchmarkBoundaryMethods(); the mesh ray cast is slower than the slice method, so it is not offered as a boundary method.)
+    // Each slice is resampled to a fixed number of points by arc length, half above the cusp and half below, so the cusps line up.
+    void BuildBoundaryMesh();
+    // Same as getBoundary3D() for BOUND_NORMAL without spiral carisma, but does one 3D ray cast against the boundary mesh
+    // instead of two 2D slice intersections plus interpolation.
+    // Returns false if the ray missed the mesh (the caller should fall back to getBoundary3D())
+    bool getBoundary3DMesh(vec3 color, double focalpointluma, vec3 &output);
+    // Same as getBoundary3D() for BOUND_NORMAL without spiral carisma, but solves for the exact point where the ray
+    // from the focal point through color leaves the linear RGB cube using Brent's method.
+    // Only valid for gamuts without CRT emulation (since the CRT clipping rules aren't a simple function of linear RGB).
+    // Returns false if the focal point is not inside the gamut (the caller should fall back to getBoundary3D())
+    bool getBoundary3DExact(vec3 color, double focalpointluma, vec3 &output);
+    // Returns how far the supplied JzCzhz color is outside the linear RGB cube (the largest of R-1, G-1, B-1, -R, -G, -B)
+    // Negative inside, zero on the boundary, and positive outside.
+    double RGBCubeExcess(vec3 color);
+    // Measures the error of the table-driven PQ functions (PQ_FAST) vs. the exact ones (PQ_EXACT) in Jzazbz units
+    // over a grid of linear RGB colors in this gamut, both for the forward conversion and for a round trip through the inverse.
+    void PQErrorReport();
+    // Times the slice and mesh (and exact, if possible) boundary methods against each other on the same random queries and reports how much they disagree.
+    void BenchmarkBoundaryMethods(int samples);
+    
     // This function is dead. It belonged to an attempted fix for VP's step3 issues that didn't work out well
     // Returns a vector representing the direction from the cusp to the just-above-the-cusp boundary node at the given hue.
     // hueindexA and hueindexB are the indices for the adjacent sampled hue slices
@@ -243,6 +275,14 @@ int hueToFloorIndex(double hue, double &excess);
 //  if RMZONE_DEST_BASED, then remapfactor does nothing
 vec3 mapColor(vec3 color, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, bool expand, double remapfactor, double remaplimit, bool softknee, double kneefactor, int mapdirection, int safezonetype, bool dospiralcarisma, bool nesmode);
 
+// The part of mapColor() that happens in JzCzhz: takes the color already converted to JzCzhz by the source gamut, and returns the remapped JzCzhz color
+// (other parameters same as for mapColor())
+vec3 mapColorJzCzhz(vec3 Jcolor, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, bool expand, double remapfactor, double remaplimit, bool softknee, double kneefactor, int mapdirection, int safezonetype, bool dospiralcarisma, bool nesmode);
+
+// mapColor() for count colors in structure-of-arrays layout (one array per channel), in place
+// The conversions to and from JzCzhz are done a whole span at a time; the mapping itself is done one color at a time.
+void mapColorSpan(double* red, double* green, double* blue, int count, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, bool expand, double remapfactor, double remaplimit, bool softknee, double kneefactor, int mapdirection, int safezonetype, bool dospiralcarisma, bool nesmode);
+
 // Scales the distance to a color according to parameters
 // distcolor: distance from the focal point to the color
 // distsource: distance from the focal point to the source gamut boundary
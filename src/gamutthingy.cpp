@@ -2,13 +2,21 @@
 #include <stdio.h>
 #include <string>
 #include <errno.h>
+#include <signal.h>
 #include <math.h>
 #include <fstream>
 #include <deque>
+#include <list>
 #include <iomanip>
 #include <numeric>
 #include <thread>
 #include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <atomic>
 
 // Include either installed libpng or local copy. Linux should have libpng-dev installed; Windows users can figure stuff out.
 //#include "../../png.h"
@@ -23,6 +31,16 @@
 #include "colormisc.h"
 #include "crtemulation.h"
 #include "nes.h"
+#include "conversionplan.h"
+#include "cpudispatch.h"
+#include "pngstream.h"
+#include "imagefile.h"
+#include "framestream.h"
+#include "requestsocket.h"
+#include "colorlist.h"
+#include "memocache.h"
+#include "fulltable.h"
+#include "lutapply.h"
 
 void printhelp(){
     printf("THIS HELP IS EXTREMELY OUT OF DATE. REFER TO https://github.com/ChthonVII/gamutthingy/blob/master/README.md INSTEAD!!\n\nUsage is:\n\n`--help` or `-h`: Displays help.\n\n`--color` or `-c`: Specifies a single color to convert. A message containing the result will be printed to stdout. Should be a \"0x\" prefixed hexadecimal representation of an RGB8 color. For example: `0xFABF00`.\n\n`--infile` or `-i`: Specifies an input file. Should be a .png image.\n\n`--outfile` or `-o`: Specifies an input file. Should be a .png image.\n\n`--gamma` or `-g`: Specifies the gamma function (and inverse) to be applied to the input and output. Possible values are `srgb` (default) and `linear`. LUTs for FFNx should be created using linear RGB. Images should generally be converted using the sRGB gamma function.\n\n`--source-gamut` or `-s`: Specifies the source gamut. Possible values are:\n\t`srgb`: The sRGB gamut used by (SDR) modern computer monitors. Identical to the bt709 gamut used for modern HD video.\n\t`ntscj`: alias for `ntscjr`.\n\t`ntscjr`: The variant of the NTSC-J gamut used by Japanese CRT television sets, official specification. (whitepoint 9300K+27mpcd) Default.\n\t`ntscjp22`: NTSC-J gamut as derived from average measurements conducted on Japanese CRT television sets with typical P22 phosphors. (whitepoint 9300K+27mpcd) Deviates significantly from the specification, which was usually compensated for by a \"color correction circuit.\" See readme for details.\n\t`ntscjb`: The variant of the NTSC-J gamut used for SD Japanese television broadcasts, official specification. (whitepoint 9300K+8mpcd)\n\t`smptec`: The SMPTE-C gamut used for American CRT television sets/broadcasts and the bt601 video standard.\n\t`ebu`: The EBU gamut used in the European 470bg television/video standards (PAL).\n\n`--dest-gamut` or `-d`: Specifies the destination gamut. Possible values are the same as for source gamut. Default is `srgb`.\n\n`--adapt` or `-a`: Specifies the chromatic adaptation method to use when changing white points. Possible values are `bradford` and `cat16` (default).\n\n`--map-mode` or `-m`: Specifies gamut mapping mode. Possible values are:\n\t`clip`: No gamut mapping is performed and linear RGB output is simply clipped to 0, 1. Detail in the out-of-bounds range will be lost.\n\t`compress`: Uses a gamut (compression) mapping algorithm to remap out-of-bounds colors to a smaller zone inside the gamut boundary. Also remaps colors originally in that zone to make room. Essentially trades away some colorimetric fidelity in exchange for preserving some of the out-of-bounds detail. Default.\n\t`expand`: Same as `compress` but also applies the inverse of the compression function in directions where the destination gamut boundary exceeds the source gamut boundary. (Also, reverses the order of the steps in the `vp` and `vpr` algorithms.) The only use for this is to prepare an image for a \"roundtrip\" conversion. For example, if you want to display a sRGB image as-is in FFNx's NTSC-J mode, you would convert from sRGB to NTSC-J using `expand` in preparation for FFNx doing the inverse operation.\n\n`--gamut-mapping-algorithm` or `--gma`: Specifies which gamut mapping algorithm to use. (Does nothing if `--map-mode clip`.) Possible values are:\n\t`cusp`: The CUSP algorithm, but with tunable compression parameters. See readme for details.\n\t`hlpcm`: The HLPCM algorithm, but with tunable compression parameters. See readme for details.\n\t`vp`: The VP algorithm, but with linear light scaling and tunable compression parameters. See readme for details.\n\t`vpr`: VPR algorithm, a modification of VP created for gamutthingy. The modifications are explained in the readme. Default.\n\n`--safe-zone-type` or `-z`: Specifies how the outer zone subject to remapping and the inner \"safe zone\" exempt from remapping are defined. Possible values are:\n\t`const-fidelity`: The zones are defined relative to the distance from the \"center of gravity\" to the destination gamut boundary. Yields consistent colorimetric fidelity, with variable detail preservation.\n\t`const-detail`: The remapping zone is defined relative to the difference between the distances from the \"center of gravity\" to the source and destination gamut boundaries. As implemented here, an overriding minimum size for the \"safe zone\" (relative to the destination gamut boundary) may also be enforced. Yields consistent detail preservation, with variable colorimetric fidelity (setting aside the override option). Default.\n\n`--remap-factor` or `--rf`: Specifies the size of the remapping zone relative to the difference between the distances from the \"center of gravity\" to the source and destination gamut boundaries. (Does nothing if `--safe-zone-type const-fidelity`.) Default 0.4.\n\n`--remap-limit` or `--rl`: Specifies the size of the safe zone (exempt from remapping) relative to the distance from the \"center of gravity\" to the destination gamut boundary. If `--safe-zone-type const-detail`, this serves as a minimum size limit when application of `--remap-factor` would lead to a smaller safe zone. Default 0.9.\n\n`--knee` or `-k`: Specifies the type of knee function used for compression, `hard` or `soft`. Default `soft`.\n\n`--knee-factor` or `--kf`: Specifies the width of the soft knee relative to the size of the remapping zone. (Does nothing if `--knee hard`.) Note that the soft knee is centered at the knee point, so half the width extends into the safe zone, thus expanding the area that is remapped. Default 0.4.\n\n`--dither` or `--di`: Specifies whether to apply dithering to the ouput, `true` or `false`. Uses Martin Roberts' quasirandom dithering algorithm. Dithering should be used for images in general, but should not be used for LUTs.  Default `true`.\n\n`--verbosity` or `-v`: Specify verbosity level. Integers 0-5. Default 2.\n");
@@ -38,6 +56,55 @@ typedef struct memo{
 // this has to be global because it's too big for the stack
 memo memos[256][256][256];
 
+// second tier of memos on disk, shared with other runs using the same settings (--memo-cache)
+// colors missing from memos are looked up here before being converted
+memocache diskmemo;
+
+// every 8-bit color converted ahead of time, on disk (--full-table)
+// when this is open, forward conversion of 8-bit images skips the memos and converts each pixel with a lookup
+fulltable fulltab;
+
+// LUTs already generated in this run (--lutsize with a list of sizes), so grid points they share with the LUT being generated are copied instead of converted.
+// Grid point i of a LUT of size n is i/(n - 1), which is exactly grid point (i * (m - 1))/(n - 1) of a LUT of size m when that divides evenly.
+// (LUT generation is never dithered, so a grid point's RGB8 output is the same in every LUT.)
+class lutgridshare{
+public:
+    std::atomic<long long> hits{0};
+
+    void Clear(){
+        sizes.clear();
+        luts.clear();
+        hits = 0;
+        return;
+    }
+    // keeps a finished LUT (RGBA, as written to the png)
+    void Add(int lutsize, const png_byte* buffer){
+        sizes.push_back(lutsize);
+        luts.push_back(std::vector<png_byte>(buffer, buffer + ((size_t)lutsize * lutsize * lutsize * 4)));
+        return;
+    }
+    // RGB8 output for grid point red, green, blue of a LUT of lutsize from the first earlier LUT that has it, or NULL if none does
+    const png_byte* Lookup(int lutsize, int red, int green, int blue){
+        int denominator = lutsize - 1;
+        for (size_t i=0; i<sizes.size(); i++){
+            int numerator = sizes[i] - 1;
+            if ((((red * numerator) % denominator) != 0) || (((green * numerator) % denominator) != 0) || (((blue * numerator) % denominator) != 0)){
+                continue;
+            }
+            size_t x = ((size_t)(blue * numerator / denominator) * sizes[i]) + (red * numerator / denominator);
+            size_t y = green * numerator / denominator;
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return &luts[i][((y * sizes[i] * sizes[i]) + x) * 4];
+        }
+        return NULL;
+    }
+
+private:
+    std::vector<int> sizes;
+    std::vector<std::vector<png_byte>> luts;
+};
+lutgridshare lutshare;
+
 // visited list for backwards search (also too big for stack)
 // we need 8 copies for multithreading (ouch)
 bool inversesearchvisitlist0[256][256][256];
@@ -55,155 +122,18 @@ std::mutex coordsmtx;
 std::mutex memomtx;
 std::mutex prettyprintmtx;
 
-// Do the full conversion process on a given color
-vec3 processcolor(vec3 inputcolor, int gammamodein, double gammapowin, int gammamodeout, double gammapowout, int mapmode, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, int cccfunctiontype, double cccfloor, double cccceiling, double cccexp, double remapfactor, double remaplimit, bool softkneemode, double kneefactor, int mapdirection, int safezonetype, bool spiralcarisma, int lutmode, bool nesmode, double hdrsdrmaxnits){
-    vec3 linearinputcolor = inputcolor;
-    if (sourcegamut.crtemumode == CRT_EMU_FRONT){
-        if (lutmode == LUTMODE_POSTCC){
-            if (sourcegamut.attachedCRT->globalgammaadjust != 1.0){
-                bool flip = (linearinputcolor.x < 0.0);
-                if (flip){
-                    linearinputcolor.x *= -1.0;
-                }
-                linearinputcolor.x = pow(linearinputcolor.x, sourcegamut.attachedCRT->globalgammaadjust);
-                if (flip){
-                    linearinputcolor.x *= -1.0;
-                }
-                flip = (linearinputcolor.y < 0.0);
-                if (flip){
-                    linearinputcolor.y *= -1.0;
-                }
-                linearinputcolor.y = pow(linearinputcolor.y, sourcegamut.attachedCRT->globalgammaadjust);
-                if (flip){
-                    linearinputcolor.y *= -1.0;
-                }
-                flip = (linearinputcolor.z < 0.0);
-                if (flip){
-                    linearinputcolor.z *= -1.0;
-                }
-                linearinputcolor.z = pow(linearinputcolor.z, sourcegamut.attachedCRT->globalgammaadjust);
-                if (flip){
-                    linearinputcolor.z *= -1.0;
-                }
-            }
-            linearinputcolor = sourcegamut.attachedCRT->tolinear1886appx1vec3(inputcolor);
-        }
-        else if ((lutmode == LUTMODE_NONE)||(lutmode == LUTMODE_NORMAL)) {
-            linearinputcolor = sourcegamut.attachedCRT->CRTEmulateGammaSpaceRGBtoLinearRGB(inputcolor);
-        }
-        // do nothing if lutmode == LUTMODE_POSTGAMMA, since input color is already linear RGB
-    }
-    else if (gammamodein == GAMMA_SRGB){
-        linearinputcolor = vec3(tolinear(inputcolor.x), tolinear(inputcolor.y), tolinear(inputcolor.z));
-    }
-    else if (gammamodein == GAMMA_REC2084){
-        linearinputcolor = vec3(rec2084tolinear(inputcolor.x, hdrsdrmaxnits), rec2084tolinear(inputcolor.y, hdrsdrmaxnits), rec2084tolinear(inputcolor.z, hdrsdrmaxnits));
-    }
-    else if (gammamodein == GAMMA_POWER){
-        linearinputcolor = vec3(pow(inputcolor.x, gammapowin), pow(inputcolor.y, gammapowin), pow(inputcolor.z, gammapowin));
-    }
-    
-    // Expanded intermediate LUTs expressly contain a ton of out-of-bounds colors
-    // XYZtoJzazbz() will force colors to black if luminosity is negative at that point.
-    // CUSP and VPR-alike GMA algorithms will pull down stuff that's above 1.0 luminosity.
-    // But desaturation-only algorithms (HLPCM) must have luminosity clamped.
-    // NES may also have out-of-bounds luminosity
-    if (((lutmode == LUTMODE_POSTCC) || nesmode) && (mapdirection == MAP_HLPCM)){
-        linearinputcolor = sourcegamut.ClampLuminosity(linearinputcolor);
-    }
-
-    //printf("Linear input is ");
-    //linearinputcolor.printout();
-    //printf("\n");
-
-    vec3 outcolor;
-
-    if (mapmode == MAP_CLIP){
-        vec3 tempcolor = sourcegamut.linearRGBtoXYZ(linearinputcolor);
-        outcolor = destgamut.XYZtoLinearRGB(tempcolor);
-    }
-    else if (mapmode == MAP_CCC_A){
-        // take weighted average of corrected and uncorrected color
-        // based on YPrPgPb-space proximity to primary/secondary colors
-        vec3 tempcolor = sourcegamut.linearRGBtoXYZ(linearinputcolor);
-        outcolor = destgamut.XYZtoLinearRGB(tempcolor);
-        double maxP = sourcegamut.linearRGBfindmaxP(linearinputcolor);
-        double oldweight = 0.0;
-        if (cccfunctiontype == CCC_EXPONENTIAL){
-            oldweight = powermap(cccfloor, cccceiling, maxP, cccexp);
-        }
-        else if (cccfunctiontype == CCC_CUBIC_HERMITE){
-            oldweight = cubichermitemap(cccfloor, cccceiling, maxP);
-        }
-        double newweight = 1.0 - oldweight;
-        outcolor = (linearinputcolor * oldweight) + (outcolor * newweight);
-    }
-    else if ((mapmode == MAP_CCC_B) || (mapmode == MAP_CCC_C)){
-        
-        // apply the "Chunghwa" matrix
-        vec3 corrected = multMatrixByColor(destgamut.matrixChunghwa, linearinputcolor);
-        
-        if (mapmode == MAP_CCC_C){
-            vec3 tempcolor = sourcegamut.linearRGBtoXYZ(linearinputcolor);
-            vec3 accurate = destgamut.XYZtoLinearRGB(tempcolor);
-            double maxP = sourcegamut.linearRGBfindmaxP(linearinputcolor);
-            double cccweight = cubichermitemap(0.0, 1.0, maxP);
-            double accurateweight = 1.0 - cccweight;
-            corrected = (corrected * cccweight) + (accurate * accurateweight); 
-        }
-        
-        // we don't need to clamp here b/c the RGB8 quantizer will clamp for us later
-        
-        
-        outcolor = corrected;
-        
-    }
-    else if ((mapmode == MAP_CCC_D) || (mapmode == MAP_CCC_E)){
-        
-        // apply the appropriate Kinoshita matrix
-        vec3 corrected = sourcegamut.KinoshitaMultiply(linearinputcolor);
-        
-        if (mapmode == MAP_CCC_C){
-            vec3 tempcolor = sourcegamut.linearRGBtoXYZ(linearinputcolor);
-            vec3 accurate = destgamut.XYZtoLinearRGB(tempcolor);
-            double maxP = sourcegamut.linearRGBfindmaxP(linearinputcolor);
-            double cccweight = cubichermitemap(0.0, 1.0, maxP);
-            double accurateweight = 1.0 - cccweight;
-            corrected = (corrected * cccweight) + (accurate * accurateweight); 
-        }
-        
-        // we don't need to clamp here b/c the RGB8 quantizer will clamp for us later
-        
-        
-        outcolor = corrected;
-        
-    }
-    else {
-        outcolor = mapColor(linearinputcolor, sourcegamut, destgamut, (mapmode == MAP_EXPAND), remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, nesmode);
-        //printf("Linear output is ");
-        //outcolor.printout();
-        //printf("\n");
-    }
-    if (destgamut.crtemumode == CRT_EMU_BACK){
-        outcolor = destgamut.attachedCRT->CRTEmulateLinearRGBtoGammaSpaceRGB(outcolor, true);
-    }
-    else if (gammamodeout == GAMMA_SRGB){
-        outcolor = vec3(togamma(outcolor.x), togamma(outcolor.y), togamma(outcolor.z));
-    }
-    else if (gammamodeout == GAMMA_REC2084){
-        outcolor = vec3(rec2084togamma(outcolor.x, hdrsdrmaxnits), rec2084togamma(outcolor.y, hdrsdrmaxnits), rec2084togamma(outcolor.z, hdrsdrmaxnits));
-    }
-    else if (gammamodeout == GAMMA_POWER){
-        double powout = 1.0/gammapowout;
-        outcolor = vec3(pow(outcolor.x, powout), pow(outcolor.y, powout), pow(outcolor.z, powout));
-    }
-    return outcolor;
-}
-
 // Search backwards for an input that yields the chosen output when run through processcolor(),
 // Or closest possible if none exists.
 // WARNING: VERY SLOW!!!
-vec3 inverseprocesscolor(vec3 inputcolor, int gammamodein, double gammapowin, int gammamodeout, double gammapowout, int mapmode, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, int cccfunctiontype, double cccfloor, double cccceiling, double cccexp, double remapfactor, double remaplimit, bool softkneemode, double kneefactor, int mapdirection, int safezonetype, bool spiralcarisma, int lutmode, bool nesmode, double hdrsdrmaxnits, bool inversesearchvisitlist[256][256][256]){
+vec3 inverseprocesscolor(vec3 inputcolor, conversionplan &plan, bool inversesearchvisitlist[256][256][256]){
+    int gammamodein = plan.gammamodein;
+    double gammapowin = plan.gammapowin;
+    int gammamodeout = plan.gammamodeout;
+    double gammapowout = plan.gammapowout;
+    gamutdescriptor &sourcegamut = *plan.sourcegamut;
+    gamutdescriptor &destgamut = *plan.destgamut;
+    double hdrsdrmaxnits = plan.hdrsdrmaxnits;
+
 
     typedef struct frontiernode{
         unsigned int red;
@@ -305,11 +235,11 @@ vec3 inverseprocesscolor(vec3 inputcolor, int gammamodein, double gammapowin, in
         //testcolor.x = examnode.red/255.0;
         //testcolor.y = examnode.green/255.0;
         //testcolor.z = examnode.blue/255.0;
-        testcolor.x = BetterDAC(examnode.red, 256);
-        testcolor.y = BetterDAC(examnode.green, 256);
-        testcolor.z = BetterDAC(examnode.blue, 256);
+        testcolor.x = DAC8Table[examnode.red];
+        testcolor.y = DAC8Table[examnode.green];
+        testcolor.z = DAC8Table[examnode.blue];
 
-        vec3 testtresult = processcolor(testcolor, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, nesmode, hdrsdrmaxnits);
+        vec3 testtresult = plan.Process(testcolor);
 
         // quantize and see how far off we are in RGB space
         int testresultred = toRGB8nodither(testtresult.x);
@@ -678,18 +608,116 @@ vec3 inverseprocesscolor(vec3 inputcolor, int gammamodein, double gammapowin, in
 }
 
 
-vec3 processcolorwrapper(vec3 inputcolor, int gammamodein, double gammapowin, int gammamodeout, double gammapowout, int mapmode, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, int cccfunctiontype, double cccfloor, double cccceiling, double cccexp, double remapfactor, double remaplimit, bool softkneemode, double kneefactor, int mapdirection, int safezonetype, bool spiralcarisma, int lutmode, bool nesmode, double hdrsdrmaxnits, bool backwardsmode, bool inversesearchvisitlist[256][256][256]){
+vec3 processcolorwrapper(vec3 inputcolor, conversionplan &plan, bool backwardsmode, bool inversesearchvisitlist[256][256][256]){
     vec3 output;
     if (backwardsmode){
-        output = inverseprocesscolor(inputcolor, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, nesmode, hdrsdrmaxnits, inversesearchvisitlist);
+        output = inverseprocesscolor(inputcolor, plan, inversesearchvisitlist);
     }
     else {
-        output = processcolor(inputcolor, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, nesmode, hdrsdrmaxnits);
+        output = plan.Process(inputcolor);
     }
     return output;
 }
 
-void loopGuts(int threadno, int width, int height, int x, int y, bool lutgen, png_bytep buffer, int lutsize, int lutmode, double crtclamplow, double crtclamphigh, double lpguscale, bool crtsuperblacks, gamutdescriptor &sourcegamut, gamutdescriptor &destgamut, bool dither, int gammamodein, double gammapowin, int gammamodeout, double gammapowout, int mapmode, int cccfunctiontype, double cccfloor, double cccceiling, double cccexp, double remapfactor, double remaplimit, bool softkneemode, double kneefactor, int mapdirection, int safezonetype, bool spiralcarisma, double hdrsdrmaxnits, bool backwardsmode, bool inversesearchvisitlist[256][256][256]){
+// input color for LUT generation at pixel x, y
+vec3 lutinputcolor(int x, int y, int lutsize, double crtclamplow, double crtclamphigh, double lpguscale, bool crtsuperblacks, conversionplan &plan){
+    // In this one place ONLY, use a "left of bin" DAC so that interpolation will be easier
+    // (When stored values are derived from the floor of each bin, relative distance between indices is proportional to relative distance between stored values)
+    double redvalue = (double)(x % lutsize) / ((double)(lutsize - 1));
+    double greenvalue = (double)y / ((double)(lutsize - 1));
+    double bluevalue = (double)(x / lutsize) / ((double)(lutsize - 1));
+
+    // In this place ONLY, don't use this DAC
+    //redvalue = BetterDAC(x % lutsize, lutsize);
+    //greenvalue = BetterDAC(y, lutsize);
+    //bluevalue = BetterDAC(x / lutsize, lutsize); // integer math implicitly floors x/ lutsize
+
+    // expanded intermediate LUT uses range specified by crt clamping parameters
+    if (plan.lutmode == LUTMODE_POSTCC){
+        double scaleby = crtclamphigh - crtclamplow;
+        redvalue = (redvalue * scaleby) + crtclamplow;
+        greenvalue = (greenvalue * scaleby) + crtclamplow;
+        bluevalue = (bluevalue * scaleby) + crtclamplow;
+    }
+    // LUTMODE_POSTGAMMA_UNLIMITED ranges from zero light to maximum output value
+    else if (plan.lutmode == LUTMODE_POSTGAMMA_UNLIMITED){
+        redvalue *= lpguscale;
+        greenvalue *= lpguscale;
+        bluevalue *= lpguscale;
+        if (!crtsuperblacks){
+            // crush the superblacks we added earlier so that the LUT indices include the superblack range, but they map to outputs without the super blacks
+            redvalue = plan.sourcegamut->attachedCRT->UnSuperBlack(redvalue);
+            greenvalue = plan.sourcegamut->attachedCRT->UnSuperBlack(greenvalue);
+            bluevalue = plan.sourcegamut->attachedCRT->UnSuperBlack(bluevalue);
+        }
+    }
+    return vec3(redvalue, greenvalue, bluevalue);
+}
+
+// where the worker threads read input pixels and write output pixels
+// For PNG, both are the same RGBA buffer and the conversion happens in place.
+// For other formats, the input may be a read-only memory-mapped file and the output another one, with 3 or 4 bytes per pixel.
+// Rows have no padding, and the buffers hold the rows of the band starting at bandstart.
+// (input is unused when generating a LUT.)
+class pixelbuffers{
+public:
+    png_bytep input;
+    int inputbytesperpixel;
+    png_bytep output;
+    int outputbytesperpixel;
+};
+
+// set the alpha of output pixel x in outrow, if the output has alpha
+// LUTs and input without alpha are opaque; otherwise the input alpha is kept (which, in place, means leaving it alone)
+inline void storealpha(pixelbuffers &buffers, png_bytep inrow, png_bytep outrow, int x, bool lutgen){
+    if (buffers.outputbytesperpixel == 4){
+        if (lutgen || (buffers.inputbytesperpixel == 3)){
+            outrow[(x * 4) + 3] = 255;
+        }
+        else if (buffers.input != buffers.output){
+            outrow[(x * 4) + 3] = inrow[(x * 4) + 3];
+        }
+    }
+    return;
+}
+
+// dither (if enabled) and write the output color for pixel x, y to the output buffer
+void storepixel(int width, int height, int x, int y, int bandstart, bool lutgen, pixelbuffers &buffers, vec3 outcolor, bool dither){
+    png_byte redout, greenout, blueout;
+
+    // dither and back to RGB8 if enabled
+    if (dither){
+        // use inverse x coord for red and inverse y coord for blue to decouple dither patterns across channels
+        // see https://blog.kaetemi.be/2015/04/01/practical-bayer-dithering/
+        redout = quasirandomdither(outcolor.x, width - x - 1, y);
+        greenout = quasirandomdither(outcolor.y, x, y);
+        blueout = quasirandomdither(outcolor.z, x, height - y - 1);
+    }
+    // otherwise just back to RGB 8
+    else {
+        redout = toRGB8nodither(outcolor.x);
+        greenout = toRGB8nodither(outcolor.y);
+        blueout = toRGB8nodither(outcolor.z);
+    }
+
+    //printfmtx.lock();
+    //printf("Final output %i, %i, %i.\n", redout, greenout, blueout);
+    //fflush(stdout);
+    //printfmtx.unlock();
+
+    // save to output buffer
+    //buffermtx.lock(); // in theory we don't need this because each index is only accessed one time by one thread
+    png_bytep outrow = &buffers.output[(size_t)(y - bandstart) * width * buffers.outputbytesperpixel];
+    outrow[x * buffers.outputbytesperpixel] = redout;
+    outrow[(x * buffers.outputbytesperpixel) + 1] = greenout;
+    outrow[(x * buffers.outputbytesperpixel) + 2] = blueout;
+    png_bytep inrow = lutgen ? NULL : &buffers.input[(size_t)(y - bandstart) * width * buffers.inputbytesperpixel];
+    storealpha(buffers, inrow, outrow, x, lutgen);
+    //buffermtx.unlock();
+    return;
+}
+
+void loopGuts(int threadno, int width, int height, int x, int y, int bandstart, bool lutgen, pixelbuffers &buffers, int lutsize, double crtclamplow, double crtclamphigh, double lpguscale, bool crtsuperblacks, conversionplan &plan, bool dither, bool backwardsmode, bool inversesearchvisitlist[256][256][256]){
 
     //printfmtx.lock();
     //printf("Thread %i does pixel %i, %i.\n", threadno, x, y);
@@ -701,9 +729,10 @@ void loopGuts(int threadno, int width, int height, int x, int y, bool lutgen, pn
     png_byte bluein = 0;
     if (!lutgen){
         //buffermtx.lock(); // in theory we don't need this because each index is only accessed one time by one thread
-        redin = buffer[ ((y * width) + x) * 4];
-        greenin = buffer[ (((y * width) + x) * 4) + 1 ];
-        bluein = buffer[ (((y * width) + x) * 4) + 2 ];
+        size_t index = ((size_t)((y - bandstart) * width) + x) * buffers.inputbytesperpixel;
+        redin = buffers.input[index];
+        greenin = buffers.input[index + 1];
+        bluein = buffers.input[index + 2];
         //buffermtx.unlock();
 
         //printfmtx.lock();
@@ -712,6 +741,19 @@ void loopGuts(int threadno, int width, int height, int x, int y, bool lutgen, pn
         //printfmtx.unlock();
     }
 
+    // grid points shared with a LUT generated earlier are copied from that one
+    if (lutgen){
+        const png_byte* shared = lutshare.Lookup(lutsize, x % lutsize, y, x / lutsize);
+        if (shared != NULL){
+            png_bytep outrow = &buffers.output[(size_t)(y - bandstart) * width * buffers.outputbytesperpixel];
+            outrow[x * buffers.outputbytesperpixel] = shared[0];
+            outrow[(x * buffers.outputbytesperpixel) + 1] = shared[1];
+            outrow[(x * buffers.outputbytesperpixel) + 2] = shared[2];
+            storealpha(buffers, NULL, outrow, x, lutgen);
+            return;
+        }
+    }
+
     vec3 outcolor;
 
     // if we've already processed the same input color, just recall the memo
@@ -727,62 +769,31 @@ void loopGuts(int threadno, int width, int height, int x, int y, bool lutgen, pn
             //fflush(stdout);
             //printfmtx.unlock();
         }
+        else if (diskmemo.Lookup(redin, greenin, bluein, outcolor)){
+            memos[redin][greenin][bluein].known = true;
+            memos[redin][greenin][bluein].data = outcolor;
+            havememo = true;
+        }
         memomtx.unlock();
     }
     if (!havememo){
 
-        double redvalue;
-        double greenvalue;
-        double bluevalue;
-
+        vec3 inputcolor;
         if (lutgen){
-            // In this one place ONLY, use a "left of bin" DAC so that interpolation will be easier
-            // (When stored values are derived from the floor of each bin, relative distance between indices is proportional to relative distance between stored values)
-            redvalue = (double)(x % lutsize) / ((double)(lutsize - 1));
-            greenvalue = (double)y / ((double)(lutsize - 1));
-            bluevalue = (double)(x / lutsize) / ((double)(lutsize - 1));
-
-            // In this place ONLY, don't use this DAC
-            //redvalue = BetterDAC(x % lutsize, lutsize);
-            //greenvalue = BetterDAC(y, lutsize);
-            //bluevalue = BetterDAC(x / lutsize, lutsize); // integer math implicitly floors x/ lutsize
-
-            // expanded intermediate LUT uses range specified by crt clamping parameters
-            if (lutmode == LUTMODE_POSTCC){
-                double scaleby = crtclamphigh - crtclamplow;
-                redvalue = (redvalue * scaleby) + crtclamplow;
-                greenvalue = (greenvalue * scaleby) + crtclamplow;
-                bluevalue = (bluevalue * scaleby) + crtclamplow;
-            }
-            // LUTMODE_POSTGAMMA_UNLIMITED ranges from zero light to maximum output value
-            else if (lutmode == LUTMODE_POSTGAMMA_UNLIMITED){
-                redvalue *= lpguscale;
-                greenvalue *= lpguscale;
-                bluevalue *= lpguscale;
-                if (!crtsuperblacks){
-                    // crush the superblacks we added earlier so that the LUT indices include the superblack range, but they map to outputs without the super blacks
-                    redvalue = sourcegamut.attachedCRT->UnSuperBlack(redvalue);
-                    greenvalue = sourcegamut.attachedCRT->UnSuperBlack(greenvalue);
-                    bluevalue = sourcegamut.attachedCRT->UnSuperBlack(bluevalue);
-                }
-            }
+            inputcolor = lutinputcolor(x, y, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, plan);
         }
         else {
             // convert to double
-            redvalue = BetterDAC(redin, 256);
-            greenvalue = BetterDAC(greenin, 256);
-            bluevalue = BetterDAC(bluein, 256);
             // don't touch alpha value
+            inputcolor = vec3(DAC8Table[redin], DAC8Table[greenin], DAC8Table[bluein]);
         }
 
-        vec3 inputcolor = vec3(redvalue, greenvalue, bluevalue);
-
         //printfmtx.lock();
         //printf("Input to processcolorwrapper is %f, %f, %f.\n", inputcolor.x, inputcolor.y, inputcolor.z);
         //fflush(stdout);
         //printfmtx.unlock();
 
-        outcolor = processcolorwrapper(inputcolor, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, false, hdrsdrmaxnits, backwardsmode, inversesearchvisitlist);
+        outcolor = processcolorwrapper(inputcolor, plan, backwardsmode, inversesearchvisitlist);
 
         //printfmtx.lock();
         //printf("Output from processcolorwrapper is %f, %f, %f.\n", outcolor.x, outcolor.y, outcolor.z);
@@ -791,7 +802,7 @@ void loopGuts(int threadno, int width, int height, int x, int y, bool lutgen, pn
 
         // blank the out-of-bounds stuff for sanity checking extended intermediate LUTSs
         /*
-        if ((redvalue < 0.0) || (greenvalue < 0.0) || (bluevalue < 0.0) || (redvalue > 1.0) || (greenvalue > 1.0) || (bluevalue > 1.0)){
+        if ((inputcolor.x < 0.0) || (inputcolor.y < 0.0) || (inputcolor.z < 0.0) || (inputcolor.x > 1.0) || (inputcolor.y > 1.0) || (inputcolor.z > 1.0)){
             outcolor = vec3(1.0, 1.0, 1.0);
         }
         */
@@ -801,49 +812,217 @@ void loopGuts(int threadno, int width, int height, int x, int y, bool lutgen, pn
             memomtx.lock();
             memos[redin][greenin][bluein].known = true;
             memos[redin][greenin][bluein].data = outcolor;
+            diskmemo.Store(redin, greenin, bluein, outcolor);
             memomtx.unlock();
         }
     }
 
-    png_byte redout, greenout, blueout;
+    storepixel(width, height, x, y, bandstart, lutgen, buffers, outcolor, dither);
+    return;
+} //end loopGuts()
 
-    // dither and back to RGB8 if enabled
+// scratch space for rowGuts()
+class rowscratch{
+public:
+    std::vector<double> red;
+    std::vector<double> green;
+    std::vector<double> blue;
+    // index in the span holding the output for each pixel, or -1 if the output was memoized
+    std::vector<int> slot;
+    std::vector<double> outred;
+    std::vector<double> outgreen;
+    std::vector<double> outblue;
+    std::vector<png_byte> outbytes;
+    // for LUTs, the output copied from a LUT generated earlier for each pixel, or NULL
+    std::vector<const png_byte*> shared;
+};
+
+// Forward conversion of a whole row at once.
+// Gathers the row's colors that aren't memoized yet (each one only once), runs them through the conversion plan as a single span,
+// memoizes the results, and then writes out every pixel in the row.
+// (Backwards mode can't be batched because each color is a search, so it uses loopGuts() one pixel at a time.)
+// scratch is reused from row to row so we don't allocate per row.
+void rowGuts(int width, int height, int y, int bandstart, bool lutgen, pixelbuffers &buffers, int lutsize, double crtclamplow, double crtclamphigh, double lpguscale, bool crtsuperblacks, conversionplan &plan, bool dither, rowscratch &scratch){
+    std::vector<double> &rowred = scratch.red;
+    std::vector<double> &rowgreen = scratch.green;
+    std::vector<double> &rowblue = scratch.blue;
+    std::vector<int> &rowslot = scratch.slot;
+    rowred.resize(width);
+    rowgreen.resize(width);
+    rowblue.resize(width);
+    rowslot.resize(width);
+    scratch.outred.resize(width);
+    scratch.outgreen.resize(width);
+    scratch.outblue.resize(width);
+    scratch.outbytes.resize(width * 3);
+    if (lutgen){
+        scratch.shared.resize(width);
+    }
+    // the buffers hold the rows of the band starting at bandstart
+    int inbpp = buffers.inputbytesperpixel;
+    int outbpp = buffers.outputbytesperpixel;
+    png_bytep row = lutgen ? NULL : &buffers.input[(size_t)(y - bandstart) * width * inbpp];
+    png_bytep outrow = &buffers.output[(size_t)(y - bandstart) * width * outbpp];
+
+    // with the full table, every pixel is a lookup (and the memos aren't needed)
+    if (!lutgen && fulltab.IsOpen()){
+        for (int x=0; x<width; x++){
+            png_byte redin = row[x * inbpp];
+            png_byte greenin = row[(x * inbpp) + 1];
+            png_byte bluein = row[(x * inbpp) + 2];
+            const png_byte* output = fulltab.Output(redin, greenin, bluein);
+            if (dither){
+                // same coordinates as storepixel()
+                const float* residuals = fulltab.Residuals(redin, greenin, bluein);
+                outrow[x * outbpp] = quasirandomditherresidual(output[0], residuals[0], width - x - 1, y);
+                outrow[(x * outbpp) + 1] = quasirandomditherresidual(output[1], residuals[1], x, y);
+                outrow[(x * outbpp) + 2] = quasirandomditherresidual(output[2], residuals[2], x, height - y - 1);
+            }
+            else {
+                outrow[x * outbpp] = output[0];
+                outrow[(x * outbpp) + 1] = output[1];
+                outrow[(x * outbpp) + 2] = output[2];
+            }
+            storealpha(buffers, row, outrow, x, lutgen);
+        }
+        return;
+    }
+
+    // gather the inputs
+    // rowslot[x] is the index in the span holding the output for pixel x, or -1 if the output was memoized
+    // (or, for LUTs, copied from a LUT generated earlier)
+    int count = 0;
+    if (lutgen){
+        for (int x=0; x<width; x++){
+            scratch.shared[x] = lutshare.Lookup(lutsize, x % lutsize, y, x / lutsize);
+            if (scratch.shared[x] != NULL){
+                rowslot[x] = -1;
+                continue;
+            }
+            vec3 inputcolor = lutinputcolor(x, y, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, plan);
+            rowred[count] = inputcolor.x;
+            rowgreen[count] = inputcolor.y;
+            rowblue[count] = inputcolor.z;
+            rowslot[x] = count;
+            count++;
+        }
+    }
+    else {
+        std::unordered_map<int, int> rowcolors;
+        memomtx.lock();
+        for (int x=0; x<width; x++){
+            png_byte redin = row[x * inbpp];
+            png_byte greenin = row[(x * inbpp) + 1];
+            png_byte bluein = row[(x * inbpp) + 2];
+            if (memos[redin][greenin][bluein].known){
+                rowslot[x] = -1;
+                continue;
+            }
+            vec3 cached;
+            if (diskmemo.Lookup(redin, greenin, bluein, cached)){
+                memos[redin][greenin][bluein].known = true;
+                memos[redin][greenin][bluein].data = cached;
+                rowslot[x] = -1;
+                continue;
+            }
+            int key = (redin << 16) | (greenin << 8) | bluein;
+            auto found = rowcolors.find(key);
+            if (found != rowcolors.end()){
+                rowslot[x] = found->second;
+                continue;
+            }
+            rowcolors[key] = count;
+            // convert to double
+            // don't touch alpha value
+            rowred[count] = DAC8Table[redin];
+            rowgreen[count] = DAC8Table[greenin];
+            rowblue[count] = DAC8Table[bluein];
+            rowslot[x] = count;
+            count++;
+        }
+        memomtx.unlock();
+    }
+
+    // convert
+    if (count > 0){
+        plan.ProcessSpan(rowred.data(), rowgreen.data(), rowblue.data(), count);
+    }
+
+    // memoize the results and recall the memos
+    if (!lutgen){
+        memomtx.lock();
+    }
+    for (int x=0; x<width; x++){
+        vec3 outcolor;
+        if (rowslot[x] >= 0){
+            outcolor = vec3(rowred[rowslot[x]], rowgreen[rowslot[x]], rowblue[rowslot[x]]);
+            if (!lutgen){
+                png_byte redin = row[x * inbpp];
+                png_byte greenin = row[(x * inbpp) + 1];
+                png_byte bluein = row[(x * inbpp) + 2];
+                memos[redin][greenin][bluein].known = true;
+                memos[redin][greenin][bluein].data = outcolor;
+                diskmemo.Store(redin, greenin, bluein, outcolor);
+            }
+        }
+        // filled in below
+        else if (lutgen){
+            outcolor = vec3(0.0, 0.0, 0.0);
+        }
+        else {
+            png_byte redin = row[x * inbpp];
+            png_byte greenin = row[(x * inbpp) + 1];
+            png_byte bluein = row[(x * inbpp) + 2];
+            outcolor = memos[redin][greenin][bluein].data;
+        }
+        scratch.outred[x] = outcolor.x;
+        scratch.outgreen[x] = outcolor.y;
+        scratch.outblue[x] = outcolor.z;
+    }
+    if (!lutgen){
+        memomtx.unlock();
+    }
+
+    // back to RGB8, same as storepixel() but a channel at a time
+    png_byte* redout = &scratch.outbytes[0];
+    png_byte* greenout = &scratch.outbytes[width];
+    png_byte* blueout = &scratch.outbytes[width * 2];
     if (dither){
         // use inverse x coord for red and inverse y coord for blue to decouple dither patterns across channels
-        // see https://blog.kaetemi.be/2015/04/01/practical-bayer-dithering/
-        redout = quasirandomdither(outcolor.x, width - x - 1, y);
-        greenout = quasirandomdither(outcolor.y, x, y);
-        blueout = quasirandomdither(outcolor.z, x, height - y - 1);
+        quasirandomditherspan(scratch.outred.data(), redout, width, width - 1, -1, y);
+        quasirandomditherspan(scratch.outgreen.data(), greenout, width, 0, 1, y);
+        quasirandomditherspan(scratch.outblue.data(), blueout, width, 0, 1, height - y - 1);
     }
-    // otherwise just back to RGB 8
     else {
-        redout = toRGB8nodither(outcolor.x);
-        greenout = toRGB8nodither(outcolor.y);
-        blueout = toRGB8nodither(outcolor.z);
+        toRGB8noditherspan(scratch.outred.data(), redout, width);
+        toRGB8noditherspan(scratch.outgreen.data(), greenout, width);
+        toRGB8noditherspan(scratch.outblue.data(), blueout, width);
     }
 
-    //printfmtx.lock();
-    //printf("Final output %i, %i, %i.\n", redout, greenout, blueout);
-    //fflush(stdout);
-    //printfmtx.unlock();
-
-    // save back to buffer
-    //buffermtx.lock(); // in theory we don't need this because each index is only accessed one time by one thread
-    buffer[ ((y * width) + x) * 4] = redout;
-    buffer[ (((y * width) + x) * 4) + 1 ] = greenout;
-    buffer[ (((y * width) + x) * 4) + 2 ] = blueout;
-    // we need to set opacity data id generating a LUT; if reading an image, leave it unchanged
-    if (lutgen){
-        buffer[ (((y * width) + x) * 4) + 3 ] = 255;
+    // save to output buffer
+    for (int x=0; x<width; x++){
+        if (lutgen && (rowslot[x] < 0)){
+            outrow[x * outbpp] = scratch.shared[x][0];
+            outrow[(x * outbpp) + 1] = scratch.shared[x][1];
+            outrow[(x * outbpp) + 2] = scratch.shared[x][2];
+        }
+        else {
+            outrow[x * outbpp] = redout[x];
+            outrow[(x * outbpp) + 1] = greenout[x];
+            outrow[(x * outbpp) + 2] = blueout[x];
+        }
+        storealpha(buffers, row, outrow, x, lutgen);
     }
-    //buffermtx.unlock();
     return;
-} //end loopGuts()
+} //end rowGuts()
 
-void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, gamutdescriptor* sourcegamutptr, gamutdescriptor* destgamutptr, int width, int height, int* globaly, int verbosity, bool lutgen, png_bytep buffer, int lutsize, int lutmode, double crtclamplow, double crtclamphigh, double lpguscale, bool crtsuperblacks, bool dither, int gammamodein, double gammapowin, int gammamodeout, double gammapowout, int mapmode, int cccfunctiontype, double cccfloor, double cccceiling, double cccexp, double remapfactor, double remaplimit, bool softkneemode, double kneefactor, int mapdirection, int safezonetype, bool spiralcarisma, double hdrsdrmaxnits, bool backwardsmode){
+// Converts rows *globaly through bandend - 1 of the image (buffers hold the rows of the band starting at bandstart).
+// For a whole image, bandstart is 0 and bandend is height.
+// If announce is false, the startup console output and handshake are skipped (for streaming, where the threads are relaunched for every band).
+void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, conversionplan* planptr, int width, int height, int bandstart, int bandend, bool announce, int* globaly, int verbosity, bool lutgen, pixelbuffers* buffers, int lutsize, double crtclamplow, double crtclamphigh, double lpguscale, bool crtsuperblacks, bool dither, bool backwardsmode){
 
     // start the threads in order so the console output looks nice
-    while (true){
+    while (announce){
         prettyprintmtx.lock();
         int ppcounter = *prettyprintcounter;
         prettyprintmtx.unlock();
@@ -854,7 +1033,7 @@ void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, gamutd
     }
 
     // immediately kill threads beyond maxthreads
-    if (threadno >= maxthreads){
+    if (announce && (threadno >= maxthreads)){
         printfmtx.lock();
         printf("Not using thread %i.\n", threadno);
         fflush(stdout);
@@ -865,19 +1044,21 @@ void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, gamutd
         return;
     }
 
-    // announce thread start
-    printfmtx.lock();
-    printf("Thread %i started.\n", threadno);
-    fflush(stdout);
-    printfmtx.unlock();
+    if (announce){
+        // announce thread start
+        printfmtx.lock();
+        printf("Thread %i started.\n", threadno);
+        fflush(stdout);
+        printfmtx.unlock();
 
-    // advance counter so next thread can start
-    prettyprintmtx.lock();
-    *prettyprintcounter = threadno + 1;
-    prettyprintmtx.unlock();
+        // advance counter so next thread can start
+        prettyprintmtx.lock();
+        *prettyprintcounter = threadno + 1;
+        prettyprintmtx.unlock();
+    }
 
     // don't start processing pixels until all threads are started
-    while (true){
+    while (announce){
         prettyprintmtx.lock();
         int ppcounter = *prettyprintcounter;
         prettyprintmtx.unlock();
@@ -923,6 +1104,9 @@ void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, gamutd
     }
     // syntax for using this later as a multidimensional array (bool(*)[256][256])inversesearchvisitlist
 
+    // scratch space for rowGuts()
+    rowscratch scratch;
+
     bool done = false;
     int localx = 0;
     int localy = 0;
@@ -932,7 +1116,7 @@ void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, gamutd
         // (or exit if no pixels left to do)
         // update pixel coords for next iteration (likely on another thread)
         coordsmtx.lock();
-        if (*globaly >= height){
+        if (*globaly >= bandend){
             done = true;
         }
         else {
@@ -944,45 +1128,688 @@ void threadDoStuff(int threadno, int maxthreads, int* prettyprintcounter, gamutd
             break;
         }
         else {
-            for (localx = 0; localx < width; localx++){
+            // progress bar
+            if ((localy == 0) && (verbosity < VERBOSITY_HIGH) && (verbosity >= VERBOSITY_MINIMAL)){
+                printfmtx.lock();
+                printf("0%%... ");
+                fflush(stdout);
+                printfmtx.unlock();
+            }
 
-                // progress bar
-                if ((localy == 0) && (localx == 0) && (verbosity < VERBOSITY_HIGH) && (verbosity >= VERBOSITY_MINIMAL)){
+            // process the row
+            if (backwardsmode){
+                for (localx = 0; localx < width; localx++){
+                    loopGuts(threadno, width, height, localx, localy, bandstart, lutgen, *buffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, *planptr, dither, backwardsmode, (bool(*)[256][256])inversesearchvisitlist);
+                }
+            }
+            else {
+                rowGuts(width, height, localy, bandstart, lutgen, *buffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, *planptr, dither, scratch);
+            }
+
+            // progress bar
+            if (verbosity >= VERBOSITY_HIGH){
+                printfmtx.lock();
+                printf("\t(thread %i) finished row %i of %i...\n", threadno, localy+1, height);
+                fflush(stdout);
+                printfmtx.unlock();
+            }
+            else if (verbosity >= VERBOSITY_MINIMAL){
+                if ((localy > 0) && (localy < height -1) && ((((localy+1)*20)/height) > ((localy*20)/height))){
                     printfmtx.lock();
-                    printf("0%%... ");
+                    printf("%i%%... ", ((localy+1)*100)/height);
+                    if (((localy+1)*100)/height == 50){
+                        printf("\n");
+                    }
                     fflush(stdout);
                     printfmtx.unlock();
                 }
+            }
+        }
+    }
 
-                // process the pixel
-                loopGuts(threadno, width, height, localx, localy, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, *sourcegamutptr, *destgamutptr, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode, (bool(*)[256][256])inversesearchvisitlist);
+    return;
+} // end threadDoStuff()
 
-                // progress bar
-                if (localx == width - 1){
-                    if (verbosity >= VERBOSITY_HIGH){
-                        printfmtx.lock();
-                        printf("\t(thread %i) finished row %i of %i...\n", threadno, localy+1, height);
-                        fflush(stdout);
-                        printfmtx.unlock();
-                    }
-                    else if (verbosity >= VERBOSITY_MINIMAL){
-                        if ((localy > 0) && (localy < height -1) && ((((localy+1)*20)/height) > ((localy*20)/height))){
-                            printfmtx.lock();
-                            printf("%i%%... ", ((localy+1)*100)/height);
-                            if (((localy+1)*100)/height == 50){
-                                printf("\n");
-                            }
-                            fflush(stdout);
-                            printfmtx.unlock();
-                        }
-                    }
-                }
+// Streaming version of the image conversion in main().
+// Rather than decoding the whole image, converting it, and encoding it, the image is decoded in bands of bandrows rows,
+// each band is converted by the worker threads, and finished bands are encoded as we go.
+// While the threads convert a band, this thread encodes the previous band and decodes the next one, so I/O overlaps the conversion,
+// and memory is bounded by three band buffers (plus the memos).
+// (Interlaced input can't be decoded a few rows at a time, so it's read as a single band.)
+int streamimage(char* inputfilename, char* outputfilename, int bandrows, int maxthreads, conversionplan &plan, int verbosity, bool dither, bool backwardsmode, int pnglevel, int pngstrategy){
+
+    pngrowreader reader;
+    if (!reader.Open(inputfilename)){
+        return ERROR_PNG_OPEN_FAIL;
+    }
+    int width = reader.width;
+    int height = reader.height;
+    if (reader.interlaced || (bandrows > height)){
+        if (reader.interlaced && (verbosity >= VERBOSITY_MINIMAL)){
+            printf("Input is interlaced, so it must be read as a single band.\n");
+        }
+        bandrows = height;
+    }
+    int bandcount = (height + bandrows - 1) / bandrows;
+
+    size_t bandsize = (size_t)bandrows * width * 4;
+    png_bytep buffers[3];
+    for (int i=0; i<3; i++){
+        buffers[i] = (png_bytep) malloc(bandsize);  //c++ wants an explict cast
+    }
+    if ((buffers[0] == NULL) || (buffers[1] == NULL) || (buffers[2] == NULL)){
+        fprintf(stderr, "gamutthingy: out of memory: %lu bytes\n", (unsigned long)(bandsize * 3));
+        for (int i=0; i<3; i++){
+            free(buffers[i]);
+        }
+        reader.Close();
+        return ERROR_PNG_MEM_FAIL;
+    }
+
+    pngrowwriter writer;
+    writer.level = pnglevel;
+    writer.strategy = pngstrategy;
+    if (!writer.Open(outputfilename, width, height)){
+        for (int i=0; i<3; i++){
+            free(buffers[i]);
+        }
+        reader.Close();
+        return ERROR_PNG_WRITE_FAIL;
+    }
+
+    // zero the memos
+    memset(&memos, 0, 256 * 256 * 256 * sizeof(memo));
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        printf("Doing gamut conversion on %s and saving result to %s, in %i bands of %i rows using %i threads...\n", inputfilename, outputfilename, bandcount, bandrows, maxthreads);
+    }
+
+    int result = RETURN_SUCCESS;
+    if (!reader.ReadRows(buffers[0], std::min(bandrows, height))){
+        fprintf(stderr, "gamutthingy: read %s: decoding failed\n", inputfilename);
+        result = ERROR_PNG_READ_FAIL;
+    }
+    for (int band=0; (band<bandcount) && (result == RETURN_SUCCESS); band++){
+        int bandstart = band * bandrows;
+        int bandend = std::min(bandstart + bandrows, height);
+        // convert in place
+        pixelbuffers bandbuffers;
+        bandbuffers.input = buffers[band % 3];
+        bandbuffers.inputbytesperpixel = 4;
+        bandbuffers.output = bandbuffers.input;
+        bandbuffers.outputbytesperpixel = 4;
+
+        // launch threads on this band
+        int thready = bandstart;
+        int prettyprintcounter = 0;
+        std::vector<std::thread> workers;
+        for (int i=0; i<maxthreads; i++){
+            workers.push_back(std::thread(threadDoStuff, i, maxthreads, &prettyprintcounter, &plan, width, height, bandstart, bandend, false, &thready, verbosity, false, &bandbuffers, 0, 0.0, 1.0, 1.0, false, dither, backwardsmode));
+        }
+
+        // meanwhile, write the previous band and read the next one
+        if (band > 0){
+            int prevstart = (band - 1) * bandrows;
+            if (!writer.WriteRows(buffers[(band - 1) % 3], bandstart - prevstart)){
+                fprintf(stderr, "gamutthingy: write %s: encoding failed\n", outputfilename);
+                result = ERROR_PNG_WRITE_FAIL;
             }
         }
+        if ((result == RETURN_SUCCESS) && (bandend < height)){
+            if (!reader.ReadRows(buffers[(band + 1) % 3], std::min(bandrows, height - bandend))){
+                fprintf(stderr, "gamutthingy: read %s: decoding failed\n", inputfilename);
+                result = ERROR_PNG_READ_FAIL;
+            }
+        }
+
+        for (int i=0; i<maxthreads; i++){
+            workers[i].join();
+        }
+    }
+    // write the last band
+    if (result == RETURN_SUCCESS){
+        int laststart = (bandcount - 1) * bandrows;
+        if (!writer.WriteRows(buffers[(bandcount - 1) % 3], height - laststart)){
+            fprintf(stderr, "gamutthingy: write %s: encoding failed\n", outputfilename);
+            result = ERROR_PNG_WRITE_FAIL;
+        }
+    }
+    if ((verbosity >= VERBOSITY_MINIMAL) && (verbosity < VERBOSITY_HIGH) && (result == RETURN_SUCCESS)){
+        printf("100%%\n");
+    }
+
+    // the output only replaces outputfilename (which may be inputfilename) if every row was written
+    reader.Close();
+    if (!writer.Close() && (result == RETURN_SUCCESS)){
+        result = ERROR_PNG_WRITE_FAIL;
+    }
+    for (int i=0; i<3; i++){
+        free(buffers[i]);
+    }
+    return result;
+} // end streamimage()
+
+// Frame stream mode: converts a continuous stream of frames from stdin to stdout (see framestream.h).
+// Everything is initialized once, and the memos persist from frame to frame, so after the first few frames most colors are just lookups.
+// Frames are pipelined the same way as bands in streamimage(): while the threads convert a frame,
+// this thread writes the previous frame and reads the next one.
+int streamframes(FILE* input, FILE* output, int format, int framewidth, int frameheight, int y4mmatrix, int maxthreads, conversionplan &plan, int verbosity, bool dither, bool backwardsmode){
+
+    framereader reader;
+    if (!reader.Open(input, format, framewidth, frameheight, y4mmatrix)){
+        return ERROR_FRAME_STREAM_FAIL;
+    }
+    framewriter writer;
+    if (!writer.Open(output, reader)){
+        return ERROR_FRAME_STREAM_FAIL;
+    }
+    int width = reader.width;
+    int height = reader.height;
+
+    size_t framesize = (size_t)width * height * 3;
+    std::vector<png_byte> frames[3];
+    for (int i=0; i<3; i++){
+        frames[i].resize(framesize);
     }
 
+    // zero the memos (once)
+    memset(&memos, 0, 256 * 256 * 256 * sizeof(memo));
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        printf("Converting %ix%i frames from stdin to stdout using %i threads...\n", width, height, maxthreads);
+        fflush(stdout);
+    }
+    auto starttime = std::chrono::steady_clock::now();
+
+    int result = RETURN_SUCCESS;
+    bool eof = false;
+    bool havenext = reader.ReadFrame(frames[0].data(), eof);
+    if (!havenext && !eof){
+        result = ERROR_FRAME_STREAM_FAIL;
+    }
+    int frame = 0;
+    while (havenext && (result == RETURN_SUCCESS)){
+        // convert in place
+        pixelbuffers framebuffers;
+        framebuffers.input = frames[frame % 3].data();
+        framebuffers.inputbytesperpixel = 3;
+        framebuffers.output = framebuffers.input;
+        framebuffers.outputbytesperpixel = 3;
+
+        // launch threads on this frame (quietly; no progress bar per frame)
+        int thready = 0;
+        int prettyprintcounter = 0;
+        std::vector<std::thread> workers;
+        for (int i=0; i<maxthreads; i++){
+            workers.push_back(std::thread(threadDoStuff, i, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, false, &thready, VERBOSITY_SILENT, false, &framebuffers, 0, 0.0, 1.0, 1.0, false, dither, backwardsmode));
+        }
+
+        // meanwhile, write the previous frame and read the next one
+        if ((frame > 0) && !writer.WriteFrame(frames[(frame - 1) % 3].data())){
+            result = ERROR_FRAME_STREAM_FAIL;
+        }
+        if (result == RETURN_SUCCESS){
+            havenext = reader.ReadFrame(frames[(frame + 1) % 3].data(), eof);
+            if (!havenext && !eof){
+                result = ERROR_FRAME_STREAM_FAIL;
+            }
+        }
+
+        for (int i=0; i<maxthreads; i++){
+            workers[i].join();
+        }
+        frame++;
+        if (verbosity >= VERBOSITY_HIGH){
+            printf("\tframe %i\n", frame);
+            fflush(stdout);
+        }
+    }
+    // write the last frame
+    if ((result == RETURN_SUCCESS) && (frame > 0)){
+        if (!writer.WriteFrame(frames[(frame - 1) % 3].data()) || !writer.Flush()){
+            result = ERROR_FRAME_STREAM_FAIL;
+        }
+    }
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count();
+        printf("Converted %i frames in %.2f seconds (%.1f frames per second).\n", frame, seconds, (seconds > 0.0) ? frame / seconds : 0.0);
+    }
+    return result;
+} // end streamframes()
+
+// One image file conversion, split into loading, converting, and saving so that batch mode can overlap them.
+// PPM, PAM, and raw files are memory-mapped (see imagefile.h), and the worker threads convert straight from the input mapping into the output mapping.
+// PNG input is decoded into an RGBA buffer first, and PNG output is encoded from an RGBA buffer afterwards.
+// Alpha is kept if both sides have it, made opaque if only the output has it, and dropped if only the input has it.
+class imagejob{
+public:
+    std::string inputfilename;
+    int inputformat = IMAGE_FORMAT_PNG;
+    int rawwidth = 0;
+    std::string outputfilename;
+    int outputformat = IMAGE_FORMAT_PNG;
+    int width = 0;
+    int height = 0;
+    pixelbuffers buffers;
+    // filled in by convertbatch()
+    int status = RETURN_SUCCESS;
+    double loadseconds = 0.0;
+    double convertseconds = 0.0;
+    double saveseconds = 0.0;
+
+    // opens or decodes the input, and creates the output file or buffer
+    int Load();
+    // encodes or finishes writing the output, then releases everything
+    int Save(int maxthreads, int pnglevel, int pngstrategy);
+    // releases everything without saving
+    void Close();
+
+private:
+    mappedimage mappedinput;
+    mappedimage mappedoutput;
+    png_bytep pnginput = NULL;
+    png_bytep pngoutput = NULL;
+};
+
+int imagejob::Load(){
+    const char* inname = inputfilename.c_str();
+    const char* outname = outputfilename.c_str();
+
+    // input
+    if (inputformat == IMAGE_FORMAT_PNG){
+        pngrowreader reader;
+        if (!reader.Open(inname)){
+            return ERROR_PNG_OPEN_FAIL;
+        }
+        width = reader.width;
+        height = reader.height;
+        pnginput = (png_bytep) malloc((size_t)width * height * 4);  //c++ wants an explict cast
+        if (pnginput == NULL){
+            fprintf(stderr, "gamutthingy: out of memory: %lu bytes\n", (unsigned long)width * height * 4);
+            reader.Close();
+            return ERROR_PNG_MEM_FAIL;
+        }
+        bool readok = reader.ReadRows(pnginput, height);
+        reader.Close();
+        if (!readok){
+            fprintf(stderr, "gamutthingy: read %s: decoding failed\n", inname);
+            Close();
+            return ERROR_PNG_READ_FAIL;
+        }
+        buffers.input = pnginput;
+        buffers.inputbytesperpixel = 4;
+    }
+    else {
+        if (!mappedinput.OpenInput(inname, inputformat, rawwidth)){
+            return ERROR_IMAGE_READ_FAIL;
+        }
+        width = mappedinput.width;
+        height = mappedinput.height;
+        buffers.input = mappedinput.pixels;
+        buffers.inputbytesperpixel = mappedinput.bytesperpixel;
+    }
+
+    // output
+    if (outputformat == IMAGE_FORMAT_PNG){
+        // png to png can be converted in place
+        if (pnginput != NULL){
+            pngoutput = pnginput;
+        }
+        else {
+            pngoutput = (png_bytep) malloc((size_t)width * height * 4);  //c++ wants an explict cast
+            if (pngoutput == NULL){
+                fprintf(stderr, "gamutthingy: out of memory: %lu bytes\n", (unsigned long)width * height * 4);
+                Close();
+                return ERROR_PNG_MEM_FAIL;
+            }
+        }
+        buffers.output = pngoutput;
+        buffers.outputbytesperpixel = 4;
+    }
+    else {
+        // PAM keeps the input's alpha (or lack thereof)
+        int outputbytesperpixel = ImageFormatBytesPerPixel(outputformat);
+        if (outputbytesperpixel == 0){
+            outputbytesperpixel = buffers.inputbytesperpixel;
+        }
+        if (!mappedoutput.CreateOutput(outname, outputformat, width, height, outputbytesperpixel)){
+            Close();
+            return ERROR_IMAGE_WRITE_FAIL;
+        }
+        buffers.output = mappedoutput.pixels;
+        buffers.outputbytesperpixel = outputbytesperpixel;
+    }
+    return RETURN_SUCCESS;
+}
+
+int imagejob::Save(int maxthreads, int pnglevel, int pngstrategy){
+    int result = RETURN_SUCCESS;
+    if (outputformat == IMAGE_FORMAT_PNG){
+        if (!WritePNGParallel(outputfilename.c_str(), pngoutput, width, height, maxthreads, pnglevel, pngstrategy)){
+            result = ERROR_PNG_WRITE_FAIL;
+        }
+    }
+    else {
+        mappedoutput.MarkComplete();
+        if (!mappedoutput.Close()){
+            result = ERROR_IMAGE_WRITE_FAIL;
+        }
+    }
+    Close();
+    return result;
+}
+
+void imagejob::Close(){
+    mappedoutput.Close();
+    mappedinput.Close();
+    if (pngoutput != pnginput){
+        free(pngoutput);
+    }
+    free(pnginput);
+    pngoutput = NULL;
+    pnginput = NULL;
     return;
-} // end threadDoStuff()
+}
+
+// Image file conversion where the input or output (or both) is PPM, PAM, or raw. (See imagejob above.)
+int convertimagefile(char* inputfilename, int inputformat, int rawwidth, char* outputfilename, int outputformat, int maxthreads, conversionplan &plan, int verbosity, bool dither, bool backwardsmode, int pnglevel, int pngstrategy){
+
+    imagejob job;
+    job.inputfilename = inputfilename;
+    job.inputformat = inputformat;
+    job.rawwidth = rawwidth;
+    job.outputfilename = outputfilename;
+    job.outputformat = outputformat;
+    int result = job.Load();
+    if (result != RETURN_SUCCESS){
+        return result;
+    }
+
+    // zero the memos
+    memset(&memos, 0, 256 * 256 * 256 * sizeof(memo));
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        printf("Doing gamut conversion on %s and saving result to %s...\n", inputfilename, outputfilename);
+    }
+
+    // launch threads!
+    int thready = 0;
+    int prettyprintcounter = 0;
+    std::vector<std::thread> workers;
+    for (int i=0; i<8; i++){
+        workers.push_back(std::thread(threadDoStuff, i, maxthreads, &prettyprintcounter, &plan, job.width, job.height, 0, job.height, true, &thready, verbosity, false, &job.buffers, 0, 0.0, 1.0, 1.0, false, dither, backwardsmode));
+    }
+    for (int i=0; i<8; i++){
+        workers[i].join();
+    }
+    if ((verbosity >= VERBOSITY_MINIMAL) && (verbosity < VERBOSITY_HIGH)){
+        printf("100%%\n");
+    }
+
+    return job.Save(maxthreads, pnglevel, pngstrategy);
+} // end convertimagefile()
+
+// converts rows threadno, threadno + maxthreads, ... of a 16-bit image in place with lut
+void png16Worker(int threadno, int maxthreads, appliedlut* lutptr, png_uint_16* pixels, int width, int height, int channels, const double* dactable, bool dither){
+    std::vector<double> red(width);
+    std::vector<double> green(width);
+    std::vector<double> blue(width);
+    for (int y=threadno; y<height; y+=maxthreads){
+        png_uint_16* row = &pixels[(size_t)y * width * channels];
+        for (int x=0; x<width; x++){
+            red[x] = dactable[row[x * channels]];
+            green[x] = dactable[row[(x * channels) + 1]];
+            blue[x] = dactable[row[(x * channels) + 2]];
+        }
+        lutptr->ProcessSpan(red.data(), green.data(), blue.data(), width);
+        // same dither coordinates as storepixel(); alpha is left as it is
+        for (int x=0; x<width; x++){
+            if (dither){
+                row[x * channels] = quasirandomdither16(red[x], width - x - 1, y);
+                row[(x * channels) + 1] = quasirandomdither16(green[x], x, y);
+                row[(x * channels) + 2] = quasirandomdither16(blue[x], x, height - y - 1);
+            }
+            else {
+                row[x * channels] = toRGB16nodither(red[x]);
+                row[(x * channels) + 1] = toRGB16nodither(green[x]);
+                row[(x * channels) + 2] = toRGB16nodither(blue[x]);
+            }
+        }
+    }
+    return;
+}
+
+// 16-bit png conversion (--png16).
+// 2^48 input colors are far too many for the memos, so the image is converted with a dense LUT generated from plan instead (see main).
+// Input of any bit depth is expanded to 16 bits, and the output is always 16 bits.
+int convertimage16(char* inputfilename, char* outputfilename, appliedlut &lut, int maxthreads, int verbosity, bool dither, int pnglevel, int pngstrategy){
+    std::vector<png_uint_16> pixels;
+    int width, height, channels;
+    if (!ReadPNG16(inputfilename, pixels, width, height, channels)){
+        return ERROR_PNG_READ_FAIL;
+    }
+    if (verbosity >= VERBOSITY_MINIMAL){
+        printf("Doing 16-bit gamut conversion on %s and saving result to %s...\n", inputfilename, outputfilename);
+    }
+    std::vector<double> dactable(65536);
+    for (int i=0; i<65536; i++){
+        dactable[i] = BetterDAC(i, 65536);
+    }
+    auto convertstart = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i=0; i<maxthreads; i++){
+        workers.push_back(std::thread(png16Worker, i, maxthreads, &lut, pixels.data(), width, height, channels, dactable.data(), dither));
+    }
+    for (int i=0; i<maxthreads; i++){
+        workers[i].join();
+    }
+    if (verbosity >= VERBOSITY_SLIGHT){
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - convertstart).count();
+        printf("Converted %i pixels in %.3f seconds (%f Mpixels/s).\n", width * height, elapsed, ((double)width * height) / elapsed / 1000000.0);
+    }
+    if (!WritePNG16(outputfilename, pixels.data(), width, height, channels, pnglevel, pngstrategy)){
+        return ERROR_PNG_WRITE_FAIL;
+    }
+    return RETURN_SUCCESS;
+} // end convertimage16()
+
+// Batch mode: converts a whole list of image files with one set of gamut descriptors and one memo table.
+// The memos are zeroed once and then shared by every file, which pays off for sets of images with similar palettes.
+// Files are pipelined like the bands in streamimage(): while the threads convert file N,
+// this thread saves file N-1 and loads file N+1.
+// A file that fails to load or save is reported and skipped; the first error code is returned at the end.
+int convertbatch(std::vector<imagejob> &jobs, int maxthreads, conversionplan &plan, int verbosity, bool dither, bool backwardsmode, int pnglevel, int pngstrategy){
+
+    int result = RETURN_SUCCESS;
+    int converted = 0;
+    int jobcount = jobs.size();
+    if (jobcount == 0){
+        return result;
+    }
+
+    // zero the memos (once)
+    memset(&memos, 0, 256 * 256 * 256 * sizeof(memo));
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        printf("Doing gamut conversion on %i files using %i threads...\n", jobcount, maxthreads);
+    }
+    auto starttime = std::chrono::steady_clock::now();
+
+    auto timedload = [&](int job){
+        auto loadstart = std::chrono::steady_clock::now();
+        jobs[job].status = jobs[job].Load();
+        jobs[job].loadseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadstart).count();
+    };
+    auto timedsave = [&](int job, int threads){
+        auto savestart = std::chrono::steady_clock::now();
+        jobs[job].status = jobs[job].Save(threads, pnglevel, pngstrategy);
+        jobs[job].saveseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - savestart).count();
+        if (jobs[job].status == RETURN_SUCCESS){
+            converted++;
+        }
+        else if (result == RETURN_SUCCESS){
+            result = jobs[job].status;
+        }
+    };
+
+    // While the previous file is saved, its deflate threads and this file's workers split the thread budget.
+    // (Saving the last file, with nothing else running, gets all of it.)
+    int savethreads = std::max(1, maxthreads / 2);
+
+    timedload(0);
+    for (int job=0; job<jobcount; job++){
+        bool saving = (job > 0) && (jobs[job - 1].status == RETURN_SUCCESS);
+        int workerthreads = saving ? std::max(1, maxthreads - savethreads) : maxthreads;
+        // launch threads on this file, if it loaded
+        std::vector<std::thread> workers;
+        int thready = 0;
+        int prettyprintcounter = 0;
+        auto convertstart = std::chrono::steady_clock::now();
+        auto convertend = convertstart;
+        if (jobs[job].status == RETURN_SUCCESS){
+            if (verbosity >= VERBOSITY_MINIMAL){
+                printf("\t%s -> %s\n", jobs[job].inputfilename.c_str(), jobs[job].outputfilename.c_str());
+            }
+            for (int i=0; i<workerthreads; i++){
+                workers.push_back(std::thread(threadDoStuff, i, workerthreads, &prettyprintcounter, &plan, jobs[job].width, jobs[job].height, 0, jobs[job].height, false, &thready, VERBOSITY_SILENT, false, &jobs[job].buffers, 0, 0.0, 1.0, 1.0, false, dither, backwardsmode));
+            }
+        }
+        else if (result == RETURN_SUCCESS){
+            result = jobs[job].status;
+        }
+        // one more thread notes when the workers finish, so the conversion time doesn't include the I/O below
+        std::thread waiter([&workers, &convertend](){
+            for (size_t i=0; i<workers.size(); i++){
+                workers[i].join();
+            }
+            convertend = std::chrono::steady_clock::now();
+        });
+
+        // meanwhile, save the previous file and load the next one
+        if (saving){
+            timedsave(job - 1, savethreads);
+        }
+        if (job + 1 < jobcount){
+            timedload(job + 1);
+        }
+
+        waiter.join();
+        jobs[job].convertseconds = std::chrono::duration<double>(convertend - convertstart).count();
+    }
+    // save the last file
+    if (jobs[jobcount - 1].status == RETURN_SUCCESS){
+        timedsave(jobcount - 1, maxthreads);
+    }
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count();
+        printf("Converted %i of %i files in %.2f seconds.\n", converted, jobcount, seconds);
+    }
+    return result;
+} // end convertbatch()
+
+// Fills in the file formats of batch jobs from their filenames, unless the formats were specified.
+void resolvebatchformats(std::vector<imagejob> &jobs, int inputformat, int outputformat, int rawwidth){
+    for (imagejob &job : jobs){
+        job.inputformat = (inputformat == IMAGE_FORMAT_AUTO) ? ImageFormatFromFilename(job.inputfilename.c_str()) : inputformat;
+        job.outputformat = (outputformat == IMAGE_FORMAT_AUTO) ? ImageFormatFromFilename(job.outputfilename.c_str()) : outputformat;
+        job.rawwidth = rawwidth;
+    }
+    return;
+}
+
+// Builds the list of batch jobs from batchsource, which is either a directory or a list file.
+// For a directory, every image file in it (by extension, see ImageFormatFromFilename()) is converted into batchoutdir under the same name.
+// A list file has one input filename per line, optionally followed by a tab and an output filename;
+// inputs without an output filename are converted into batchoutdir under the same name. Blank lines and lines starting with # are skipped.
+// If outputformat is not auto, output filenames from batchoutdir get that format's extension.
+// Returns false (after printing why) on failure.
+bool buildbatch(const char* batchsource, const char* batchoutdir, int inputformat, int outputformat, int rawwidth, std::vector<imagejob> &jobs){
+    const char* formatextensions[5] = {".png", ".ppm", ".pam", ".rgb", ".rgba"};
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::error_code ec;
+    if (std::filesystem::is_directory(batchsource, ec)){
+        for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(batchsource, ec)){
+            if (!entry.is_regular_file()){
+                continue;
+            }
+            std::string extension = entry.path().extension().string();
+            for (char &c : extension){
+                c = tolower(c);
+            }
+            if ((extension == ".png") || (ImageFormatFromFilename(extension.c_str()) != IMAGE_FORMAT_PNG)){
+                inputs.push_back(entry.path().string());
+                outputs.push_back("");
+            }
+        }
+        if (ec){
+            fprintf(stderr, "gamutthingy: %s: %s\n", batchsource, ec.message().c_str());
+            return false;
+        }
+        // directory order is arbitrary
+        std::sort(inputs.begin(), inputs.end());
+    }
+    else {
+        FILE* listfile = fopen(batchsource, "r");
+        if (listfile == NULL){
+            fprintf(stderr, "gamutthingy: %s: %s\n", batchsource, strerror(errno));
+            return false;
+        }
+        char line[4096];
+        while (fgets(line, sizeof(line), listfile) != NULL){
+            std::string entry = line;
+            while (!entry.empty() && ((entry.back() == '\n') || (entry.back() == '\r'))){
+                entry.pop_back();
+            }
+            if (entry.empty() || (entry[0] == '#')){
+                continue;
+            }
+            size_t tab = entry.find('\t');
+            if (tab == std::string::npos){
+                inputs.push_back(entry);
+                outputs.push_back("");
+            }
+            else {
+                inputs.push_back(entry.substr(0, tab));
+                outputs.push_back(entry.substr(tab + 1));
+            }
+        }
+        fclose(listfile);
+    }
+    if (inputs.empty()){
+        fprintf(stderr, "gamutthingy: %s: no input files\n", batchsource);
+        return false;
+    }
+    if (batchoutdir != NULL){
+        std::filesystem::create_directories(batchoutdir, ec);
+        if (ec){
+            fprintf(stderr, "gamutthingy: %s: %s\n", batchoutdir, ec.message().c_str());
+            return false;
+        }
+    }
+
+    for (size_t i=0; i<inputs.size(); i++){
+        imagejob job;
+        job.inputfilename = inputs[i];
+        job.outputfilename = outputs[i];
+        if (job.outputfilename.empty()){
+            if (batchoutdir == NULL){
+                fprintf(stderr, "gamutthingy: %s: no output filename, and no --batch-outdir\n", inputs[i].c_str());
+                return false;
+            }
+            std::filesystem::path outpath = std::filesystem::path(batchoutdir) / std::filesystem::path(inputs[i]).filename();
+            if (outputformat != IMAGE_FORMAT_AUTO){
+                outpath.replace_extension(formatextensions[outputformat]);
+            }
+            job.outputfilename = outpath.string();
+        }
+        jobs.push_back(job);
+    }
+    resolvebatchformats(jobs, inputformat, outputformat, rawwidth);
+    return true;
+} // end buildbatch()
 
 // structs for holding our ever-growing list of parameters
 typedef struct boolparam{
@@ -1041,7 +1868,379 @@ typedef struct float2param{
     double* vartobind1; // pointer to variable whose value to set
 } float2param;
 
-int main(int argc, const char **argv){
+typedef struct intlistparam{
+    std::string paramstring; // parameter's text
+    std::string prettyname; // name for pretty printing
+    std::vector<int>* vartobind; // pointer to variable whose value to set
+} intlistparam;
+
+// converts every 8-bit color with blue value threadno, threadno + maxthreads, ... and saves the RGB8 output
+void precisionReportWorker(int threadno, int maxthreads, conversionplan* planptr, png_byte* output){
+    std::vector<double> red(256);
+    std::vector<double> green(256);
+    std::vector<double> blue(256);
+    for (int b=threadno; b<256; b+=maxthreads){
+        for (int g=0; g<256; g++){
+            for (int r=0; r<256; r++){
+                red[r] = DAC8Table[r];
+                green[r] = DAC8Table[g];
+                blue[r] = DAC8Table[b];
+            }
+            planptr->ProcessSpan(red.data(), green.data(), blue.data(), 256);
+            png_byte* row = &output[((b * 256) + g) * 256 * 3];
+            for (int r=0; r<256; r++){
+                row[(r * 3)] = toRGB8nodither(red[r]);
+                row[(r * 3) + 1] = toRGB8nodither(green[r]);
+                row[(r * 3) + 2] = toRGB8nodither(blue[r]);
+            }
+        }
+    }
+    return;
+}
+
+// Runs all 256^3 8-bit colors through plan in double precision and again with PRECISION_FLOAT,
+// and prints how much the (undithered) RGB8 outputs differ.
+void precisionReport(conversionplan &plan, int maxthreads){
+    printf("\nComparing single and double precision on all 256^3 8-bit colors...\n");
+    fflush(stdout);
+    int oldprecision = Jzazbzprecision;
+    const int colorcount = 256 * 256 * 256;
+    std::vector<png_byte> doubleoutput(colorcount * 3);
+    std::vector<png_byte> floatoutput(colorcount * 3);
+    double elapsed[2];
+    for (int pass=0; pass<2; pass++){
+        Jzazbzprecision = (pass == 0) ? PRECISION_DOUBLE : PRECISION_FLOAT;
+        png_byte* output = (pass == 0) ? doubleoutput.data() : floatoutput.data();
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int i=0; i<maxthreads; i++){
+            workers.push_back(std::thread(precisionReportWorker, i, maxthreads, &plan, output));
+        }
+        for (int i=0; i<maxthreads; i++){
+            workers[i].join();
+        }
+        auto end = std::chrono::steady_clock::now();
+        elapsed[pass] = std::chrono::duration<double>(end - start).count();
+    }
+    Jzazbzprecision = oldprecision;
+
+    // histogram of the largest channel difference for each color
+    long long histogram[256] = {0};
+    long long channeldiffs[3] = {0, 0, 0};
+    for (int i=0; i<colorcount; i++){
+        int maxdiff = 0;
+        for (int c=0; c<3; c++){
+            int diff = abs((int)doubleoutput[(i * 3) + c] - (int)floatoutput[(i * 3) + c]);
+            if (diff > 0){
+                channeldiffs[c]++;
+            }
+            if (diff > maxdiff){
+                maxdiff = diff;
+            }
+        }
+        histogram[maxdiff]++;
+    }
+    int maxdiff = 0;
+    for (int i=0; i<256; i++){
+        if (histogram[i] > 0){
+            maxdiff = i;
+        }
+    }
+    long long differing = colorcount - histogram[0];
+
+    printf("\tDouble precision: %f s (%f Mcolors/s)\n", elapsed[0], colorcount / elapsed[0] / 1000000.0);
+    printf("\tSingle precision: %f s (%f Mcolors/s)\n", elapsed[1], colorcount / elapsed[1] / 1000000.0);
+    printf("\tColors with any RGB8 difference: %lli of %i (%f%%)\n", differing, colorcount, (100.0 * differing) / colorcount);
+    printf("\tChannels differing: red %lli, green %lli, blue %lli\n", channeldiffs[0], channeldiffs[1], channeldiffs[2]);
+    printf("\tLargest channel difference per color:\n");
+    for (int i=1; i<=maxdiff; i++){
+        if (histogram[i] > 0){
+            printf("\t\t%i: %lli colors\n", i, histogram[i]);
+        }
+    }
+    const double percentiles[5] = {50.0, 90.0, 99.0, 99.9, 99.99};
+    for (int p=0; p<5; p++){
+        long long needed = (long long)ceil((percentiles[p] / 100.0) * colorcount);
+        long long cumulative = 0;
+        int value = 0;
+        for (int i=0; i<256; i++){
+            cumulative += histogram[i];
+            if (cumulative >= needed){
+                value = i;
+                break;
+            }
+        }
+        printf("\t%.2f percentile: %i\n", percentiles[p], value);
+    }
+    printf("\tMax: %i\n", maxdiff);
+    return;
+}
+
+void colorListWorker(int threadno, int maxthreads, conversionplan* planptr, const std::vector<int>* colors, std::vector<vec3>* results, bool backwardsmode){
+    conversionplan &plan = *planptr;
+    // each thread needs its own visited list for backwards search
+    bool (*visitlists[8])[256][256] = {inversesearchvisitlist0, inversesearchvisitlist1, inversesearchvisitlist2, inversesearchvisitlist3, inversesearchvisitlist4, inversesearchvisitlist5, inversesearchvisitlist6, inversesearchvisitlist7};
+    for (size_t i=threadno; i<colors->size(); i+=maxthreads){
+        int input = (*colors)[i];
+        vec3 color = vec3(BetterDAC(input >> 16, 256), BetterDAC((input & 0x0000FF00) >> 8, 256), BetterDAC(input & 0x000000FF, 256));
+        (*results)[i] = processcolorwrapper(color, plan, backwardsmode, visitlists[threadno]);
+    }
+    return;
+}
+
+// Converts a list of RGB8 colors (0xRRGGBB) across maxthreads threads, for color list mode and server mode.
+// The results are unclamped, before quantization.
+void convertcolorlist(const std::vector<int> &colors, std::vector<vec3> &results, conversionplan &plan, int maxthreads, bool backwardsmode){
+    results.resize(colors.size());
+    // not worth starting threads for a handful of colors
+    if (colors.size() < 64){
+        maxthreads = 1;
+    }
+    std::vector<std::thread> workers;
+    for (int i=0; i<maxthreads; i++){
+        workers.push_back(std::thread(colorListWorker, i, maxthreads, &plan, &colors, &results, backwardsmode));
+    }
+    for (int i=0; i<maxthreads; i++){
+        workers[i].join();
+    }
+    return;
+}
+
+// For running gamutthingymain() from inside gamutthingy (job file mode and server mode):
+// the run converts these instead of its --infile/--outfile or --color.
+typedef struct hostedrun{
+    std::vector<imagejob>* batch = NULL;    // batch to convert (see convertbatch())
+    std::vector<int>* colors = NULL;        // RGB8 colors (0xRRGGBB) to convert
+    std::vector<vec3> colorresults;         // converted colors (unclamped, before quantization)
+} hostedrun;
+
+// Cache of initialized gamut descriptors, and the CRT they're attached to, keyed by everything that goes into them.
+// (A list, so that the descriptors never move once they're in it; the source gamut points at the CRT.)
+// Kept in least recently used order, and limited to descriptorcachelimit entries so a long-running server doesn't grow without bound.
+#define DESCRIPTOR_CACHE_SIZE 8 // default limit; server mode adds one per configuration
+typedef struct descriptorset{
+    std::string key;
+    crtdescriptor crt;
+    gamutdescriptor source;
+    gamutdescriptor dest;
+} descriptorset;
+
+std::list<descriptorset> descriptorcache;
+size_t descriptorcachelimit = DESCRIPTOR_CACHE_SIZE;
+int descriptorsetsbuilt = 0;
+
+// returns the cached descriptors for key (with found set), or a fresh entry for the caller to initialize
+// (the least recently used entry is thrown away if the cache is full, so pointers from earlier calls don't stay valid)
+descriptorset* finddescriptorset(const std::string &key, bool &found){
+    for (auto entry = descriptorcache.begin(); entry != descriptorcache.end(); entry++){
+        if (entry->key == key){
+            found = true;
+            // move it to the most recently used end (splice() doesn't move the element itself)
+            descriptorcache.splice(descriptorcache.end(), descriptorcache, entry);
+            return &descriptorcache.back();
+        }
+    }
+    found = false;
+    while ((descriptorcache.size() >= descriptorcachelimit) && !descriptorcache.empty()){
+        descriptorcache.pop_front();
+    }
+    descriptorcache.emplace_back();
+    descriptorcache.back().key = key;
+    descriptorsetsbuilt++;
+    return &descriptorcache.back();
+}
+
+// throws away the newest entry (after its initialization failed)
+void dropdescriptorset(){
+    descriptorcache.pop_back();
+    descriptorsetsbuilt--;
+    return;
+}
+
+void keyappend(std::string &key, double value){
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.17g,", value);
+    key += buffer;
+    return;
+}
+
+void keyappend(std::string &key, int value){
+    key += std::to_string(value) + ",";
+    return;
+}
+
+void keyappend(std::string &key, vec3 value){
+    keyappend(key, value.x);
+    keyappend(key, value.y);
+    keyappend(key, value.z);
+    return;
+}
+
+// prints (and resets) how many colors the memo cache on disk supplied and took
+void reportmemocache(int verbosity){
+    if (!diskmemo.IsOpen()){
+        return;
+    }
+    if (verbosity >= VERBOSITY_SLIGHT){
+        printf("Memo cache: %li colors reused from earlier runs, %li colors added.\n", diskmemo.hits.load(), diskmemo.stores.load());
+    }
+    diskmemo.hits = 0;
+    diskmemo.stores = 0;
+    return;
+}
+
+// output filename for one of several LUT sizes: the size is added before the extension (lut.png -> lut-64.png)
+std::string lutsizefilename(const char* filename, int lutsize){
+    std::filesystem::path path(filename);
+    std::filesystem::path sized = path.parent_path() / (path.stem().string() + "-" + std::to_string(lutsize) + path.extension().string());
+    return sized.string();
+}
+
+// LUT generation: converts every grid point of a LUT of lutsize and saves it to outputfilename.
+// Grid points shared with LUTs generated earlier in this run are copied from lutshare, and this LUT is added to it when done.
+// Sets lpguscale and lpguscalereciprocal for LUTMODE_POSTGAMMA_UNLIMITED (which depend on lutsize).
+int generatelut(int lutsize, const char* outputfilename, int maxthreads, conversionplan &plan, int verbosity, bool backwardsmode, crtdescriptor* crt, double crtclamplow, double crtclamphigh, bool crtdoclamphigh, double crtgammaknob, bool crtsuperblacks, int pnglevel, int pngstrategy, double &lpguscale, double &lpguscalereciprocal){
+    int width = lutsize * lutsize;
+    int height = lutsize;
+    size_t buffsize = (size_t)width * height * 4;
+    png_bytep buffer = (png_bytep) malloc(buffsize);  //c++ wants an explict cast
+    if (buffer == NULL){
+        fprintf(stderr, "gamutthingy: out of memory: %lu bytes\n", (unsigned long)buffsize);
+        return ERROR_PNG_MEM_FAIL;
+    }
+
+    if (verbosity >= VERBOSITY_MINIMAL){
+        printf("Doing gamut conversion on LUT and saving result to %s...\n", outputfilename);
+    }
+
+    // we need to know our ceiling for LUTMODE_POSTGAMMA_UNLIMITED
+    lpguscale = 1.0;
+    lpguscalereciprocal = 1.0;
+    if ((plan.lutmode == LUTMODE_POSTGAMMA_UNLIMITED) && crt){
+        lpguscale = postgammaunlimitedscale(crt, lutsize, crtdoclamphigh, crtclamphigh, crtgammaknob, lpguscalereciprocal);
+    }
+
+    pixelbuffers imagebuffers;
+    imagebuffers.input = buffer;
+    imagebuffers.inputbytesperpixel = 4;
+    imagebuffers.output = buffer;
+    imagebuffers.outputbytesperpixel = 4;
+    long long sharedbefore = lutshare.hits.load();
+
+    // launch threads!
+    int thready = 0;
+    int prettyprintcounter = 0;
+    std::vector<std::thread> workers;
+    for (int i=0; i<8; i++){
+        workers.push_back(std::thread(threadDoStuff, i, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, true, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, false, backwardsmode));
+    }
+    for (int i=0; i<8; i++){
+        workers[i].join();
+    }
+    if ((verbosity >= VERBOSITY_MINIMAL) && (verbosity < VERBOSITY_HIGH)){
+        printf("100%%\n");
+    }
+    long long shared = lutshare.hits.load() - sharedbefore;
+    if ((shared > 0) && (verbosity >= VERBOSITY_SLIGHT)){
+        printf("Copied %lli of %lli grid points from LUTs generated earlier.\n", shared, (long long)width * height);
+    }
+
+    int result = ERROR_PNG_WRITE_FAIL;
+    // filter and deflate bands of rows in parallel
+    if (WritePNGParallel(outputfilename, buffer, width, height, maxthreads, pnglevel, pngstrategy)){
+        result = RETURN_SUCCESS;
+        printf("done.\n");
+    }
+    // the grid for LUTMODE_POSTGAMMA_UNLIMITED is scaled differently for each size, so nothing is shared
+    if ((result == RETURN_SUCCESS) && (plan.lutmode != LUTMODE_POSTGAMMA_UNLIMITED)){
+        lutshare.Add(lutsize, buffer);
+    }
+    free(buffer);
+    return result;
+} // end generatelut()
+
+// writes the parameters file for retroarch CCC shaders for the LUT in lutfilename
+int writeretroarchtext(const char* textfilename, const char* lutfilename, int lutmode, int argc, const char **argv, crtdescriptor* crt, double crtblacklevel, double crtwhitelevel, double crtgammaknob, double lpguscalereciprocal, bool crtsuperblacks, bool crtblackpedestalcrush, double crtblackpedestalcrushamount, bool crtdoclamphigh, double crtclamphigh){
+    printf("Writing text file for retroarch CC shaders parameters to %s...", textfilename);
+    std::ofstream ratxtfile;
+    ratxtfile.open(textfilename, std::ios::out);
+    if (!ratxtfile.is_open()){
+        printf("Unable to open %s for writing.\n", textfilename);
+        return ERROR_PNG_OPEN_FAIL;
+    }
+    ratxtfile << "# Paste this at the bottom of a template file of Chthon's Color Correction shaders.\n";
+    switch (lutmode){
+        case LUTMODE_NORMAL:
+            ratxtfile << "# Use a LUTtype1 or LUTtype1fast template.\n";
+            break;
+        case LUTMODE_POSTCC:
+            ratxtfile << "# Use a LUTtype2 template.\n";
+            break;
+        case LUTMODE_POSTGAMMA:
+            ratxtfile << "# Use a LUTtype3 template.\n";
+            break;
+        case LUTMODE_POSTGAMMA_UNLIMITED:
+            ratxtfile << "# Use a LUTtype4 template.\n";
+            break;
+        default:
+            ratxtfile << "# Somthing is very wrong.\n";
+            break;
+    };
+    ratxtfile << "# Paste " << lutfilename << " into the \"luts\" subdirectory of Chthon's Color Correction shaders.\n";
+    ratxtfile << "# LUT generation command: gamutthingy";
+    for (int i=1; i<argc; i++){
+        ratxtfile << " " << argv[i];
+    }
+    ratxtfile << "\n\n\n";
+    ratxtfile << "SamplerLUT = \"luts/" << lutfilename << "\"\n\n";
+
+    ratxtfile << std::setprecision(16);
+
+    ratxtfile << "crtBlackLevel = \"" << crtblacklevel << "\"\n";
+    ratxtfile << "crtWhiteLevel = \"" << crtwhitelevel << "\"\n";
+    ratxtfile << "crtConstantB = \"" << crt->CRT_EOTF_b << "\"\n";
+    ratxtfile << "crtConstantK = \"" << crt->CRT_EOTF_k << "\"\n";
+    ratxtfile << "crtConstantS = \"" << crt->CRT_EOTF_s << "\"\n";
+    ratxtfile << "crtGammaKnob = \"" << crtgammaknob << "\"\n\n";
+
+    if (lutmode == LUTMODE_NORMAL){
+        ratxtfile << "# For a LUTtype1fast template, you may omit everything below this point.\n\n";
+    }
+
+    ratxtfile << "crtLUT4scale = \"" << lpguscalereciprocal << "\"\n";
+    ratxtfile << "crtLUT4renorm = \"" << (((lutmode == LUTMODE_POSTGAMMA_UNLIMITED) && !crtsuperblacks) ? "1.0" : "0.0") << "\"\n\n";
+
+    ratxtfile << "crtMatrixRR = \"" << crt->overallMatrix[0][0] << "\"\n";
+    ratxtfile << "crtMatrixRG = \"" << crt->overallMatrix[0][1] << "\"\n";
+    ratxtfile << "crtMatrixRB = \"" << crt->overallMatrix[0][2] << "\"\n";
+    ratxtfile << "crtMatrixGR = \"" << crt->overallMatrix[1][0] << "\"\n";
+    ratxtfile << "crtMatrixGG = \"" << crt->overallMatrix[1][1] << "\"\n";
+    ratxtfile << "crtMatrixGB = \"" << crt->overallMatrix[1][2] << "\"\n";
+    ratxtfile << "crtMatrixBR = \"" << crt->overallMatrix[2][0] << "\"\n";
+    ratxtfile << "crtMatrixBG = \"" << crt->overallMatrix[2][1] << "\"\n";
+    ratxtfile << "crtMatrixBB = \"" << crt->overallMatrix[2][2] << "\"\n\n";
+
+    ratxtfile << "crtBlackCrush = \"" << (crtblackpedestalcrush ? "1.0" : "0.0") << "\"\n";
+    ratxtfile << "crtBlackCrushAmount = \"" << crtblackpedestalcrushamount << "\"\n";
+    if ((lutmode == LUTMODE_POSTGAMMA_UNLIMITED) && !crtsuperblacks){
+        ratxtfile << "# crtSuperBlackEnable is forced to true for LUTtype4.\n";
+    }
+    ratxtfile << "crtSuperBlackEnable = \"" << ((crtsuperblacks || (lutmode == LUTMODE_POSTGAMMA_UNLIMITED)) ? "1.0" : "0.0") << "\"\n\n";
+
+    if(crt->zerolightclampenable){
+        ratxtfile << "# crtLowClamp is set at zero light emission.\n";
+    }
+    ratxtfile << "crtLowClamp = \"" << crt->rgbclamplowlevel << "\"\n";
+    ratxtfile << "crtHighClampEnable = \"" << (crtdoclamphigh ? "1.0" : "0.0") << "\"\n";
+    ratxtfile << "crtHighClamp = \"" << crtclamphigh << "\"\n";
+
+    ratxtfile.flush();
+    ratxtfile.close();
+    printf(" done.\n");
+    return RETURN_SUCCESS;
+}
+
+int gamutthingymain(int argc, const char **argv, hostedrun* host){
     
     // ----------------------------------------------------------------------------------------
     // parameter processing
@@ -1097,6 +2296,16 @@ int main(int argc, const char **argv){
     bool infileset = false;
     bool outfileset = false;
     bool incolorset = false;
+    char* batchsource;
+    char* batchoutdir = NULL;
+    bool batchset = false;
+    bool batchoutdirset = false;
+    char* memocachedir = NULL;
+    bool memocacheset = false;
+    char* fulltabledir = NULL;
+    bool fulltableset = false;
+    std::vector<imagejob> builtbatch;
+    std::vector<imagejob>* batchjobs = &builtbatch;
     double remapfactor = 0.4;
     double remaplimit = 0.9;
     double kneefactor = 0.4;
@@ -1139,6 +2348,7 @@ int main(int argc, const char **argv){
     bool lutgen = false;
     int lutmode = LUTMODE_NORMAL;
     int lutsize = 128;
+    std::vector<int> lutsizes = {lutsize}; // more than one for generating several LUT sizes at once
     double lpguscale = 1.0; // needs to be a function-wide variable so we can print it later
     double lpguscalereciprocal = 1.0; // needs to be a function-wide variable so we can print it later
     bool nesmode = false;
@@ -1158,8 +2368,35 @@ int main(int argc, const char **argv){
     bool retroarchwritetext = false;
     char* retroarchtextfilename;
     int maxthreads = 0;
+    int boundarymethod = BOUNDARY_SLICE;
+    bool boundarybenchmark = false;
+    int pqmode = PQ_EXACT;
+    int precision = PRECISION_DOUBLE;
+    int cpulevel = CPU_LEVEL_AUTO;
+    bool precisionreport = false;
+    char* colorlistfilename;
+    bool colorlistset = false;
+    int colorlistformat = COLOR_LIST_AUTO;
+    char* lutapplyfilename;
+    bool lutapplyset = false;
+    int lutinterpolation = LUT_INTERPOLATE_TETRAHEDRAL;
+    bool lutbenchmark = false;
+    bool png16 = false;
+    bool png16report = false;
+    int png16lutsize = 129;
+    bool colorlistfloats = false;
+    colorlist inputcolorlist;
+    int streamband = 0;
+    int pnglevel = 6;
+    int pngstrategy = PNG_STRATEGY_FILTERED;
+    int inputformat = IMAGE_FORMAT_AUTO;
+    int outputformat = IMAGE_FORMAT_AUTO;
+    int rawwidth = 0;
+    int rawheight = 0;
+    int framestream = FRAME_STREAM_NONE;
+    int y4mmatrix = Y4M_MATRIX_BT601;
     
-    const boolparam params_bool[20] = {
+    const boolparam params_bool[26] = {
         {
             "--dither",         //std::string paramstring; // parameter's text
             "Dithering",        //std::string prettyname; // name for pretty printing
@@ -1251,18 +2488,48 @@ int main(int argc, const char **argv){
             &forcedisablechromaticadapt                //bool* vartobind; // pointer to variable whose value to set
         },
         {
-            "--nealrenormangle",                     //std::string paramstring; // parameter's text
-            "Renormalize Neal CRT color correction angles",           //std::string prettyname; // name for pretty printing
-            &nealrenormangle                //bool* vartobind; // pointer to variable whose value to set
+            "--nealrenormangle",                     //std::string paramstring; // parameter's text
+            "Renormalize Neal CRT color correction angles",           //std::string prettyname; // name for pretty printing
+            &nealrenormangle                //bool* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--nealrenormgain",                     //std::string paramstring; // parameter's text
+            "Renormalize Neal CRT color correction gains",           //std::string prettyname; // name for pretty printing
+            &nealrenormgain               //bool* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--boundary-benchmark",                     //std::string paramstring; // parameter's text
+            "Benchmark gamut boundary methods",           //std::string prettyname; // name for pretty printing
+            &boundarybenchmark               //bool* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--lut-benchmark",                     //std::string paramstring; // parameter's text
+            "Benchmark LUT interpolation",           //std::string prettyname; // name for pretty printing
+            &lutbenchmark               //bool* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--precision-report",                     //std::string paramstring; // parameter's text
+            "Report single vs. double precision differences",           //std::string prettyname; // name for pretty printing
+            &precisionreport               //bool* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--colorlist-floats",                     //std::string paramstring; // parameter's text
+            "Color List Floating Point Output",           //std::string prettyname; // name for pretty printing
+            &colorlistfloats               //bool* vartobind; // pointer to variable whose value to set
         },
         {
-            "--nealrenormgain",                     //std::string paramstring; // parameter's text
-            "Renormalize Neal CRT color correction gains",           //std::string prettyname; // name for pretty printing
-            &nealrenormgain               //bool* vartobind; // pointer to variable whose value to set
+            "--png16",                     //std::string paramstring; // parameter's text
+            "16-bit PNG Input/Output",           //std::string prettyname; // name for pretty printing
+            &png16               //bool* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--png16-report",                     //std::string paramstring; // parameter's text
+            "Report 16-bit LUT error",           //std::string prettyname; // name for pretty printing
+            &png16report               //bool* vartobind; // pointer to variable whose value to set
         }
     };
 
-    const stringparam params_string[8] = {
+    const stringparam params_string[14] = {
         {
             "--infile",             //std::string paramstring; // parameter's text
             "Input Filename",       //std::string prettyname; // name for pretty printing
@@ -1311,6 +2578,42 @@ int main(int argc, const char **argv){
             &retroarchtextfilename,         //char** vartobind;    // pointer to variable whose value to set
             &retroarchwritetext              //bool* flagtobind; // pointer to flag to set when this variable is set
         },
+        {
+            "--batch",             //std::string paramstring; // parameter's text
+            "Batch Input List or Directory",       //std::string prettyname; // name for pretty printing
+            &batchsource,         //char** vartobind;    // pointer to variable whose value to set
+            &batchset              //bool* flagtobind; // pointer to flag to set when this variable is set
+        },
+        {
+            "--batch-outdir",             //std::string paramstring; // parameter's text
+            "Batch Output Directory",       //std::string prettyname; // name for pretty printing
+            &batchoutdir,         //char** vartobind;    // pointer to variable whose value to set
+            &batchoutdirset              //bool* flagtobind; // pointer to flag to set when this variable is set
+        },
+        {
+            "--colorlist",             //std::string paramstring; // parameter's text
+            "Input Color List Filename",       //std::string prettyname; // name for pretty printing
+            &colorlistfilename,         //char** vartobind;    // pointer to variable whose value to set
+            &colorlistset              //bool* flagtobind; // pointer to flag to set when this variable is set
+        },
+        {
+            "--memo-cache",             //std::string paramstring; // parameter's text
+            "Memo Cache Directory",       //std::string prettyname; // name for pretty printing
+            &memocachedir,         //char** vartobind;    // pointer to variable whose value to set
+            &memocacheset              //bool* flagtobind; // pointer to flag to set when this variable is set
+        },
+        {
+            "--full-table",             //std::string paramstring; // parameter's text
+            "Full Table Directory",       //std::string prettyname; // name for pretty printing
+            &fulltabledir,         //char** vartobind;    // pointer to variable whose value to set
+            &fulltableset              //bool* flagtobind; // pointer to flag to set when this variable is set
+        },
+        {
+            "--lutapply",             //std::string paramstring; // parameter's text
+            "LUT to Apply",       //std::string prettyname; // name for pretty printing
+            &lutapplyfilename,         //char** vartobind;    // pointer to variable whose value to set
+            &lutapplyset              //bool* flagtobind; // pointer to flag to set when this variable is set
+        },
 
     };
 
@@ -1883,7 +3186,165 @@ int main(int argc, const char **argv){
         }
     };
 
-    const selectparam params_select[41] = {
+    const paramvalue boundarymethodlist[2] = {
+        {
+            "slice",
+            BOUNDARY_SLICE
+        },
+        {
+            "exact",
+            BOUNDARY_EXACT
+        }
+    };
+
+    const paramvalue pqmodelist[2] = {
+        {
+            "exact",
+            PQ_EXACT
+        },
+        {
+            "fast",
+            PQ_FAST
+        }
+    };
+
+    const paramvalue cpulevellist[5] = {
+        {
+            "auto",
+            CPU_LEVEL_AUTO
+        },
+        {
+            "baseline",
+            CPU_LEVEL_BASELINE
+        },
+        {
+            "sse4.2",
+            CPU_LEVEL_SSE42
+        },
+        {
+            "avx2",
+            CPU_LEVEL_AVX2
+        },
+        {
+            "avx512",
+            CPU_LEVEL_AVX512
+        }
+    };
+
+    const paramvalue precisionlist[2] = {
+        {
+            "double",
+            PRECISION_DOUBLE
+        },
+        {
+            "float",
+            PRECISION_FLOAT
+        }
+    };
+
+    const paramvalue pngstrategylist[4] = {
+        {
+            "default",
+            PNG_STRATEGY_DEFAULT
+        },
+        {
+            "filtered",
+            PNG_STRATEGY_FILTERED
+        },
+        {
+            "huffman",
+            PNG_STRATEGY_HUFFMAN
+        },
+        {
+            "rle",
+            PNG_STRATEGY_RLE
+        }
+    };
+
+    const paramvalue imageformatlist[6] = {
+        {
+            "auto",
+            IMAGE_FORMAT_AUTO
+        },
+        {
+            "png",
+            IMAGE_FORMAT_PNG
+        },
+        {
+            "ppm",
+            IMAGE_FORMAT_PPM
+        },
+        {
+            "pam",
+            IMAGE_FORMAT_PAM
+        },
+        {
+            "rgb",
+            IMAGE_FORMAT_RAW_RGB
+        },
+        {
+            "rgba",
+            IMAGE_FORMAT_RAW_RGBA
+        }
+    };
+
+    const paramvalue framestreamlist[3] = {
+        {
+            "none",
+            FRAME_STREAM_NONE
+        },
+        {
+            "rgb24",
+            FRAME_STREAM_RGB24
+        },
+        {
+            "y4m",
+            FRAME_STREAM_Y4M
+        }
+    };
+
+    const paramvalue y4mmatrixlist[2] = {
+        {
+            "bt601",
+            Y4M_MATRIX_BT601
+        },
+        {
+            "bt709",
+            Y4M_MATRIX_BT709
+        }
+    };
+
+    const paramvalue colorlistformatlist[4] = {
+        {
+            "auto",
+            COLOR_LIST_AUTO
+        },
+        {
+            "text",
+            COLOR_LIST_TEXT
+        },
+        {
+            "csv",
+            COLOR_LIST_CSV
+        },
+        {
+            "binary",
+            COLOR_LIST_BINARY
+        }
+    };
+
+    const paramvalue lutinterpolationlist[2] = {
+        {
+            "trilinear",
+            LUT_INTERPOLATE_TRILINEAR
+        },
+        {
+            "tetrahedral",
+            LUT_INTERPOLATE_TETRAHEDRAL
+        }
+    };
+
+    const selectparam params_select[53] = {
         {
             "--source-primaries",            //std::string paramstring; // parameter's text
             "Source Primaries",             //std::string prettyname; // name for pretty printing
@@ -2171,6 +3632,90 @@ int main(int argc, const char **argv){
             nesagcchromalist,                  // const paramvalue* valuetable; // pointer to table of possible values
             sizeof(nesagcchromalist)/sizeof(nesagcchromalist[0])  //int tablesize; // number of items in the table
         },
+        {
+            "--boundary-method",            //std::string paramstring; // parameter's text
+            "Gamut Boundary Method",             //std::string prettyname; // name for pretty printing
+            &boundarymethod,          //int* vartobind; // pointer to variable whose value to set
+            boundarymethodlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(boundarymethodlist)/sizeof(boundarymethodlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--bm",            //std::string paramstring; // parameter's text
+            "Gamut Boundary Method",             //std::string prettyname; // name for pretty printing
+            &boundarymethod,          //int* vartobind; // pointer to variable whose value to set
+            boundarymethodlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(boundarymethodlist)/sizeof(boundarymethodlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--pq",            //std::string paramstring; // parameter's text
+            "PQ Function Implementation",             //std::string prettyname; // name for pretty printing
+            &pqmode,          //int* vartobind; // pointer to variable whose value to set
+            pqmodelist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(pqmodelist)/sizeof(pqmodelist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--precision",            //std::string paramstring; // parameter's text
+            "Jzazbz Conversion Precision",             //std::string prettyname; // name for pretty printing
+            &precision,          //int* vartobind; // pointer to variable whose value to set
+            precisionlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(precisionlist)/sizeof(precisionlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--cpu",            //std::string paramstring; // parameter's text
+            "CPU Instruction Set Level",             //std::string prettyname; // name for pretty printing
+            &cpulevel,          //int* vartobind; // pointer to variable whose value to set
+            cpulevellist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(cpulevellist)/sizeof(cpulevellist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--png-strategy",            //std::string paramstring; // parameter's text
+            "PNG Compression Strategy",             //std::string prettyname; // name for pretty printing
+            &pngstrategy,          //int* vartobind; // pointer to variable whose value to set
+            pngstrategylist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(pngstrategylist)/sizeof(pngstrategylist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--input-format",            //std::string paramstring; // parameter's text
+            "Input File Format",             //std::string prettyname; // name for pretty printing
+            &inputformat,          //int* vartobind; // pointer to variable whose value to set
+            imageformatlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(imageformatlist)/sizeof(imageformatlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--output-format",            //std::string paramstring; // parameter's text
+            "Output File Format",             //std::string prettyname; // name for pretty printing
+            &outputformat,          //int* vartobind; // pointer to variable whose value to set
+            imageformatlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(imageformatlist)/sizeof(imageformatlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--frame-stream",            //std::string paramstring; // parameter's text
+            "Frame Stream Format",             //std::string prettyname; // name for pretty printing
+            &framestream,          //int* vartobind; // pointer to variable whose value to set
+            framestreamlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(framestreamlist)/sizeof(framestreamlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--y4m-matrix",            //std::string paramstring; // parameter's text
+            "Y4M Y'CbCr Matrix",             //std::string prettyname; // name for pretty printing
+            &y4mmatrix,          //int* vartobind; // pointer to variable whose value to set
+            y4mmatrixlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(y4mmatrixlist)/sizeof(y4mmatrixlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--colorlist-format",            //std::string paramstring; // parameter's text
+            "Color List Format",             //std::string prettyname; // name for pretty printing
+            &colorlistformat,          //int* vartobind; // pointer to variable whose value to set
+            colorlistformatlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(colorlistformatlist)/sizeof(colorlistformatlist[0])  //int tablesize; // number of items in the table
+        },
+        {
+            "--lutapply-interpolation",            //std::string paramstring; // parameter's text
+            "LUT Interpolation",             //std::string prettyname; // name for pretty printing
+            &lutinterpolation,          //int* vartobind; // pointer to variable whose value to set
+            lutinterpolationlist,                  // const paramvalue* valuetable; // pointer to table of possible values
+            sizeof(lutinterpolationlist)/sizeof(lutinterpolationlist[0])  //int tablesize; // number of items in the table
+        },
     };
 
 
@@ -2406,7 +3951,7 @@ int main(int argc, const char **argv){
         // Leaving them on the backend in case they ever prove useful in the future.
     };
 
-    const intparam params_int[4] = {
+    const intparam params_int[8] = {
         {
             "--verbosity",         //std::string paramstring; // parameter's text
             "Verbosity",        //std::string prettyname; // name for pretty printing
@@ -2417,16 +3962,36 @@ int main(int argc, const char **argv){
             "Verbosity",        //std::string prettyname; // name for pretty printing
             &verbosity            //int* vartobind; // pointer to variable whose value to set
         },
-        {
-            "--lutsize",         //std::string paramstring; // parameter's text
-            "LUT Size",        //std::string prettyname; // name for pretty printing
-            &lutsize            //int* vartobind; // pointer to variable whose value to set
-        },
         {
             "--maxthreads",         //std::string paramstring; // parameter's text
             "Max Threads",        //std::string prettyname; // name for pretty printing
             &maxthreads            //int* vartobind; // pointer to variable whose value to set
         },
+        {
+            "--stream-band",         //std::string paramstring; // parameter's text
+            "Streaming Band Rows",        //std::string prettyname; // name for pretty printing
+            &streamband            //int* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--png-level",         //std::string paramstring; // parameter's text
+            "PNG Compression Level",        //std::string prettyname; // name for pretty printing
+            &pnglevel            //int* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--raw-width",         //std::string paramstring; // parameter's text
+            "Raw Image Width",        //std::string prettyname; // name for pretty printing
+            &rawwidth            //int* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--raw-height",         //std::string paramstring; // parameter's text
+            "Raw Frame Height",        //std::string prettyname; // name for pretty printing
+            &rawheight            //int* vartobind; // pointer to variable whose value to set
+        },
+        {
+            "--png16-lutsize",         //std::string paramstring; // parameter's text
+            "16-bit LUT Size",        //std::string prettyname; // name for pretty printing
+            &png16lutsize            //int* vartobind; // pointer to variable whose value to set
+        },
     };
 
     const float6param params_float6[5] = {
@@ -2509,6 +4074,14 @@ int main(int argc, const char **argv){
         }
     };
 
+    const intlistparam params_intlist[1] = {
+        {
+            "--lutsize",         //std::string paramstring; // parameter's text
+            "LUT Size",        //std::string prettyname; // name for pretty printing
+            &lutsizes            //std::vector<int>* vartobind; // pointer to variable whose value to set
+        }
+    };
+
 
     int nextparamtype = 0;
     int listsize = 0;
@@ -2516,6 +4089,7 @@ int main(int argc, const char **argv){
     bool* nextboolptr = nullptr;
     char** nextstringptr = nullptr;
     int* nextintptr = nullptr;
+    std::vector<int>* nextintlistptr = nullptr;
     const paramvalue* nexttable = nullptr;
     int nexttablesize = 0;
     double* nextfloatptr = nullptr;
@@ -2536,6 +4110,7 @@ int main(int argc, const char **argv){
                 nextboolptr = nullptr;
                 nextstringptr = nullptr;
                 nextintptr = nullptr;
+                nextintlistptr = nullptr;
                 nexttable = nullptr;
                 nexttablesize = 0;
                 nextfloatptr = nullptr;
@@ -2641,6 +4216,18 @@ int main(int argc, const char **argv){
                 }
                 if (breakout){break;}
 
+                listsize = sizeof(params_intlist)/sizeof(params_intlist[0]);
+                for (int j=0; j<listsize; j++){
+                    if (strcmp(argv[i], params_intlist[j].paramstring.c_str()) == 0){
+                        nextintlistptr = params_intlist[j].vartobind;
+                        nextparamtype = 8;
+                        lastj = j;
+                        breakout = true;
+                        break;
+                    }
+                }
+                if (breakout){break;}
+
                 // check for help flag
                 if (strcmp(argv[i], "-h") == 0){
                     helpmode = true;
@@ -2772,6 +4359,36 @@ int main(int argc, const char **argv){
                     nextparamtype = 0;
                     break;
                 }
+            case 8:
+                {
+                    std::vector<int> values;
+                    const char* next = argv[i];
+                    bool inputok = true;
+                    while (inputok){
+                        char* endptr;
+                        errno = 0; //make sure errno is 0 before strtol()
+                        long int input = strtol(next, &endptr, 0);
+                        // is errno set? did we read anything? is anything but a comma or the end next?
+                        if ((errno != 0) || (endptr == next) || ((*endptr != ',') && (*endptr != '\0'))){
+                            inputok = false;
+                            break;
+                        }
+                        values.push_back(input);
+                        if (*endptr == '\0'){
+                            break;
+                        }
+                        next = endptr + 1;
+                    }
+                    if (inputok){
+                        *nextintlistptr = values;
+                    }
+                    else {
+                        printf("Invalid value for parameter %s (%s). Expecting integer numerical value or comma-separated list of them.\n", params_intlist[lastj].paramstring.c_str(), params_intlist[lastj].prettyname.c_str());
+                        return ERROR_BAD_PARAM_INT;
+                    }
+                    nextparamtype = 0;
+                    break;
+                }
             default:
                 break;
         };
@@ -2803,6 +4420,9 @@ int main(int argc, const char **argv){
             case 5:
                printf("Missing value for parameter %s (%s). Expecting floating-point numerical value.\n", params_float[lastj].paramstring.c_str(), params_float[lastj].prettyname.c_str());
                break;
+            case 8:
+                printf("Missing value for parameter %s (%s). Expecting integer numerical value or comma-separated list of them.\n", params_intlist[lastj].paramstring.c_str(), params_intlist[lastj].prettyname.c_str());
+                break;
             default:
                 break;
         };
@@ -2818,6 +4438,15 @@ int main(int argc, const char **argv){
         return RETURN_SUCCESS;
     }
 
+    // in frame stream mode stdout carries the frames, so all the console output goes to stderr instead
+    FILE* framestreamoutput = NULL;
+    if (framestream != FRAME_STREAM_NONE){
+        framestreamoutput = RedirectConsoleToStderr();
+        if (framestreamoutput == NULL){
+            return ERROR_FRAME_STREAM_FAIL;
+        }
+    }
+
     softkneemode = (softkneemodealias == 0) ? false : true;
 
     if (verbosity < VERBOSITY_SILENT){
@@ -2827,6 +4456,62 @@ int main(int argc, const char **argv){
         verbosity = VERBOSITY_EXTREME;
     }
 
+    // job file mode hands us its batch, and server mode its colors
+    if ((host != NULL) && (host->batch != NULL)){
+        batchset = true;
+    }
+    if ((host != NULL) && (host->colors != NULL)){
+        incolorset = true;
+    }
+
+    // frame stream mode overrides other modes
+    if (framestream != FRAME_STREAM_NONE){
+        if (incolorset || infileset || outfileset || lutgen || nesmode){
+            printf("\nIgnoring other input and output modes because frame stream mode specified.\n");
+        }
+        incolorset = false;
+        infileset = false;
+        outfileset = false;
+        lutgen = false;
+        nesmode = false;
+        filemode = true;
+        streamband = 0;
+        batchset = false;
+    }
+
+    // batch mode overrides other modes, except frame stream mode
+    if (batchset){
+        if (incolorset || infileset || outfileset || lutgen || nesmode){
+            printf("\nIgnoring other input and output modes because batch mode specified.\n");
+        }
+        incolorset = false;
+        infileset = false;
+        outfileset = false;
+        lutgen = false;
+        nesmode = false;
+        filemode = true;
+        if (streamband > 0){
+            printf("\nIgnoring streaming band size because batch mode specified.\n");
+            streamband = 0;
+        }
+    }
+
+    // color list mode overrides other modes, except frame stream and batch modes
+    if (colorlistset && ((framestream != FRAME_STREAM_NONE) || batchset)){
+        printf("\nIgnoring color list because %s mode specified.\n", batchset ? "batch" : "frame stream");
+        colorlistset = false;
+    }
+    if (colorlistset){
+        if (incolorset || infileset || lutgen || nesmode){
+            printf("\nIgnoring other input modes because color list mode specified.\n");
+        }
+        incolorset = false;
+        infileset = false;
+        lutgen = false;
+        nesmode = false;
+        filemode = false;
+    }
+
     // single color mode should override other input modes
     // (and must, b/c filemode is true by default
     if (incolorset){
@@ -2864,6 +4549,24 @@ int main(int argc, const char **argv){
     if (!nesmode && neswritehtml){
         neswritehtml = false;
     }
+    // a LUT can only be applied to image files
+    if (lutapplyset && (!filemode || lutgen || nesmode || ((host != NULL) && (host->colors != NULL)))){
+        printf("\nIgnoring LUT to apply because not converting image files.\n");
+        lutapplyset = false;
+    }
+    if (lutapplyset && backwardsmode){
+        printf("\nForcing backwards to false because applying a LUT.\n");
+        backwardsmode = false;
+    }
+    // the full table is the forward conversion of 8-bit image colors
+    if (fulltableset && (!filemode || lutgen || nesmode || lutapplyset || backwardsmode || ((host != NULL) && (host->colors != NULL)))){
+        printf("\nIgnoring full table because not doing a forward conversion of image files.\n");
+        fulltableset = false;
+    }
+    if (png16 && (!filemode || ((host != NULL) && (host->colors != NULL)))){
+        printf("\nIgnoring png16 because not converting image files.\n");
+        png16 = false;
+    }
     if (nesmode && (crtemumode != CRT_EMU_FRONT)){
         printf("\nForcing crtemu to front because nespalgen is true.\n");
         crtemumode = CRT_EMU_FRONT;
@@ -2877,14 +4580,38 @@ int main(int argc, const char **argv){
         crtmodindex = CRT_MODULATOR_NONE;
     }
 
+    if ((pnglevel < 0) || (pnglevel > 9)){
+        printf("\nWARNING: PNG compression level must be 0 through 9. Changing to 6.\n");
+        pnglevel = 6;
+    }
+    if (streamband < 0){
+        printf("\nWARNING: Streaming band size cannot be negative. Disabling streaming.\n");
+        streamband = 0;
+    }
+    if (lutgen && (streamband > 0)){
+        printf("\nIgnoring streaming band size because lutgen is true.\n");
+        streamband = 0;
+    }
+
     if (lutgen){
-        if (lutsize < 2){
-            lutsize = 2;
-            printf("\nWARNING: LUT size cannot be less than 2. Changing to 2.\n");
-        }
-        else if (lutsize > 128){
-            printf("\nWARNING: LUT size is %i. Some programs, e.g. retroarch, cannot handle extra-large LUTs.\n", lutsize);
+        std::vector<int> checkedsizes;
+        for (size_t i=0; i<lutsizes.size(); i++){
+            int size = lutsizes[i];
+            if (size < 2){
+                size = 2;
+                printf("\nWARNING: LUT size cannot be less than 2. Changing to 2.\n");
+            }
+            else if (size > 128){
+                printf("\nWARNING: LUT size is %i. Some programs, e.g. retroarch, cannot handle extra-large LUTs.\n", size);
+            }
+            if (std::find(checkedsizes.begin(), checkedsizes.end(), size) != checkedsizes.end()){
+                printf("\nIgnoring repeated LUT size %i.\n", size);
+                continue;
+            }
+            checkedsizes.push_back(size);
         }
+        lutsizes = checkedsizes;
+        lutsize = lutsizes[0];
         if (infileset){
             printf("\nIgnoring input file because lutgen is true.\n");
             infileset = false;
@@ -2899,7 +4626,16 @@ int main(int argc, const char **argv){
         }
     }
     else {
-        lutmode = LUTMODE_NONE; // make sure we pass mode none if not lutgen
+        if (lutapplyset){
+            // the LUT mode says what the LUT being applied expects for input
+            if ((crtemumode != CRT_EMU_FRONT) && (lutmode != LUTMODE_NORMAL)){
+                lutmode = LUTMODE_NORMAL;
+                printf("Forcing lutmode to normal because no CRT simulation.\n");
+            }
+        }
+        else {
+            lutmode = LUTMODE_NONE; // make sure we pass mode none if not lutgen
+        }
         if (retroarchwritetext){
             retroarchwritetext = false;
             printf("\nNot writing retroarch shader parameters text file because not generating a LUT.\n");
@@ -2941,11 +4677,11 @@ int main(int argc, const char **argv){
 
     if (filemode || lutgen || nesmode){
         bool failboat = false;
-        if (!infileset && !lutgen && !nesmode){
+        if (!infileset && !lutgen && !nesmode && (framestream == FRAME_STREAM_NONE) && !batchset){
             printf("Input file not specified.\n");
             failboat = true;
         }
-        if (!outfileset){
+        if (!outfileset && (framestream == FRAME_STREAM_NONE) && !batchset){
             printf("Output file not specified.\n");
             failboat = true;
         }
@@ -2976,8 +4712,63 @@ int main(int argc, const char **argv){
             printf("\nForcing dither to false because backwards is true.\n");
             dither = false;
         }
+        // pick image file formats from the file extensions unless specified
+        if (framestream != FRAME_STREAM_NONE){
+            inputformat = IMAGE_FORMAT_PNG;
+            outputformat = IMAGE_FORMAT_PNG;
+        }
+        // batch mode picks formats per file
+        else if ((host != NULL) && (host->batch != NULL)){
+            batchjobs = host->batch;
+            resolvebatchformats(*batchjobs, inputformat, outputformat, rawwidth);
+        }
+        else if (batchset){
+            if (!buildbatch(batchsource, batchoutdirset ? batchoutdir : NULL, inputformat, outputformat, rawwidth, *batchjobs)){
+                return ERROR_BATCH_LIST_FAIL;
+            }
+        }
+        else if (!lutgen && !nesmode){
+            if (inputformat == IMAGE_FORMAT_AUTO){
+                inputformat = ImageFormatFromFilename(inputfilename);
+            }
+            if (outputformat == IMAGE_FORMAT_AUTO){
+                outputformat = ImageFormatFromFilename(outputfilename);
+            }
+            if ((streamband > 0) && ((inputformat != IMAGE_FORMAT_PNG) || (outputformat != IMAGE_FORMAT_PNG))){
+                printf("\nIgnoring streaming band size because input or output is not png. (Those files are memory-mapped instead.)\n");
+                streamband = 0;
+            }
+        }
+        else if (lutgen && (outputformat != IMAGE_FORMAT_AUTO) && (outputformat != IMAGE_FORMAT_PNG)){
+            printf("\nForcing output format to png because lutgen is true.\n");
+        }
+        // 16-bit mode converts one whole png with a generated LUT
+        if (png16 && (lutgen || nesmode || lutapplyset || backwardsmode || batchset || ((host != NULL) && (host->batch != NULL)) || (framestream != FRAME_STREAM_NONE) || (inputformat != IMAGE_FORMAT_PNG) || (outputformat != IMAGE_FORMAT_PNG))){
+            printf("\nIgnoring png16 because not doing a forward conversion of one png file to another.\n");
+            png16 = false;
+        }
+        if (png16 && (streamband > 0)){
+            printf("\nIgnoring streaming band size because png16 is true.\n");
+            streamband = 0;
+        }
+        if (png16 && (png16lutsize < 2)){
+            png16lutsize = 2;
+            printf("\nWARNING: png16 LUT size cannot be less than 2. Changing to 2.\n");
+        }
+    }
+    else if (colorlistset){
+        if (!outfileset){
+            printf("Output file not specified.\n");
+            return ERROR_BAD_PARAM_FILE_NOT_SPECIFIED;
+        }
+        if (colorlistformat == COLOR_LIST_AUTO){
+            colorlistformat = ColorListFormatFromFilename(colorlistfilename);
+        }
+        if (!inputcolorlist.Read(colorlistfilename, colorlistformat)){
+            return ERROR_COLOR_LIST_FAIL;
+        }
     }
-    else{
+    else if ((host == NULL) || (host->colors == NULL)){
         if (!incolorset){
             printf("Input color not specified.\n");
             return ERROR_BAD_PARAM_COLOR_NOT_SPECIFIED;
@@ -3102,7 +4893,7 @@ int main(int argc, const char **argv){
         printf("Chromatic adapation cannot be disabled when destination whitepoint is not D65.\n");
     }
 
-    if (filemode || lutgen){
+    if (filemode || lutgen || precisionreport || colorlistset || ((host != NULL) && (host->colors != NULL))){
         if (maxthreads == 0){
             maxthreads = std::thread::hardware_concurrency();
             printf("Detected %i processor cores.\n", maxthreads);
@@ -3161,7 +4952,15 @@ int main(int argc, const char **argv){
         printf("\n\n----------\nParameters are:\n");
         if (filemode){
             if (lutgen){
-                printf("LUT generation.\nLUT size: %i\nOutput file: %s\n", lutsize, outputfilename);
+                if (lutsizes.size() == 1){
+                    printf("LUT generation.\nLUT size: %i\nOutput file: %s\n", lutsize, outputfilename);
+                }
+                else {
+                    printf("LUT generation.\n");
+                    for (size_t i=0; i<lutsizes.size(); i++){
+                        printf("LUT size: %i\nOutput file: %s\n", lutsizes[i], lutsizefilename(outputfilename, lutsizes[i]).c_str());
+                    }
+                }
                 printf("LUT type: ");
                 if (lutmode == LUTMODE_NORMAL){
                     printf("LUT type: Normal LUT\n");
@@ -3176,12 +4975,35 @@ int main(int argc, const char **argv){
                     printf("Error!\n");
                 }
                 if (retroarchwritetext){
-                    printf("Retroarch CCC shader parameter text output file: %s\n", retroarchtextfilename);
+                    for (size_t i=0; i<lutsizes.size(); i++){
+                        printf("Retroarch CCC shader parameter text output file: %s\n", (lutsizes.size() == 1) ? retroarchtextfilename : lutsizefilename(retroarchtextfilename, lutsizes[i]).c_str());
+                    }
                 }
             }
+            else if (framestream != FRAME_STREAM_NONE){
+                printf("Frame stream from stdin to stdout\n");
+            }
+            else if (batchset){
+                printf("Batch of %i files\n", (int)batchjobs->size());
+            }
             else {
                 printf("Input file: %s\nOutput file: %s\n", inputfilename, outputfilename);
             }
+            if (png16){
+                printf("16-bit png via %i^3 LUT\n", png16lutsize);
+                if (fulltableset){
+                    printf("16-bit LUT cache directory: %s\n", fulltabledir);
+                }
+            }
+            else if (lutapplyset){
+                printf("Applying LUT: %s (%s interpolation)\n", lutapplyfilename, (lutinterpolation == LUT_INTERPOLATE_TRILINEAR) ? "trilinear" : "tetrahedral");
+            }
+            else if (fulltableset){
+                printf("Full table directory: %s\n", fulltabledir);
+            }
+            else if (memocacheset && !lutgen){
+                printf("Memo cache directory: %s\n", memocachedir);
+            }
         }
         else if (nesmode){
             printf("NES palette generation.\nOutput file: %s\n", outputfilename);
@@ -3189,6 +5011,12 @@ int main(int argc, const char **argv){
                 printf("HTML output file: %s\n", neshtmlfilename);
             }
         }
+        else if ((host != NULL) && (host->colors != NULL)){
+            printf("Input colors: %i\n", (int)host->colors->size());
+        }
+        else if (colorlistset){
+            printf("Input color list: %s (%i colors)\nOutput file: %s\n", colorlistfilename, (int)inputcolorlist.colors.size(), outputfilename);
+        }
         else {
             printf("Input color: %s\n", inputcolorstring);
         }
@@ -3418,6 +5246,17 @@ int main(int argc, const char **argv){
             else{
                 printf("Knee type: hard\n");
             }
+            printf("Gamut boundary method: ");
+            switch(boundarymethod){
+                case BOUNDARY_SLICE:
+                    printf("slice\n");
+                    break;
+                case BOUNDARY_EXACT:
+                    printf("exact\n");
+                    break;
+                default:
+                    break;
+            };
         }
         if (filemode){
             if (dither){
@@ -3558,6 +5397,9 @@ int main(int argc, const char **argv){
             printf("NES CRT automatic gain control type for chroma: %s\n", nesagcchromanames[nesagcchroma].c_str());
             printf("NES %f%% of CRT \"super white\" colors shown.\n", nessuperwhiteshowfactor * 100.0);
         }
+        printf("PQ function implementation: %s\n", (pqmode == PQ_FAST) ? "fast" : "exact");
+        printf("Jzazbz conversion precision: %s\n", (precision == PRECISION_FLOAT) ? "float" : "double");
+        printf("CPU instruction set level: %s (detected %s)\n", CPULevelName(cpulevel), CPULevelName(DetectCPULevel()));
         printf("Verbosity: %i\n", verbosity);
         printf("----------\n\n");
     }
@@ -3565,11 +5407,42 @@ int main(int argc, const char **argv){
     // ------------------------------------------------------------------------
     // Initialize stuff
     
+    if (!SetCPULevel(cpulevel)){
+        printf("This CPU does not support the %s instruction set level. (Best supported level is %s.)\n", CPULevelName(cpulevel), CPULevelName(DetectCPULevel()));
+        return ERROR_CPU_LEVEL_UNSUPPORTED;
+    }
+
     if (!initializeInverseMatrices()){
         printf("Unable to initialize inverse Jzazbz matrices. WTF error!\n");
         return ERROR_INVERT_MATRIX_FAIL;
     }
-    
+    
+    if (pqmode == PQ_FAST){
+        if (!initializePQTables()){
+            printf("Unable to initialize PQ tables. WTF error!\n");
+            return ERROR_PQ_TABLE_FAIL;
+        }
+        if (verbosity >= VERBOSITY_SLIGHT){
+            printf("\n----------\n");
+            PQTableErrorReport();
+            printf("----------\n");
+        }
+    }
+    PQmode = pqmode;
+    Jzazbzprecision = precision;
+
+    // The output gamma table is only exact after undithered 8-bit quantization, so everything else
+    // (dithering, 16-bit output, single colors and color lists, backwards search, frame streams) uses the exact function.
+    bool quantized8 = filemode && !dither && !png16 && !backwardsmode && !incolorset && !colorlistset && (framestream == FRAME_STREAM_NONE) && ((host == NULL) || (host->colors == NULL));
+    if (!initializeTransferTables(gammamodein, gammapowin, gammamodeout, gammapowout, hdrsdrmaxnits, quantized8)){
+        printf("Unable to initialize transfer function tables. WTF error!\n");
+        return ERROR_TRANSFER_TABLE_FAIL;
+    }
+    if (verbosity >= VERBOSITY_SLIGHT){
+        printf("\n----------\n");
+        TransferTableErrorReport();
+        printf("----------\n");
+    }
 
     
     vec3 sourcewhite;
@@ -3618,37 +5491,163 @@ int main(int argc, const char **argv){
         destblue = vec3(gamutpoints[destgamutindex][2][0], gamutpoints[destgamutindex][2][1], gamutpoints[destgamutindex][2][2]);
     }
     
-    crtdescriptor emulatedcrt;
-    int sourcegamutcrtsetting = CRT_EMU_NONE;
-    int destgamutcrtsetting = CRT_EMU_NONE;
-    if (crtemumode != CRT_EMU_NONE){
-        emulatedcrt.Initialize(crtblacklevel, crtwhitelevel, crtyuvconstantprecision, crtmodindex, crtdemodindex, custom_demod_constants, crtdemodrenorm, crtdoclamphigh, crtclamplowatzerolight, crtclamplow, crtclamphigh, verbosity, crtdemodfixes, crthueknob, crtsaturationknob, crtgammaknob, crtblackpedestalcrush, crtblackpedestalcrushamount, crtsuperblacks, nealdistance, (crtemumode == CRT_EMU_FRONT) ? sourcered : destred, (crtemumode == CRT_EMU_FRONT) ? sourcegreen : destgreen, (crtemumode == CRT_EMU_FRONT) ? sourceblue : destblue, (crtemumode == CRT_EMU_FRONT) ? sourcewhite : destwhite, nealrenormangle, nealrenormgain);
+    // LUT application mode converts with an existing LUT,
+    // so it skips the gamut descriptors (and most of the initialization time) entirely.
+    // Only the CRT is needed, for LUT modes that leave part of the CRT simulation to the calling code.
+    if (lutapplyset){
+        // the memo cache and full table don't know about the LUT
+        diskmemo.Close();
+        fulltab.Close();
+        crtdescriptor lutcrt;
         if (crtemumode == CRT_EMU_FRONT){
-            sourcegamutcrtsetting = CRT_EMU_FRONT;
+            lutcrt.Initialize(crtblacklevel, crtwhitelevel, crtyuvconstantprecision, crtmodindex, crtdemodindex, custom_demod_constants, crtdemodrenorm, crtdoclamphigh, crtclamplowatzerolight, crtclamplow, crtclamphigh, verbosity, crtdemodfixes, crthueknob, crtsaturationknob, crtgammaknob, crtblackpedestalcrush, crtblackpedestalcrushamount, crtsuperblacks, nealdistance, sourcered, sourcegreen, sourceblue, sourcewhite, nealrenormangle, nealrenormgain);
+        }
+        auto loadstart = std::chrono::steady_clock::now();
+        appliedlut lut;
+        if (!lut.Load(lutapplyfilename, lutmode, lutinterpolation, gammamodeout, gammapowout, hdrsdrmaxnits, (crtemumode != CRT_EMU_BACK), (crtemumode == CRT_EMU_FRONT) ? &lutcrt : NULL, crtclamplow, crtclamphigh, crtdoclamphigh, crtgammaknob)){
+            if (framestream != FRAME_STREAM_NONE){
+                fclose(framestreamoutput);
+            }
+            return ERROR_LUT_APPLY_FAIL;
+        }
+        if (verbosity >= VERBOSITY_SLIGHT){
+            printf("Loaded %ix%ix%i LUT in %.3f seconds.\n", lut.lutsize, lut.lutsize, lut.lutsize, std::chrono::duration<double>(std::chrono::steady_clock::now() - loadstart).count());
+        }
+        if (lutbenchmark){
+            lut.Benchmark(LUT_BENCHMARK_SAMPLES);
+            printf("----------\n");
+        }
+        conversionplan lutplan;
+        lutplan.InitializeLUT(lut);
+
+        int result;
+        if (framestream != FRAME_STREAM_NONE){
+            result = streamframes(stdin, framestreamoutput, framestream, rawwidth, rawheight, y4mmatrix, maxthreads, lutplan, verbosity, dither, false);
+            fclose(framestreamoutput);
+            return result;
         }
-        else if (crtemumode == CRT_EMU_BACK){
-            destgamutcrtsetting = CRT_EMU_BACK;
+        else if (batchset){
+            result = convertbatch(*batchjobs, maxthreads, lutplan, verbosity, dither, false, pnglevel, pngstrategy);
         }
+        else if (streamband > 0){
+            result = streamimage(inputfilename, outputfilename, streamband, maxthreads, lutplan, verbosity, dither, false, pnglevel, pngstrategy);
+        }
+        else {
+            result = convertimagefile(inputfilename, inputformat, rawwidth, outputfilename, outputformat, maxthreads, lutplan, verbosity, dither, false, pnglevel, pngstrategy);
+        }
+        if (result == RETURN_SUCCESS){
+            printf("done.\n");
+        }
+        return result;
+    }
+
+    int sourcegamutcrtsetting = CRT_EMU_NONE;
+    int destgamutcrtsetting = CRT_EMU_NONE;
+    if (crtemumode == CRT_EMU_FRONT){
+        sourcegamutcrtsetting = CRT_EMU_FRONT;
+    }
+    else if (crtemumode == CRT_EMU_BACK){
+        destgamutcrtsetting = CRT_EMU_BACK;
     }
 
     bool compressenabled = (mapmode >= MAP_FIRST_COMPRESS);
-    
-    gamutdescriptor sourcegamut;
-    bool srcOK = sourcegamut.initialize(sourcegamutindex != GAMUT_CUSTOM ? gamutnames[sourcegamutindex] : "Custom Source Gamut", sourcewhite, sourcered, sourcegreen, sourceblue, destwhite, true, verbosity, adapttype, forcedisablechromaticadapt, compressenabled, sourcegamutcrtsetting, &emulatedcrt);
-    
-    gamutdescriptor destgamut;
-    bool destOK = destgamut.initialize(destgamutindex != GAMUT_CUSTOM ? gamutnames[destgamutindex] : "Custom Destination Gamut", destwhite, destred, destgreen, destblue, sourcewhite, false, verbosity, adapttype, false, compressenabled, destgamutcrtsetting, &emulatedcrt);
-    
-    if ((mapmode == MAP_CCC_B) || (mapmode == MAP_CCC_C)){
-        destgamut.initializeMatrixChunghwa(sourcegamut, verbosity);
+
+    // The gamut descriptors (and the CRT attached to them) are cached by everything that goes into them,
+    // so that job file mode only samples the boundaries once for all the jobs that share them.
+    std::string descriptorkey;
+    keyappend(descriptorkey, crtemumode);
+    if (crtemumode != CRT_EMU_NONE){
+        keyappend(descriptorkey, crtblacklevel);
+        keyappend(descriptorkey, crtwhitelevel);
+        keyappend(descriptorkey, crtyuvconstantprecision);
+        keyappend(descriptorkey, crtmodindex);
+        keyappend(descriptorkey, crtdemodindex);
+        for (int i=0; i<2; i++){
+            for (int j=0; j<3; j++){
+                keyappend(descriptorkey, custom_demod_constants[i][j]);
+            }
+        }
+        keyappend(descriptorkey, crtdemodrenorm);
+        keyappend(descriptorkey, crtdoclamphigh);
+        keyappend(descriptorkey, crtclamplowatzerolight);
+        keyappend(descriptorkey, crtclamplow);
+        keyappend(descriptorkey, crtclamphigh);
+        keyappend(descriptorkey, crtdemodfixes);
+        keyappend(descriptorkey, crthueknob);
+        keyappend(descriptorkey, crtsaturationknob);
+        keyappend(descriptorkey, crtgammaknob);
+        keyappend(descriptorkey, crtblackpedestalcrush);
+        keyappend(descriptorkey, crtblackpedestalcrushamount);
+        keyappend(descriptorkey, crtsuperblacks);
+        keyappend(descriptorkey, nealdistance);
+        keyappend(descriptorkey, nealrenormangle);
+        keyappend(descriptorkey, nealrenormgain);
     }
-    else if ((mapmode == MAP_CCC_D) || (mapmode == MAP_CCC_E)){
-        srcOK &= sourcegamut.initializeKinoshitaStuff(destgamut, verbosity);
+    keyappend(descriptorkey, sourcewhite);
+    keyappend(descriptorkey, sourcered);
+    keyappend(descriptorkey, sourcegreen);
+    keyappend(descriptorkey, sourceblue);
+    keyappend(descriptorkey, destwhite);
+    keyappend(descriptorkey, destred);
+    keyappend(descriptorkey, destgreen);
+    keyappend(descriptorkey, destblue);
+    keyappend(descriptorkey, sourcegamutindex);
+    keyappend(descriptorkey, destgamutindex);
+    keyappend(descriptorkey, adapttype);
+    keyappend(descriptorkey, forcedisablechromaticadapt);
+    keyappend(descriptorkey, compressenabled);
+    keyappend(descriptorkey, boundarymethod);
+    keyappend(descriptorkey, pqmode);
+    keyappend(descriptorkey, precision);
+    keyappend(descriptorkey, mapmode);
+    keyappend(descriptorkey, spiralcarisma);
+    if (spiralcarisma){
+        keyappend(descriptorkey, scfloor);
+        keyappend(descriptorkey, scceiling);
+        keyappend(descriptorkey, scexp);
+        keyappend(descriptorkey, scfunctiontype);
+        keyappend(descriptorkey, scmax);
+        keyappend(descriptorkey, remapfactor);
+        keyappend(descriptorkey, remaplimit);
+        keyappend(descriptorkey, softkneemode);
+        keyappend(descriptorkey, kneefactor);
+        keyappend(descriptorkey, mapdirection);
+        keyappend(descriptorkey, safezonetype);
     }
-    
-    if (!srcOK || !destOK){
-        printf("Gamut descriptor initialization failed. All is lost. Abandon ship.\n");
-        return GAMUT_INITIALIZE_FAIL;
+    bool descriptorscached = false;
+    bool srcOK = true;
+    bool destOK = true;
+    descriptorset* descriptors = finddescriptorset(descriptorkey, descriptorscached);
+    crtdescriptor &emulatedcrt = descriptors->crt;
+    gamutdescriptor &sourcegamut = descriptors->source;
+    gamutdescriptor &destgamut = descriptors->dest;
+    if (descriptorscached){
+        if (verbosity >= VERBOSITY_SLIGHT){
+            printf("Reusing gamut descriptors from an earlier job.\n");
+        }
+    }
+    else {
+        if (crtemumode != CRT_EMU_NONE){
+            emulatedcrt.Initialize(crtblacklevel, crtwhitelevel, crtyuvconstantprecision, crtmodindex, crtdemodindex, custom_demod_constants, crtdemodrenorm, crtdoclamphigh, crtclamplowatzerolight, crtclamplow, crtclamphigh, verbosity, crtdemodfixes, crthueknob, crtsaturationknob, crtgammaknob, crtblackpedestalcrush, crtblackpedestalcrushamount, crtsuperblacks, nealdistance, (crtemumode == CRT_EMU_FRONT) ? sourcered : destred, (crtemumode == CRT_EMU_FRONT) ? sourcegreen : destgreen, (crtemumode == CRT_EMU_FRONT) ? sourceblue : destblue, (crtemumode == CRT_EMU_FRONT) ? sourcewhite : destwhite, nealrenormangle, nealrenormgain);
+        }
+
+
+        srcOK = sourcegamut.initialize(sourcegamutindex != GAMUT_CUSTOM ? gamutnames[sourcegamutindex] : "Custom Source Gamut", sourcewhite, sourcered, sourcegreen, sourceblue, destwhite, true, verbosity, adapttype, forcedisablechromaticadapt, compressenabled, sourcegamutcrtsetting, &emulatedcrt, boundarymethod);
+
+        destOK = destgamut.initialize(destgamutindex != GAMUT_CUSTOM ? gamutnames[destgamutindex] : "Custom Destination Gamut", destwhite, destred, destgreen, destblue, sourcewhite, false, verbosity, adapttype, false, compressenabled, destgamutcrtsetting, &emulatedcrt, boundarymethod);
+
+        if ((mapmode == MAP_CCC_B) || (mapmode == MAP_CCC_C)){
+            destgamut.initializeMatrixChunghwa(sourcegamut, verbosity);
+        }
+        else if ((mapmode == MAP_CCC_D) || (mapmode == MAP_CCC_E)){
+            srcOK &= sourcegamut.initializeKinoshitaStuff(destgamut, verbosity);
+        }
+
+        if (!srcOK || !destOK){
+            printf("Gamut descriptor initialization failed. All is lost. Abandon ship.\n");
+            dropdescriptorset();
+            return GAMUT_INITIALIZE_FAIL;
+        }
     }
 
     // screen barf an overall matrix (useful for copy/pasting into other code)
@@ -3673,11 +5672,12 @@ int main(int argc, const char **argv){
     printf("----------\n");
 
     // if spiral CARISMA is enabled, we need some more initialization
-    if (spiralcarisma){
+    if (spiralcarisma && !descriptorscached){
         srcOK = sourcegamut.initializePolarPrimaries(true, scfloor, scceiling, scexp, scfunctiontype, verbosity);
         destOK = destgamut.initializePolarPrimaries(false, scfloor, scceiling, scexp, scfunctiontype, verbosity);
         if (! srcOK || !destOK){
             printf("Gamut descriptor initialization failed in primary/secondary rotation. All is lost. Abandon ship.\n");
+            dropdescriptorset();
             return GAMUT_INITIALIZE_FAIL_SPIRAL;
         }
         sourcegamut.FindPrimaryRotations(destgamut, scmax, verbosity, (mapmode == MAP_EXPAND), remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype);
@@ -3688,17 +5688,70 @@ int main(int argc, const char **argv){
             printf("\n----------\n");
         }
     }
+
+    if ((pqmode == PQ_FAST) && (verbosity >= VERBOSITY_SLIGHT)){
+        printf("\n----------\n");
+        sourcegamut.PQErrorReport();
+        destgamut.PQErrorReport();
+        printf("----------\n");
+    }
+
+    if (boundarybenchmark){
+        sourcegamut.BenchmarkBoundaryMethods(BOUNDARY_BENCHMARK_SAMPLES);
+        destgamut.BenchmarkBoundaryMethods(BOUNDARY_BENCHMARK_SAMPLES);
+        printf("----------\n");
+    }
     
+    // resolve all the conversion settings into a fixed sequence of stages
+    conversionplan plan;
+    plan.Initialize(gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, false, hdrsdrmaxnits);
+
+    if (precisionreport){
+        // (8-bit colors don't use the LUT mode)
+        conversionplan reportplan = plan.Variant(LUTMODE_NONE, false);
+        precisionReport(reportplan, maxthreads);
+        printf("----------\n");
+    }
+
     // ---------------------------------------------------------------------------
     // Do actual color processing
 
+    // server mode's colors are converted quietly, and the results handed back
+    if (!filemode && !nesmode && (host != NULL) && (host->colors != NULL)){
+        conversionplan singleplan = plan.Variant(LUTMODE_NONE, false);
+        convertcolorlist(*host->colors, host->colorresults, singleplan, maxthreads, backwardsmode);
+        return RETURN_SUCCESS;
+    }
+
+    // color list mode converts a whole file of colors
+    if (colorlistset){
+        // (colors don't use the LUT mode)
+        conversionplan singleplan = plan.Variant(LUTMODE_NONE, false);
+        if (verbosity >= VERBOSITY_MINIMAL){
+            printf("Converting %i colors from %s and saving results to %s...\n", (int)inputcolorlist.colors.size(), colorlistfilename, outputfilename);
+        }
+        auto starttime = std::chrono::steady_clock::now();
+        std::vector<vec3> results;
+        convertcolorlist(inputcolorlist.colors, results, singleplan, maxthreads, backwardsmode);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count();
+        if (!inputcolorlist.Write(outputfilename, results, colorlistfloats)){
+            return ERROR_COLOR_LIST_FAIL;
+        }
+        if (verbosity >= VERBOSITY_MINIMAL){
+            printf("Converted %i colors in %.3f seconds.\ndone.\n", (int)results.size(), seconds);
+        }
+        return RETURN_SUCCESS;
+    }
+
     // this mode converts a single color and printfs the result
     if (!filemode && !nesmode){
         int redout;
         int greenout;
         int blueout;
         
-        vec3 outcolor = processcolorwrapper(inputcolor, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, false, false, hdrsdrmaxnits, backwardsmode, inversesearchvisitlist0);
+        // (single colors don't use the LUT mode)
+        conversionplan singleplan = plan.Variant(LUTMODE_NONE, false);
+        vec3 outcolor = processcolorwrapper(inputcolor, singleplan, backwardsmode, inversesearchvisitlist0);
 
         redout = toRGB8nodither(outcolor.x);
         greenout = toRGB8nodither(outcolor.y);
@@ -4028,6 +6081,7 @@ int main(int argc, const char **argv){
             htmlfile << "\t\t</div>\n\t\t<table style=\"margin-left:auto; margin-right:auto; border:0px; border-collapse: collapse;\">\n";
         }
 
+        conversionplan nesplan = plan.Variant(lutmode, true);
 
         for (int emp=0; emp<8; emp++){
             if (neswritehtml){
@@ -4039,7 +6093,7 @@ int main(int argc, const char **argv){
                 }
                 for (int hue=0; hue < 16; hue++){
                     vec3 nesrgb = nessim.NEStoRGB(hue,luma, emp);
-                    vec3 outcolor = processcolorwrapper(nesrgb, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, true, hdrsdrmaxnits, backwardsmode, inversesearchvisitlist0);
+                    vec3 outcolor = processcolorwrapper(nesrgb, nesplan, backwardsmode, inversesearchvisitlist0);
                     // for now screen barf
                     //printf("NES palette: Luma %i, hue %i, emp %i yeilds RGB: ", luma, hue, emp);
                     //nesrgb.printout();
@@ -4092,14 +6146,143 @@ int main(int argc, const char **argv){
     memset(&image, 0, sizeof image);
     image.version = PNG_IMAGE_VERSION;
 
-    // we also need dimensions if we're generating a LUT
-    if (lutgen){
-        image.width = lutsize * lutsize;
-        image.height = lutsize;
+    // The memo cache on disk and the full table are keyed by everything that goes into converting an 8-bit color:
+    // the gamut descriptors, everything else in the plan, and the search direction.
+    // (Dithering happens after the memos, but it decides whether the output gamma table is used (see initializeTransferTables()),
+    // so the memo cache, which holds unquantized results, is keyed by that as well.)
+    // If one can't be opened, we carry on without it.
+    // The full table makes the memo cache redundant, so only one is used.
+    std::string memokey;
+    if ((memocacheset || fulltableset || png16) && !lutgen){
+        memokey = descriptorkey;
+        keyappend(memokey, plan.gammamodein);
+        keyappend(memokey, plan.gammapowin);
+        keyappend(memokey, plan.gammamodeout);
+        keyappend(memokey, plan.gammapowout);
+        keyappend(memokey, plan.cccfunctiontype);
+        keyappend(memokey, plan.cccfloor);
+        keyappend(memokey, plan.cccceiling);
+        keyappend(memokey, plan.cccexp);
+        keyappend(memokey, plan.remapfactor);
+        keyappend(memokey, plan.remaplimit);
+        keyappend(memokey, plan.softkneemode);
+        keyappend(memokey, plan.kneefactor);
+        keyappend(memokey, plan.mapdirection);
+        keyappend(memokey, plan.safezonetype);
+        keyappend(memokey, plan.lutmode);
+        keyappend(memokey, plan.nesmode);
+        keyappend(memokey, plan.hdrsdrmaxnits);
+        keyappend(memokey, backwardsmode);
+    }
+    bool fulltableopen = false;
+    // (in 16-bit mode, the full table directory holds the generated LUT instead)
+    if (fulltableset && !png16){
+        fulltableopen = fulltab.Open(fulltabledir, memokey, plan, maxthreads, verbosity);
+        if (!fulltableopen){
+            printf("WARNING: Full table could not be opened. Continuing without it.\n");
+        }
+    }
+    if (!fulltableopen){
+        fulltab.Close();
+    }
+    if (memocacheset && !lutgen && !fulltableopen && !png16){
+        std::string memocachekey = memokey;
+        keyappend(memocachekey, quantized8);
+        if (!diskmemo.Open(memocachedir, memocachekey)){
+            printf("WARNING: Memo cache could not be opened. Continuing without it.\n");
+        }
+    }
+    else {
+        diskmemo.Close();
     }
 
-    // check for lutgen first to short-circuit reading from file that isn't there
-    if (lutgen || png_image_begin_read_from_file(&image, inputfilename)){
+    // LUT generation makes each LUT size in turn, sharing grid points between them
+    if (lutgen){
+        lutshare.Clear();
+        result = RETURN_SUCCESS;
+        for (size_t i=0; (i<lutsizes.size()) && (result == RETURN_SUCCESS); i++){
+            lutsize = lutsizes[i];
+            std::string lutfilename = (lutsizes.size() == 1) ? std::string(outputfilename) : lutsizefilename(outputfilename, lutsize);
+            result = generatelut(lutsize, lutfilename.c_str(), maxthreads, plan, verbosity, backwardsmode, sourcegamut.attachedCRT, crtclamplow, crtclamphigh, crtdoclamphigh, crtgammaknob, crtsuperblacks, pnglevel, pngstrategy, lpguscale, lpguscalereciprocal);
+            // maybe write the parameters file for retroarch CCC shaders
+            if (retroarchwritetext && (result == RETURN_SUCCESS) && sourcegamut.attachedCRT){
+                std::string textfilename = (lutsizes.size() == 1) ? std::string(retroarchtextfilename) : lutsizefilename(retroarchtextfilename, lutsize);
+                result = writeretroarchtext(textfilename.c_str(), lutfilename.c_str(), lutmode, argc, argv, sourcegamut.attachedCRT, crtblacklevel, crtwhitelevel, crtgammaknob, lpguscalereciprocal, crtsuperblacks, crtblackpedestalcrush, crtblackpedestalcrushamount, crtdoclamphigh, crtclamphigh);
+            }
+        }
+        lutshare.Clear();
+    }
+    // 16-bit mode generates a dense LUT (or loads it from the full table directory) and converts with that
+    else if (png16){
+        bool png16linearize = (crtemumode != CRT_EMU_BACK) && (gammamodeout != GAMMA_LINEAR);
+        std::string lutkey = memokey;
+        keyappend(lutkey, png16lutsize);
+        std::string lutcachename;
+        if (fulltableset){
+            char hashname[64];
+            snprintf(hashname, sizeof(hashname), "gamutthingy-lut16-%016llx.bin", (unsigned long long)cachekeyhash(lutkey));
+            std::error_code ec;
+            std::filesystem::create_directories(fulltabledir, ec);
+            lutcachename = (std::filesystem::path(fulltabledir) / hashname).string();
+        }
+        appliedlut lut;
+        auto lutstart = std::chrono::steady_clock::now();
+        if (fulltableset && lut.LoadGenerated(lutcachename, lutkey, png16lutsize, png16linearize)){
+            if (verbosity >= VERBOSITY_SLIGHT){
+                printf("Loaded %ix%ix%i LUT from %s in %.3f seconds.\n", png16lutsize, png16lutsize, png16lutsize, lutcachename.c_str(), std::chrono::duration<double>(std::chrono::steady_clock::now() - lutstart).count());
+            }
+        }
+        else {
+            if (verbosity >= VERBOSITY_SLIGHT){
+                printf("Generating %ix%ix%i LUT...\n", png16lutsize, png16lutsize, png16lutsize);
+                fflush(stdout);
+            }
+            lut.Generate(plan, png16lutsize, maxthreads, gammamodeout, gammapowout, hdrsdrmaxnits, png16linearize);
+            if (verbosity >= VERBOSITY_SLIGHT){
+                printf("Generated LUT in %.1f seconds.\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - lutstart).count());
+            }
+            if (fulltableset && !lut.SaveGenerated(lutcachename, lutkey)){
+                printf("WARNING: LUT could not be saved. Continuing without saving it.\n");
+            }
+        }
+        if (png16report){
+            lut.ErrorReport(plan, LUT_ERROR_REPORT_SAMPLES);
+            printf("----------\n");
+        }
+        result = convertimage16(inputfilename, outputfilename, lut, maxthreads, verbosity, dither, pnglevel, pngstrategy);
+        if (result == RETURN_SUCCESS){
+            printf("done.\n");
+        }
+    }
+    // frame stream mode converts frames from stdin to stdout until stdin runs out
+    else if (framestream != FRAME_STREAM_NONE){
+        result = streamframes(stdin, framestreamoutput, framestream, rawwidth, rawheight, y4mmatrix, maxthreads, plan, verbosity, dither, backwardsmode);
+        fclose(framestreamoutput);
+        reportmemocache(verbosity);
+        return result;
+    }
+    // batch mode converts a list of files with the same plan
+    else if (batchset){
+        result = convertbatch(*batchjobs, maxthreads, plan, verbosity, dither, backwardsmode, pnglevel, pngstrategy);
+        if (result == RETURN_SUCCESS){
+            printf("done.\n");
+        }
+    }
+    // other file formats are memory-mapped and converted in one go
+    else if ((inputformat != IMAGE_FORMAT_PNG) || (outputformat != IMAGE_FORMAT_PNG)){
+        result = convertimagefile(inputfilename, inputformat, rawwidth, outputfilename, outputformat, maxthreads, plan, verbosity, dither, backwardsmode, pnglevel, pngstrategy);
+        if (result == RETURN_SUCCESS){
+            printf("done.\n");
+        }
+    }
+    // streaming mode reads, converts, and writes the image a band of rows at a time
+    else if (streamband > 0){
+        result = streamimage(inputfilename, outputfilename, streamband, maxthreads, plan, verbosity, dither, backwardsmode, pnglevel, pngstrategy);
+        if (result == RETURN_SUCCESS){
+            printf("done.\n");
+        }
+    }
+    else if (png_image_begin_read_from_file(&image, inputfilename)){
         png_bytep buffer;
 
         /* Change this to try different formats!  If you set a colormap format
@@ -4107,18 +6290,10 @@ int main(int argc, const char **argv){
         */
         image.format = PNG_FORMAT_RGBA;
 
-        size_t buffsize;
-        if (lutgen){
-            buffsize = lutsize * lutsize * lutsize * 4;
-        }
-        else {
-            buffsize = PNG_IMAGE_SIZE(image);
-        }
-        buffer = (png_bytep) malloc(buffsize);  //c++ wants an explict cast
+        buffer = (png_bytep) malloc(PNG_IMAGE_SIZE(image));  //c++ wants an explict cast
 
         if (buffer != NULL){
-            // check for lutgen first to short-circuit reading from file that isn't there
-            if (lutgen || png_image_finish_read(&image, NULL/*background*/, buffer, 0/*row_stride*/, NULL/*colormap for PNG_FORMAT_FLAG_COLORMAP */)){
+            if (png_image_finish_read(&image, NULL/*background*/, buffer, 0/*row_stride*/, NULL/*colormap for PNG_FORMAT_FLAG_COLORMAP */)){
                 
                 // ------------------------------------------------------------------------------------------------------------------------------------------
                 // Begin actual color conversion code
@@ -4127,104 +6302,29 @@ int main(int argc, const char **argv){
                 memset(&memos, 0, 256 * 256 * 256 * sizeof(memo));
                 
                 if (verbosity >= VERBOSITY_MINIMAL){
-                    if (lutgen){
-                        printf("Doing gamut conversion on LUT and saving result to %s...\n", outputfilename);
-                    }
-                    else {
-                        printf("Doing gamut conversion on %s and saving result to %s...\n", inputfilename, outputfilename);
-                    }
-                }
-                
-                // we need to know our ceiling for LUTMODE_POSTGAMMA_UNLIMITED
-                lpguscale = 1.0;
-                lpguscalereciprocal = 1.0;
-                if (lutgen && (lutmode == LUTMODE_POSTGAMMA_UNLIMITED) && sourcegamut.attachedCRT){
-                    // we need to temporarily set the CRT to super black mode
-                    bool oldsuperblackmode = sourcegamut.attachedCRT->superblacks;
-                    sourcegamut.attachedCRT->superblacks = true;
-                    // if we're clamping, then we can compute the ceiling
-                    if (crtdoclamphigh){
-                        if (crtclamphigh > 1.0){
-                            lpguscale = crtclamphigh;
-                            if (crtgammaknob != 1.0){
-                                lpguscale = pow(lpguscale, crtgammaknob);
-                            }
-                            lpguscale = sourcegamut.attachedCRT->tolinear1886appx1(lpguscale);
-                        }
-                    }
-                    // otherwise we must guess and check to find the max output value.
-                    else {
-                        double lpgumax = 0.0;
-                        // iterate over the primary and secondary colors
-                        for (int guessr=0; guessr<=1; guessr++){
-                            for (int guessg=0; guessg<=1; guessg++){
-                                for (int guessb=0; guessb<=1; guessb++){
-                                    if (guessr + guessg + guessb == 0){
-                                        continue; // skip black
-                                    }
-                                    vec3 guess = vec3(double(guessr), double(guessg), double(guessb));
-                                    vec3 guessresult = sourcegamut.attachedCRT->CRTEmulateGammaSpaceRGBtoLinearRGB(guess);
-                                    if (guessresult.x > lpgumax){
-                                        lpgumax = guessresult.x;
-                                    }
-                                    if (guessresult.y > lpgumax){
-                                        lpgumax = guessresult.y;
-                                    }
-                                    if (guessresult.z > lpgumax){
-                                        lpgumax = guessresult.z;
-                                    }
-                                }
-                            }
-                        }
-                        lpguscale = lpgumax;
-                    }
-                    //printf("lpguscale is %f!\n", lpguscale);
-                    // since there's no way to interpolate white from its neighbors,
-                    // we need to make sure that white gets its own entry in the LUT
-                    // so we'll increase the scale to hit a good factor to make that happen
-                    // we want the reciprocal to be a concise rational number
-                    if (lpguscale > 1.0){
-                        bool happy = false;
-                        for (int divisor = lutsize - 1; divisor > 0; divisor--){
-                            // keep trying until we hit a bigger factor than what we have
-                            double scalefactor = ((double)lutsize) / ((double)divisor);
-                            if (scalefactor < lpguscale){
-                                continue;
-                            }
-                            // compute greatest common factor
-                            int gcf = std::gcd(lutsize, divisor);
-                            // at least 2?
-                            if (gcf < 2){
-                                continue;
-                            }
-                            happy = true;
-                            lpguscale = scalefactor;
-                            lpguscalereciprocal = ((double)divisor) / ((double)lutsize);
-                            //printf("lpguscale increased to %f!\n", lpguscale);
-                            break;
-                        }
-                        if (!happy){
-                            printf("WARNING: Could not find a good scaling factor to ensure white has its own entry in the LUT.\n");
-                        }
-                    }
-                    // set the CRT superblack setting back to what it was
-                    sourcegamut.attachedCRT->superblacks = oldsuperblackmode;
+                    printf("Doing gamut conversion on %s and saving result to %s...\n", inputfilename, outputfilename);
                 }
 
                 int width = image.width;
                 int height = image.height;
                 int thready = 0;
+                // convert in place
+                pixelbuffers imagebuffers;
+                imagebuffers.input = buffer;
+                imagebuffers.inputbytesperpixel = 4;
+                imagebuffers.output = buffer;
+                imagebuffers.outputbytesperpixel = 4;
                 int prettyprintcounter = 0;
 
                 // launch threads!
-                std::thread thread0(threadDoStuff, 0, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread1(threadDoStuff, 1, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread2(threadDoStuff, 2, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread3(threadDoStuff, 3, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread4(threadDoStuff, 4, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread5(threadDoStuff, 5, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread6(threadDoStuff, 6, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
-                std::thread thread7(threadDoStuff, 7, maxthreads, &prettyprintcounter, &sourcegamut, &destgamut, width, height, &thready, verbosity, lutgen, buffer, lutsize, lutmode, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, hdrsdrmaxnits, backwardsmode);
+                std::thread thread0(threadDoStuff, 0, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread1(threadDoStuff, 1, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread2(threadDoStuff, 2, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread3(threadDoStuff, 3, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread4(threadDoStuff, 4, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread5(threadDoStuff, 5, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread6(threadDoStuff, 6, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
+                std::thread thread7(threadDoStuff, 7, maxthreads, &prettyprintcounter, &plan, width, height, 0, height, true, &thready, verbosity, lutgen, &imagebuffers, lutsize, crtclamplow, crtclamphigh, lpguscale, crtsuperblacks, dither, backwardsmode);
 
                 thread0.join();
                 thread1.join();
@@ -4314,15 +6414,15 @@ int main(int argc, const char **argv){
                             }
                             else {
                                 // convert to double
-                                redvalue = BetterDAC(redin, 256);
-                                greenvalue = BetterDAC(greenin, 256);
-                                bluevalue = BetterDAC(bluein, 256);
+                                redvalue = DAC8Table[redin];
+                                greenvalue = DAC8Table[greenin];
+                                bluevalue = DAC8Table[bluein];
                                 // don't touch alpha value
                             }
 
                             vec3 inputcolor = vec3(redvalue, greenvalue, bluevalue);
                             
-                            outcolor = processcolorwrapper(inputcolor, gammamodein, gammapowin, gammamodeout, gammapowout, mapmode, sourcegamut, destgamut, cccfunctiontype, cccfloor, cccceiling, cccexp, remapfactor, remaplimit, softkneemode, kneefactor, mapdirection, safezonetype, spiralcarisma, lutmode, false, hdrsdrmaxnits, backwardsmode, inversesearchvisitlist0);
+                            outcolor = processcolorwrapper(inputcolor, plan, backwardsmode, inversesearchvisitlist0);
 
                             // blank the out-of-bounds stuff for sanity checking extended intermediate LUTSs
                             /*
@@ -4375,13 +6475,13 @@ int main(int argc, const char **argv){
                 // ------------------------------------------------------------------------------------------------------------------------------------------
                 
                 
-                if (png_image_write_to_file(&image, outputfilename, 0/*convert_to_8bit*/, buffer, 0/*row_stride*/, NULL/*colormap*/)){
+                // filter and deflate bands of rows in parallel
+                if (WritePNGParallel(outputfilename, buffer, width, height, maxthreads, pnglevel, pngstrategy)){
                     result = RETURN_SUCCESS;
                     printf("done.\n");
                 }
 
                 else {
-                    fprintf(stderr, "gamutthingy: write %s: %s\n", outputfilename, image.message);
                     result = ERROR_PNG_WRITE_FAIL;
                 }
             }
@@ -4414,86 +6514,547 @@ int main(int argc, const char **argv){
         result = ERROR_PNG_OPEN_FAIL;
     }
 
-    // if we're still here, maybe write the parameters file for retroarch CCC shaders
-    if (lutgen && retroarchwritetext && (result == RETURN_SUCCESS) && sourcegamut.attachedCRT){
-        printf("Writing text file for retroarch CC shaders parameters to %s...", retroarchtextfilename);
-        std::ofstream ratxtfile;
-        ratxtfile.open(retroarchtextfilename, std::ios::out);
-        if (!ratxtfile.is_open()){
-            printf("Unable to open %s for writing.\n", retroarchtextfilename);
-            return ERROR_PNG_OPEN_FAIL;
+
+    reportmemocache(verbosity);
+
+   return result;
+}
+
+// one job from a job file
+typedef struct jobspec{
+    int line;               // line in the job file
+    std::vector<std::string> args; // command line for the job, minus the program name (and minus the input and output files if batchable)
+    std::string inputfilename;
+    std::string outputfilename;
+    bool batchable;         // an image file conversion that can be batched with others that have the same args
+    int group;
+    int status;
+    double loadseconds;
+    double convertseconds;
+    double saveseconds;
+} jobspec;
+
+// splits a job file line into arguments at whitespace (double quotes group an argument with spaces in it)
+std::vector<std::string> splitjobline(const std::string &line){
+    std::vector<std::string> tokens;
+    std::string token;
+    bool intoken = false;
+    bool inquotes = false;
+    for (char c : line){
+        if (c == '"'){
+            inquotes = !inquotes;
+            intoken = true;
         }
-        ratxtfile << "# Paste this at the bottom of a template file of Chthon's Color Correction shaders.\n";
-        switch (lutmode){
-            case LUTMODE_NORMAL:
-                ratxtfile << "# Use a LUTtype1 or LUTtype1fast template.\n";
-                break;
-            case LUTMODE_POSTCC:
-                ratxtfile << "# Use a LUTtype2 template.\n";
-                break;
-            case LUTMODE_POSTGAMMA:
-                ratxtfile << "# Use a LUTtype3 template.\n";
-                break;
-            case LUTMODE_POSTGAMMA_UNLIMITED:
-                ratxtfile << "# Use a LUTtype4 template.\n";
-                break;
-            default:
-                ratxtfile << "# Somthing is very wrong.\n";
-                break;
-        };
-        ratxtfile << "# Paste " << outputfilename << " into the \"luts\" subdirectory of Chthon's Color Correction shaders.\n";
-        ratxtfile << "# LUT generation command: gamutthingy";
-        for (int i=1; i<argc; i++){
-            ratxtfile << " " << argv[i];
+        else if (!inquotes && ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'))){
+            if (intoken){
+                tokens.push_back(token);
+                token.clear();
+                intoken = false;
+            }
+        }
+        else {
+            token.push_back(c);
+            intoken = true;
+        }
+    }
+    if (intoken){
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+// reads one line (of any length) from file, without the newline; returns false at the end of the file
+bool readline(FILE* file, std::string &line){
+    line.clear();
+    int c;
+    while (((c = fgetc(file)) != EOF) && (c != '\n')){
+        line.push_back((char)c);
+    }
+    return (c != EOF) || !line.empty();
+}
+
+// Job file mode: runs a list of jobs in one process.
+// Each line of the job file is one job, written as the gamutthingy command line for it (without the program name),
+// and the rest of our own command line is put in front of every job (so a job can override it).
+// Blank lines and lines starting with # are skipped.
+// Image file conversions (-i and -o) with otherwise identical command lines are grouped and run as a batch (see convertbatch()),
+// in order of each group's first appearance, so they share one plan and one memo table and are pipelined across the worker threads.
+// Everything else (--lutgen, --nespalgen, --color) runs as a job of its own.
+// Gamut descriptors are cached across all the jobs (see finddescriptorset()), so jobs that differ only in settings
+// that don't go into the descriptors (gamma, dither, LUT mode, CCC settings, etc.) sample the gamut boundaries only once.
+// Prints a per-job timing report at the end, and returns the first error code (if any).
+int runjobs(const char* jobfilename, const std::vector<std::string> &commonargs){
+
+    FILE* jobfile = fopen(jobfilename, "r");
+    if (jobfile == NULL){
+        fprintf(stderr, "gamutthingy: %s: %s\n", jobfilename, strerror(errno));
+        return ERROR_JOB_FILE_FAIL;
+    }
+    std::vector<jobspec> jobs;
+    std::vector<std::vector<std::string>> groupargs;
+    std::string line;
+    int lineno = 0;
+    int result = RETURN_SUCCESS;
+    while (readline(jobfile, line)){
+        lineno++;
+        std::vector<std::string> tokens = splitjobline(line);
+        if (tokens.empty() || (tokens[0][0] == '#')){
+            continue;
+        }
+        jobspec job;
+        job.line = lineno;
+        job.batchable = true;
+        job.status = -1; // not run (yet)
+        job.loadseconds = 0.0;
+        job.convertseconds = 0.0;
+        job.saveseconds = 0.0;
+        std::vector<std::string> allargs = commonargs;
+        allargs.insert(allargs.end(), tokens.begin(), tokens.end());
+        bool badjob = false;
+        for (size_t i=0; i<allargs.size(); i++){
+            const std::string &arg = allargs[i];
+            bool hasvalue = (i + 1 < allargs.size());
+            if (((arg == "-i") || (arg == "--infile")) && hasvalue){
+                job.inputfilename = allargs[++i];
+            }
+            else if (((arg == "-o") || (arg == "--outfile")) && hasvalue){
+                job.outputfilename = allargs[++i];
+            }
+            else {
+                // (--png16 output is 16-bit, which the batch path can't do)
+                if ((arg == "--jobs") || (arg == "--frame-stream") || (arg == "--batch") || (arg == "--batch-outdir") || ((arg == "--png16") && hasvalue && (allargs[i + 1] == "true"))){
+                    fprintf(stderr, "gamutthingy: %s line %i: %s can't be used in a job file\n", jobfilename, lineno, arg.c_str());
+                    badjob = true;
+                }
+                if ((arg == "--color") || (arg == "-c") || (((arg == "--lutgen") || (arg == "--nespalgen")) && hasvalue && (allargs[i + 1] == "true"))){
+                    job.batchable = false;
+                }
+                job.args.push_back(arg);
+            }
+        }
+        if (job.inputfilename.empty() || job.outputfilename.empty()){
+            job.batchable = false;
+        }
+        // jobs that aren't batched keep their input and output
+        if (!job.batchable){
+            job.args = allargs;
+        }
+        if (badjob){
+            job.batchable = false;
+            job.args = allargs;
+            job.status = ERROR_JOB_FILE_FAIL;
+            job.group = -1;
+            if (result == RETURN_SUCCESS){
+                result = ERROR_JOB_FILE_FAIL;
+            }
+        }
+        else {
+            job.group = -1;
+            if (job.batchable){
+                for (size_t g=0; g<groupargs.size(); g++){
+                    if (groupargs[g] == job.args){
+                        job.group = g;
+                        break;
+                    }
+                }
+            }
+            if (job.group < 0){
+                job.group = groupargs.size();
+                groupargs.push_back(job.args);
+            }
         }
-        ratxtfile << "\n\n\n";
-        ratxtfile << "SamplerLUT = \"luts/" << outputfilename << "\"\n\n";
+        jobs.push_back(job);
+    }
+    fclose(jobfile);
+    if (jobs.empty()){
+        fprintf(stderr, "gamutthingy: %s: no jobs\n", jobfilename);
+        return ERROR_JOB_FILE_FAIL;
+    }
 
-        ratxtfile << std::setprecision(16);
+    printf("Running %i jobs from %s in %i groups...\n", (int)jobs.size(), jobfilename, (int)groupargs.size());
+    auto starttime = std::chrono::steady_clock::now();
+    std::vector<double> groupseconds(groupargs.size(), 0.0);
+    for (size_t g=0; g<groupargs.size(); g++){
+        std::vector<const char*> groupargv;
+        groupargv.push_back("gamutthingy");
+        for (const std::string &arg : groupargs[g]){
+            groupargv.push_back(arg.c_str());
+        }
+        std::vector<imagejob> batch;
+        std::vector<int> batchmembers;
+        bool batched = false;
+        for (size_t j=0; j<jobs.size(); j++){
+            if (jobs[j].group == (int)g){
+                batched = jobs[j].batchable;
+                if (batched){
+                    imagejob image;
+                    image.inputfilename = jobs[j].inputfilename;
+                    image.outputfilename = jobs[j].outputfilename;
+                    image.status = -1;
+                    batch.push_back(image);
+                }
+                batchmembers.push_back(j);
+            }
+        }
+        printf("\n---------- Job group %i of %i (%i jobs) ----------\n", (int)g + 1, (int)groupargs.size(), (int)batchmembers.size());
+        auto groupstart = std::chrono::steady_clock::now();
+        hostedrun host;
+        host.batch = batched ? &batch : NULL;
+        int groupresult = gamutthingymain(groupargv.size(), groupargv.data(), &host);
+        groupseconds[g] = std::chrono::duration<double>(std::chrono::steady_clock::now() - groupstart).count();
+        for (size_t m=0; m<batchmembers.size(); m++){
+            jobspec &job = jobs[batchmembers[m]];
+            if (batched){
+                // (if the batch never started, the whole group failed)
+                job.status = (batch[m].status == -1) ? groupresult : batch[m].status;
+                job.loadseconds = batch[m].loadseconds;
+                job.convertseconds = batch[m].convertseconds;
+                job.saveseconds = batch[m].saveseconds;
+            }
+            else {
+                job.status = groupresult;
+                job.convertseconds = groupseconds[g];
+            }
+            if ((job.status != RETURN_SUCCESS) && (result == RETURN_SUCCESS)){
+                result = job.status;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count();
+
+    printf("\n---------- Job report ----------\n");
+    for (size_t j=0; j<jobs.size(); j++){
+        jobspec &job = jobs[j];
+        std::string what = job.batchable ? (job.inputfilename + " -> " + job.outputfilename) : "";
+        if (!job.batchable){
+            for (const std::string &arg : job.args){
+                what += (what.empty() ? "" : " ") + arg;
+            }
+        }
+        printf("line %i: %s\n", job.line, what.c_str());
+        if (job.status == RETURN_SUCCESS){
+            printf("\tOK");
+        }
+        else {
+            printf("\tFAILED (error %i)", job.status);
+        }
+        if (job.group >= 0){
+            printf(", group %i", job.group + 1);
+        }
+        if (job.batchable){
+            printf(", load %.3f s, convert %.3f s, save %.3f s\n", job.loadseconds, job.convertseconds, job.saveseconds);
+        }
+        else {
+            printf(", %.3f s\n", job.convertseconds);
+        }
+    }
+    for (size_t g=0; g<groupargs.size(); g++){
+        printf("group %i: %.3f s total (including setup)\n", (int)g + 1, groupseconds[g]);
+    }
+    printf("%i sets of gamut descriptors built for %i groups; %.3f s total.\n", descriptorsetsbuilt, (int)groupargs.size(), seconds);
+    return result;
+} // end runjobs()
+
+#define SERVER_ACCEPT_RETRY_MS 100 // wait after a failed accept()
+#define SERVER_ACCEPT_MAX_FAILURES 50 // consecutive failed accept()s before the server gives up
+
+// a named configuration for server mode
+typedef struct serverconfig{
+    std::string name;
+    std::vector<std::string> args;
+} serverconfig;
+
+// Parameters a server client can't add to a request: other modes that would take over the server
+// (or read its stdin), and outputs other than the one 8-bit image or LUT the request is for.
+const char* serverrejectedparams[] = {"--jobs", "--frame-stream", "--batch", "--batch-outdir", "--serve", "--socket", "--colorlist", "--png16"};
+
+// runs gamutthingymain() quietly with commonargs, then config's args, then extraargs
+int runserverconfig(const std::vector<std::string> &commonargs, const serverconfig &config, const std::vector<std::string> &extraargs, hostedrun* host){
+    std::vector<const char*> argv;
+    argv.push_back("gamutthingy");
+    argv.push_back("--verbosity");
+    argv.push_back("0");
+    for (const std::string &arg : commonargs){
+        argv.push_back(arg.c_str());
+    }
+    for (const std::string &arg : config.args){
+        argv.push_back(arg.c_str());
+    }
+    for (const std::string &arg : extraargs){
+        argv.push_back(arg.c_str());
+    }
+    return gamutthingymain(argv.size(), argv.data(), host);
+}
 
-        ratxtfile << "crtBlackLevel = \"" << crtblacklevel << "\"\n";
-        ratxtfile << "crtWhiteLevel = \"" << crtwhitelevel << "\"\n";
-        ratxtfile << "crtConstantB = \"" << sourcegamut.attachedCRT->CRT_EOTF_b << "\"\n";
-        ratxtfile << "crtConstantK = \"" << sourcegamut.attachedCRT->CRT_EOTF_k << "\"\n";
-        ratxtfile << "crtConstantS = \"" << sourcegamut.attachedCRT->CRT_EOTF_s << "\"\n";
-        ratxtfile << "crtGammaKnob = \"" << crtgammaknob << "\"\n\n";
+// Handles one server mode request line, and writes a one-line reply to output.
+// Returns false if the client asked the server to quit.
+bool serverrequest(const std::string &line, const std::vector<std::string> &commonargs, const std::vector<serverconfig> &configs, FILE* output){
+    std::vector<std::string> tokens = splitjobline(line);
+    if (tokens.empty()){
+        return true;
+    }
+    const std::string &request = tokens[0];
+    if (request == "quit"){
+        fprintf(output, "ok\n");
+        fflush(output);
+        return false;
+    }
+    if (request == "configs"){
+        fprintf(output, "ok");
+        for (const serverconfig &config : configs){
+            fprintf(output, " %s", config.name.c_str());
+        }
+        fprintf(output, "\n");
+        fflush(output);
+        return true;
+    }
+    if ((request != "color") && (request != "image") && (request != "lut")){
+        fprintf(output, "error %i unknown request %s\n", ERROR_SERVER_FAIL, request.c_str());
+        fflush(output);
+        return true;
+    }
+    const serverconfig* config = NULL;
+    if (tokens.size() >= 2){
+        for (const serverconfig &candidate : configs){
+            if (candidate.name == tokens[1]){
+                config = &candidate;
+                break;
+            }
+        }
+    }
+    if (config == NULL){
+        fprintf(output, "error %i unknown configuration %s\n", ERROR_SERVER_FAIL, (tokens.size() >= 2) ? tokens[1].c_str() : "");
+        fflush(output);
+        return true;
+    }
 
-        if (lutmode == LUTMODE_NORMAL){
-            ratxtfile << "# For a LUTtype1fast template, you may omit everything below this point.\n\n";
+    // (color requests have no extra parameters; image requests have them after INPUT OUTPUT, and lut requests after OUTPUT)
+    size_t firstparam = (request == "color") ? tokens.size() : ((request == "image") ? 4 : 3);
+    for (size_t i=firstparam; i<tokens.size(); i++){
+        for (const char* rejected : serverrejectedparams){
+            if (tokens[i] == rejected){
+                fprintf(output, "error %i %s can't be used in a request\n", ERROR_SERVER_FAIL, rejected);
+                fflush(output);
+                return true;
+            }
         }
+    }
 
-        ratxtfile << "crtLUT4scale = \"" << lpguscalereciprocal << "\"\n";
-        ratxtfile << "crtLUT4renorm = \"" << (((lutmode == LUTMODE_POSTGAMMA_UNLIMITED) && !crtsuperblacks) ? "1.0" : "0.0") << "\"\n\n";
+    int result = RETURN_SUCCESS;
+    hostedrun host;
+    // color NAME 0xRRGGBB [0xRRGGBB ...]
+    if (request == "color"){
+        std::vector<int> colors;
+        for (size_t i=2; i<tokens.size(); i++){
+            char* endptr;
+            errno = 0;
+            long int input = strtol(tokens[i].c_str(), &endptr, 0);
+            if ((tokens[i].size() != 8) || (endptr - tokens[i].c_str() != 8) || (errno != 0) || (input < 0)){
+                fprintf(output, "error %i invalid color %s\n", ERROR_BAD_PARAM_INVALID_COLOR, tokens[i].c_str());
+                fflush(output);
+                return true;
+            }
+            colors.push_back(input);
+        }
+        host.colors = &colors;
+        result = runserverconfig(commonargs, *config, std::vector<std::string>(), &host);
+        if (result == RETURN_SUCCESS){
+            fprintf(output, "ok");
+            for (vec3 &color : host.colorresults){
+                fprintf(output, " 0x%02X%02X%02X", toRGB8nodither(color.x), toRGB8nodither(color.y), toRGB8nodither(color.z));
+            }
+            fprintf(output, "\n");
+            fflush(output);
+            return true;
+        }
+    }
+    // image NAME INPUT OUTPUT [parameters ...]
+    else if (request == "image"){
+        if (tokens.size() < 4){
+            fprintf(output, "error %i usage: image NAME INPUT OUTPUT [parameters ...]\n", ERROR_SERVER_FAIL);
+            fflush(output);
+            return true;
+        }
+        std::vector<imagejob> batch(1);
+        batch[0].inputfilename = tokens[2];
+        batch[0].outputfilename = tokens[3];
+        batch[0].status = -1;
+        host.batch = &batch;
+        result = runserverconfig(commonargs, *config, std::vector<std::string>(tokens.begin() + 4, tokens.end()), &host);
+        if ((result == RETURN_SUCCESS) && (batch[0].status != RETURN_SUCCESS)){
+            // (-1 means the run never got to the image)
+            result = (batch[0].status == -1) ? ERROR_SERVER_FAIL : batch[0].status;
+        }
+    }
+    // lut NAME OUTPUT [parameters ...]
+    else {
+        if (tokens.size() < 3){
+            fprintf(output, "error %i usage: lut NAME OUTPUT [parameters ...]\n", ERROR_SERVER_FAIL);
+            fflush(output);
+            return true;
+        }
+        std::vector<std::string> extraargs(tokens.begin() + 3, tokens.end());
+        extraargs.push_back("--lutgen");
+        extraargs.push_back("true");
+        extraargs.push_back("--outfile");
+        extraargs.push_back(tokens[2]);
+        result = runserverconfig(commonargs, *config, extraargs, NULL);
+    }
+    if (result == RETURN_SUCCESS){
+        fprintf(output, "ok\n");
+    }
+    else {
+        fprintf(output, "error %i %s failed\n", result, request.c_str());
+    }
+    fflush(output);
+    return true;
+} // end serverrequest()
+
+// Server mode: sets up the named configurations in configfilename once, then answers requests without setting them up again.
+// Each line of the configuration file is a name followed by the gamutthingy parameters for it
+// (and the rest of our own command line is put in front of every configuration).
+// Requests are read one per line, from stdin (with replies on stdout, and console output moved to stderr),
+// or from clients of a Unix domain socket at socketpath, one client at a time. Requests are:
+//     color NAME 0xRRGGBB [0xRRGGBB ...]      replies "ok 0xRRGGBB ..." with the converted colors
+//     image NAME INPUT OUTPUT [parameters]    converts an image file; replies "ok"
+//     lut NAME OUTPUT [parameters]            generates a LUT; replies "ok"
+//     configs                                 replies "ok NAME ..." with the configuration names
+//     quit                                    replies "ok" and stops the server
+// Failures reply "error CODE message". Extra parameters are applied after the configuration's own.
+// The gamut descriptors stay warm in the descriptor cache (see finddescriptorset()), so only the cheap per-run setup is repeated.
+int runserver(const char* configfilename, const char* socketpath, const std::vector<std::string> &commonargs){
+
+    FILE* replies = stdout;
+    if (socketpath == NULL){
+        replies = RedirectConsoleToStderr();
+        if (replies == NULL){
+            return ERROR_SERVER_FAIL;
+        }
+    }
 
-        ratxtfile << "crtMatrixRR = \"" << sourcegamut.attachedCRT->overallMatrix[0][0] << "\"\n";
-        ratxtfile << "crtMatrixRG = \"" << sourcegamut.attachedCRT->overallMatrix[0][1] << "\"\n";
-        ratxtfile << "crtMatrixRB = \"" << sourcegamut.attachedCRT->overallMatrix[0][2] << "\"\n";
-        ratxtfile << "crtMatrixGR = \"" << sourcegamut.attachedCRT->overallMatrix[1][0] << "\"\n";
-        ratxtfile << "crtMatrixGG = \"" << sourcegamut.attachedCRT->overallMatrix[1][1] << "\"\n";
-        ratxtfile << "crtMatrixGB = \"" << sourcegamut.attachedCRT->overallMatrix[1][2] << "\"\n";
-        ratxtfile << "crtMatrixBR = \"" << sourcegamut.attachedCRT->overallMatrix[2][0] << "\"\n";
-        ratxtfile << "crtMatrixBG = \"" << sourcegamut.attachedCRT->overallMatrix[2][1] << "\"\n";
-        ratxtfile << "crtMatrixBB = \"" << sourcegamut.attachedCRT->overallMatrix[2][2] << "\"\n\n";
+    FILE* configfile = fopen(configfilename, "r");
+    if (configfile == NULL){
+        fprintf(stderr, "gamutthingy: %s: %s\n", configfilename, strerror(errno));
+        return ERROR_SERVER_FAIL;
+    }
+    std::vector<serverconfig> configs;
+    char linebuffer[8192];
+    while (fgets(linebuffer, sizeof(linebuffer), configfile) != NULL){
+        std::vector<std::string> tokens = splitjobline(linebuffer);
+        if (tokens.empty() || (tokens[0][0] == '#')){
+            continue;
+        }
+        serverconfig config;
+        config.name = tokens[0];
+        config.args.assign(tokens.begin() + 1, tokens.end());
+        configs.push_back(config);
+    }
+    fclose(configfile);
+    if (configs.empty()){
+        fprintf(stderr, "gamutthingy: %s: no configurations\n", configfilename);
+        return ERROR_SERVER_FAIL;
+    }
 
-        ratxtfile << "crtBlackCrush = \"" << (crtblackpedestalcrush ? "1.0" : "0.0") << "\"\n";
-        ratxtfile << "crtBlackCrushAmount = \"" << crtblackpedestalcrushamount << "\"\n";
-        if ((lutmode == LUTMODE_POSTGAMMA_UNLIMITED) && !crtsuperblacks){
-            ratxtfile << "# crtSuperBlackEnable is forced to true for LUTtype4.\n";
+    // room to keep every configuration warm, plus the usual number of one-offs from requests with extra parameters
+    descriptorcachelimit = configs.size() + DESCRIPTOR_CACHE_SIZE;
+
+    // warm up every configuration by converting black
+    for (const serverconfig &config : configs){
+        auto starttime = std::chrono::steady_clock::now();
+        std::vector<int> colors(1, 0);
+        hostedrun host;
+        host.colors = &colors;
+        int result = runserverconfig(commonargs, config, std::vector<std::string>(), &host);
+        if (result != RETURN_SUCCESS){
+            fprintf(stderr, "gamutthingy: configuration %s failed to initialize (error %i)\n", config.name.c_str(), result);
+            return result;
         }
-        ratxtfile << "crtSuperBlackEnable = \"" << ((crtsuperblacks || (lutmode == LUTMODE_POSTGAMMA_UNLIMITED)) ? "1.0" : "0.0") << "\"\n\n";
+        printf("Configuration %s ready (%.3f s).\n", config.name.c_str(), std::chrono::duration<double>(std::chrono::steady_clock::now() - starttime).count());
+    }
+    fflush(stdout);
 
-        if(sourcegamut.attachedCRT->zerolightclampenable){
-            ratxtfile << "# crtLowClamp is set at zero light emission.\n";
+    std::string line;
+    if (socketpath == NULL){
+        printf("Reading requests from stdin.\n");
+        fflush(stdout);
+        while (readline(stdin, line)){
+            if (!serverrequest(line, commonargs, configs, replies)){
+                break;
+            }
         }
-        ratxtfile << "crtLowClamp = \"" << sourcegamut.attachedCRT->rgbclamplowlevel << "\"\n";
-        ratxtfile << "crtHighClampEnable = \"" << (crtdoclamphigh ? "1.0" : "0.0") << "\"\n";
-        ratxtfile << "crtHighClamp = \"" << crtclamphigh << "\"\n";
+        fclose(replies);
+        return RETURN_SUCCESS;
+    }
 
-        ratxtfile.flush();
-        ratxtfile.close();
-        printf(" done.\n");
+    int listener = OpenRequestSocket(socketpath);
+    if (listener < 0){
+        return ERROR_SERVER_FAIL;
+    }
+#ifdef SIGPIPE
+    // a client that hangs up before reading its reply should make the write fail, not kill the server
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    printf("Listening for requests on %s.\n", socketpath);
+    fflush(stdout);
+    bool running = true;
+    int acceptfailures = 0;
+    int result = RETURN_SUCCESS;
+    while (running){
+        FILE* clientinput;
+        FILE* clientoutput;
+        if (!AcceptRequestClient(listener, clientinput, clientoutput)){
+            // back off rather than spin, and give up if it keeps failing
+            acceptfailures++;
+            if (acceptfailures >= SERVER_ACCEPT_MAX_FAILURES){
+                fprintf(stderr, "gamutthingy: giving up after %i failed connections in a row\n", acceptfailures);
+                result = ERROR_SERVER_FAIL;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(SERVER_ACCEPT_RETRY_MS));
+            continue;
+        }
+        acceptfailures = 0;
+        while (running && readline(clientinput, line)){
+            running = serverrequest(line, commonargs, configs, clientoutput);
+            // drop a client that's gone away and wait for the next one
+            if (ferror(clientoutput)){
+                fprintf(stderr, "gamutthingy: client hung up before reading its reply\n");
+                break;
+            }
+        }
+        fclose(clientoutput);
+        fclose(clientinput);
     }
-   
+    CloseRequestSocket(listener, socketpath);
+    return result;
+} // end runserver()
 
-   return result;
+int main(int argc, const char **argv){
+    // job file mode runs a whole list of gamutthingy command lines (see runjobs()),
+    // and server mode keeps configurations warm and answers requests (see runserver())
+    const char* jobfilename = NULL;
+    const char* serverconfigfilename = NULL;
+    const char* socketpath = NULL;
+    std::vector<std::string> commonargs;
+    for (int i=1; i<argc; i++){
+        if ((strcmp(argv[i], "--jobs") == 0) && (i + 1 < argc)){
+            jobfilename = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--serve") == 0) && (i + 1 < argc)){
+            serverconfigfilename = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--socket") == 0) && (i + 1 < argc)){
+            socketpath = argv[++i];
+        }
+        else {
+            commonargs.push_back(argv[i]);
+        }
+    }
+    if (serverconfigfilename != NULL){
+        return runserver(serverconfigfilename, socketpath, commonargs);
+    }
+    if (jobfilename != NULL){
+        return runjobs(jobfilename, commonargs);
+    }
+    return gamutthingymain(argc, argv, NULL);
 }
@@ -0,0 +1,328 @@
+#include "imagefile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string>
+
+#ifdef _WIN32
+    #define IMAGEFILE_MMAP 0
+    #define strcasecmp _stricmp
+#else
+    #define IMAGEFILE_MMAP 1
+    #include <strings.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+int ImageFormatFromFilename(const char* filename){
+    const char* dot = strrchr(filename, '.');
+    if (dot == NULL){
+        return IMAGE_FORMAT_PNG;
+    }
+    if ((strcasecmp(dot, ".ppm") == 0) || (strcasecmp(dot, ".pnm") == 0)){
+        return IMAGE_FORMAT_PPM;
+    }
+    if (strcasecmp(dot, ".pam") == 0){
+        return IMAGE_FORMAT_PAM;
+    }
+    if ((strcasecmp(dot, ".rgb") == 0) || (strcasecmp(dot, ".raw") == 0)){
+        return IMAGE_FORMAT_RAW_RGB;
+    }
+    if (strcasecmp(dot, ".rgba") == 0){
+        return IMAGE_FORMAT_RAW_RGBA;
+    }
+    return IMAGE_FORMAT_PNG;
+}
+
+int ImageFormatBytesPerPixel(int format){
+    switch (format){
+        case IMAGE_FORMAT_PPM:
+        case IMAGE_FORMAT_RAW_RGB:
+            return 3;
+        case IMAGE_FORMAT_RAW_RGBA:
+            return 4;
+        default:
+            break;
+    }
+    return 0;
+}
+
+bool mappedimage::OpenInput(const char* filename, int imageformat, int rawwidth){
+    name = filename;
+    output = false;
+    format = imageformat;
+
+#if IMAGEFILE_MMAP
+    fd = open(filename, O_RDONLY);
+    if (fd < 0){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+        Close();
+        return false;
+    }
+    length = info.st_size;
+    if (length > 0){
+        void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED){
+            fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+            Close();
+            return false;
+        }
+        base = (unsigned char*)mapping;
+        // the worker threads take rows in order
+        madvise(base, length, MADV_SEQUENTIAL);
+    }
+#else
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    base = (unsigned char*) malloc((length > 0) ? length : 1);  //c++ wants an explict cast
+    if ((base == NULL) || (fread(base, 1, length, file) != length)){
+        fprintf(stderr, "gamutthingy: %s: could not read file\n", filename);
+        fclose(file);
+        Close();
+        return false;
+    }
+    fclose(file);
+#endif
+
+    if ((format == IMAGE_FORMAT_RAW_RGB) || (format == IMAGE_FORMAT_RAW_RGBA)){
+        bytesperpixel = ImageFormatBytesPerPixel(format);
+        if (rawwidth < 1){
+            fprintf(stderr, "gamutthingy: %s: raw input needs --raw-width\n", filename);
+            Close();
+            return false;
+        }
+        size_t rowbytes = (size_t)rawwidth * bytesperpixel;
+        if ((length == 0) || ((length % rowbytes) != 0)){
+            fprintf(stderr, "gamutthingy: %s: file size %lu is not a multiple of the row size %lu\n", filename, (unsigned long)length, (unsigned long)rowbytes);
+            Close();
+            return false;
+        }
+        width = rawwidth;
+        height = length / rowbytes;
+        pixels = base;
+        return true;
+    }
+    if (!ParseHeader()){
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// reads one header token (skipping whitespace and comments) starting at pos
+// returns false if we run off the end
+static bool headertoken(const unsigned char* data, size_t length, size_t &pos, std::string &token){
+    token.clear();
+    while (pos < length){
+        if (data[pos] == '#'){
+            while ((pos < length) && (data[pos] != '\n')){
+                pos++;
+            }
+        }
+        else if ((data[pos] == ' ') || (data[pos] == '\t') || (data[pos] == '\n') || (data[pos] == '\r')){
+            pos++;
+        }
+        else {
+            break;
+        }
+    }
+    while ((pos < length) && (data[pos] != ' ') && (data[pos] != '\t') && (data[pos] != '\n') && (data[pos] != '\r')){
+        token.push_back(data[pos]);
+        pos++;
+    }
+    return !token.empty();
+}
+
+bool mappedimage::ParseHeader(){
+    size_t pos = 0;
+    std::string token;
+    if (!headertoken(base, length, pos, token) || ((format == IMAGE_FORMAT_PPM) && (token != "P6")) || ((format == IMAGE_FORMAT_PAM) && (token != "P7"))){
+        fprintf(stderr, "gamutthingy: %s: Not a %s file\n", name, (format == IMAGE_FORMAT_PPM) ? "binary PPM (P6)" : "PAM (P7)");
+        return false;
+    }
+    long maxval = 0;
+    if (format == IMAGE_FORMAT_PPM){
+        width = headertoken(base, length, pos, token) ? atoi(token.c_str()) : 0;
+        height = headertoken(base, length, pos, token) ? atoi(token.c_str()) : 0;
+        maxval = headertoken(base, length, pos, token) ? atol(token.c_str()) : 0;
+        bytesperpixel = 3;
+        // exactly one whitespace character separates the header from the pixels
+        pos++;
+    }
+    else {
+        int depth = 0;
+        std::string tupltype;
+        bool ended = false;
+        while (headertoken(base, length, pos, token)){
+            if (token == "ENDHDR"){
+                // skip to the end of the line
+                while ((pos < length) && (base[pos] != '\n')){
+                    pos++;
+                }
+                pos++;
+                ended = true;
+                break;
+            }
+            std::string value;
+            if (!headertoken(base, length, pos, value)){
+                break;
+            }
+            if (token == "WIDTH"){
+                width = atoi(value.c_str());
+            }
+            else if (token == "HEIGHT"){
+                height = atoi(value.c_str());
+            }
+            else if (token == "DEPTH"){
+                depth = atoi(value.c_str());
+            }
+            else if (token == "MAXVAL"){
+                maxval = atol(value.c_str());
+            }
+            else if (token == "TUPLTYPE"){
+                tupltype = value;
+            }
+        }
+        if (!ended || ((depth != 3) && (depth != 4))){
+            fprintf(stderr, "gamutthingy: %s: Only PAM files with depth 3 (RGB) or 4 (RGB_ALPHA) are supported\n", name);
+            return false;
+        }
+        bytesperpixel = depth;
+    }
+    if ((width < 1) || (height < 1)){
+        fprintf(stderr, "gamutthingy: %s: Bad image dimensions\n", name);
+        return false;
+    }
+    if (maxval != 255){
+        fprintf(stderr, "gamutthingy: %s: Only 8 bits per channel (maxval 255) is supported\n", name);
+        return false;
+    }
+    size_t pixelbytes = (size_t)width * height * bytesperpixel;
+    if ((pos > length) || ((length - pos) < pixelbytes)){
+        fprintf(stderr, "gamutthingy: %s: File is truncated\n", name);
+        return false;
+    }
+    pixels = &base[pos];
+    return true;
+}
+
+bool mappedimage::CreateOutput(const char* filename, int imageformat, int imagewidth, int imageheight, int imagebytesperpixel){
+    name = filename;
+    output = true;
+    format = imageformat;
+    width = imagewidth;
+    height = imageheight;
+    bytesperpixel = imagebytesperpixel;
+
+    char header[256];
+    int headerlength = 0;
+    if (format == IMAGE_FORMAT_PPM){
+        headerlength = snprintf(header, sizeof(header), "P6\n%i %i\n255\n", width, height);
+    }
+    else if (format == IMAGE_FORMAT_PAM){
+        headerlength = snprintf(header, sizeof(header), "P7\nWIDTH %i\nHEIGHT %i\nDEPTH %i\nMAXVAL 255\nTUPLTYPE %s\nENDHDR\n", width, height, bytesperpixel, (bytesperpixel == 4) ? "RGB_ALPHA" : "RGB");
+    }
+    length = headerlength + ((size_t)width * height * bytesperpixel);
+
+#if IMAGEFILE_MMAP
+    // The output is mapped under a temporary name and renamed into place by Close(),
+    // so converting a file onto itself doesn't truncate the input while it's still mapped,
+    // and a failed conversion doesn't leave a partial file behind.
+    tempname = std::string(filename) + ".tmp." + std::to_string((long)getpid());
+    complete = false;
+    fd = open(tempname.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", tempname.c_str(), strerror(errno));
+        tempname.clear();
+        return false;
+    }
+    if (ftruncate(fd, length) != 0){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+        Close();
+        return false;
+    }
+    void* mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+        Close();
+        return false;
+    }
+    base = (unsigned char*)mapping;
+#else
+    base = (unsigned char*) malloc(length);  //c++ wants an explict cast
+    if (base == NULL){
+        fprintf(stderr, "gamutthingy: out of memory: %lu bytes\n", (unsigned long)length);
+        return false;
+    }
+#endif
+    memcpy(base, header, headerlength);
+    pixels = &base[headerlength];
+    return true;
+}
+
+void mappedimage::MarkComplete(){
+    complete = output && (base != NULL);
+    return;
+}
+
+bool mappedimage::Close(){
+    bool ok = true;
+#if IMAGEFILE_MMAP
+    if (base != NULL){
+        if (munmap(base, length) != 0){
+            ok = false;
+        }
+    }
+    if (fd >= 0){
+        if (close(fd) != 0){
+            ok = false;
+        }
+    }
+    if (!tempname.empty()){
+        if (ok && complete){
+            if (rename(tempname.c_str(), name) != 0){
+                ok = false;
+            }
+        }
+        else {
+            unlink(tempname.c_str());
+        }
+    }
+#else
+    if (output && complete && (base != NULL)){
+        FILE* file = fopen(name, "wb");
+        if ((file == NULL) || (fwrite(base, 1, length, file) != length)){
+            ok = false;
+        }
+        if ((file != NULL) && (fclose(file) != 0)){
+            ok = false;
+        }
+    }
+    free(base);
+#endif
+    if (!ok){
+        fprintf(stderr, "gamutthingy: %s%s: %s\n", output ? "write " : "", name, strerror(errno));
+    }
+    base = NULL;
+    pixels = NULL;
+    length = 0;
+    fd = -1;
+    tempname.clear();
+    complete = false;
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef IMAGEFILE_H
+#define IMAGEFILE_H
+
+#include "constants.h"
+
+#include <stddef.h>
+#include <string>
+#include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
+
+// Netpbm (PPM/PAM) and headerless raw RGB24/RGBA image files.
+// These are uncompressed, so the pixels can be used right where they sit in a memory-mapped file:
+// input files are mapped read-only and converted directly from the mapping,
+// and output files are created at their final size (under a temporary name until closed), mapped, and converted directly into.
+// An output that's closed without MarkComplete() (e.g., after an error) never replaces the file of that name.
+// (On Windows, where there's no mmap(), the file is read into or written from an ordinary buffer instead.)
+// Only 8 bits per channel (PPM/PAM maxval 255) is supported.
+// All functions print an error and return false on failure. Close() is safe to call at any time.
+
+// picks an IMAGE_FORMAT_* from the file extension (.ppm/.pnm, .pam, .rgb/.raw, .rgba), or IMAGE_FORMAT_PNG for anything else
+int ImageFormatFromFilename(const char* filename);
+// bytes per pixel for raw formats; 3 for PPM; 0 for PAM (which is either) or PNG
+int ImageFormatBytesPerPixel(int format);
+
+class mappedimage{
+public:
+    int format = IMAGE_FORMAT_PPM;
+    int width = 0;
+    int height = 0;
+    int bytesperpixel = 3;
+    // first byte of the first pixel; rows are width * bytesperpixel bytes with no padding
+    png_bytep pixels = NULL;
+
+    // maps an existing file; rawwidth is only used for raw formats (the height is inferred from the file size)
+    bool OpenInput(const char* filename, int imageformat, int rawwidth);
+    // creates (or replaces) a file with room for the whole image and maps it
+    bool CreateOutput(const char* filename, int imageformat, int imagewidth, int imageheight, int imagebytesperpixel);
+    // call once the output's pixels have all been written, so that Close() keeps it
+    void MarkComplete();
+    // unmaps the file; output is finished and renamed into place if MarkComplete() was called, and thrown away if not
+    bool Close();
+
+private:
+    const char* name = NULL;
+    bool output = false;
+    unsigned char* base = NULL; // start of the mapping (or buffer)
+    size_t length = 0;
+    int fd = -1;
+    std::string tempname; // output is written here and renamed to name when closed (mmap only)
+    bool complete = false; // see MarkComplete()
+
+    // parses the PPM or PAM header at the start of the mapping, and points pixels past it
+    bool ParseHeader();
+};
+
+#endif
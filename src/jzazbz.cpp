@@ -1,9 +1,15 @@
 #include "jzazbz.h"
 
 #include <math.h>
+#include <stdio.h>
+#include <cstdint>
+#include <cfloat>
+#include <cstring> //for memcpy
 #include "matrix.h"
+#include "constants.h"
+#include "octavetable.h"
+#include "cpudispatch.h"
 
-//#include <stdio.h>
 
 // we also need inverses of the constant matrices
 double InverseJzazbzLMSMatrix[3][3]; // gets initialized by initializeInverseMatrices()
@@ -18,18 +24,131 @@ bool initializeInverseMatrices(){
     return true;
 }
 
+int PQmode = PQ_EXACT;
+
 // PQ function & inverse
 double PQ(double input){
+    if (PQmode == PQ_FAST){
+        return PQFast(input);
+    }
+    return PQExact(input);
+}
+double InversePQ(double input){
+    if (PQmode == PQ_FAST){
+        return InversePQFast(input);
+    }
+    return InversePQExact(input);
+}
+
+double PQExact(double input){
+    // pow() of a negative number to a fractional power is imaginary
+    if (input < 0.0){
+        return NAN;
+    }
     double XX = pow(input / 10000.0, Jzazbz_n);
     return pow((Jzazbz_c1 + Jzazbz_c2*XX) / (1.0 + Jzazbz_c3*XX), Jzazbz_p);
 }
 // Warning: The Inverse PQ function can return NAN.
-// Without doing a formal analysis and proof, I *assume* this is *always* the result of asking pow() to do something that leads to an imaginary or complex number, and *only* happens on inputs that fall outside any possible gamut.
-double InversePQ(double input){
+double InversePQExact(double input){
+    // pow() of a negative number to a fractional power is imaginary
+    if (input < 0.0){
+        return NAN;
+    }
     double XX = pow(input, 1.0 / Jzazbz_p);
+    // below PQ(0) the numerator goes negative (and the denominator is negative everywhere below c2/c3), so the base is negative and pow() is imaginary
+    // at or above c2/c3 the denominator goes to zero and then positive, which is nonsense
+    if ((XX < Jzazbz_c1) || (XX >= (Jzazbz_c2 / Jzazbz_c3))){
+        return NAN;
+    }
     return 10000.0 * pow((Jzazbz_c1 - XX) / ((Jzazbz_c3 * XX) - Jzazbz_c2) , 1.0 / Jzazbz_n);
 }
 
+// derivatives of the exact functions, for building the Hermite tables
+double PQDerivative(double input){
+    double XX = pow(input / 10000.0, Jzazbz_n);
+    double denominator = 1.0 + Jzazbz_c3*XX;
+    double base = (Jzazbz_c1 + Jzazbz_c2*XX) / denominator;
+    double dbasedXX = (Jzazbz_c2 - (Jzazbz_c1 * Jzazbz_c3)) / (denominator * denominator);
+    double dXXdinput = (Jzazbz_n * XX) / input;
+    return Jzazbz_p * pow(base, Jzazbz_p - 1.0) * dbasedXX * dXXdinput;
+}
+double InversePQDerivative(double input){
+    double XX = pow(input, 1.0 / Jzazbz_p);
+    double denominator = (Jzazbz_c3 * XX) - Jzazbz_c2;
+    double base = (Jzazbz_c1 - XX) / denominator;
+    double dbasedXX = (Jzazbz_c2 - (Jzazbz_c1 * Jzazbz_c3)) / (denominator * denominator);
+    double dXXdinput = XX / (Jzazbz_p * input);
+    return 10000.0 * (1.0 / Jzazbz_n) * pow(base, (1.0 / Jzazbz_n) - 1.0) * dbasedXX * dXXdinput;
+}
+
+double PQTableValue[PQ_TABLE_SIZE];
+double PQTableSlope[PQ_TABLE_SIZE];
+double InversePQTableValue[INVERSE_PQ_TABLE_SIZE];
+double InversePQTableSlope[INVERSE_PQ_TABLE_SIZE];
+double PQTableMaxError = 0.0;
+double InversePQTableMaxError = 0.0;
+
+bool initializePQTables(){
+    OctaveTableBuild(PQ_TABLE_MIN_EXPONENT, PQ_TABLE_MAX_EXPONENT, PQTableValue, PQTableSlope, PQExact, PQDerivative);
+    OctaveTableBuild(INVERSE_PQ_TABLE_MIN_EXPONENT, INVERSE_PQ_TABLE_MAX_EXPONENT, InversePQTableValue, InversePQTableSlope, InversePQExact, InversePQDerivative);
+    // measure the error at the midpoints between nodes (where it's largest) plus a few more spots
+    PQTableMaxError = 0.0;
+    for (int i=0; i<PQ_TABLE_SIZE - 1; i++){
+        double low = OctaveTableNode(i, PQ_TABLE_MIN_EXPONENT);
+        double high = OctaveTableNode(i + 1, PQ_TABLE_MIN_EXPONENT);
+        for (int j=1; j<4; j++){
+            double sample = low + ((high - low) * j * 0.25);
+            double exact = PQExact(sample);
+            double error = fabs(PQFast(sample) - exact) / exact;
+            if (!(error <= PQTableMaxError)){
+                PQTableMaxError = error;
+            }
+        }
+    }
+    InversePQTableMaxError = 0.0;
+    for (int i=0; i<INVERSE_PQ_TABLE_SIZE - 1; i++){
+        double low = OctaveTableNode(i, INVERSE_PQ_TABLE_MIN_EXPONENT);
+        double high = OctaveTableNode(i + 1, INVERSE_PQ_TABLE_MIN_EXPONENT);
+        for (int j=1; j<4; j++){
+            double sample = low + ((high - low) * j * 0.25);
+            double exact = InversePQExact(sample);
+            // relative error is meaningless right next to PQ(0), where the output is zero
+            if (exact < 1.0e-6){
+                continue;
+            }
+            double error = fabs(InversePQFast(sample) - exact) / exact;
+            if (!(error <= InversePQTableMaxError)){
+                InversePQTableMaxError = error;
+            }
+        }
+    }
+    // NaN would mean something is badly wrong with the tables
+    return !isnan(PQTableMaxError) && !isnan(InversePQTableMaxError);
+}
+
+double PQFast(double input){
+    if (OctaveTableInRange(input, PQ_TABLE_MIN_EXPONENT, PQ_TABLE_MAX_EXPONENT)){
+        return OctaveTableLookup(input, PQ_TABLE_MIN_EXPONENT, PQTableValue, PQTableSlope);
+    }
+    // this also takes care of negative input and NaN
+    return PQExact(input);
+}
+
+double InversePQFast(double input){
+    if (OctaveTableInRange(input, INVERSE_PQ_TABLE_MIN_EXPONENT, INVERSE_PQ_TABLE_MAX_EXPONENT)){
+        return OctaveTableLookup(input, INVERSE_PQ_TABLE_MIN_EXPONENT, InversePQTableValue, InversePQTableSlope);
+    }
+    // this also takes care of NaN and the domains where the inverse doesn't exist
+    return InversePQExact(input);
+}
+
+// prints the measured max relative error of the tables vs. the exact functions
+void PQTableErrorReport(){
+    printf("PQ table max relative error: %e (input 2^%i to 2^%i cd/m^2)\n", PQTableMaxError, PQ_TABLE_MIN_EXPONENT, PQ_TABLE_MAX_EXPONENT);
+    printf("Inverse PQ table max relative error: %e (input 2^%i to 2^%i)\n", InversePQTableMaxError, INVERSE_PQ_TABLE_MIN_EXPONENT, INVERSE_PQ_TABLE_MAX_EXPONENT);
+    return;
+}
+
 
 
 
@@ -82,3 +201,482 @@ vec3 JzazbzToXYZ(vec3 input){
     
     return output;
 }
+
+// Batch implementation ------------------------------------------------------------------------------------------------------------------------
+
+// The makefile targets baseline x86-64 (SSE2), which is only 2 doubles wide and can't vectorize the 64-bit integer tricks below,
+// so each batch function is compiled for each wider instruction set and picked at runtime (see cpudispatch.h).
+
+// bit casts that the compiler turns into plain register moves
+static inline uint64_t doubleBits(double input){
+    uint64_t output;
+    memcpy(&output, &input, sizeof(output));
+    return output;
+}
+static inline double bitsDouble(uint64_t input){
+    double output;
+    memcpy(&output, &input, sizeof(output));
+    return output;
+}
+
+// log2() for positive, normal input, accurate to about 1 ulp
+// Splits input into exponent and mantissa, moves the mantissa into [sqrt(0.5), sqrt(2)),
+// then uses the atanh series ln(m) = 2 * (s + s^3/3 + s^5/5 + ...) where s = (m-1)/(m+1).
+// |s| <= 0.1716, so 12 terms is enough to reach double precision.
+static inline double batchlog2(double input){
+    uint64_t bits = doubleBits(input);
+    uint64_t mantissabits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+    // halve the mantissa and bump the exponent if the mantissa is over sqrt(2)
+    bool big = (bitsDouble(mantissabits) > 1.4142135623730951);
+    mantissabits -= big ? 0x0010000000000000ULL : 0ULL;
+    double mantissa = bitsDouble(mantissabits);
+    // exponent to double without an int64 to double conversion (which doesn't vectorize without AVX-512DQ)
+    double exponent = bitsDouble(((bits >> 52) + (big ? 1ULL : 0ULL)) | 0x4330000000000000ULL) - 4503599627370496.0 - 1023.0;
+    double s = (mantissa - 1.0) / (mantissa + 1.0);
+    double s2 = s * s;
+    double series = 1.0/23.0;
+    series = (series * s2) + (1.0/21.0);
+    series = (series * s2) + (1.0/19.0);
+    series = (series * s2) + (1.0/17.0);
+    series = (series * s2) + (1.0/15.0);
+    series = (series * s2) + (1.0/13.0);
+    series = (series * s2) + (1.0/11.0);
+    series = (series * s2) + (1.0/9.0);
+    series = (series * s2) + (1.0/7.0);
+    series = (series * s2) + (1.0/5.0);
+    series = (series * s2) + (1.0/3.0);
+    series = (series * s2) + 1.0;
+    // 2 * log2(e)
+    return exponent + (s * series * 2.8853900817779268);
+}
+
+// exp2(), accurate to about 1 ulp (results below 2^-1022 flush to zero)
+// Splits input into a nearest integer n and a remainder f in [-0.5, 0.5],
+// evaluates e^(f*ln2) with a degree 14 Taylor polynomial, then scales by 2^n by building the exponent bits directly.
+static inline double batchexp2(double input){
+    // adding 1.5 * 2^52 rounds to nearest integer and leaves that integer in the low bits
+    double shifted = input + 6755399441055744.0;
+    double rounded = shifted - 6755399441055744.0;
+    // 2^n, built directly from the low bits of shifted, then clamped to zero or infinity if n is out of range
+    uint64_t scalebits = (doubleBits(shifted) - 0x4338000000000000ULL + 1023ULL) << 52;
+    scalebits = (rounded < -1022.0) ? 0ULL : scalebits;
+    scalebits = (rounded > 1023.0) ? 0x7FF0000000000000ULL : scalebits;
+    double g = (input - rounded) * 0.69314718055994531;
+    double poly = 1.0/87178291200.0;
+    poly = (poly * g) + (1.0/6227020800.0);
+    poly = (poly * g) + (1.0/479001600.0);
+    poly = (poly * g) + (1.0/39916800.0);
+    poly = (poly * g) + (1.0/3628800.0);
+    poly = (poly * g) + (1.0/362880.0);
+    poly = (poly * g) + (1.0/40320.0);
+    poly = (poly * g) + (1.0/5040.0);
+    poly = (poly * g) + (1.0/720.0);
+    poly = (poly * g) + (1.0/120.0);
+    poly = (poly * g) + (1.0/24.0);
+    poly = (poly * g) + (1.0/6.0);
+    poly = (poly * g) + 0.5;
+    poly = (poly * g) + 1.0;
+    poly = (poly * g) + 1.0;
+    return poly * bitsDouble(scalebits);
+}
+
+// pow() for the non-integer exponents used by PQ
+// zero (and subnormal) input gives zero; negative or NaN input gives NaN, same as pow() does for non-integer exponents
+static inline double batchpow(double input, double exponent){
+    double output = batchexp2(exponent * batchlog2(input));
+    output = (input < DBL_MIN) ? 0.0 : output;
+    output = (input >= 0.0) ? output : NAN; // written this way to catch NaN input too
+    return output;
+}
+
+static CPU_ALWAYS_INLINE void XYZtoJzazbzBatchBody(const double* X, const double* Y, const double* Z, double* Jz, double* az, double* bz, int count){
+    
+    double L[JZAZBZ_BATCH_LANES];
+    double M[JZAZBZ_BATCH_LANES];
+    double S[JZAZBZ_BATCH_LANES];
+    
+    for (int first = 0; first < count; first += JZAZBZ_BATCH_LANES){
+        int lanes = count - first;
+        if (lanes > JZAZBZ_BATCH_LANES){
+            lanes = JZAZBZ_BATCH_LANES;
+        }
+        
+        // load the block (padding a partial block with black, which is harmless)
+        double Xp[JZAZBZ_BATCH_LANES];
+        double Yp[JZAZBZ_BATCH_LANES];
+        double Zp[JZAZBZ_BATCH_LANES];
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            bool valid = (i < lanes);
+            Xp[i] = valid ? X[first + i] : 0.0;
+            Yp[i] = valid ? Y[first + i] : 0.0;
+            Zp[i] = valid ? Z[first + i] : 0.0;
+        }
+        
+        // XYZ to XYZ' to LMS
+        bool outofbounds[JZAZBZ_BATCH_LANES];
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            double XD65 = Xp[i] * Jzazbz_peak_lum;
+            double YD65 = Yp[i] * Jzazbz_peak_lum;
+            double ZD65 = Zp[i] * Jzazbz_peak_lum;
+            double Xprime = (Jzazbz_b * XD65) - ((Jzazbz_b - 1.0) * ZD65);
+            double Yprime = (Jzazbz_g * YD65) - ((Jzazbz_g - 1.0) * XD65);
+            double Zprime = ZD65;
+            L[i] = (JzazbzLMSMatrix[0][0] * Xprime) + (JzazbzLMSMatrix[0][1] * Yprime) + (JzazbzLMSMatrix[0][2] * Zprime);
+            M[i] = (JzazbzLMSMatrix[1][0] * Xprime) + (JzazbzLMSMatrix[1][1] * Yprime) + (JzazbzLMSMatrix[1][2] * Zprime);
+            S[i] = (JzazbzLMSMatrix[2][0] * Xprime) + (JzazbzLMSMatrix[2][1] * Yprime) + (JzazbzLMSMatrix[2][2] * Zprime);
+            // same bypass as XYZtoJzazbz()
+            outofbounds[i] = ((L[i] < 0.0) || (M[i] < 0.0) || (S[i] < 0.0));
+        }
+        
+        // PQ
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            double XX = batchpow(L[i] / 10000.0, Jzazbz_n);
+            L[i] = batchpow((Jzazbz_c1 + Jzazbz_c2*XX) / (1.0 + Jzazbz_c3*XX), Jzazbz_p);
+            XX = batchpow(M[i] / 10000.0, Jzazbz_n);
+            M[i] = batchpow((Jzazbz_c1 + Jzazbz_c2*XX) / (1.0 + Jzazbz_c3*XX), Jzazbz_p);
+            XX = batchpow(S[i] / 10000.0, Jzazbz_n);
+            S[i] = batchpow((Jzazbz_c1 + Jzazbz_c2*XX) / (1.0 + Jzazbz_c3*XX), Jzazbz_p);
+        }
+        
+        // L'M'S' to Izazbz to Jzazbz
+        double Jzp[JZAZBZ_BATCH_LANES];
+        double azp[JZAZBZ_BATCH_LANES];
+        double bzp[JZAZBZ_BATCH_LANES];
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            double Iz = (JzazbzIabMatrix[0][0] * L[i]) + (JzazbzIabMatrix[0][1] * M[i]) + (JzazbzIabMatrix[0][2] * S[i]);
+            double a = (JzazbzIabMatrix[1][0] * L[i]) + (JzazbzIabMatrix[1][1] * M[i]) + (JzazbzIabMatrix[1][2] * S[i]);
+            double b = (JzazbzIabMatrix[2][0] * L[i]) + (JzazbzIabMatrix[2][1] * M[i]) + (JzazbzIabMatrix[2][2] * S[i]);
+            double J = (((1.0 + Jzazbz_d) * Iz) / (1.0 + (Jzazbz_d * Iz))) - Jzazbz_d0;
+            Jzp[i] = outofbounds[i] ? 0.0 : J;
+            azp[i] = outofbounds[i] ? 0.0 : a;
+            bzp[i] = outofbounds[i] ? 0.0 : b;
+        }
+        
+        // store
+        for (int i=0; i<lanes; i++){
+            Jz[first + i] = Jzp[i];
+            az[first + i] = azp[i];
+            bz[first + i] = bzp[i];
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, XYZtoJzazbzBatch, (const double* X, const double* Y, const double* Z, double* Jz, double* az, double* bz, int count), (X, Y, Z, Jz, az, bz, count))
+
+static CPU_ALWAYS_INLINE void JzazbzToXYZBatchBody(const double* Jz, const double* az, const double* bz, double* X, double* Y, double* Z, int count){
+    
+    double L[JZAZBZ_BATCH_LANES];
+    double M[JZAZBZ_BATCH_LANES];
+    double S[JZAZBZ_BATCH_LANES];
+    
+    for (int first = 0; first < count; first += JZAZBZ_BATCH_LANES){
+        int lanes = count - first;
+        if (lanes > JZAZBZ_BATCH_LANES){
+            lanes = JZAZBZ_BATCH_LANES;
+        }
+        
+        // load the block (padding a partial block with black, which is harmless)
+        double Jzp[JZAZBZ_BATCH_LANES];
+        double azp[JZAZBZ_BATCH_LANES];
+        double bzp[JZAZBZ_BATCH_LANES];
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            bool valid = (i < lanes);
+            Jzp[i] = valid ? Jz[first + i] : 0.0;
+            azp[i] = valid ? az[first + i] : 0.0;
+            bzp[i] = valid ? bz[first + i] : 0.0;
+        }
+        
+        // Jzazbz to Izazbz to L'M'S'
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            double tempIz = Jzp[i] + Jzazbz_d0;
+            double Iz = (tempIz) / (1.0 + Jzazbz_d - (Jzazbz_d * tempIz));
+            L[i] = (InverseJzazbzIabMatrix[0][0] * Iz) + (InverseJzazbzIabMatrix[0][1] * azp[i]) + (InverseJzazbzIabMatrix[0][2] * bzp[i]);
+            M[i] = (InverseJzazbzIabMatrix[1][0] * Iz) + (InverseJzazbzIabMatrix[1][1] * azp[i]) + (InverseJzazbzIabMatrix[1][2] * bzp[i]);
+            S[i] = (InverseJzazbzIabMatrix[2][0] * Iz) + (InverseJzazbzIabMatrix[2][1] * azp[i]) + (InverseJzazbzIabMatrix[2][2] * bzp[i]);
+        }
+        
+        // inverse PQ
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            double XX = batchpow(L[i], 1.0 / Jzazbz_p);
+            L[i] = 10000.0 * batchpow((Jzazbz_c1 - XX) / ((Jzazbz_c3 * XX) - Jzazbz_c2) , 1.0 / Jzazbz_n);
+            XX = batchpow(M[i], 1.0 / Jzazbz_p);
+            M[i] = 10000.0 * batchpow((Jzazbz_c1 - XX) / ((Jzazbz_c3 * XX) - Jzazbz_c2) , 1.0 / Jzazbz_n);
+            XX = batchpow(S[i], 1.0 / Jzazbz_p);
+            S[i] = 10000.0 * batchpow((Jzazbz_c1 - XX) / ((Jzazbz_c3 * XX) - Jzazbz_c2) , 1.0 / Jzazbz_n);
+        }
+        
+        // LMS to XYZ' to XYZ
+        double Xp[JZAZBZ_BATCH_LANES];
+        double Yp[JZAZBZ_BATCH_LANES];
+        double Zp[JZAZBZ_BATCH_LANES];
+        for (int i=0; i<JZAZBZ_BATCH_LANES; i++){
+            double Xprime = (InverseJzazbzLMSMatrix[0][0] * L[i]) + (InverseJzazbzLMSMatrix[0][1] * M[i]) + (InverseJzazbzLMSMatrix[0][2] * S[i]);
+            double Yprime = (InverseJzazbzLMSMatrix[1][0] * L[i]) + (InverseJzazbzLMSMatrix[1][1] * M[i]) + (InverseJzazbzLMSMatrix[1][2] * S[i]);
+            double Zprime = (InverseJzazbzLMSMatrix[2][0] * L[i]) + (InverseJzazbzLMSMatrix[2][1] * M[i]) + (InverseJzazbzLMSMatrix[2][2] * S[i]);
+            double x = (Xprime + ((Jzazbz_b - 1.0) * Zprime)) / Jzazbz_b;
+            double y = (Yprime + ((Jzazbz_g - 1.0) * x)) / Jzazbz_g; // note that the X term is from the line above, not from XYZprime
+            Xp[i] = x / Jzazbz_peak_lum;
+            Yp[i] = y / Jzazbz_peak_lum;
+            Zp[i] = Zprime / Jzazbz_peak_lum;
+        }
+        
+        // store
+        for (int i=0; i<lanes; i++){
+            X[first + i] = Xp[i];
+            Y[first + i] = Yp[i];
+            Z[first + i] = Zp[i];
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, JzazbzToXYZBatch, (const double* Jz, const double* az, const double* bz, double* X, double* Y, double* Z, int count), (Jz, az, bz, X, Y, Z, count))
+
+// Single precision batch implementation -------------------------------------------------------------------------------------------------------
+
+int Jzazbzprecision = PRECISION_DOUBLE;
+
+static inline uint32_t floatBits(float input){
+    uint32_t output;
+    memcpy(&output, &input, sizeof(output));
+    return output;
+}
+
+static inline float bitsFloat(uint32_t input){
+    float output;
+    memcpy(&output, &input, sizeof(output));
+    return output;
+}
+
+// single precision version of batchlog2(), accurate to about 1 ulp
+// |s| <= 0.1716, so 6 terms is enough to reach single precision.
+static inline float batchlog2f(float input){
+    uint32_t bits = floatBits(input);
+    uint32_t mantissabits = (bits & 0x007FFFFFU) | 0x3F800000U;
+    // halve the mantissa and bump the exponent if the mantissa is over sqrt(2)
+    bool big = (bitsFloat(mantissabits) > 1.41421356f);
+    mantissabits -= big ? 0x00800000U : 0U;
+    float mantissa = bitsFloat(mantissabits);
+    float exponent = (float)((int32_t)(bits >> 23) + (big ? 1 : 0) - 127);
+    float s = (mantissa - 1.0f) / (mantissa + 1.0f);
+    float s2 = s * s;
+    float series = 1.0f/11.0f;
+    series = (series * s2) + (1.0f/9.0f);
+    series = (series * s2) + (1.0f/7.0f);
+    series = (series * s2) + (1.0f/5.0f);
+    series = (series * s2) + (1.0f/3.0f);
+    series = (series * s2) + 1.0f;
+    // 2 * log2(e)
+    return exponent + (s * series * 2.88539008f);
+}
+
+// single precision version of batchexp2(), accurate to about 1 ulp (results below 2^-126 flush to zero)
+// degree 7 Taylor polynomial
+static inline float batchexp2f(float input){
+    // adding 1.5 * 2^23 rounds to nearest integer and leaves that integer in the low bits
+    float shifted = input + 12582912.0f;
+    float rounded = shifted - 12582912.0f;
+    // 2^n, built directly from the low bits of shifted, then clamped to zero or infinity if n is out of range
+    uint32_t scalebits = (floatBits(shifted) - 0x4B400000U + 127U) << 23;
+    scalebits = (rounded < -126.0f) ? 0U : scalebits;
+    scalebits = (rounded > 127.0f) ? 0x7F800000U : scalebits;
+    float g = (input - rounded) * 0.693147181f;
+    float poly = 1.0f/5040.0f;
+    poly = (poly * g) + (1.0f/720.0f);
+    poly = (poly * g) + (1.0f/120.0f);
+    poly = (poly * g) + (1.0f/24.0f);
+    poly = (poly * g) + (1.0f/6.0f);
+    poly = (poly * g) + 0.5f;
+    poly = (poly * g) + 1.0f;
+    poly = (poly * g) + 1.0f;
+    return poly * bitsFloat(scalebits);
+}
+
+// single precision version of batchpow()
+static inline float batchpowf(float input, float exponent){
+    float output = batchexp2f(exponent * batchlog2f(input));
+    output = (input < FLT_MIN) ? 0.0f : output;
+    output = (input >= 0.0f) ? output : NAN; // written this way to catch NaN input too
+    return output;
+}
+
+static CPU_ALWAYS_INLINE void XYZtoJzazbzBatchFloatBody(const double* X, const double* Y, const double* Z, double* Jz, double* az, double* bz, int count){
+
+    // single precision copies of the constants
+    float lms[3][3];
+    float iab[3][3];
+    for (int i=0; i<3; i++){
+        for (int j=0; j<3; j++){
+            lms[i][j] = (float)JzazbzLMSMatrix[i][j];
+            iab[i][j] = (float)JzazbzIabMatrix[i][j];
+        }
+    }
+    const float b = (float)Jzazbz_b;
+    const float g = (float)Jzazbz_g;
+    const float c1 = (float)Jzazbz_c1;
+    const float c2 = (float)Jzazbz_c2;
+    const float c3 = (float)Jzazbz_c3;
+    const float n = (float)Jzazbz_n;
+    const float p = (float)Jzazbz_p;
+    const float d = (float)Jzazbz_d;
+    const float d0 = (float)Jzazbz_d0;
+    const float peak = (float)Jzazbz_peak_lum;
+
+    float L[JZAZBZ_BATCH_LANES_FLOAT];
+    float M[JZAZBZ_BATCH_LANES_FLOAT];
+    float S[JZAZBZ_BATCH_LANES_FLOAT];
+
+    for (int first = 0; first < count; first += JZAZBZ_BATCH_LANES_FLOAT){
+        int lanes = count - first;
+        if (lanes > JZAZBZ_BATCH_LANES_FLOAT){
+            lanes = JZAZBZ_BATCH_LANES_FLOAT;
+        }
+
+        // load the block (padding a partial block with black, which is harmless)
+        float Xp[JZAZBZ_BATCH_LANES_FLOAT];
+        float Yp[JZAZBZ_BATCH_LANES_FLOAT];
+        float Zp[JZAZBZ_BATCH_LANES_FLOAT];
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            bool valid = (i < lanes);
+            Xp[i] = valid ? (float)X[first + i] : 0.0f;
+            Yp[i] = valid ? (float)Y[first + i] : 0.0f;
+            Zp[i] = valid ? (float)Z[first + i] : 0.0f;
+        }
+
+        // XYZ to XYZ' to LMS
+        bool outofbounds[JZAZBZ_BATCH_LANES_FLOAT];
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            float XD65 = Xp[i] * peak;
+            float YD65 = Yp[i] * peak;
+            float ZD65 = Zp[i] * peak;
+            float Xprime = (b * XD65) - ((b - 1.0f) * ZD65);
+            float Yprime = (g * YD65) - ((g - 1.0f) * XD65);
+            float Zprime = ZD65;
+            L[i] = (lms[0][0] * Xprime) + (lms[0][1] * Yprime) + (lms[0][2] * Zprime);
+            M[i] = (lms[1][0] * Xprime) + (lms[1][1] * Yprime) + (lms[1][2] * Zprime);
+            S[i] = (lms[2][0] * Xprime) + (lms[2][1] * Yprime) + (lms[2][2] * Zprime);
+            // same bypass as XYZtoJzazbz()
+            outofbounds[i] = ((L[i] < 0.0f) || (M[i] < 0.0f) || (S[i] < 0.0f));
+        }
+
+        // PQ
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            float XX = batchpowf(L[i] / 10000.0f, n);
+            L[i] = batchpowf((c1 + c2*XX) / (1.0f + c3*XX), p);
+            XX = batchpowf(M[i] / 10000.0f, n);
+            M[i] = batchpowf((c1 + c2*XX) / (1.0f + c3*XX), p);
+            XX = batchpowf(S[i] / 10000.0f, n);
+            S[i] = batchpowf((c1 + c2*XX) / (1.0f + c3*XX), p);
+        }
+
+        // L'M'S' to Izazbz to Jzazbz
+        float Jzp[JZAZBZ_BATCH_LANES_FLOAT];
+        float azp[JZAZBZ_BATCH_LANES_FLOAT];
+        float bzp[JZAZBZ_BATCH_LANES_FLOAT];
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            float Iz = (iab[0][0] * L[i]) + (iab[0][1] * M[i]) + (iab[0][2] * S[i]);
+            float a = (iab[1][0] * L[i]) + (iab[1][1] * M[i]) + (iab[1][2] * S[i]);
+            float bb = (iab[2][0] * L[i]) + (iab[2][1] * M[i]) + (iab[2][2] * S[i]);
+            float J = (((1.0f + d) * Iz) / (1.0f + (d * Iz))) - d0;
+            Jzp[i] = outofbounds[i] ? 0.0f : J;
+            azp[i] = outofbounds[i] ? 0.0f : a;
+            bzp[i] = outofbounds[i] ? 0.0f : bb;
+        }
+
+        // store
+        for (int i=0; i<lanes; i++){
+            Jz[first + i] = Jzp[i];
+            az[first + i] = azp[i];
+            bz[first + i] = bzp[i];
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, XYZtoJzazbzBatchFloat, (const double* X, const double* Y, const double* Z, double* Jz, double* az, double* bz, int count), (X, Y, Z, Jz, az, bz, count))
+
+static CPU_ALWAYS_INLINE void JzazbzToXYZBatchFloatBody(const double* Jz, const double* az, const double* bz, double* X, double* Y, double* Z, int count){
+
+    // single precision copies of the constants
+    float lms[3][3];
+    float iab[3][3];
+    for (int i=0; i<3; i++){
+        for (int j=0; j<3; j++){
+            lms[i][j] = (float)InverseJzazbzLMSMatrix[i][j];
+            iab[i][j] = (float)InverseJzazbzIabMatrix[i][j];
+        }
+    }
+    const float b = (float)Jzazbz_b;
+    const float g = (float)Jzazbz_g;
+    const float c1 = (float)Jzazbz_c1;
+    const float c2 = (float)Jzazbz_c2;
+    const float c3 = (float)Jzazbz_c3;
+    const float invn = (float)(1.0 / Jzazbz_n);
+    const float invp = (float)(1.0 / Jzazbz_p);
+    const float d = (float)Jzazbz_d;
+    const float d0 = (float)Jzazbz_d0;
+    const float peak = (float)Jzazbz_peak_lum;
+
+    float L[JZAZBZ_BATCH_LANES_FLOAT];
+    float M[JZAZBZ_BATCH_LANES_FLOAT];
+    float S[JZAZBZ_BATCH_LANES_FLOAT];
+
+    for (int first = 0; first < count; first += JZAZBZ_BATCH_LANES_FLOAT){
+        int lanes = count - first;
+        if (lanes > JZAZBZ_BATCH_LANES_FLOAT){
+            lanes = JZAZBZ_BATCH_LANES_FLOAT;
+        }
+
+        // load the block (padding a partial block with black, which is harmless)
+        float Jzp[JZAZBZ_BATCH_LANES_FLOAT];
+        float azp[JZAZBZ_BATCH_LANES_FLOAT];
+        float bzp[JZAZBZ_BATCH_LANES_FLOAT];
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            bool valid = (i < lanes);
+            Jzp[i] = valid ? (float)Jz[first + i] : 0.0f;
+            azp[i] = valid ? (float)az[first + i] : 0.0f;
+            bzp[i] = valid ? (float)bz[first + i] : 0.0f;
+        }
+
+        // Jzazbz to Izazbz to L'M'S'
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            float tempIz = Jzp[i] + d0;
+            float Iz = (tempIz) / (1.0f + d - (d * tempIz));
+            L[i] = (iab[0][0] * Iz) + (iab[0][1] * azp[i]) + (iab[0][2] * bzp[i]);
+            M[i] = (iab[1][0] * Iz) + (iab[1][1] * azp[i]) + (iab[1][2] * bzp[i]);
+            S[i] = (iab[2][0] * Iz) + (iab[2][1] * azp[i]) + (iab[2][2] * bzp[i]);
+        }
+
+        // inverse PQ
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            float XX = batchpowf(L[i], invp);
+            L[i] = 10000.0f * batchpowf((c1 - XX) / ((c3 * XX) - c2) , invn);
+            XX = batchpowf(M[i], invp);
+            M[i] = 10000.0f * batchpowf((c1 - XX) / ((c3 * XX) - c2) , invn);
+            XX = batchpowf(S[i], invp);
+            S[i] = 10000.0f * batchpowf((c1 - XX) / ((c3 * XX) - c2) , invn);
+        }
+
+        // LMS to XYZ' to XYZ
+        float Xp[JZAZBZ_BATCH_LANES_FLOAT];
+        float Yp[JZAZBZ_BATCH_LANES_FLOAT];
+        float Zp[JZAZBZ_BATCH_LANES_FLOAT];
+        for (int i=0; i<JZAZBZ_BATCH_LANES_FLOAT; i++){
+            float Xprime = (lms[0][0] * L[i]) + (lms[0][1] * M[i]) + (lms[0][2] * S[i]);
+            float Yprime = (lms[1][0] * L[i]) + (lms[1][1] * M[i]) + (lms[1][2] * S[i]);
+            float Zprime = (lms[2][0] * L[i]) + (lms[2][1] * M[i]) + (lms[2][2] * S[i]);
+            float x = (Xprime + ((b - 1.0f) * Zprime)) / b;
+            float y = (Yprime + ((g - 1.0f) * x)) / g; // note that the X term is from the line above, not from XYZprime
+            Xp[i] = x / peak;
+            Yp[i] = y / peak;
+            Zp[i] = Zprime / peak;
+        }
+
+        // store
+        for (int i=0; i<lanes; i++){
+            X[first + i] = Xp[i];
+            Y[first + i] = Yp[i];
+            Z[first + i] = Zp[i];
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, JzazbzToXYZBatchFloat, (const double* Jz, const double* az, const double* bz, double* X, double* Y, double* Z, int count), (Jz, az, bz, X, Y, Z, count))
@@ -2,6 +2,7 @@
 #define JZAZBZ_H
 
 #include "vec3.h"
+#include "octavetable.h"
 
 // Jzazbz Implementation------------------------------------------------------------------------------------------------------------------------
 // The academic paper:  https://opg.optica.org/oe/fulltext.cfm?uri=oe-25-13-15131&id=368272
@@ -28,10 +29,34 @@
 #define Jzazbz_peak_lum 200.0
 
 // PQ function & inverse
+// These dispatch to the exact or fast versions below according to PQmode (PQ_EXACT or PQ_FAST).
 double PQ(double input);
 double InversePQ(double input);
 // Warning: The Inverse PQ function can return NAN.
 // Without doing a formal analysis and proof, I *assume* this is *always* the result of asking pow() to do something that leads to an imaginary or complex number, and *only* happens on inputs that fall outside any possible gamut.
+// The domains are now checked explicitly rather than waiting for pow() to fail:
+//  - PQ() returns NAN for negative input.
+//  - InversePQ() returns NAN for input below PQ(0) (darker than black) and for input at or above (c2/c3)^p (about 3.27) where the denominator goes to zero.
+extern int PQmode;
+double PQExact(double input);
+double InversePQExact(double input);
+
+// Table-driven PQ & inverse
+// These are octave tables (see octavetable.h): cubic Hermite interpolation with OCTAVE_TABLE_CELLS_PER_OCTAVE cells per octave.
+// Inputs outside the table range (extremely dark colors, or colors far outside any possible gamut) fall back to the exact functions.
+// Max relative error vs. the exact functions over the table range is about 2e-10 for PQ and 1.3e-8 for the inverse (worst near 10000 cd/m^2);
+// initializePQTables() measures it and PQTableErrorReport() prints it.
+#define PQ_TABLE_MIN_EXPONENT -30 // PQ input (cd/m^2) below 2^-30 uses the exact function
+#define PQ_TABLE_MAX_EXPONENT 16 // PQ input (cd/m^2) at or above 2^16 uses the exact function
+#define INVERSE_PQ_TABLE_MIN_EXPONENT -30 // InversePQ input below 2^-30 (less than 1e-9 cd/m^2 output) uses the exact function
+#define INVERSE_PQ_TABLE_MAX_EXPONENT 0 // InversePQ input at or above 1 (10000 cd/m^2 output) uses the exact function (it blows up approaching (c2/c3)^p, so cubics fit poorly)
+#define PQ_TABLE_SIZE OCTAVE_TABLE_SIZE(PQ_TABLE_MIN_EXPONENT, PQ_TABLE_MAX_EXPONENT)
+#define INVERSE_PQ_TABLE_SIZE OCTAVE_TABLE_SIZE(INVERSE_PQ_TABLE_MIN_EXPONENT, INVERSE_PQ_TABLE_MAX_EXPONENT)
+bool initializePQTables();
+double PQFast(double input);
+double InversePQFast(double input);
+// prints the measured max relative error of the tables vs. the exact functions
+void PQTableErrorReport();
 
 // Constant matrices from the paper
 const double JzazbzLMSMatrix[3][3]{
@@ -52,5 +77,33 @@ bool initializeInverseMatrices();
 vec3 XYZtoJzazbz(vec3 input);
 vec3 JzazbzToXYZ(vec3 input);
 
+// Batch conversions for count colors in structure-of-arrays layout (one array per channel).
+// Work is done in blocks of JZAZBZ_BATCH_LANES colors, with every step written as a straight-line loop over the block
+// and pow() replaced by a branch-free exp2/log2 pair, so the compiler can vectorize the whole thing.
+// Output arrays may be the same as the input arrays (in-place conversion).
+// Accuracy vs. the scalar functions above, measured over all 256^3 8-bit sRGB colors (linearized, converted to XYZ, then forward and back):
+//  - XYZtoJzazbzBatch(): max relative difference 7e-14 in Jz; max absolute difference 1.2e-13 in az/bz
+//  - JzazbzToXYZBatch(): max relative difference 1.8e-13 in Y; max absolute difference 9.4e-14 in XYZ
+// (The error is dominated by PQ's large exponent amplifying the last bit of log2(), and is far below anything that matters for 8- or 16-bit output.)
+// Speed on the same data with AVX-512: about 4x the scalar functions in both directions.
+// Out-of-domain inputs behave like the scalar functions: negative LMS on the forward path yields 0,0,0, and inputs that make
+// the scalar inverse PQ return NaN also yield NaN here.
+#define JZAZBZ_BATCH_LANES 8
+void XYZtoJzazbzBatch(const double* X, const double* Y, const double* Z, double* Jz, double* az, double* bz, int count);
+void JzazbzToXYZBatch(const double* Jz, const double* az, const double* bz, double* X, double* Y, double* Z, int count);
+
+// Single precision versions of the batch conversions.
+// Same interface (the buffers stay double; each block is converted to float on load and back on store), but all the math is float,
+// so twice as many colors fit in each vector register.
+// Used by the span conversions in gamutbounds.cpp when Jzazbzprecision is PRECISION_FLOAT (--precision float).
+// The error is dominated by PQ's large exponents amplifying float rounding. Measured the same way as above (on a 63^3 subset):
+//  - XYZtoJzazbzBatchFloat(): max relative difference 1.9e-5 in Jz; max absolute difference 3.6e-5 in az/bz
+//  - JzazbzToXYZBatchFloat(): max relative difference 5.5e-5 in Y
+// That is enough to flip some RGB8 roundings; use --precision-report to measure the effect on RGB8 output.
+#define JZAZBZ_BATCH_LANES_FLOAT 16
+extern int Jzazbzprecision;
+void XYZtoJzazbzBatchFloat(const double* X, const double* Y, const double* Z, double* Jz, double* az, double* bz, int count);
+void JzazbzToXYZBatchFloat(const double* Jz, const double* az, const double* bz, double* X, double* Y, double* Z, int count);
+
 
 #endif
@@ -0,0 +1,656 @@
+#include "lutapply.h"
+#include "colormisc.h"
+#include "cpudispatch.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <errno.h>
+#include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
+
+double postgammaunlimitedscale(crtdescriptor* crt, int lutsize, bool crtdoclamphigh, double crtclamphigh, double crtgammaknob, double &lpguscalereciprocal){
+    double lpguscale = 1.0;
+    lpguscalereciprocal = 1.0;
+    // we need to temporarily set the CRT to super black mode
+    bool oldsuperblackmode = crt->superblacks;
+    crt->superblacks = true;
+    // if we're clamping, then we can compute the ceiling
+    if (crtdoclamphigh){
+        if (crtclamphigh > 1.0){
+            lpguscale = crtclamphigh;
+            if (crtgammaknob != 1.0){
+                lpguscale = pow(lpguscale, crtgammaknob);
+            }
+            lpguscale = crt->tolinear1886appx1(lpguscale);
+        }
+    }
+    // otherwise we must guess and check to find the max output value.
+    else {
+        double lpgumax = 0.0;
+        // iterate over the primary and secondary colors
+        for (int guessr=0; guessr<=1; guessr++){
+            for (int guessg=0; guessg<=1; guessg++){
+                for (int guessb=0; guessb<=1; guessb++){
+                    if (guessr + guessg + guessb == 0){
+                        continue; // skip black
+                    }
+                    vec3 guess = vec3(double(guessr), double(guessg), double(guessb));
+                    vec3 guessresult = crt->CRTEmulateGammaSpaceRGBtoLinearRGB(guess);
+                    if (guessresult.x > lpgumax){
+                        lpgumax = guessresult.x;
+                    }
+                    if (guessresult.y > lpgumax){
+                        lpgumax = guessresult.y;
+                    }
+                    if (guessresult.z > lpgumax){
+                        lpgumax = guessresult.z;
+                    }
+                }
+            }
+        }
+        lpguscale = lpgumax;
+    }
+    //printf("lpguscale is %f!\n", lpguscale);
+    // since there's no way to interpolate white from its neighbors,
+    // we need to make sure that white gets its own entry in the LUT
+    // so we'll increase the scale to hit a good factor to make that happen
+    // we want the reciprocal to be a concise rational number
+    if (lpguscale > 1.0){
+        bool happy = false;
+        for (int divisor = lutsize - 1; divisor > 0; divisor--){
+            // keep trying until we hit a bigger factor than what we have
+            double scalefactor = ((double)lutsize) / ((double)divisor);
+            if (scalefactor < lpguscale){
+                continue;
+            }
+            // compute greatest common factor
+            int gcf = std::gcd(lutsize, divisor);
+            // at least 2?
+            if (gcf < 2){
+                continue;
+            }
+            happy = true;
+            lpguscale = scalefactor;
+            lpguscalereciprocal = ((double)divisor) / ((double)lutsize);
+            //printf("lpguscale increased to %f!\n", lpguscale);
+            break;
+        }
+        if (!happy){
+            printf("WARNING: Could not find a good scaling factor to ensure white has its own entry in the LUT.\n");
+        }
+    }
+    // set the CRT superblack setting back to what it was
+    crt->superblacks = oldsuperblackmode;
+    return lpguscale;
+}
+
+// inverse of the output gamma function, exact
+static double outputtolinear(double input, int gammamodeout, double gammapowout, double hdrsdrmaxnits){
+    switch (gammamodeout){
+        case GAMMA_SRGB:
+            return tolinear(input);
+        case GAMMA_REC2084:
+            return rec2084tolinear(input, hdrsdrmaxnits);
+        case GAMMA_POWER:
+            return pow(input, gammapowout);
+        default:
+            break;
+    }
+    return input;
+}
+
+bool appliedlut::Load(const char* filename, int lutmode_in, int interpolation_in, int gammamodeout, double gammapowout, double hdrsdrmaxnits, bool linearize_in, crtdescriptor* crt_in, double crtclamplow_in, double crtclamphigh_in, bool crtdoclamphigh, double crtgammaknob){
+    lutmode = lutmode_in;
+    interpolation = interpolation_in;
+    linearize = linearize_in && (gammamodeout != GAMMA_LINEAR);
+    // PreLUT() runs on every worker thread, so it gets a private copy of the CRT that it never has to modify
+    crt = NULL;
+    if (crt_in != NULL){
+        ownedcrt = *crt_in;
+        // the LUTMODE_POSTGAMMA_UNLIMITED indices include the super black range
+        if (lutmode == LUTMODE_POSTGAMMA_UNLIMITED){
+            ownedcrt.superblacks = true;
+        }
+        crt = &ownedcrt;
+    }
+    crtclamplow = crtclamplow_in;
+    crtclamphigh = crtclamphigh_in;
+
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, filename)){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, image.message);
+        return false;
+    }
+    lutsize = image.height;
+    if ((lutsize < 2) || (image.width != (png_uint_32)(lutsize * lutsize))){
+        fprintf(stderr, "gamutthingy: %s: Not a LUT (should be lutsize * lutsize wide and lutsize tall, but it's %u x %u)\n", filename, image.width, image.height);
+        png_image_free(&image);
+        return false;
+    }
+    image.format = PNG_FORMAT_RGB;
+    std::vector<png_byte> pixels(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, NULL, pixels.data(), 0, NULL)){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, image.message);
+        return false;
+    }
+
+    // the 256 possible entry values
+    float values[256];
+    for (int i=0; i<256; i++){
+        double value = i / 255.0;
+        if (linearize){
+            value = outputtolinear(value, gammamodeout, gammapowout, hdrsdrmaxnits);
+        }
+        values[i] = (float)value;
+    }
+    // png row is green, and x is (blue * lutsize) + red
+    bricks = (lutsize + LUT_BRICK_SIZE - 1) / LUT_BRICK_SIZE;
+    entries.assign((size_t)bricks * bricks * bricks * LUT_BRICK_ENTRIES * 3, 0.0f);
+    for (int green=0; green<lutsize; green++){
+        for (int blue=0; blue<lutsize; blue++){
+            for (int red=0; red<lutsize; red++){
+                png_bytep pixel = &pixels[((((size_t)green * lutsize * lutsize) + (blue * lutsize) + red) * 3)];
+                float* entry = &entries[EntryIndex(red, green, blue)];
+                entry[0] = values[pixel[0]];
+                entry[1] = values[pixel[1]];
+                entry[2] = values[pixel[2]];
+            }
+        }
+    }
+
+    if ((lutmode != LUTMODE_NORMAL) && (crt == NULL)){
+        fprintf(stderr, "gamutthingy: %s: This LUT mode needs CRT simulation (--crtemu front)\n", filename);
+        return false;
+    }
+    if (lutmode == LUTMODE_POSTGAMMA_UNLIMITED){
+        postgammaunlimitedscale(crt, lutsize, crtdoclamphigh, crtclamphigh, crtgammaknob, lpguscalereciprocal);
+    }
+    return true;
+}
+
+void appliedlut::Generate(conversionplan &plan, int lutsize_in, int maxthreads, int gammamodeout, double gammapowout, double hdrsdrmaxnits, bool linearize_in){
+    lutsize = lutsize_in;
+    lutmode = LUTMODE_NORMAL;
+    interpolation = LUT_INTERPOLATE_TETRAHEDRAL;
+    linearize = linearize_in && (gammamodeout != GAMMA_LINEAR);
+    crt = NULL;
+    bricks = (lutsize + LUT_BRICK_SIZE - 1) / LUT_BRICK_SIZE;
+    entries.assign((size_t)bricks * bricks * bricks * LUT_BRICK_ENTRIES * 3, 0.0f);
+
+    // each thread does every maxthreads-th blue plane, a row of red at a time
+    auto worker = [&](int threadno){
+        std::vector<double> red(lutsize);
+        std::vector<double> green(lutsize);
+        std::vector<double> blue(lutsize);
+        double top = lutsize - 1;
+        for (int b=threadno; b<lutsize; b+=maxthreads){
+            for (int g=0; g<lutsize; g++){
+                for (int r=0; r<lutsize; r++){
+                    red[r] = r / top;
+                    green[r] = g / top;
+                    blue[r] = b / top;
+                }
+                plan.ProcessSpan(red.data(), green.data(), blue.data(), lutsize);
+                for (int r=0; r<lutsize; r++){
+                    float* entry = &entries[EntryIndex(r, g, b)];
+                    entry[0] = (float)(linearize ? outputtolinear(red[r], gammamodeout, gammapowout, hdrsdrmaxnits) : red[r]);
+                    entry[1] = (float)(linearize ? outputtolinear(green[r], gammamodeout, gammapowout, hdrsdrmaxnits) : green[r]);
+                    entry[2] = (float)(linearize ? outputtolinear(blue[r], gammamodeout, gammapowout, hdrsdrmaxnits) : blue[r]);
+                }
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i=0; i<maxthreads; i++){
+        workers.push_back(std::thread(worker, i));
+    }
+    for (int i=0; i<maxthreads; i++){
+        workers[i].join();
+    }
+    return;
+}
+
+// bump this if the file layout or the meaning of the entries changes
+#define LUT_CACHE_MAGIC "GAMUTTHINGYLUT01"
+
+typedef struct lutcacheheader{
+    char magic[16];
+    uint64_t lutsize;
+    uint64_t linearize;
+    uint64_t keylength;
+} lutcacheheader;
+
+bool appliedlut::SaveGenerated(const std::string &filename, const std::string &key){
+    // written under a temporary name and renamed into place, so a half-written file is never read
+    std::random_device random;
+    std::string tempname = filename + ".tmp." + std::to_string(random());
+    FILE* file = fopen(tempname.c_str(), "wb");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: LUT cache %s: %s\n", tempname.c_str(), strerror(errno));
+        return false;
+    }
+    lutcacheheader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LUT_CACHE_MAGIC, sizeof(header.magic));
+    header.lutsize = lutsize;
+    header.linearize = linearize;
+    header.keylength = key.size();
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    ok = ok && (fwrite(key.data(), 1, key.size(), file) == key.size());
+    ok = ok && (fwrite(entries.data(), sizeof(float), entries.size(), file) == entries.size());
+    if (fclose(file) != 0){
+        ok = false;
+    }
+    if (ok && (rename(tempname.c_str(), filename.c_str()) != 0)){
+        ok = false;
+    }
+    if (!ok){
+        fprintf(stderr, "gamutthingy: LUT cache %s: %s\n", filename.c_str(), strerror(errno));
+        remove(tempname.c_str());
+    }
+    return ok;
+}
+
+bool appliedlut::LoadGenerated(const std::string &filename, const std::string &key, int lutsize_in, bool linearize_in){
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == NULL){
+        if (errno != ENOENT){
+            fprintf(stderr, "gamutthingy: LUT cache %s: %s\n", filename.c_str(), strerror(errno));
+        }
+        return false;
+    }
+    lutcacheheader header;
+    std::string filekey(key.size(), '\0');
+    bool ok = (fread(&header, sizeof(header), 1, file) == 1);
+    ok = ok && (memcmp(header.magic, LUT_CACHE_MAGIC, sizeof(header.magic)) == 0) && (header.lutsize == (uint64_t)lutsize_in) && (header.linearize == (uint64_t)linearize_in) && (header.keylength == key.size());
+    ok = ok && (fread(&filekey[0], 1, key.size(), file) == key.size()) && (filekey == key);
+    if (ok){
+        lutsize = lutsize_in;
+        lutmode = LUTMODE_NORMAL;
+        interpolation = LUT_INTERPOLATE_TETRAHEDRAL;
+        linearize = linearize_in;
+        crt = NULL;
+        bricks = (lutsize + LUT_BRICK_SIZE - 1) / LUT_BRICK_SIZE;
+        entries.resize((size_t)bricks * bricks * bricks * LUT_BRICK_ENTRIES * 3);
+        ok = (fread(entries.data(), sizeof(float), entries.size(), file) == entries.size());
+    }
+    fclose(file);
+    if (!ok){
+        fprintf(stderr, "gamutthingy: LUT cache %s: Doesn't match these settings\n", filename.c_str());
+        entries.clear();
+    }
+    return ok;
+}
+
+vec3 appliedlut::PreLUT(vec3 input){
+    vec3 output = input;
+    if (lutmode == LUTMODE_POSTCC){
+        output = crt->CRTEmulateGammaSpaceRGBtoPreEOTF(input);
+        double scaleby = 1.0 / (crtclamphigh - crtclamplow);
+        output.x = (output.x - crtclamplow) * scaleby;
+        output.y = (output.y - crtclamplow) * scaleby;
+        output.z = (output.z - crtclamplow) * scaleby;
+    }
+    else if (lutmode == LUTMODE_POSTGAMMA){
+        output = crt->CRTEmulateGammaSpaceRGBtoLinearRGB(input);
+    }
+    else if (lutmode == LUTMODE_POSTGAMMA_UNLIMITED){
+        // (crt is in super black mode, see Load())
+        output = crt->CRTEmulateGammaSpaceRGBtoLinearRGB(input) * lpguscalereciprocal;
+    }
+    return output;
+}
+
+// Entry offset of coordinate x along one axis, and the step from x to x + 1 (further when that crosses into the next brick).
+// The offset of an entry is the sum of the offsets for its three coordinates.
+static CPU_ALWAYS_INLINE int lutaxisoffset(int x, int brickstride, int innerstride){
+    return ((x >> LUT_BRICK_BITS) * brickstride) + ((x & LUT_BRICK_MASK) * innerstride);
+}
+
+static CPU_ALWAYS_INLINE int lutaxisstep(int x, int brickstride, int innerstride){
+    return ((x & LUT_BRICK_MASK) == LUT_BRICK_MASK) ? brickstride - (LUT_BRICK_MASK * innerstride) : innerstride;
+}
+
+size_t appliedlut::EntryIndex(int red, int green, int blue){
+    int offset = lutaxisoffset(red, LUT_BRICK_ENTRIES, 1) + lutaxisoffset(green, LUT_BRICK_ENTRIES * bricks, LUT_BRICK_SIZE) + lutaxisoffset(blue, LUT_BRICK_ENTRIES * bricks * bricks, LUT_BRICK_SIZE * LUT_BRICK_SIZE);
+    return (size_t)offset * 3;
+}
+
+vec3 appliedlut::Trilinear(vec3 coords){
+    int maxbase = lutsize - 2;
+    int r = (int)coords.x;
+    int g = (int)coords.y;
+    int b = (int)coords.z;
+    r = (r > maxbase) ? maxbase : r;
+    g = (g > maxbase) ? maxbase : g;
+    b = (b > maxbase) ? maxbase : b;
+    double fr = coords.x - r;
+    double fg = coords.y - g;
+    double fb = coords.z - b;
+    size_t rstep = lutaxisstep(r, LUT_BRICK_ENTRIES, 1) * 3;
+    size_t gstep = lutaxisstep(g, LUT_BRICK_ENTRIES * bricks, LUT_BRICK_SIZE) * 3;
+    size_t bstep = lutaxisstep(b, LUT_BRICK_ENTRIES * bricks * bricks, LUT_BRICK_SIZE * LUT_BRICK_SIZE) * 3;
+    const float* c000 = &entries[EntryIndex(r, g, b)];
+    double output[3];
+    for (int i=0; i<3; i++){
+        double c00 = c000[i] + (fr * (c000[rstep + i] - c000[i]));
+        double c10 = c000[gstep + i] + (fr * (c000[gstep + rstep + i] - c000[gstep + i]));
+        double c01 = c000[bstep + i] + (fr * (c000[bstep + rstep + i] - c000[bstep + i]));
+        double c11 = c000[bstep + gstep + i] + (fr * (c000[bstep + gstep + rstep + i] - c000[bstep + gstep + i]));
+        double c0 = c00 + (fg * (c10 - c00));
+        double c1 = c01 + (fg * (c11 - c01));
+        output[i] = c0 + (fb * (c1 - c0));
+    }
+    return vec3(output[0], output[1], output[2]);
+}
+
+// Splits the cube into 6 tetrahedra along the black-white diagonal and interpolates between the 4 corners of the one holding the color.
+// Only 4 lookups instead of 8, and neutral colors only ever see the gray axis entries.
+// This is the straightforward one-color-at-a-time version, kept as the reference for tetrahedralspan() in Benchmark().
+vec3 appliedlut::Tetrahedral(vec3 coords){
+    int maxbase = lutsize - 2;
+    int r = (int)coords.x;
+    int g = (int)coords.y;
+    int b = (int)coords.z;
+    r = (r > maxbase) ? maxbase : r;
+    g = (g > maxbase) ? maxbase : g;
+    b = (b > maxbase) ? maxbase : b;
+    double fr = coords.x - r;
+    double fg = coords.y - g;
+    double fb = coords.z - b;
+    size_t rstep = lutaxisstep(r, LUT_BRICK_ENTRIES, 1) * 3;
+    size_t gstep = lutaxisstep(g, LUT_BRICK_ENTRIES * bricks, LUT_BRICK_SIZE) * 3;
+    size_t bstep = lutaxisstep(b, LUT_BRICK_ENTRIES * bricks * bricks, LUT_BRICK_SIZE * LUT_BRICK_SIZE) * 3;
+    const float* c000 = &entries[EntryIndex(r, g, b)];
+    const float* c111 = c000 + rstep + gstep + bstep;
+    // the two corners between black and white, and the weights of the 4 corners
+    const float* first;
+    const float* second;
+    double w0, w1, w2, w3;
+    if (fr >= fg){
+        if (fg >= fb){
+            first = c000 + rstep;
+            second = c000 + rstep + gstep;
+            w0 = 1.0 - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+        }
+        else if (fr >= fb){
+            first = c000 + rstep;
+            second = c000 + rstep + bstep;
+            w0 = 1.0 - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+        }
+        else {
+            first = c000 + bstep;
+            second = c000 + rstep + bstep;
+            w0 = 1.0 - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+        }
+    }
+    else {
+        if (fb >= fg){
+            first = c000 + bstep;
+            second = c000 + gstep + bstep;
+            w0 = 1.0 - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+        }
+        else if (fb >= fr){
+            first = c000 + gstep;
+            second = c000 + gstep + bstep;
+            w0 = 1.0 - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+        }
+        else {
+            first = c000 + gstep;
+            second = c000 + rstep + gstep;
+            w0 = 1.0 - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+        }
+    }
+    double output[3];
+    for (int i=0; i<3; i++){
+        output[i] = (w0 * c000[i]) + (w1 * first[i]) + (w2 * second[i]) + (w3 * c111[i]);
+    }
+    return vec3(output[0], output[1], output[2]);
+}
+
+// Tetrahedral interpolation for one block of LUT_SPAN_BLOCK colors in place: input 0-1 (clamped here, then scaled to LUT coordinates), output as interpolated.
+// Fixed-length loops without branches, so each loop vectorizes.
+// (The corner lookups are gathers. GCC's generic tuning does them as one load per lane rather than with AVX2 gather instructions;
+// forcing the gather instructions measured about the same.)
+// Picking the tetrahedron with selects instead of branches gives the same corners and weights as Tetrahedral(),
+// except on ties, where the corners differ only by one whose weight is 0, so the results are identical.
+static CPU_ALWAYS_INLINE void tetrahedralblock(const float* entries, int lutsize, int bricks, double* red, double* green, double* blue){
+    const double top = lutsize - 1;
+    const int maxbase = lutsize - 2;
+    const int gbrickstride = LUT_BRICK_ENTRIES * bricks;
+    const int bbrickstride = LUT_BRICK_ENTRIES * bricks * bricks;
+    int c000[LUT_SPAN_BLOCK];
+    int first[LUT_SPAN_BLOCK];
+    int second[LUT_SPAN_BLOCK];
+    int c111[LUT_SPAN_BLOCK];
+    double w0[LUT_SPAN_BLOCK];
+    double w1[LUT_SPAN_BLOCK];
+    double w2[LUT_SPAN_BLOCK];
+    double w3[LUT_SPAN_BLOCK];
+    for (int i=0; i<LUT_SPAN_BLOCK; i++){
+        // "left of bin": entry x is the conversion of x/(lutsize - 1)
+        double xr = ((red[i] < 0.0) ? 0.0 : ((red[i] > 1.0) ? 1.0 : red[i])) * top;
+        double xg = ((green[i] < 0.0) ? 0.0 : ((green[i] > 1.0) ? 1.0 : green[i])) * top;
+        double xb = ((blue[i] < 0.0) ? 0.0 : ((blue[i] > 1.0) ? 1.0 : blue[i])) * top;
+        int r = (int)xr;
+        int g = (int)xg;
+        int b = (int)xb;
+        r = (r > maxbase) ? maxbase : r;
+        g = (g > maxbase) ? maxbase : g;
+        b = (b > maxbase) ? maxbase : b;
+        double fr = xr - r;
+        double fg = xg - g;
+        double fb = xb - b;
+        int rstep = lutaxisstep(r, LUT_BRICK_ENTRIES, 1);
+        int gstep = lutaxisstep(g, gbrickstride, LUT_BRICK_SIZE);
+        int bstep = lutaxisstep(b, bbrickstride, LUT_BRICK_SIZE * LUT_BRICK_SIZE);
+        int base = lutaxisoffset(r, LUT_BRICK_ENTRIES, 1) + lutaxisoffset(g, gbrickstride, LUT_BRICK_SIZE) + lutaxisoffset(b, bbrickstride, LUT_BRICK_SIZE * LUT_BRICK_SIZE);
+        // the path from c000 to c111 steps along the axis with the biggest fraction first, and the smallest last
+        double rgmax = (fr > fg) ? fr : fg;
+        double rgmin = (fr < fg) ? fr : fg;
+        double fbig = (rgmax > fb) ? rgmax : fb;
+        double fsmall = (rgmin < fb) ? rgmin : fb;
+        double fmid = (rgmax < fb) ? rgmax : fb;
+        fmid = (rgmin > fmid) ? rgmin : fmid;
+        // on ties, big prefers red and small prefers blue, so they're never the same axis
+        int bigstep = (fr == fbig) ? rstep : ((fg == fbig) ? gstep : bstep);
+        int smallstep = (fb == fsmall) ? bstep : ((fg == fsmall) ? gstep : rstep);
+        c000[i] = base * 3;
+        first[i] = (base + bigstep) * 3;
+        second[i] = (base + rstep + gstep + bstep - smallstep) * 3;
+        c111[i] = (base + rstep + gstep + bstep) * 3;
+        w0[i] = 1.0 - fbig;
+        w1[i] = fbig - fmid;
+        w2[i] = fmid - fsmall;
+        w3[i] = fsmall;
+    }
+    for (int i=0; i<LUT_SPAN_BLOCK; i++){
+        red[i] = (w0[i] * entries[c000[i]]) + (w1[i] * entries[first[i]]) + (w2[i] * entries[second[i]]) + (w3[i] * entries[c111[i]]);
+        green[i] = (w0[i] * entries[c000[i] + 1]) + (w1[i] * entries[first[i] + 1]) + (w2[i] * entries[second[i] + 1]) + (w3[i] * entries[c111[i] + 1]);
+        blue[i] = (w0[i] * entries[c000[i] + 2]) + (w1[i] * entries[first[i] + 2]) + (w2[i] * entries[second[i] + 2]) + (w3[i] * entries[c111[i] + 2]);
+    }
+    return;
+}
+
+// tetrahedral interpolation for count colors in place
+static CPU_ALWAYS_INLINE void tetrahedralspanBody(const float* entries, int lutsize, int bricks, double* red, double* green, double* blue, int count){
+    int start = 0;
+    for (; start + LUT_SPAN_BLOCK <= count; start+=LUT_SPAN_BLOCK){
+        tetrahedralblock(entries, lutsize, bricks, &red[start], &green[start], &blue[start]);
+    }
+    // a short last block is padded with copies of its first color
+    int leftover = count - start;
+    if (leftover > 0){
+        double cr[LUT_SPAN_BLOCK];
+        double cg[LUT_SPAN_BLOCK];
+        double cb[LUT_SPAN_BLOCK];
+        for (int i=0; i<LUT_SPAN_BLOCK; i++){
+            int j = start + ((i < leftover) ? i : 0);
+            cr[i] = red[j];
+            cg[i] = green[j];
+            cb[i] = blue[j];
+        }
+        tetrahedralblock(entries, lutsize, bricks, cr, cg, cb);
+        for (int i=0; i<leftover; i++){
+            red[start + i] = cr[i];
+            green[start + i] = cg[i];
+            blue[start + i] = cb[i];
+        }
+    }
+    return;
+}
+CPUDISPATCH(void, tetrahedralspan, (const float* entries, int lutsize, int bricks, double* red, double* green, double* blue, int count), (entries, lutsize, bricks, red, green, blue, count))
+
+void appliedlut::ProcessSpan(double* red, double* green, double* blue, int count){
+    // the CRT simulation the LUT mode leaves to us is one color at a time
+    if (lutmode != LUTMODE_NORMAL){
+        for (int i=0; i<count; i++){
+            vec3 coords = PreLUT(vec3(red[i], green[i], blue[i]));
+            red[i] = coords.x;
+            green[i] = coords.y;
+            blue[i] = coords.z;
+        }
+    }
+    if (interpolation == LUT_INTERPOLATE_TETRAHEDRAL){
+        tetrahedralspan(entries.data(), lutsize, bricks, red, green, blue, count);
+    }
+    else {
+        double top = lutsize - 1;
+        for (int i=0; i<count; i++){
+            vec3 output = Trilinear(vec3(clampdouble(red[i]) * top, clampdouble(green[i]) * top, clampdouble(blue[i]) * top));
+            red[i] = output.x;
+            green[i] = output.y;
+            blue[i] = output.z;
+        }
+    }
+    if (linearize){
+        togammatablespan(red, count);
+        togammatablespan(green, count);
+        togammatablespan(blue, count);
+    }
+    return;
+}
+
+void appliedlut::Benchmark(int samples){
+    printf("\nBenchmarking %ix%ix%i LUT interpolation with %i colors on one thread...\n", lutsize, lutsize, lutsize, samples);
+
+    // random LUT inputs (the CRT simulation for other LUT modes isn't part of this)
+    std::mt19937 rng(8675309);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<double> inputs(samples * 3);
+    for (int i=0; i<samples * 3; i++){
+        inputs[i] = uniform(rng);
+    }
+    std::vector<double> red(samples);
+    std::vector<double> green(samples);
+    std::vector<double> blue(samples);
+    double top = lutsize - 1;
+
+    // one color at a time
+    std::vector<vec3> reference(samples);
+    auto scalarstart = std::chrono::steady_clock::now();
+    for (int i=0; i<samples; i++){
+        reference[i] = Tetrahedral(vec3(inputs[i * 3] * top, inputs[(i * 3) + 1] * top, inputs[(i * 3) + 2] * top));
+    }
+    auto scalarend = std::chrono::steady_clock::now();
+    double scalartime = std::chrono::duration<double>(scalarend - scalarstart).count();
+    printf("\tTetrahedral, one color at a time: %f Mpixels/s per core\n", samples / scalartime / 1000000.0);
+
+    std::vector<vec3> trilinear(samples);
+    auto trilinearstart = std::chrono::steady_clock::now();
+    for (int i=0; i<samples; i++){
+        trilinear[i] = Trilinear(vec3(inputs[i * 3] * top, inputs[(i * 3) + 1] * top, inputs[(i * 3) + 2] * top));
+    }
+    auto trilinearend = std::chrono::steady_clock::now();
+    printf("\tTrilinear, one color at a time: %f Mpixels/s per core\n", samples / std::chrono::duration<double>(trilinearend - trilinearstart).count() / 1000000.0);
+
+    // the span kernel at each instruction set level this CPU supports, in spans the size the conversion code uses
+    int oldlevel = CPUlevel;
+    for (int level=CPU_LEVEL_BASELINE; level<=DetectCPULevel(); level++){
+        SetCPULevel(level);
+        for (int i=0; i<samples; i++){
+            red[i] = inputs[i * 3];
+            green[i] = inputs[(i * 3) + 1];
+            blue[i] = inputs[(i * 3) + 2];
+        }
+        auto spanstart = std::chrono::steady_clock::now();
+        for (int i=0; i<samples; i+=LUT_BENCHMARK_SPAN){
+            int spancount = ((samples - i) < LUT_BENCHMARK_SPAN) ? (samples - i) : LUT_BENCHMARK_SPAN;
+            tetrahedralspan(entries.data(), lutsize, bricks, &red[i], &green[i], &blue[i], spancount);
+        }
+        auto spanend = std::chrono::steady_clock::now();
+        double spantime = std::chrono::duration<double>(spanend - spanstart).count();
+        int mismatches = 0;
+        for (int i=0; i<samples; i++){
+            if ((red[i] != reference[i].x) || (green[i] != reference[i].y) || (blue[i] != reference[i].z)){
+                mismatches++;
+            }
+        }
+        printf("\tTetrahedral, %i at a time, %s: %f Mpixels/s per core (%f times one at a time); %i results differ\n", LUT_SPAN_BLOCK, CPULevelName(level), samples / spantime / 1000000.0, scalartime / spantime, mismatches);
+    }
+    CPUlevel = oldlevel;
+    return;
+}
+
+void appliedlut::ErrorReport(conversionplan &plan, int samples){
+    printf("\nComparing %ix%ix%i LUT with direct conversion on %i random 16-bit colors...\n", lutsize, lutsize, lutsize, samples);
+    std::mt19937 rng(8675309);
+    std::uniform_int_distribution<int> uniform(0, 65535);
+    std::vector<double> red(samples);
+    std::vector<double> green(samples);
+    std::vector<double> blue(samples);
+    for (int i=0; i<samples; i++){
+        red[i] = BetterDAC(uniform(rng), 65536);
+        green[i] = BetterDAC(uniform(rng), 65536);
+        blue[i] = BetterDAC(uniform(rng), 65536);
+    }
+    std::vector<double> lutred = red;
+    std::vector<double> lutgreen = green;
+    std::vector<double> lutblue = blue;
+
+    auto directstart = std::chrono::steady_clock::now();
+    plan.ProcessSpan(red.data(), green.data(), blue.data(), samples);
+    auto directend = std::chrono::steady_clock::now();
+    ProcessSpan(lutred.data(), lutgreen.data(), lutblue.data(), samples);
+    auto lutend = std::chrono::steady_clock::now();
+
+    // largest channel difference per color, in undithered 16-bit steps
+    std::vector<int> diffs(samples);
+    double total = 0.0;
+    long long differ8 = 0;
+    for (int i=0; i<samples; i++){
+        int maxdiff = 0;
+        double direct[3] = {red[i], green[i], blue[i]};
+        double interpolated[3] = {lutred[i], lutgreen[i], lutblue[i]};
+        bool differs8 = false;
+        for (int c=0; c<3; c++){
+            int diff = abs((int)toRGB16nodither(direct[c]) - (int)toRGB16nodither(interpolated[c]));
+            if (diff > maxdiff){
+                maxdiff = diff;
+            }
+            if (toRGB8nodither(direct[c]) != toRGB8nodither(interpolated[c])){
+                differs8 = true;
+            }
+        }
+        diffs[i] = maxdiff;
+        total += maxdiff;
+        if (differs8){
+            differ8++;
+        }
+    }
+    std::sort(diffs.begin(), diffs.end());
+    double directtime = std::chrono::duration<double>(directend - directstart).count();
+    double luttime = std::chrono::duration<double>(lutend - directend).count();
+    printf("\tDirect conversion: %f Mpixels/s per core\n", samples / directtime / 1000000.0);
+    printf("\tLUT: %f Mpixels/s per core\n", samples / luttime / 1000000.0);
+    printf("\tLargest channel difference per color in 16-bit steps: mean %f, median %i, 99th percentile %i, 99.9th percentile %i, max %i\n", total / samples, diffs[samples / 2], diffs[(int)(samples * 0.99)], diffs[(int)(samples * 0.999)], diffs[samples - 1]);
+    printf("\tColors that would differ at 8 bits: %lli of %i (%f%%)\n", differ8, samples, (100.0 * differ8) / samples);
+    return;
+}
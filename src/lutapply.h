@@ -0,0 +1,91 @@
+#ifndef LUTAPPLY_H
+#define LUTAPPLY_H
+
+#include "constants.h"
+#include "vec3.h"
+#include "crtemulation.h"
+#include "conversionplan.h"
+
+#include <vector>
+#include <string>
+
+// Applying a LUT made by --lutgen to images, instead of doing the whole conversion (--lutapply).
+// The LUT png is lutsize * lutsize wide and lutsize tall, with the red index fastest, then blue in blocks of lutsize across, and green down.
+// The entry at index i is the conversion of i/(lutsize - 1) ("left of bin," see lutinputcolor()),
+// so a color's LUT coordinates are just the color scaled by lutsize - 1, after whatever CRT simulation the LUT mode leaves to the calling code:
+//   normal: none
+//   postcc: CRT simulation up to the EOTF, then shifted and scaled from crtclamplow-crtclamphigh to 0-1
+//   postgamma: the whole CRT simulation (clamped to 0-1)
+//   postgammaunlimited: the whole CRT simulation with super blacks, then scaled by 1/(the LUT's ceiling)
+// Entries stored in gamma space are linearized with the output gamma function before interpolating, and the result goes back to gamma space.
+// (Entries made with CRT simulation on the output side are interpolated as they are, since that gamma isn't per channel.)
+// The settings passed in must match the ones the LUT was made with.
+// In memory, the entries are stored in bricks of 4x4x4 (padded out to whole bricks) rather than the png's row order,
+// so the 8 corners of a cell are usually within a few cache lines of each other.
+
+#define LUT_BRICK_BITS 2
+#define LUT_BRICK_SIZE (1 << LUT_BRICK_BITS)
+#define LUT_BRICK_MASK (LUT_BRICK_SIZE - 1)
+#define LUT_BRICK_ENTRIES (LUT_BRICK_SIZE * LUT_BRICK_SIZE * LUT_BRICK_SIZE)
+// colors per block in the tetrahedral span kernel (one AVX2 gather of floats)
+#define LUT_SPAN_BLOCK 8
+// span size for Benchmark()
+#define LUT_BENCHMARK_SPAN 256
+#define LUT_BENCHMARK_SAMPLES 4000000
+// random colors for ErrorReport()
+#define LUT_ERROR_REPORT_SAMPLES 1000000
+
+// The ceiling of LUTMODE_POSTGAMMA_UNLIMITED LUT indices (the maximum linear output of the CRT, with super blacks),
+// rounded up so that white gets its own entry in a LUT of lutsize. Sets lpguscalereciprocal to 1/ceiling.
+double postgammaunlimitedscale(crtdescriptor* crt, int lutsize, bool crtdoclamphigh, double crtclamphigh, double crtgammaknob, double &lpguscalereciprocal);
+
+class appliedlut{
+public:
+    int lutsize = 0;
+    int lutmode = LUTMODE_NORMAL;
+    int interpolation = LUT_INTERPOLATE_TETRAHEDRAL;
+
+    // Reads the LUT png and prepares for applying it. crt is only used (and must be initialized) for LUT modes other than normal; it is copied, so it needn't outlive this.
+    // linearize says whether the entries are in gamma space per gammamodeout (and initializeTransferTables() has been run for it).
+    // Prints an error and returns false on failure.
+    bool Load(const char* filename, int lutmode_in, int interpolation_in, int gammamodeout, double gammapowout, double hdrsdrmaxnits, bool linearize_in, crtdescriptor* crt_in, double crtclamplow_in, double crtclamphigh_in, bool crtdoclamphigh, double crtgammaknob);
+
+    // Makes the LUT by converting every grid point (i/(lutsize - 1), as for --lutgen normal mode) with plan on maxthreads threads,
+    // instead of reading a png. Entries are floats straight from the conversion, so there's no 8-bit quantization. (For --png16.)
+    void Generate(conversionplan &plan, int lutsize_in, int maxthreads, int gammamodeout, double gammapowout, double hdrsdrmaxnits, bool linearize_in);
+    // Saves or loads generated entries, so a configuration only has to be generated once.
+    // key must hold every setting that affects the entries; loading fails (quietly if the file doesn't exist) unless it matches.
+    bool SaveGenerated(const std::string &filename, const std::string &key);
+    bool LoadGenerated(const std::string &filename, const std::string &key, int lutsize_in, bool linearize_in);
+
+    // Applies the LUT to count colors in place (input as from DAC8Table, output in gamma space ready for quantization)
+    void ProcessSpan(double* red, double* green, double* blue, int count);
+
+    // Times the interpolation methods (one thread, pixels per second) and checks the span kernel at each CPU level against the one-at-a-time version.
+    void Benchmark(int samples);
+
+    // Compares the LUT with converting directly with plan on random 16-bit colors, and prints the differences in 16-bit steps.
+    void ErrorReport(conversionplan &plan, int samples);
+
+private:
+    // entries in bricks (see EntryIndex()), 3 floats each, linearized if linearize
+    std::vector<float> entries;
+    int bricks = 0; // per side
+    bool linearize = false;
+    crtdescriptor* crt = NULL; // points to ownedcrt, or NULL if there's no CRT simulation
+    crtdescriptor ownedcrt; // copy of the CRT passed to Load()
+    double crtclamplow = 0.0;
+    double crtclamphigh = 1.0;
+    double lpguscalereciprocal = 1.0;
+
+    // index in entries of the first float of an entry:
+    // red fastest then green then blue within a brick, and the same order for the bricks
+    size_t EntryIndex(int red, int green, int blue);
+    // the CRT simulation for the LUT mode, giving LUT inputs (0-1, not yet clamped) for an input color
+    vec3 PreLUT(vec3 input);
+    // these take LUT coordinates (0 to lutsize - 1)
+    vec3 Trilinear(vec3 coords);
+    vec3 Tetrahedral(vec3 coords);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "matrix.h"
+#include "cpudispatch.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -10,15 +11,30 @@ void print3x3matrix(double input[3][3]){
 }
 
 
-// multiplies matrix * color
-// remember that a c++ 2-dimensional array is [row][col]
-vec3 multMatrixByColor(const double matrix[3][3], vec3 color){
-    vec3 output;
-    output.x = matrix[0][0] * color.x + matrix[0][1] * color.y + matrix[0][2] * color.z;
-    output.y = matrix[1][0] * color.x + matrix[1][1] * color.y + matrix[1][2] * color.z;
-    output.z = matrix[2][0] * color.x + matrix[2][1] * color.y + matrix[2][2] * color.z;
-    return output;
+// multiplies matrix * color for count colors in structure-of-arrays layout, in place
+// (same arithmetic as multMatrixByColor(), so results are identical; the loop is simple enough for the compiler to vectorize)
+// (compiled for each instruction set level; see cpudispatch.h)
+static CPU_ALWAYS_INLINE void multMatrixBySpanBody(const double matrix[3][3], double* x, double* y, double* z, int count){
+    const double m00 = matrix[0][0];
+    const double m01 = matrix[0][1];
+    const double m02 = matrix[0][2];
+    const double m10 = matrix[1][0];
+    const double m11 = matrix[1][1];
+    const double m12 = matrix[1][2];
+    const double m20 = matrix[2][0];
+    const double m21 = matrix[2][1];
+    const double m22 = matrix[2][2];
+    for (int i=0; i<count; i++){
+        double inx = x[i];
+        double iny = y[i];
+        double inz = z[i];
+        x[i] = m00 * inx + m01 * iny + m02 * inz;
+        y[i] = m10 * inx + m11 * iny + m12 * inz;
+        z[i] = m20 * inx + m21 * iny + m22 * inz;
+    }
+    return;
 }
+CPUDISPATCH(void, multMatrixBySpan, (const double matrix[3][3], double* x, double* y, double* z, int count), (matrix, x, y, z, count))
 
 // multiplies A*B and puts result in output
 // remember that a c++ 2-dimensional array is [row][col]
@@ -7,7 +7,18 @@
 void print3x3matrix(double input[3][3]);
 
 // multiplies matrix * color
-vec3 multMatrixByColor(const double matrix[3][3], vec3 color);
+// remember that a c++ 2-dimensional array is [row][col]
+// (defined here so it can be inlined into the hot paths in other translation units)
+inline vec3 multMatrixByColor(const double matrix[3][3], vec3 color){
+    vec3 output;
+    output.x = matrix[0][0] * color.x + matrix[0][1] * color.y + matrix[0][2] * color.z;
+    output.y = matrix[1][0] * color.x + matrix[1][1] * color.y + matrix[1][2] * color.z;
+    output.z = matrix[2][0] * color.x + matrix[2][1] * color.y + matrix[2][2] * color.z;
+    return output;
+}
+
+// multiplies matrix * color for count colors in structure-of-arrays layout (one array per channel), in place
+void multMatrixBySpan(const double matrix[3][3], double* x, double* y, double* z, int count);
 
 // multiplies A*B and puts result in output
 void mult3x3Matrices(const double A[3][3], const double B[3][3], double output[3][3]);
@@ -0,0 +1,209 @@
+#include "memocache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <filesystem>
+
+#ifdef _WIN32
+    #define MEMOCACHE_MMAP 0
+#else
+    #define MEMOCACHE_MMAP 1
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+// bump this if the file layout or the meaning of a cached result changes
+#define MEMOCACHE_MAGIC "GAMUTTHINGYMEMO1"
+
+#define MEMOCACHE_COLORS (256 * 256 * 256)
+#define MEMOCACHE_BITMAP_BYTES (MEMOCACHE_COLORS / 8)
+#define MEMOCACHE_TABLE_BYTES ((size_t)MEMOCACHE_COLORS * 3 * sizeof(double))
+// the header is padded to a whole page so the bitmap and table are aligned
+#define MEMOCACHE_HEADER_ALIGN 4096
+
+typedef struct memocacheheader{
+    char magic[16];
+    uint64_t headersize; // including the key and padding
+    uint64_t keylength;
+} memocacheheader;
+
+// FNV-1a, 64-bit
+uint64_t cachekeyhash(const std::string &key){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i=0; i<key.size(); i++){
+        hash ^= (unsigned char)key[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool memocache::IsOpen(){
+    return (base != NULL);
+}
+
+bool memocache::Lookup(png_byte red, png_byte green, png_byte blue, vec3 &output){
+    if (base == NULL){
+        return false;
+    }
+    size_t index = (red << 16) | (green << 8) | blue;
+    uint64_t word = std::atomic_ref<uint64_t>(bitmap[index >> 6]).load(std::memory_order_acquire);
+    if ((word & (1ULL << (index & 63))) == 0){
+        return false;
+    }
+    output = vec3(table[index * 3], table[(index * 3) + 1], table[(index * 3) + 2]);
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void memocache::Store(png_byte red, png_byte green, png_byte blue, vec3 value){
+    if (base == NULL){
+        return;
+    }
+    size_t index = (red << 16) | (green << 8) | blue;
+    std::atomic_ref<uint64_t> word(bitmap[index >> 6]);
+    uint64_t bit = 1ULL << (index & 63);
+    // don't dirty the page again if another run already stored it
+    if ((word.load(std::memory_order_relaxed) & bit) != 0){
+        return;
+    }
+    table[index * 3] = value.x;
+    table[(index * 3) + 1] = value.y;
+    table[(index * 3) + 2] = value.z;
+    word.fetch_or(bit, std::memory_order_release);
+    stores.fetch_add(1, std::memory_order_relaxed);
+    return;
+}
+
+#if MEMOCACHE_MMAP
+
+// Creates the cache file under a temporary name and links it into place, so other processes never see a half-written header.
+// If another process gets there first, theirs is kept.
+static bool createcachefile(const std::string &name, const std::string &key, size_t headersize, size_t filelength){
+    std::string tempname = name + ".tmp." + std::to_string((long)getpid());
+    int tempfd = open(tempname.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (tempfd < 0){
+        fprintf(stderr, "gamutthingy: memo cache %s: %s\n", tempname.c_str(), strerror(errno));
+        return false;
+    }
+    std::string header(headersize, '\0');
+    memocacheheader fixed;
+    memset(&fixed, 0, sizeof(fixed));
+    memcpy(fixed.magic, MEMOCACHE_MAGIC, sizeof(fixed.magic));
+    fixed.headersize = headersize;
+    fixed.keylength = key.size();
+    memcpy(&header[0], &fixed, sizeof(fixed));
+    memcpy(&header[sizeof(fixed)], key.data(), key.size());
+    // the rest of the file (bitmap and table) is left as a hole, which reads as zeros
+    bool ok = (write(tempfd, header.data(), headersize) == (ssize_t)headersize) && (ftruncate(tempfd, filelength) == 0);
+    if (close(tempfd) != 0){
+        ok = false;
+    }
+    if (ok && (link(tempname.c_str(), name.c_str()) != 0) && (errno != EEXIST)){
+        ok = false;
+    }
+    if (!ok){
+        fprintf(stderr, "gamutthingy: memo cache %s: %s\n", name.c_str(), strerror(errno));
+    }
+    unlink(tempname.c_str());
+    return ok;
+}
+
+bool memocache::Open(const char* directory, const std::string &key){
+    char hashname[64];
+    snprintf(hashname, sizeof(hashname), "gamutthingy-memo-%016llx.bin", (unsigned long long)cachekeyhash(key));
+    std::string name = (std::filesystem::path(directory) / hashname).string();
+    if ((base != NULL) && (name == filename) && (key == openkey)){
+        return true;
+    }
+    Close();
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec){
+        fprintf(stderr, "gamutthingy: memo cache %s: %s\n", directory, ec.message().c_str());
+        return false;
+    }
+    size_t headersize = ((sizeof(memocacheheader) + key.size() + MEMOCACHE_HEADER_ALIGN - 1) / MEMOCACHE_HEADER_ALIGN) * MEMOCACHE_HEADER_ALIGN;
+    size_t filelength = headersize + MEMOCACHE_BITMAP_BYTES + MEMOCACHE_TABLE_BYTES;
+
+    fd = open(name.c_str(), O_RDWR);
+    if ((fd < 0) && (errno == ENOENT)){
+        if (!createcachefile(name, key, headersize, filelength)){
+            return false;
+        }
+        fd = open(name.c_str(), O_RDWR);
+    }
+    if (fd < 0){
+        fprintf(stderr, "gamutthingy: memo cache %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0){
+        fprintf(stderr, "gamutthingy: memo cache %s: %s\n", name.c_str(), strerror(errno));
+        Close();
+        return false;
+    }
+    if ((size_t)info.st_size != filelength){
+        fprintf(stderr, "gamutthingy: memo cache %s: Wrong file size (not a memo cache for these settings?)\n", name.c_str());
+        Close();
+        return false;
+    }
+    void* mapping = mmap(NULL, filelength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED){
+        fprintf(stderr, "gamutthingy: memo cache %s: %s\n", name.c_str(), strerror(errno));
+        Close();
+        return false;
+    }
+    base = (unsigned char*)mapping;
+    length = filelength;
+    // lookups are scattered all over the table
+    madvise(base, length, MADV_RANDOM);
+
+    memocacheheader fixed;
+    memcpy(&fixed, base, sizeof(fixed));
+    if ((memcmp(fixed.magic, MEMOCACHE_MAGIC, sizeof(fixed.magic)) != 0) || (fixed.headersize != headersize) || (fixed.keylength != key.size()) || (memcmp(base + sizeof(fixed), key.data(), key.size()) != 0)){
+        fprintf(stderr, "gamutthingy: memo cache %s: Header doesn't match these settings\n", name.c_str());
+        Close();
+        return false;
+    }
+    bitmap = (uint64_t*)(base + headersize);
+    table = (double*)(base + headersize + MEMOCACHE_BITMAP_BYTES);
+    filename = name;
+    openkey = key;
+    hits = 0;
+    stores = 0;
+    return true;
+}
+
+void memocache::Close(){
+    if (base != NULL){
+        munmap(base, length);
+    }
+    if (fd >= 0){
+        close(fd);
+    }
+    base = NULL;
+    length = 0;
+    fd = -1;
+    bitmap = NULL;
+    table = NULL;
+    filename.clear();
+    openkey.clear();
+    return;
+}
+
+#else
+
+bool memocache::Open(const char* directory, const std::string &key){
+    fprintf(stderr, "gamutthingy: --memo-cache is not available on this platform\n");
+    return false;
+}
+
+void memocache::Close(){
+    return;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MEMOCACHE_H
+#define MEMOCACHE_H
+
+#include "vec3.h"
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
+
+// On-disk memo cache, so that colors converted in one run are reused by later runs with the same settings.
+// There is one file per configuration, named by a hash of a key string holding every setting that affects the conversion of an 8-bit color.
+// (The whole key is also stored in the file header and checked, so a hash collision just means the cache isn't used.)
+// After the header comes a validity bitmap with one bit per 24-bit color, then a dense table of 3 doubles per color
+// (so cached results are bit-exact, and there's no per-entry padding like the in-memory memos have).
+// The file is created at its full size (~400 MB) but sparse, so it only takes up disk space for the pages that get used.
+// Several processes can share the file at once without locking:
+// a result is written before its bit is set (release), and is only read after its bit is seen set (acquire).
+// Two processes racing on the same color write the same bytes, so that's harmless.
+// The file is memory-mapped, so it's not available on Windows.
+// Open() prints an error and returns false on failure; the other functions are safe to call when the cache isn't open.
+
+// hash of a key string, for naming cache files (also used by the full table, see fulltable.h)
+uint64_t cachekeyhash(const std::string &key);
+
+class memocache{
+public:
+    // colors found in the cache, and colors added to it, since Open()
+    std::atomic<long> hits{0};
+    std::atomic<long> stores{0};
+
+    // opens (or creates) the cache file for key in directory; does nothing if that file is already open
+    bool Open(const char* directory, const std::string &key);
+    bool IsOpen();
+    // if the result for this input color is in the cache, copies it to output and returns true
+    bool Lookup(png_byte red, png_byte green, png_byte blue, vec3 &output);
+    // adds the result for this input color to the cache (unless it's already there)
+    void Store(png_byte red, png_byte green, png_byte blue, vec3 value);
+    void Close();
+
+private:
+    std::string filename;
+    std::string openkey;
+    unsigned char* base = NULL; // start of the mapping
+    size_t length = 0;
+    int fd = -1;
+    uint64_t* bitmap = NULL;
+    double* table = NULL;
+};
+
+#endif
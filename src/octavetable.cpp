@@ -0,0 +1,43 @@
+#include "octavetable.h"
+
+#include <math.h>
+
+// Returns the input at table node index (nodes are evenly spaced within each octave starting at 2^minexponent)
+double OctaveTableNode(int index, int minexponent){
+    int octave = index / OCTAVE_TABLE_CELLS_PER_OCTAVE;
+    int cell = index % OCTAVE_TABLE_CELLS_PER_OCTAVE;
+    return ldexp(1.0 + ((double)cell / OCTAVE_TABLE_CELLS_PER_OCTAVE), minexponent + octave);
+}
+
+// Fills value and slope for the nodes from 2^minexponent to 2^maxexponent
+void OctaveTableBuild(int minexponent, int maxexponent, double* value, double* slope, double (*function)(double), double (*derivative)(double)){
+    int size = OCTAVE_TABLE_SIZE(minexponent, maxexponent);
+    for (int i=0; i<size; i++){
+        double node = OctaveTableNode(i, minexponent);
+        value[i] = function(node);
+        slope[i] = derivative(node);
+    }
+    return;
+}
+
+// Measures the max absolute error of the table vs. the exact function at the quarter points between nodes
+double OctaveTableMaxError(int minexponent, int maxexponent, const double* value, const double* slope, double (*function)(double), double ceiling){
+    double maxerror = 0.0;
+    int size = OCTAVE_TABLE_SIZE(minexponent, maxexponent);
+    for (int i=0; i<size - 1; i++){
+        double low = OctaveTableNode(i, minexponent);
+        double high = OctaveTableNode(i + 1, minexponent);
+        for (int j=1; j<4; j++){
+            double sample = low + ((high - low) * j * 0.25);
+            double exact = function(sample);
+            if (exact > ceiling){
+                continue;
+            }
+            double error = fabs(OctaveTableLookup(sample, minexponent, value, slope) - exact);
+            if (!(error <= maxerror)){
+                maxerror = error;
+            }
+        }
+    }
+    return maxerror;
+}
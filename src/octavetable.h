@@ -0,0 +1,67 @@
+#ifndef OCTAVETABLE_H
+#define OCTAVETABLE_H
+
+#include <cstdint>
+#include <cstring> //for memcpy
+
+// Octave tables ------------------------------------------------------------------------------------------------------------------------
+// Piecewise cubic Hermite tables for smooth functions whose inputs span many orders of magnitude (PQ, gamma functions, etc.).
+// Each table covers 2^minexponent to 2^maxexponent in octaves (powers of 2) with OCTAVE_TABLE_CELLS_PER_OCTAVE cells per octave,
+// and stores the function value and its derivative at each node.
+// So cells are narrow where the input is small, and the relative error is about the same everywhere.
+// Finding the cell is just picking apart the bits of the input, so there's no pow(), log(), or search.
+// Callers are responsible for checking the input is inside the table's range and falling back to the exact function otherwise.
+#define OCTAVE_TABLE_CELLS_PER_OCTAVE 64
+#define OCTAVE_TABLE_SIZE(minexponent, maxexponent) ((((maxexponent) - (minexponent)) * OCTAVE_TABLE_CELLS_PER_OCTAVE) + 1)
+
+// Returns the input at table node index (nodes are evenly spaced within each octave starting at 2^minexponent)
+double OctaveTableNode(int index, int minexponent);
+
+// Fills value and slope for the nodes from 2^minexponent to 2^maxexponent
+// function and derivative are the exact function and its first derivative
+void OctaveTableBuild(int minexponent, int maxexponent, double* value, double* slope, double (*function)(double), double (*derivative)(double));
+
+// Cubic Hermite interpolation in a table
+// input must be positive, normal, and inside the table's range
+// (inline because it sits on the hot path of everything that uses it)
+inline double OctaveTableLookup(double input, int minexponent, const double* value, const double* slope){
+    uint64_t bits;
+    memcpy(&bits, &input, sizeof(bits));
+    int exponent = (int)((bits >> 52) & 0x7FF) - 1023;
+    // position within the octave, 0 to OCTAVE_TABLE_CELLS_PER_OCTAVE (the mantissa's fraction bits are already evenly spaced)
+    double position = (double)(bits & 0x000FFFFFFFFFFFFFULL) * (OCTAVE_TABLE_CELLS_PER_OCTAVE / 4503599627370496.0);
+    int cell = (int)position;
+    double t = position - cell;
+    int index = ((exponent - minexponent) * OCTAVE_TABLE_CELLS_PER_OCTAVE) + cell;
+    // cell width is 2^exponent / OCTAVE_TABLE_CELLS_PER_OCTAVE; build the power of 2 from bits rather than calling ldexp()
+    uint64_t scalebits = (uint64_t)(exponent + 1023) << 52;
+    double width;
+    memcpy(&width, &scalebits, sizeof(width));
+    width *= (1.0 / OCTAVE_TABLE_CELLS_PER_OCTAVE);
+    double t2 = t * t;
+    double t3 = t2 * t;
+    double h00 = (2.0 * t3) - (3.0 * t2) + 1.0;
+    double h10 = t3 - (2.0 * t2) + t;
+    double h01 = (3.0 * t2) - (2.0 * t3);
+    double h11 = t3 - t2;
+    return (h00 * value[index]) + (h10 * width * slope[index]) + (h01 * value[index + 1]) + (h11 * width * slope[index + 1]);
+}
+
+// Returns true if input is inside the range 2^minexponent (inclusive) to 2^maxexponent (exclusive)
+// (false for NaN)
+inline bool OctaveTableInRange(double input, int minexponent, int maxexponent){
+    uint64_t lowbits = (uint64_t)(minexponent + 1023) << 52;
+    uint64_t highbits = (uint64_t)(maxexponent + 1023) << 52;
+    double low;
+    double high;
+    memcpy(&low, &lowbits, sizeof(low));
+    memcpy(&high, &highbits, sizeof(high));
+    return (input >= low) && (input < high);
+}
+
+// Measures the max absolute error of the table vs. the exact function by sampling between the nodes (where the error is largest)
+// Samples where the exact function is above ceiling are skipped (for functions whose output gets clamped anyway).
+// NaN means something is badly wrong with the table.
+double OctaveTableMaxError(int minexponent, int maxexponent, const double* value, const double* slope, double (*function)(double), double ceiling);
+
+#endif
@@ -0,0 +1,615 @@
+#include "pngstream.h"
+
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+#ifdef _WIN32
+    #include <process.h>
+    #include <io.h>
+    #define getpid _getpid
+    #define unlink _unlink
+#else
+    #include <unistd.h>
+#endif
+
+bool pngrowreader::Open(const char* filename){
+    file = fopen(filename, "rb");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    png_byte signature[8];
+    if ((fread(signature, 1, 8, file) != 8) || (png_sig_cmp(signature, 0, 8) != 0)){
+        fprintf(stderr, "gamutthingy: %s: Not a PNG file\n", filename);
+        Close();
+        return false;
+    }
+    png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (png != NULL){
+        info = png_create_info_struct(png);
+    }
+    if (info == NULL){
+        fprintf(stderr, "gamutthingy: %s: out of memory\n", filename);
+        Close();
+        return false;
+    }
+    // libpng has already printed the error if we land here
+    if (setjmp(png_jmpbuf(png))){
+        Close();
+        return false;
+    }
+    png_init_io(png, file);
+    png_set_sig_bytes(png, 8);
+    png_read_info(png, info);
+
+    width = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    int bitdepth = png_get_bit_depth(png, info);
+    int colortype = png_get_color_type(png, info);
+    interlaced = (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE);
+
+    // same transformations as png_image_finish_read() with PNG_FORMAT_RGBA:
+    // 16-bit files without a gAMA chunk are assumed to be linear, 8-bit (and smaller) files are assumed to be sRGB,
+    // and everything is gamma corrected to sRGB 8-bit with unassociated alpha
+    png_set_alpha_mode_fixed(png, PNG_ALPHA_PNG, (bitdepth == 16) ? PNG_GAMMA_LINEAR : PNG_DEFAULT_sRGB);
+    png_set_expand(png);
+    if (bitdepth == 16){
+        png_set_scale_16(png);
+    }
+    if ((colortype & PNG_COLOR_MASK_COLOR) == 0){
+        png_set_gray_to_rgb(png);
+    }
+    if (((colortype & PNG_COLOR_MASK_ALPHA) == 0) && !png_get_valid(png, info, PNG_INFO_tRNS)){
+        png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+    }
+    png_set_alpha_mode_fixed(png, PNG_ALPHA_PNG, PNG_DEFAULT_sRGB);
+    if (interlaced){
+        png_set_interlace_handling(png);
+    }
+    png_read_update_info(png, info);
+
+    if ((png_get_bit_depth(png, info) != 8) || (png_get_channels(png, info) != 4)){
+        fprintf(stderr, "gamutthingy: %s: Could not convert to 8-bit RGBA\n", filename);
+        Close();
+        return false;
+    }
+    rowsread = 0;
+    return true;
+}
+
+bool pngrowreader::ReadRows(png_bytep buffer, int rows){
+    if (setjmp(png_jmpbuf(png))){
+        return false;
+    }
+    if (interlaced){
+        // every pass touches every row, so we need all of them at once
+        int passes = png_set_interlace_handling(png);
+        for (int pass=0; pass<passes; pass++){
+            for (int y=0; y<rows; y++){
+                png_read_row(png, &buffer[(size_t)y * width * 4], NULL);
+            }
+        }
+    }
+    else {
+        for (int y=0; y<rows; y++){
+            png_read_row(png, &buffer[(size_t)y * width * 4], NULL);
+        }
+    }
+    rowsread += rows;
+    return true;
+}
+
+void pngrowreader::Close(){
+    if (png != NULL){
+        png_destroy_read_struct(&png, (info != NULL) ? &info : NULL, NULL);
+    }
+    png = NULL;
+    info = NULL;
+    if (file != NULL){
+        fclose(file);
+        file = NULL;
+    }
+    return;
+}
+
+bool pngrowwriter::Open(const char* filename, int imagewidth, int imageheight){
+    width = imagewidth;
+    height = imageheight;
+    name = filename;
+    tempname = name + ".tmp." + std::to_string((long)getpid());
+    complete = false;
+    // "x": fail rather than clobber something that happens to have the temp name
+    file = fopen(tempname.c_str(), "wbx");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", tempname.c_str(), strerror(errno));
+        tempname.clear();
+        return false;
+    }
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (png != NULL){
+        info = png_create_info_struct(png);
+    }
+    if (info == NULL){
+        fprintf(stderr, "gamutthingy: write %s: out of memory\n", filename);
+        Close();
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png))){
+        Close();
+        return false;
+    }
+    png_init_io(png, file);
+    // same header as png_image_write_to_file() with PNG_FORMAT_RGBA
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    png_set_sRGB(png, info, PNG_sRGB_INTENT_PERCEPTUAL);
+    png_set_compression_level(png, level);
+    png_set_compression_strategy(png, strategy);
+    png_write_info(png, info);
+    rowswritten = 0;
+    return true;
+}
+
+bool pngrowwriter::WriteRows(png_bytep buffer, int rows){
+    if (setjmp(png_jmpbuf(png))){
+        return false;
+    }
+    for (int y=0; y<rows; y++){
+        png_write_row(png, &buffer[(size_t)y * width * 4]);
+    }
+    rowswritten += rows;
+    if (rowswritten >= height){
+        png_write_end(png, NULL);
+        if (fflush(file) != 0){
+            fprintf(stderr, "gamutthingy: write: %s\n", strerror(errno));
+            return false;
+        }
+        complete = true;
+    }
+    return true;
+}
+
+bool pngrowwriter::Close(){
+    bool ok = true;
+    if (png != NULL){
+        png_destroy_write_struct(&png, (info != NULL) ? &info : NULL);
+    }
+    png = NULL;
+    info = NULL;
+    if (file != NULL){
+        if (fclose(file) != 0){
+            fprintf(stderr, "gamutthingy: write %s: %s\n", tempname.c_str(), strerror(errno));
+            ok = false;
+        }
+        file = NULL;
+    }
+    if (!tempname.empty()){
+        if (ok && complete){
+#ifdef _WIN32
+            // rename() won't replace an existing file on Windows
+            remove(name.c_str());
+#endif
+            if (rename(tempname.c_str(), name.c_str()) != 0){
+                fprintf(stderr, "gamutthingy: write %s: %s\n", name.c_str(), strerror(errno));
+                ok = false;
+            }
+        }
+        if (!(ok && complete)){
+            unlink(tempname.c_str());
+        }
+    }
+    tempname.clear();
+    complete = false;
+    return ok;
+}
+
+// applies PNG filter type filter to one row of bytesperpixel-byte pixels, storing the result in output
+// prevrow is the unfiltered previous row, or NULL for the first row
+// returns the sum of absolute values of the output (as signed bytes), or gives up and returns limit as soon as the sum reaches limit
+static unsigned long applyfilter(int filter, const png_byte* row, const png_byte* prevrow, int rowbytes, int bytesperpixel, png_bytep output, unsigned long limit){
+    unsigned long sum = 0;
+    int i = 0;
+    switch (filter){
+        case PNG_FILTER_VALUE_SUB:
+            for (; i<bytesperpixel; i++){
+                output[i] = row[i];
+                sum += abs((signed char)output[i]);
+            }
+            for (; i<rowbytes; i++){
+                output[i] = row[i] - row[i - bytesperpixel];
+                sum += abs((signed char)output[i]);
+                if (sum >= limit){
+                    return limit;
+                }
+            }
+            break;
+        case PNG_FILTER_VALUE_UP:
+            for (; i<rowbytes; i++){
+                output[i] = row[i] - prevrow[i];
+                sum += abs((signed char)output[i]);
+                if (sum >= limit){
+                    return limit;
+                }
+            }
+            break;
+        case PNG_FILTER_VALUE_AVG:
+            for (; i<bytesperpixel; i++){
+                output[i] = row[i] - (prevrow[i] >> 1);
+                sum += abs((signed char)output[i]);
+            }
+            for (; i<rowbytes; i++){
+                output[i] = row[i] - ((row[i - bytesperpixel] + prevrow[i]) >> 1);
+                sum += abs((signed char)output[i]);
+                if (sum >= limit){
+                    return limit;
+                }
+            }
+            break;
+        case PNG_FILTER_VALUE_PAETH:
+            // with c = a = 0 for the first pixel, the predictor is b
+            for (; i<bytesperpixel; i++){
+                output[i] = row[i] - prevrow[i];
+                sum += abs((signed char)output[i]);
+            }
+            for (; i<rowbytes; i++){
+                int a = row[i - bytesperpixel];
+                int b = prevrow[i];
+                int c = prevrow[i - bytesperpixel];
+                int pa = abs(b - c);
+                int pb = abs(a - c);
+                int pc = abs(a + b - c - c);
+                int predictor = ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c;
+                output[i] = row[i] - predictor;
+                sum += abs((signed char)output[i]);
+                if (sum >= limit){
+                    return limit;
+                }
+            }
+            break;
+        default:
+            for (; i<rowbytes; i++){
+                output[i] = row[i];
+                sum += abs((signed char)output[i]);
+            }
+            break;
+    }
+    return sum;
+}
+
+// filters one row of bytesperpixel-byte pixels into output (filter type byte followed by rowbytes bytes)
+// using whichever of the five PNG filters gives the smallest sum of absolute values (as signed bytes), same as libpng
+// prevrow is the unfiltered previous row, or NULL for the first row (where up, average, and Paeth reduce to none or sub, so only those are tried)
+// scratch must hold rowbytes bytes
+static void filterrow(const png_byte* row, const png_byte* prevrow, int rowbytes, int bytesperpixel, png_bytep output, png_bytep scratch){
+    output[0] = PNG_FILTER_VALUE_NONE;
+    unsigned long bestsum = applyfilter(PNG_FILTER_VALUE_NONE, row, prevrow, rowbytes, bytesperpixel, &output[1], (unsigned long)-1);
+    int lastfilter = (prevrow != NULL) ? PNG_FILTER_VALUE_PAETH : PNG_FILTER_VALUE_SUB;
+    for (int filter=PNG_FILTER_VALUE_SUB; filter<=lastfilter; filter++){
+        unsigned long sum = applyfilter(filter, row, prevrow, rowbytes, bytesperpixel, scratch, bestsum);
+        if (sum < bestsum){
+            bestsum = sum;
+            output[0] = (png_byte)filter;
+            memcpy(&output[1], scratch, rowbytes);
+        }
+    }
+    return;
+}
+
+// one independently deflated band of rows for WritePNGParallel()
+class deflateband{
+public:
+    int firstrow;
+    int rows;
+    std::vector<png_byte> compressed;
+    uLong adler;
+    uLong length; // uncompressed (filtered) length
+    bool ok;
+};
+
+static void deflatebandworker(png_bytep buffer, int width, int height, int level, int strategy, std::vector<deflateband>* bands, int* nextband, std::mutex* bandmtx){
+    int rowbytes = width * 4;
+    int filteredrowbytes = rowbytes + 1;
+    std::vector<png_byte> filtered;
+    std::vector<png_byte> dictionary;
+    std::vector<png_byte> scratch(rowbytes);
+    while (true){
+        bandmtx->lock();
+        int index = *nextband;
+        *nextband = index + 1;
+        bandmtx->unlock();
+        if (index >= (int)bands->size()){
+            break;
+        }
+        deflateband &band = (*bands)[index];
+        band.ok = false;
+        bool last = (index == (int)bands->size() - 1);
+
+        // filter the band
+        filtered.resize((size_t)band.rows * filteredrowbytes);
+        for (int y=0; y<band.rows; y++){
+            int row = band.firstrow + y;
+            filterrow(&buffer[(size_t)row * rowbytes], (row > 0) ? &buffer[(size_t)(row - 1) * rowbytes] : NULL, rowbytes, 4, &filtered[(size_t)y * filteredrowbytes], scratch.data());
+        }
+        band.length = filtered.size();
+        band.adler = adler32(adler32(0L, Z_NULL, 0), filtered.data(), band.length);
+
+        // the dictionary is the tail of the filtered data before this band, so we have to refilter as many preceding rows as it takes
+        int dictionarylength = 0;
+        if (band.firstrow > 0){
+            int dictionaryrows = (PNG_DEFLATE_WINDOW + filteredrowbytes - 1) / filteredrowbytes;
+            if (dictionaryrows > band.firstrow){
+                dictionaryrows = band.firstrow;
+            }
+            dictionary.resize((size_t)dictionaryrows * filteredrowbytes);
+            for (int y=0; y<dictionaryrows; y++){
+                int row = band.firstrow - dictionaryrows + y;
+                filterrow(&buffer[(size_t)row * rowbytes], (row > 0) ? &buffer[(size_t)(row - 1) * rowbytes] : NULL, rowbytes, 4, &dictionary[(size_t)y * filteredrowbytes], scratch.data());
+            }
+            dictionarylength = (dictionary.size() > PNG_DEFLATE_WINDOW) ? PNG_DEFLATE_WINDOW : (int)dictionary.size();
+        }
+
+        // raw deflate (the zlib header and trailer are written around the concatenated bands)
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, strategy) != Z_OK){
+            continue;
+        }
+        if (dictionarylength > 0){
+            deflateSetDictionary(&stream, &dictionary[dictionary.size() - dictionarylength], dictionarylength);
+        }
+        // deflateBound() doesn't count the sync flush marker
+        band.compressed.resize(deflateBound(&stream, band.length) + 16);
+        stream.next_in = filtered.data();
+        stream.avail_in = band.length;
+        stream.next_out = band.compressed.data();
+        stream.avail_out = band.compressed.size();
+        int zresult = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        if ((last && (zresult == Z_STREAM_END)) || (!last && (zresult == Z_OK) && (stream.avail_in == 0))){
+            band.compressed.resize(stream.total_out);
+            band.ok = true;
+        }
+        deflateEnd(&stream);
+    }
+    return;
+}
+
+// writes a PNG chunk (length, type, data, crc)
+static bool writechunk(FILE* file, const char* type, const png_byte* data, uLong length){
+    png_byte header[8];
+    png_save_uint_32(header, length);
+    memcpy(&header[4], type, 4);
+    uLong crc = crc32(crc32(0L, Z_NULL, 0), &header[4], 4);
+    if (length > 0){
+        crc = crc32(crc, data, length);
+    }
+    png_byte trailer[4];
+    png_save_uint_32(trailer, crc);
+    if (fwrite(header, 1, 8, file) != 8){
+        return false;
+    }
+    if ((length > 0) && (fwrite(data, 1, length, file) != length)){
+        return false;
+    }
+    return (fwrite(trailer, 1, 4, file) == 4);
+}
+
+bool WritePNGParallel(const char* filename, png_bytep buffer, int width, int height, int threads, int level, int strategy){
+    int rowbytes = width * 4;
+    int bandrows = PNG_PARALLEL_BAND_BYTES / (rowbytes + 1);
+    if (bandrows < 1){
+        bandrows = 1;
+    }
+    std::vector<deflateband> bands((height + bandrows - 1) / bandrows);
+    for (size_t i=0; i<bands.size(); i++){
+        bands[i].firstrow = i * bandrows;
+        bands[i].rows = ((bands[i].firstrow + bandrows) > height) ? (height - bands[i].firstrow) : bandrows;
+    }
+
+    // compress
+    if (threads < 1){
+        threads = 1;
+    }
+    if (threads > (int)bands.size()){
+        threads = bands.size();
+    }
+    int nextband = 0;
+    std::mutex bandmtx;
+    std::vector<std::thread> workers;
+    for (int i=0; i<threads; i++){
+        workers.push_back(std::thread(deflatebandworker, buffer, width, height, level, strategy, &bands, &nextband, &bandmtx));
+    }
+    for (int i=0; i<threads; i++){
+        workers[i].join();
+    }
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (size_t i=0; i<bands.size(); i++){
+        if (!bands[i].ok){
+            fprintf(stderr, "gamutthingy: write %s: deflate failed\n", filename);
+            return false;
+        }
+        adler = adler32_combine(adler, bands[i].adler, bands[i].length);
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    bool ok = true;
+
+    // signature and same header as png_image_write_to_file() with PNG_FORMAT_RGBA
+    static const png_byte signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    ok = ok && (fwrite(signature, 1, 8, file) == 8);
+    png_byte ihdr[13];
+    png_save_uint_32(&ihdr[0], width);
+    png_save_uint_32(&ihdr[4], height);
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = PNG_COLOR_TYPE_RGBA;
+    ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+    ihdr[11] = PNG_FILTER_TYPE_BASE;
+    ihdr[12] = PNG_INTERLACE_NONE;
+    ok = ok && writechunk(file, "IHDR", ihdr, 13);
+    png_byte srgb = PNG_sRGB_INTENT_PERCEPTUAL;
+    ok = ok && writechunk(file, "sRGB", &srgb, 1);
+
+    // one IDAT per band, with the zlib header in the first one and the adler32 trailer in the last one
+    // the header's level hint is the same as zlib's
+    int effectivelevel = (level < 0) ? 6 : level;
+    png_byte levelflags = (effectivelevel < 2) ? 0 : (effectivelevel < 6) ? 1 : (effectivelevel == 6) ? 2 : 3;
+    if ((strategy == PNG_STRATEGY_HUFFMAN) || (strategy == PNG_STRATEGY_RLE)){
+        levelflags = 0;
+    }
+    png_byte zlibheader[2];
+    zlibheader[0] = 0x78; // deflate, 32K window
+    zlibheader[1] = levelflags << 6;
+    zlibheader[1] += (31 - (((zlibheader[0] << 8) + zlibheader[1]) % 31)) % 31;
+    png_byte zlibtrailer[4];
+    png_save_uint_32(zlibtrailer, adler);
+    std::vector<png_byte> idat;
+    for (size_t i=0; (i<bands.size()) && ok; i++){
+        idat.clear();
+        if (i == 0){
+            idat.insert(idat.end(), zlibheader, zlibheader + 2);
+        }
+        idat.insert(idat.end(), bands[i].compressed.begin(), bands[i].compressed.end());
+        if (i == bands.size() - 1){
+            idat.insert(idat.end(), zlibtrailer, zlibtrailer + 4);
+        }
+        ok = writechunk(file, "IDAT", idat.data(), idat.size());
+        // free as we go
+        std::vector<png_byte>().swap(bands[i].compressed);
+    }
+    ok = ok && writechunk(file, "IEND", NULL, 0);
+
+    if (fclose(file) != 0){
+        ok = false;
+    }
+    if (!ok){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+    }
+    return ok;
+}
+
+// PNG samples are big-endian
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    #define PNG16_SWAP 1
+#else
+    #define PNG16_SWAP 0
+#endif
+
+bool ReadPNG16(const char* filename, std::vector<png_uint_16> &pixels, int &width, int &height, int &channels){
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    png_byte signature[8];
+    if ((fread(signature, 1, 8, file) != 8) || (png_sig_cmp(signature, 0, 8) != 0)){
+        fprintf(stderr, "gamutthingy: %s: Not a PNG file\n", filename);
+        fclose(file);
+        return false;
+    }
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = NULL;
+    if (png != NULL){
+        info = png_create_info_struct(png);
+    }
+    if (info == NULL){
+        fprintf(stderr, "gamutthingy: %s: out of memory\n", filename);
+        png_destroy_read_struct(&png, NULL, NULL);
+        fclose(file);
+        return false;
+    }
+    std::vector<png_bytep> rows;
+    // libpng has already printed the error if we land here
+    if (setjmp(png_jmpbuf(png))){
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        return false;
+    }
+    png_init_io(png, file);
+    png_set_sig_bytes(png, 8);
+    png_read_info(png, info);
+
+    width = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    int colortype = png_get_color_type(png, info);
+    png_set_expand(png);
+    png_set_expand_16(png);
+    if ((colortype & PNG_COLOR_MASK_COLOR) == 0){
+        png_set_gray_to_rgb(png);
+    }
+    if (PNG16_SWAP){
+        png_set_swap(png);
+    }
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    channels = png_get_channels(png, info);
+    if ((png_get_bit_depth(png, info) != 16) || ((channels != 3) && (channels != 4))){
+        fprintf(stderr, "gamutthingy: %s: Could not convert to 16-bit RGB\n", filename);
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        return false;
+    }
+    pixels.resize((size_t)width * height * channels);
+    rows.resize(height);
+    for (int y=0; y<height; y++){
+        rows[y] = (png_bytep)&pixels[(size_t)y * width * channels];
+    }
+    png_read_image(png, rows.data());
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(file);
+    return true;
+}
+
+bool WritePNG16(const char* filename, const png_uint_16* pixels, int width, int height, int channels, int level, int strategy){
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = NULL;
+    if (png != NULL){
+        info = png_create_info_struct(png);
+    }
+    if (info == NULL){
+        fprintf(stderr, "gamutthingy: write %s: out of memory\n", filename);
+        png_destroy_write_struct(&png, NULL);
+        fclose(file);
+        return false;
+    }
+    std::vector<png_bytep> rows;
+    if (setjmp(png_jmpbuf(png))){
+        png_destroy_write_struct(&png, &info);
+        fclose(file);
+        return false;
+    }
+    png_init_io(png, file);
+    png_set_IHDR(png, info, width, height, 16, (channels == 4) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    png_set_sRGB(png, info, PNG_sRGB_INTENT_PERCEPTUAL);
+    png_set_compression_level(png, level);
+    png_set_compression_strategy(png, strategy);
+    png_write_info(png, info);
+    if (PNG16_SWAP){
+        png_set_swap(png);
+    }
+    rows.resize(height);
+    for (int y=0; y<height; y++){
+        rows[y] = (png_bytep)&pixels[(size_t)y * width * channels];
+    }
+    png_write_image(png, rows.data());
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+    bool ok = (fclose(file) == 0);
+    if (!ok){
+        fprintf(stderr, "gamutthingy: write %s: %s\n", filename, strerror(errno));
+    }
+    return ok;
+}
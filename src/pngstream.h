@@ -0,0 +1,85 @@
+#ifndef PNGSTREAM_H
+#define PNGSTREAM_H
+
+#include "constants.h"
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <png.h> // Linux should have libpng-dev installed; Windows users can figure stuff out.
+
+// target uncompressed size of each independently deflated band for WritePNGParallel()
+// (at least one row per band; rows of a 256^3 LUT are 256KiB, so that's one row per band)
+#define PNG_PARALLEL_BAND_BYTES 262144
+// deflate window size; each band is primed with this much of the preceding data as a preset dictionary
+#define PNG_DEFLATE_WINDOW 32768
+
+// Row-at-a-time PNG reading and writing for streaming mode, using the low-level libpng API
+// so that we never need to hold the whole image in memory.
+// Rows are always 8-bit RGBA (same as PNG_FORMAT_RGBA with the simplified png_image API),
+// and the read transformations mirror what png_image_finish_read() does for that format,
+// so a streamed image converts to the same pixels as a whole-image read.
+// All functions print an error and return false on failure. Close() is safe to call at any time.
+
+class pngrowreader{
+public:
+    png_structp png = NULL;
+    png_infop info = NULL;
+    FILE* file = NULL;
+    int width = 0;
+    int height = 0;
+    // interlaced images can't be read a few rows at a time; ReadRows() must be given the whole image in one call
+    bool interlaced = false;
+    int rowsread = 0;
+
+    bool Open(const char* filename);
+    // reads the next rows rows into buffer (width * 4 bytes per row)
+    bool ReadRows(png_bytep buffer, int rows);
+    void Close();
+};
+
+class pngrowwriter{
+public:
+    png_structp png = NULL;
+    png_infop info = NULL;
+    FILE* file = NULL;
+    int width = 0;
+    int height = 0;
+    int rowswritten = 0;
+    // zlib compression level (0-9) and strategy (see PNG_STRATEGY_* in constants.h)
+    int level = 6;
+    int strategy = PNG_STRATEGY_FILTERED;
+
+    // the image is written to a temporary file next to filename, which replaces filename only when Close() is called after the last row
+    // (so the input can be the output, and a failed conversion doesn't leave a truncated file behind)
+    bool Open(const char* filename, int imagewidth, int imageheight);
+    // writes the next rows rows from buffer (width * 4 bytes per row); finishes the file after the last row
+    bool WriteRows(png_bytep buffer, int rows);
+    // returns false if a finished image couldn't be moved into place; an unfinished one is just deleted
+    bool Close();
+
+private:
+    std::string name;
+    std::string tempname;
+    bool complete = false; // all rows were written and flushed
+};
+
+// Writes a whole 8-bit RGBA image (width * 4 bytes per row) to a PNG file, pigz-style:
+// the image is split into bands of rows, and threads threads filter and deflate the bands independently.
+// Each band after the first uses the last PNG_DEFLATE_WINDOW bytes of the preceding filtered data as a preset dictionary,
+// and ends with a sync flush so the bands can simply be concatenated into a single valid zlib stream
+// (with the adler32 checksums of the bands combined for the trailer).
+// Rows are filtered with libpng's heuristic (whichever filter gives the smallest sum of absolute values),
+// so the result decodes identically to, and is about the same size as, png_image_write_to_file() at the same level and strategy.
+bool WritePNGParallel(const char* filename, png_bytep buffer, int width, int height, int threads, int level, int strategy);
+
+// Whole-image 16-bit PNG reading and writing for --png16, using the low-level libpng API.
+// Pixels are native-endian 16-bit samples, channels (3 or 4) per pixel; there's alpha if the file has alpha or transparency.
+// Lower bit depths, palettes, and grayscale are expanded to 16-bit RGB(A).
+// Unlike the 8-bit paths, no gamma correction is done: samples are taken as they are (the way 8-bit files without a gAMA chunk are),
+// so they're interpreted with --gamma-in.
+bool ReadPNG16(const char* filename, std::vector<png_uint_16> &pixels, int &width, int &height, int &channels);
+// header is the same as the 8-bit writers' except for the bit depth (and no alpha if channels is 3)
+bool WritePNG16(const char* filename, const png_uint_16* pixels, int width, int height, int channels, int level, int strategy);
+
+#endif
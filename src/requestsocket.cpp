@@ -0,0 +1,102 @@
+#include "requestsocket.h"
+
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+    #define REQUESTSOCKET_UNIX 0
+#else
+    #define REQUESTSOCKET_UNIX 1
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if REQUESTSOCKET_UNIX
+
+int OpenRequestSocket(const char* path){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)){
+        fprintf(stderr, "gamutthingy: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    // a socket left behind by a previous server would make bind() fail, so remove it,
+    // but don't touch anything else that happens to be at path
+    struct stat info;
+    if (lstat(path, &info) == 0){
+        if (!S_ISSOCK(info.st_mode)){
+            fprintf(stderr, "gamutthingy: %s: File exists and is not a socket\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0){
+        fprintf(stderr, "gamutthingy: socket: %s\n", strerror(errno));
+        return -1;
+    }
+    if ((bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0) || (listen(listener, 8) != 0)){
+        fprintf(stderr, "gamutthingy: %s: %s\n", path, strerror(errno));
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+bool AcceptRequestClient(int listener, FILE* &input, FILE* &output){
+    int client;
+    do {
+        client = accept(listener, NULL, NULL);
+    } while ((client < 0) && (errno == EINTR));
+    if (client < 0){
+        fprintf(stderr, "gamutthingy: accept: %s\n", strerror(errno));
+        return false;
+    }
+    int clientout = dup(client);
+    input = fdopen(client, "r");
+    output = (clientout >= 0) ? fdopen(clientout, "w") : NULL;
+    if ((input == NULL) || (output == NULL)){
+        fprintf(stderr, "gamutthingy: fdopen: %s\n", strerror(errno));
+        if (input != NULL){
+            fclose(input);
+        }
+        else {
+            close(client);
+        }
+        if (output != NULL){
+            fclose(output);
+        }
+        else if (clientout >= 0){
+            close(clientout);
+        }
+        return false;
+    }
+    return true;
+}
+
+void CloseRequestSocket(int listener, const char* path){
+    close(listener);
+    unlink(path);
+    return;
+}
+
+#else
+
+int OpenRequestSocket(const char* path){
+    fprintf(stderr, "gamutthingy: request sockets are not supported on this platform; use stdin/stdout instead\n");
+    return -1;
+}
+
+bool AcceptRequestClient(int listener, FILE* &input, FILE* &output){
+    return false;
+}
+
+void CloseRequestSocket(int listener, const char* path){
+    return;
+}
+
+#endif
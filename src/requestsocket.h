@@ -0,0 +1,18 @@
+#ifndef REQUESTSOCKET_H
+#define REQUESTSOCKET_H
+
+#include <stdio.h>
+
+// Local request socket for server mode: a Unix domain socket at a filesystem path.
+// Clients connect one at a time and talk the same line protocol as server mode on stdin/stdout.
+// Not available on Windows, where server mode only talks over stdin/stdout.
+// All functions print an error and return failure (-1 or false) on failure.
+
+// creates the socket at path (replacing any stale socket there, but failing if something else is there) and listens on it; returns the socket or -1
+int OpenRequestSocket(const char* path);
+// waits for the next client, and makes FILE*s for reading its requests and writing replies (the caller closes both)
+bool AcceptRequestClient(int listener, FILE* &input, FILE* &output);
+// closes the socket and removes it from the filesystem
+void CloseRequestSocket(int listener, const char* path);
+
+#endif
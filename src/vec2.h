@@ -1,6 +1,12 @@
 #ifndef VEC2_H
 #define VEC2_H
 
+#include "constants.h"
+
+#include <math.h>
+
+// Everything but printout() is defined inline here so that it can be inlined into the hot paths in other translation units.
+
 // 2D stuff
 class vec2 {
 public:
@@ -8,8 +14,8 @@ public:
     double y;
     
     // constructors
-    vec2();
-    vec2(double x, double y);
+    constexpr vec2() : x(0), y(0) {}
+    constexpr vec2(double a, double b) : x(a), y(b) {}
     
     // operators
     vec2 operator+(vec2 const& other){
@@ -39,32 +45,91 @@ public:
     
     // functions
     // normalizes the vector in place
-    void normalize();
+    void normalize(){
+        double mag= magnitude();
+        x /= mag;
+        y /= mag;
+    }
     // returns a normalized copy of the vector without altering the original
-    vec2 normalizedcopy();
-    double magnitude();
+    vec2 normalizedcopy(){
+        double mag = magnitude();
+        vec2 output;
+        output.x = x / mag;
+        output.y = y / mag;
+        return output;
+    }
+    double magnitude(){
+        return sqrt((x * x) + (y * y));
+    }
     // screen barf
     void printout();
-    bool isequal(vec2 other);
+    bool isequal(vec2 other){
+        if (fabs(x - other.x) > EPSILON) return false;
+        if (fabs(y - other.y) > EPSILON) return false;
+        return true;
+    }
 };
 
-double DotProduct(vec2 A, vec2 B);
+inline double DotProduct(vec2 A, vec2 B){
+    return (A.x * B.x) + (A.y * B.y);
+}
 
 // returns clockwise angle (in radians) between two vectors
-double clockwiseAngle(vec2 A, vec2 B);
+// see https://stackoverflow.com/questions/14066933/direct-way-of-computing-the-clockwise-angle-between-two-vectors
+inline double clockwiseAngle(vec2 A, vec2 B){
+    double dot = DotProduct(A, B);
+    double det = (B.x * A.y) - (B.y * A.x);
+    return atan2(det, dot);
+}
 
 // finds the intersection between lines AB and CD and puts the result in output
 // returns false if parallel; otherwise true
-bool lineIntersection2D(vec2 A, vec2 B, vec2 C, vec2 D, vec2 &output);
+inline bool lineIntersection2D(vec2 A, vec2 B, vec2 C, vec2 D, vec2 &output){
+    double a1 = B.y - A.y;
+    double b1 = A.x - B.x;
+    double c1 = (a1 * A.x) + (b1 * A.y);
+
+    double a2 = D.y - C.y;
+    double b2 = C.x - D.x;
+    double c2 = (a2 * C.x) + (b2 * C.y);
+
+    double determinant = (a1 * b2) - (a2 * b1);
+
+    if (fabs(determinant) < EPSILONZERO){
+        return false;
+    }
+
+    output.x = ((b2 * c1) - (b1 * c2)) / determinant;
+    output.y = ((a1 * c2) - (a2 * c1)) / determinant;
+    return true;
+}
 
 // assuming A, B, and C are on a line, returns true if B is between A and C; otherwise false
 // may fail if all 3 x values or all 3 y values are nearly the same but for floating point errors 
-bool isBetween2D(vec2 A, vec2 B, vec2 C);
+inline bool isBetween2D(vec2 A, vec2 B, vec2 C){
+    return (
+        (((A.x >= B.x) && (B.x >= C.x)) || ((A.x <= B.x) && (B.x <= C.x))) &&
+        (((A.y >= B.y) && (B.y >= C.y)) || ((A.y <= B.y) && (B.y <= C.y)))
+    );
+}
 
 // assuming A, B, and C are on a line, returns true if B is between A and C; otherwise false
 // fixes the floating point issue with isBetween2D() at the cost of being slow
-bool slowIsBetween2D(vec2 A, vec2 B, vec2 C);
+inline bool slowIsBetween2D(vec2 A, vec2 B, vec2 C){
+    bool axisbx = (fabs(A.x - B.x) < EPSILONZERO);
+    bool bxiscx = (fabs(B.x - C.x) < EPSILONZERO);
+    bool ayisby = (fabs(A.y - B.y) < EPSILONZERO);
+    bool byiscy = (fabs(B.y - C.y) < EPSILONZERO);
+    return (
+        (((A.x >= B.x) && (B.x >= C.x)) || ((A.x <= B.x) && (B.x <= C.x)) || axisbx || bxiscx) &&
+        (((A.y >= B.y) && (B.y >= C.y)) || ((A.y <= B.y) && (B.y <= C.y)) || ayisby || byiscy)
+    );
+}
 
-double distance2D(vec2 A, vec2 B);
+inline double distance2D(vec2 A, vec2 B){
+    double xdiff = B.x - A.x;
+    double ydiff = B.y - A.y;
+    return sqrt((xdiff * xdiff) + (ydiff * ydiff));
+}
 
 #endif
@@ -2,49 +2,8 @@
 #include "constants.h"
 
 #include <stdio.h>
-#ifdef _WIN32
-#include <cmath>
-#else
-#include <math.h>
-#endif
 
-#include <numbers>
-
-
-vec3:: vec3(){ x = y = z = 0;}
-
-vec3::vec3(double a, double b, double c){
-    x = a;
-    y = b;
-    z = c;
-}
-
-double vec3::magnitude(){
-    return sqrt((x * x) + (y * y) + (z * z));
-}
-
-// assumes a LCh style colorspace and outputs the radians hue value as degrees
-double vec3::polarangle(){
-    return z * (180.0 / std::numbers::pi_v<long double>);
-}
-
-// normalizes the vector in place
-void vec3::normalize(){
-    double mag= magnitude();
-    x /= mag;
-    y /= mag;
-    z /= mag;
-}
-
-// returns a normalized copy of the vector without altering the original
-vec3 vec3::normalizedcopy(){
-    double mag = magnitude();
-    vec3 output;
-    output.x = x / mag;
-    output.y = y / mag;
-    output.z = z / mag;
-    return output;
-}
+// (the rest of vec3 is inline in vec3.h)
 
 // screen barf
 void vec3::printout(){
@@ -59,44 +18,6 @@ bool vec3::isequal(vec3 other){
     return true;
 }
 
-double DotProduct(vec3 A, vec3 B){
-    return (A.x * B.x) + (A.y * B.y) + (A.z * B.z);
-}
-
-vec3 CrossProduct(vec3 A, vec3 B){
-    vec3 output;
-    output.x = (A.y * B.z) - (A.z * B.y);
-    output.y = (A.z * B.x) - (A.x * B.z);
-    output.z = (A.x * B.y) - (A.y * B.x);
-    return output;
-}
-
-// converts LAB-style colorspaces to their polar LCh-style cousins
-// h is in radians
-vec3 Polarize(vec3 input){
-    vec3 output;
-    output.x = input.x;
-    output.y = sqrt((input.y * input.y) + (input.z * input.z));
-    output.z = atan2(input.z, input.y);
-    if (output.z < 0){
-        output.z += 2.0 * std::numbers::pi_v<long double>;
-    }
-    
-    return output;
-}
-
-// converts LCh-style colorpaces back to their LAB-style cartesian cousins
-// h is in radians
-vec3 Depolarize(vec3 input){
-    vec3 output;
-    output.x = input.x;
-    output.y = input.y * cos(input.z);
-    output.z = input.y * sin(input.z);
-    
-    
-    return output;
-}
-
 // not used?
 /*
 // returns true if point B is between A and C
@@ -107,34 +28,3 @@ bool between(vec3 A, vec3 B, vec3 C){
     return xOK && yOK && zOK;
 }
 */
-
-// convert xyY to XYZ
-vec3 xyYtoXYZ(vec3 input){
-    /*
-    X= xY/y
-    Y=Y
-    Z=((1-x-y)Y)/y
-    */
-    double X = (input.x * input.z)/input.y;
-    double Z = ((1.0 - input.x - input.y) * input.z)/input.y;
-    return vec3(X, input.z, Z);
-}
-
-vec3 XYZtoxyY(vec3 input){
-    /*
-    x= X/(X+Y+Z)
-    y= Y/(X+Y+Z)
-    Y=Y
-    */
-    double sum = input.x + input.y + input.z;
-    double x = input.x/sum;
-    double y = input.y/sum;
-    return vec3(x, y, input.y);
-}
-
-double Distance3D(vec3 A, vec3 B){
-    double dx = A.x - B.x;
-    double dy = A.y - B.y;
-    double dz = A.z - B.z;
-    return std::sqrt((dx * dx) + (dy * dy) + (dz * dz));
-}